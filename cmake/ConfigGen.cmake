@@ -71,6 +71,10 @@ function(caffe_generate_export_configs)
     list(APPEND Caffe_DEFINITIONS -DUSE_LEVELDB)
   endif()
 
+  if(USE_LIBJPEG)
+    list(APPEND Caffe_DEFINITIONS -DUSE_LIBJPEG)
+  endif()
+
   if(NOT HAVE_CUDNN)
     set(HAVE_CUDNN FALSE)
   else()
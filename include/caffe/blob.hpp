@@ -262,6 +262,32 @@ class Blob {
    * shared_ptr calls its destructor when reset with the "=" operator.
    */
   void ShareDiff(const Blob& other);
+  /**
+   * @brief Set the data_ shared_ptr to point to a SyncedMemory of at least
+   *        count() elements -- used by Net to let blobs whose lifetimes do not
+   *        overlap share one (possibly larger) buffer.
+   *
+   * Like ShareData, this deallocates the SyncedMemory previously holding this
+   * Blob's data_ if no one else refers to it. A later Reshape to a larger
+   * count allocates fresh memory for the Blob again.
+   */
+  void ShareDataMemory(const shared_ptr<SyncedMemory>& memory);
+  /**
+   * @brief Set the data_ shared_ptr to a view of the count() elements of the
+   *        data_ of Blob other starting at offset -- used by Net to let the
+   *        parts of a concatenation be computed in place.
+   *
+   * Writing the data of this Blob then writes that range of other's data. A
+   * later Reshape to a larger count allocates fresh memory for the Blob again.
+   */
+  void ShareDataView(const Blob& other, int offset);
+  /// @brief The same as ShareDataView, for the diff_.
+  void ShareDiffView(const Blob& other, int offset);
+  /**
+   * @brief Give the Blob fresh memory of its own for its data_ and diff_,
+   *        ending any sharing set up by the methods above.
+   */
+  void UnshareMemory();
 
   bool ShapeEquals(const BlobProto& other);
 
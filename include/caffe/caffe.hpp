@@ -11,6 +11,7 @@
 #include "caffe/layer_factory.hpp"
 #include "caffe/net.hpp"
 #include "caffe/parallel.hpp"
+#include "caffe/pipeline.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/solver.hpp"
 #include "caffe/solver_factory.hpp"
@@ -105,6 +105,7 @@ class Caffe {
   static Caffe& Get();
 
   enum Brew { CPU, GPU };
+  enum HostAllocatorType { MALLOC, POOLED };
 
   // This random number generator facade hides boost and CUDA rng
   // implementation from one another (for cross-platform compatibility).
@@ -154,6 +155,26 @@ class Caffe {
   inline static void set_solver_count(int val) { Get().solver_count_ = val; }
   inline static bool root_solver() { return Get().root_solver_; }
   inline static void set_root_solver(bool val) { Get().root_solver_ = val; }
+  // Host memory allocation (see caffe/util/host_allocator.hpp). Unlike the
+  // settings above these are process-wide rather than per thread, since host
+  // memory may be freed by another thread than the one that allocated it.
+  // Changing them only affects memory allocated afterwards.
+  static HostAllocatorType host_allocator();
+  static void set_host_allocator(HostAllocatorType type);
+  // Whether the pooled allocator backs large blocks with huge pages.
+  static bool host_huge_pages();
+  static void set_host_huge_pages(bool val);
+  // Threads of the process-wide pool running the parallel_for loops of the
+  // CPU layers (see caffe/util/thread_pool.hpp), by default one per core.
+  // Setting it also sets the thread count of MKL and OpenBLAS, so that the
+  // loops and the GEMMs between them use the same cores. Set it before
+  // starting other threads that run loops.
+  static int cpu_threads();
+  static void set_cpu_threads(int threads);
+  // Whether the worker threads of the pool are pinned to one core each;
+  // the thread starting the loops is not pinned.
+  static bool cpu_thread_affinity();
+  static void set_cpu_thread_affinity(bool val);
 
  protected:
 #ifndef CPU_ONLY
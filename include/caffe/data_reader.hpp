@@ -19,18 +19,24 @@ namespace caffe {
  * databases are read sequentially, and that each solver accesses a different
  * subset of the database. Data is distributed to solvers in a round-robin
  * way to keep parallel training deterministic.
+ *
+ * With DataParameter.readers larger than 1, the body starts more threads,
+ * each with its own cursor: reader r reads records r, r + readers, ... of
+ * the database. If ordered_read, each reader fills its own queue pair per
+ * solver, which the solver takes datums from in turn, so that they arrive
+ * in the same order as with a single reader.
  */
 class DataReader {
  public:
   explicit DataReader(const LayerParameter& param);
   ~DataReader();
 
-  inline BlockingQueue<Datum*>& free() const {
-    return queue_pair_->free_;
-  }
-  inline BlockingQueue<Datum*>& full() const {
-    return queue_pair_->full_;
-  }
+  // Takes the next datum, which must be given back with push once used.
+  Datum* pop(const string& log_on_wait = "");
+  // Returns the next datum without taking it.
+  Datum* peek();
+  // Gives back a datum, in the order pop took them.
+  void push(Datum* datum);
 
  protected:
   // Queue pairs are shared between a body and its readers
@@ -52,11 +58,35 @@ class DataReader {
     virtual ~Body();
 
    protected:
+    // A thread reading every readers_ records, from its own cursor.
+    class Reader : public InternalThread {
+     public:
+      Reader(Body* body, db::Cursor* cursor, uint64_t record)
+          : body_(body), cursor_(cursor), record_(record) {}
+      virtual ~Reader();
+
+     protected:
+      void InternalThreadEntry();
+
+      Body* body_;
+      db::Cursor* cursor_;
+      uint64_t record_;
+    };
+
     void InternalThreadEntry();
     void read_one(db::Cursor* cursor, QueuePair* qp);
+    // Reads *record into the queues of its solver, then moves the cursor
+    // and *record on to the next record of the same reader.
+    void read_record(db::Cursor* cursor, uint64_t* record);
+    static void next(db::Cursor* cursor);
 
     const LayerParameter param_;
     BlockingQueue<shared_ptr<QueuePair> > new_queue_pairs_;
+    // The queue pairs of each solver in turn, queue_pairs_ of them each.
+    vector<shared_ptr<QueuePair> > qps_;
+    const int readers_;
+    const int queue_pairs_;
+    int solver_count_;
 
     friend class DataReader;
 
@@ -69,7 +99,11 @@ class DataReader {
     return param.name() + ":" + param.data_param().source();
   }
 
-  const shared_ptr<QueuePair> queue_pair_;
+  // The queue pairs the datums are taken from in turn: one per reader if
+  // ordered_read, else a single one all the readers fill.
+  vector<shared_ptr<QueuePair> > queue_pairs_;
+  int pop_index_;
+  int push_index_;
   shared_ptr<Body> body_;
 
   static map<const string, boost::weak_ptr<DataReader::Body> > bodies_;
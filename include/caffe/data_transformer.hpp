@@ -139,6 +139,24 @@ class DataTransformer {
   virtual int Rand(int n);
 
   void Transform(const Datum& datum, Dtype* transformed_data);
+  // Transforms a crop of an 8-bit image with interleaved channels, as in a
+  // cv::Mat: pixel (h, w) of the crop is at crop[h * step + w * img_channels],
+  // and the crop starts at (h_off, w_off) of the img_height x img_width image,
+  // which the mean_file must match.
+  void TransformImage(const unsigned char* crop, int step, int img_channels,
+      int img_height, int img_width, int h_off, int w_off, bool do_mirror,
+      Blob<Dtype>* transformed_blob);
+#ifdef USE_LIBJPEG
+  // Transforms an encoded datum decoded by libjpeg, at a reduced scale if
+  // decode_min_size allows and only over the crop. Returns false if it is
+  // not a JPEG image libjpeg can decode.
+  bool TransformJPEG(const Datum& datum, Blob<Dtype>* transformed_blob);
+  // The color flag of the JPEG decoder for force_color and force_gray.
+  int DecodeColor() const;
+  // The size the JPEG decoder may scale the sides of the images down to, or
+  // 0 to decode them at their size.
+  int DecodeMinSize() const;
+#endif  // USE_LIBJPEG
   // Tranformation parameters
   TransformationParameter param_;
 
@@ -147,6 +165,8 @@ class DataTransformer {
   Phase phase_;
   Blob<Dtype> data_mean_;
   vector<Dtype> mean_values_;
+  // The pixels of the last image the JPEG decoder decoded.
+  vector<unsigned char> decode_buffer_;
 };
 
 }  // namespace caffe
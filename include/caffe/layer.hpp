@@ -282,6 +282,46 @@ class Layer {
    */
   virtual inline bool AutoTopBlobs() const { return false; }
 
+  /**
+   * @brief Return whether the top blobs hold the data of the first bottom blob
+   *        by reference instead of owning their own memory.
+   *
+   * Layers such as Split, Flatten, and Reshape implement Forward by sharing
+   * the bottom data with their tops. Net memory planning needs to know this
+   * so that it treats the bottom and such tops as a single buffer.
+   */
+  virtual inline bool TopsShareBottomData() const { return false; }
+
+  /**
+   * @brief Return whether Forward draws from the random number generator of
+   *        Caffe, as Dropout does at training time.
+   *
+   * The generator belongs to the calling thread, so nets running layers
+   * concurrently run such layers in order on the thread calling Forward:
+   * they draw the same numbers as in a sequential pass.
+   */
+  virtual inline bool UsesCaffeRNG() const { return false; }
+
+  /**
+   * @brief Return the offset, in elements, at which the data of a bottom blob
+   *        lies in the data of the first top blob as one contiguous range, or
+   *        -1 if it does not.
+   *
+   * Concat returns the offsets of its bottoms when they are contiguous parts
+   * of the top, so that the net can make them views of the top (see
+   * NetParameter.share_blob_views) and the layer need not copy them. Only
+   * valid after Reshape.
+   */
+  virtual inline int BottomOffsetInTop(int bottom_index) const { return -1; }
+
+  /**
+   * @brief Return the offset, in elements, at which the data of a top blob
+   *        lies in the data of the first bottom blob as one contiguous range,
+   *        or -1 if it does not -- the counterpart of BottomOffsetInTop, for
+   *        Slice.
+   */
+  virtual inline int TopOffsetInBottom(int top_index) const { return -1; }
+
   /**
    * @brief Return whether to allow force_backward for a given bottom blob
    *        index.
@@ -6,7 +6,10 @@
 #include "caffe/blob.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/conv_workspace.hpp"
+#include "caffe/util/depthwise_conv.hpp"
 #include "caffe/util/im2col.hpp"
+#include "caffe/util/packed_gemm.hpp"
 
 namespace caffe {
 
@@ -19,6 +22,7 @@ class BaseConvolutionLayer : public Layer<Dtype> {
  public:
   explicit BaseConvolutionLayer(const LayerParameter& param)
       : Layer<Dtype>(param) {}
+  virtual ~BaseConvolutionLayer() { ConvWorkspace::Register(this, 0); }
   virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
@@ -35,11 +39,72 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   void forward_cpu_gemm(const Dtype* input, const Dtype* weights,
       Dtype* output, bool skip_im2col = false);
   void forward_cpu_bias(Dtype* output, const Dtype* bias);
+  // Adds the bias, if any, to output and applies the fused activation, if
+  // any, in the same pass over it.
+  void forward_cpu_bias_activation(Dtype* output);
+  // Multiplies the diffs of top by the derivative of the fused activation,
+  // making them the diffs of the convolution outputs.
+  void backward_cpu_activation(const vector<Blob<Dtype>*>& top);
   void backward_cpu_gemm(const Dtype* input, const Dtype* weights,
       Dtype* output);
   void weight_cpu_gemm(const Dtype* input, const Dtype* output, Dtype*
       weights);
   void backward_cpu_bias(Dtype* bias, const Dtype* input);
+  // Versions of forward_cpu_gemm and weight_cpu_gemm for num consecutive
+  // images, at most gemm_batch_, that run one GEMM per group for all of them.
+  void forward_cpu_gemm_batch(const Dtype* input, const Dtype* weights,
+      Dtype* output, int num);
+  void weight_cpu_gemm_batch(const Dtype* input, const Dtype* output,
+      Dtype* weights, int num);
+  // Direct versions of forward_cpu_gemm, backward_cpu_gemm and
+  // weight_cpu_gemm for depthwise convolution, used when depthwise_ is set.
+  inline void forward_cpu_depthwise(const Dtype* input, const Dtype* weights,
+      Dtype* output) {
+    depthwise_conv_cpu(input, channels_, conv_input_shape_.cpu_data()[1],
+        conv_input_shape_.cpu_data()[2], weights, num_output_ / group_,
+        kernel_shape_.cpu_data()[0], kernel_shape_.cpu_data()[1],
+        pad_.cpu_data()[0], pad_.cpu_data()[1],
+        stride_.cpu_data()[0], stride_.cpu_data()[1],
+        dilation_.cpu_data()[0], dilation_.cpu_data()[1],
+        output_shape_[0], output_shape_[1], output);
+  }
+  // Versions of forward_cpu_depthwise and forward_cpu_bias_activation for
+  // the channel-blocked layout, used when the layer has a channel_block.
+  inline void forward_cpu_depthwise_blocked(const Dtype* input,
+      const Dtype* weights, Dtype* output) {
+    depthwise_conv_blocked_cpu(input, channels_,
+        static_cast<int>(this->layer_param_.channel_block()),
+        conv_input_shape_.cpu_data()[1], conv_input_shape_.cpu_data()[2],
+        weights, kernel_shape_.cpu_data()[0], kernel_shape_.cpu_data()[1],
+        pad_.cpu_data()[0], pad_.cpu_data()[1],
+        stride_.cpu_data()[0], stride_.cpu_data()[1],
+        dilation_.cpu_data()[0], dilation_.cpu_data()[1],
+        output_shape_[0], output_shape_[1], output);
+  }
+  void forward_cpu_bias_activation_blocked(Dtype* output);
+  inline void backward_cpu_depthwise(const Dtype* output,
+      const Dtype* weights, Dtype* input) {
+    caffe_set(bottom_dim_, Dtype(0), input);
+    depthwise_conv_backward_data_cpu(output, channels_,
+        conv_input_shape_.cpu_data()[1], conv_input_shape_.cpu_data()[2],
+        weights, num_output_ / group_,
+        kernel_shape_.cpu_data()[0], kernel_shape_.cpu_data()[1],
+        pad_.cpu_data()[0], pad_.cpu_data()[1],
+        stride_.cpu_data()[0], stride_.cpu_data()[1],
+        dilation_.cpu_data()[0], dilation_.cpu_data()[1],
+        output_shape_[0], output_shape_[1], input);
+  }
+  inline void weight_cpu_depthwise(const Dtype* input, const Dtype* output,
+      Dtype* weights) {
+    depthwise_conv_backward_weights_cpu(input, channels_,
+        conv_input_shape_.cpu_data()[1], conv_input_shape_.cpu_data()[2],
+        output, num_output_ / group_,
+        kernel_shape_.cpu_data()[0], kernel_shape_.cpu_data()[1],
+        pad_.cpu_data()[0], pad_.cpu_data()[1],
+        stride_.cpu_data()[0], stride_.cpu_data()[1],
+        dilation_.cpu_data()[0], dilation_.cpu_data()[1],
+        output_shape_[0], output_shape_[1], weights);
+  }
 
 #ifndef CPU_ONLY
   void forward_gpu_gemm(const Dtype* col_input, const Dtype* weights,
@@ -50,6 +115,8 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   void weight_gpu_gemm(const Dtype* col_input, const Dtype* output, Dtype*
       weights);
   void backward_gpu_bias(Dtype* bias, const Dtype* input);
+  void forward_gpu_activation(const vector<Blob<Dtype>*>& top);
+  void backward_gpu_activation(const vector<Blob<Dtype>*>& top);
 #endif
 
   /// @brief The spatial dimensions of the input.
@@ -92,8 +159,21 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   bool bias_term_;
   bool is_1x1_;
   bool force_nd_im2col_;
+  /// @brief Images per GEMM for the batched CPU helpers (1 if unbatched).
+  int gemm_batch_;
+  /// @brief Whether the CPU passes use the direct depthwise kernels, which is
+  ///        the case for 2D convolution with group == channels, unless
+  ///        col_buffer_limit or batch_gemm_limit asks for tiled or batched
+  ///        GEMMs.
+  bool depthwise_;
 
  private:
+  // Points col_buffer_ at the column workspace shared by all convolutions on
+  // the calling thread; its contents only last until another layer uses it.
+  inline void borrow_col_buffer() {
+    col_buffer_.ShareDataMemory(ConvWorkspace::Get().Reserve(
+        col_buffer_.count() * sizeof(Dtype)));
+  }
   // wrap im2col/col2im so we don't have to remember the (long) argument lists
   inline void conv_im2col_cpu(const Dtype* data, Dtype* col_buff) {
     if (!force_nd_im2col_ && num_spatial_axes_ == 2) {
@@ -123,6 +203,38 @@ class BaseConvolutionLayer : public Layer<Dtype> {
           pad_.cpu_data(), stride_.cpu_data(), dilation_.cpu_data(), data);
     }
   }
+  // The same for image n of a batch whose columns lie side by side.
+  inline void conv_im2col_batch_cpu(const Dtype* data, int n, int num,
+      Dtype* col_buff) {
+    im2col_strided_cpu(data, conv_in_channels_,
+        conv_input_shape_.cpu_data()[1], conv_input_shape_.cpu_data()[2],
+        kernel_shape_.cpu_data()[0], kernel_shape_.cpu_data()[1],
+        pad_.cpu_data()[0], pad_.cpu_data()[1],
+        stride_.cpu_data()[0], stride_.cpu_data()[1],
+        dilation_.cpu_data()[0], dilation_.cpu_data()[1],
+        num * conv_out_spatial_dim_, col_buff + n * conv_out_spatial_dim_);
+  }
+  // The same for the strip [row_begin, row_end) of the column image.
+  inline void conv_im2col_rows_cpu(const Dtype* data, int row_begin,
+      int row_end, Dtype* col_buff) {
+    im2col_rows_cpu(data, conv_in_channels_,
+        conv_input_shape_.cpu_data()[1], conv_input_shape_.cpu_data()[2],
+        kernel_shape_.cpu_data()[0], kernel_shape_.cpu_data()[1],
+        pad_.cpu_data()[0], pad_.cpu_data()[1],
+        stride_.cpu_data()[0], stride_.cpu_data()[1],
+        dilation_.cpu_data()[0], dilation_.cpu_data()[1],
+        row_begin, row_end, col_buff);
+  }
+  inline void conv_col2im_rows_cpu(const Dtype* col_buff, int row_begin,
+      int row_end, Dtype* data) {
+    col2im_rows_cpu(col_buff, conv_in_channels_,
+        conv_input_shape_.cpu_data()[1], conv_input_shape_.cpu_data()[2],
+        kernel_shape_.cpu_data()[0], kernel_shape_.cpu_data()[1],
+        pad_.cpu_data()[0], pad_.cpu_data()[1],
+        stride_.cpu_data()[0], stride_.cpu_data()[1],
+        dilation_.cpu_data()[0], dilation_.cpu_data()[1],
+        row_begin, row_end, data);
+  }
 #ifndef CPU_ONLY
   inline void conv_im2col_gpu(const Dtype* data, Dtype* col_buff) {
     if (!force_nd_im2col_ && num_spatial_axes_ == 2) {
@@ -164,9 +276,14 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   int kernel_dim_;
   int col_offset_;
   int output_offset_;
+  // Rows of the column image per strip when the CPU helpers run on strips
+  // to honour col_buffer_limit, or 0 when they run on whole images.
+  int col_tile_rows_;
 
   Blob<Dtype> col_buffer_;
   Blob<Dtype> bias_multiplier_;
+  // The weights packed for the TEST phase forward on the CPU.
+  PackedWeights<Dtype> packed_weights_;
 };
 
 }  // namespace caffe
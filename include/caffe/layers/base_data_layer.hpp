@@ -9,6 +9,7 @@
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/blocking_queue.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -48,7 +49,11 @@ class BaseDataLayer : public Layer<Dtype> {
 template <typename Dtype>
 class Batch {
  public:
+  Batch() : wait_ms_(0) {}
   Blob<Dtype> data_, label_;
+  // The milliseconds the prefetch thread waited for this batch to be free
+  // before loading it.
+  double wait_ms_;
 };
 
 template <typename Dtype>
@@ -67,18 +72,55 @@ class BasePrefetchingDataLayer :
   virtual void Forward_gpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
 
-  // Prefetches batches (asynchronously if to GPU memory)
-  static const int PREFETCH_COUNT = 3;
+  // The number of batches in the prefetch queue, which grows up to the
+  // max_prefetch of the layer parameter when Forward waits for them.
+  int prefetch_depth() const { return prefetch_.size(); }
+  // Counters of the prefetch queue, telling whether the net waits for its
+  // data or the data waits for the net: the batches Forward took, how many
+  // times and milliseconds in total it waited for one to be loaded, and the
+  // milliseconds the prefetch thread waited for those batches to be free.
+  int prefetch_batches() const { return prefetch_batches_; }
+  int prefetch_stalls() const { return prefetch_stalls_; }
+  double consumer_wait_ms() const { return consumer_wait_ms_; }
+  double producer_wait_ms() const { return producer_wait_ms_; }
 
  protected:
   virtual void InternalThreadEntry();
   virtual void load_batch(Batch<Dtype>* batch) = 0;
+  // Pops the next loaded batch for Forward, updating the counters and
+  // growing the queue if it had to wait.
+  Batch<Dtype>* NextBatch();
 
-  Batch<Dtype> prefetch_[PREFETCH_COUNT];
+  // Fills the first items of batch->data_, split between the workers of
+  // transform_param().threads(), each calling transform_item on a
+  // contiguous range of them with its own transformer. Called from
+  // load_batch on the prefetch thread, after batch->data_ is reshaped.
+  void TransformBatch(Batch<Dtype>* batch, int items);
+  // Transforms an item of the batch being loaded into transformed, a view
+  // of its slot. Runs on the transform workers: it may only read the state
+  // load_batch prepared for the batch.
+  virtual void transform_item(int item, DataTransformer<Dtype>* transformer,
+      Blob<Dtype>* transformed) {}
+
+  vector<shared_ptr<Batch<Dtype> > > prefetch_;
+  int max_prefetch_;
   BlockingQueue<Batch<Dtype>*> prefetch_free_;
   BlockingQueue<Batch<Dtype>*> prefetch_full_;
 
   Blob<Dtype> transformed_data_;
+  // The transformers of the workers, the first being data_transformer_ so
+  // that a single worker behaves as a plain load_batch loop, and the pool
+  // running them.
+  vector<shared_ptr<DataTransformer<Dtype> > > transformers_;
+  shared_ptr<WorkerPool> transform_pool_;
+
+  int prefetch_batches_;
+  int prefetch_stalls_;
+  double consumer_wait_ms_;
+  double producer_wait_ms_;
+
+ private:
+  class TransformWorkers;
 };
 
 }  // namespace caffe
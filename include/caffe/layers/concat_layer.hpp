@@ -26,6 +26,13 @@ class ConcatLayer : public Layer<Dtype> {
   virtual inline const char* type() const { return "Concat"; }
   virtual inline int MinBottomBlobs() const { return 1; }
   virtual inline int ExactNumTopBlobs() const { return 1; }
+  virtual inline bool TopsShareBottomData() const {
+    return this->layer_param_.bottom_size() == 1;
+  }
+  virtual inline int BottomOffsetInTop(int bottom_index) const {
+    return bottom_index < bottom_offsets_.size() ?
+        bottom_offsets_[bottom_index] : -1;
+  }
 
  protected:
   /**
@@ -80,6 +87,9 @@ class ConcatLayer : public Layer<Dtype> {
   int num_concats_;
   int concat_input_size_;
   int concat_axis_;
+  /// @brief The offsets of the bottoms in the top, if they are contiguous
+  ///        ranges of it (num_concats_ == 1), or -1.
+  vector<int> bottom_offsets_;
 };
 
 }  // namespace caffe
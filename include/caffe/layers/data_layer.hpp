@@ -30,8 +30,12 @@ class DataLayer : public BasePrefetchingDataLayer<Dtype> {
 
  protected:
   virtual void load_batch(Batch<Dtype>* batch);
+  virtual void transform_item(int item, DataTransformer<Dtype>* transformer,
+      Blob<Dtype>* transformed);
 
   DataReader reader_;
+  // The datums of the batch being loaded, held until it is transformed.
+  vector<Datum*> batch_datums_;
 };
 
 }  // namespace caffe
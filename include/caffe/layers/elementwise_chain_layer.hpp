@@ -0,0 +1,69 @@
+#ifndef CAFFE_ELEMENTWISE_CHAIN_LAYER_HPP_
+#define CAFFE_ELEMENTWISE_CHAIN_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief Computes a chain of elementwise layers, given by
+ *        ElementwiseChainParameter, in one pass over the memory.
+ *
+ * The chain may start with an Eltwise layer combining several bottoms, and
+ * then applies neuron layers one after the other. The elements are processed
+ * in blocks small enough to stay in cache, with the whole chain applied to a
+ * block before moving on, so that none of the intermediate blobs of the
+ * original layers are stored. Backward recomputes the intermediate values of
+ * a block from the bottoms and applies the chain rule to it in the same way.
+ * NetParameter.fuse_elementwise builds these layers from a net.
+ *
+ * The layer computes on the CPU in both modes.
+ */
+template <typename Dtype>
+class ElementwiseChainLayer : public Layer<Dtype> {
+ public:
+  explicit ElementwiseChainLayer(const LayerParameter& param)
+      : Layer<Dtype>(param) {}
+  virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  virtual inline const char* type() const { return "ElementwiseChain"; }
+  virtual inline int MinBottomBlobs() const { return 1; }
+  virtual inline int ExactNumTopBlobs() const { return 1; }
+
+  /// @brief One elementwise function of the chain.
+  struct Op {
+    enum Type {
+      ABSVAL, BNLL, EXP, LOG, POWER, RELU, SIGMOID, TANH, THRESHOLD
+    };
+    Type type;
+    // The constants of the function, as the layer computing it has them.
+    Dtype a, b, c;
+  };
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+
+  /// @brief Whether the chain starts with an Eltwise layer.
+  bool eltwise_;
+  EltwiseParameter_EltwiseOp eltwise_op_;
+  vector<Dtype> coeffs_;
+  vector<Op> ops_;
+  /// @brief Whether a Threshold layer, which has no gradient, is in the chain.
+  bool has_threshold_;
+  /// @brief The bottom of an in-place chain, kept for Backward in TRAIN.
+  Blob<Dtype> bottom_copy_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_ELEMENTWISE_CHAIN_LAYER_HPP_
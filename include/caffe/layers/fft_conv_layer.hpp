@@ -0,0 +1,87 @@
+#ifndef CAFFE_FFT_CONV_LAYER_HPP_
+#define CAFFE_FFT_CONV_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+#include "caffe/layers/conv_layer.hpp"
+#include "caffe/util/fft.hpp"
+
+namespace caffe {
+
+/**
+ * @brief FFT implementation of ConvolutionLayer for large or dilated 2D
+ *        filters on the CPU. Fallback to ConvolutionLayer for N-D
+ *        convolution and GPU mode.
+ *
+ * The input is cut into overlapping tiles that are transformed with a 2D FFT
+ * of fft_h x fft_w points; each tile yields
+ * (fft_h - extent_h + 1) x (fft_w - extent_w + 1) outputs, where the extent
+ * of a filter is dilation * (kernel_size - 1) + 1. The products with the
+ * filter spectra are summed over the input channels of each group and
+ * transformed back, so the cost per output grows with log(fft size) rather
+ * than with the kernel area. The FFT sizes are picked at Reshape to minimize
+ * an estimate of the arithmetic over all tiles.
+ *
+ * Strided convolutions compute every stride-1 output of a tile and keep the
+ * strided ones. The forward pass and, for stride 1, the gradient w.r.t. the
+ * bottom use the FFT; the other gradients use the im2col implementation.
+ * The filter spectra are computed once and reused until blobs_[0] is
+ * modified or the FFT sizes change.
+ */
+template <typename Dtype>
+class FFTConvolutionLayer : public ConvolutionLayer<Dtype> {
+ public:
+  explicit FFTConvolutionLayer(const LayerParameter& param)
+      : ConvolutionLayer<Dtype>(param), spectra_version_(0) {}
+  virtual ~FFTConvolutionLayer() {
+    ConvWorkspace::Register(&fft_buffer_, 0);
+  }
+  virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+
+  // Computes the filter spectra for the forward and backward passes, unless
+  // they are still up to date with blobs_[0] and the FFT sizes.
+  void ComputeSpectra();
+  // Correlates one image of channels x height x width, padded by pad, with
+  // the filter spectra, which map each group of channels to one of
+  // num_output output channels, into num_output x output_h x output_w with
+  // the given stride.
+  void FFTCorrelate(const Dtype* input, int channels, int height, int width,
+      int pad_h, int pad_w, int stride_h, int stride_w, const Dtype* spectra,
+      int num_output, int output_h, int output_w, Dtype* output);
+
+  /// @brief Whether the convolution is 2D.
+  bool use_fft_;
+  /// @brief The FFT of the tiles, fft_h x fft_w points.
+  shared_ptr<FFT2D<Dtype> > fft_;
+  /// @brief The conjugated filter spectra, scaled by 1 / (fft_h * fft_w),
+  ///        2 (real and imaginary parts) x num_output_ x channels_ / group_
+  ///        x fft_h x fft_w.
+  Blob<Dtype> forward_spectra_;
+  /// @brief The same for the flipped filters used to backpropagate,
+  ///        2 x channels_ x num_output_ / group_ x fft_h x fft_w.
+  Blob<Dtype> backward_spectra_;
+  /// @brief The weights and FFT the spectra come from.
+  shared_ptr<SyncedMemory> spectra_source_;
+  unsigned int spectra_version_;
+  shared_ptr<FFT2D<Dtype> > spectra_fft_;
+  /// @brief The spectra of the input tile and of one output tile, borrowed
+  ///        from the ConvWorkspace.
+  Blob<Dtype> fft_buffer_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_FFT_CONV_LAYER_HPP_
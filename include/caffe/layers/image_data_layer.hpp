@@ -36,9 +36,14 @@ class ImageDataLayer : public BasePrefetchingDataLayer<Dtype> {
   shared_ptr<Caffe::RNG> prefetch_rng_;
   virtual void ShuffleImages();
   virtual void load_batch(Batch<Dtype>* batch);
+  virtual void transform_item(int item, DataTransformer<Dtype>* transformer,
+      Blob<Dtype>* transformed);
 
   vector<std::pair<std::string, int> > lines_;
   int lines_id_;
+  // The lines of the batch being loaded, which a shuffle of lines_ while it
+  // is read does not change.
+  vector<std::pair<std::string, int> > batch_lines_;
 };
 
 
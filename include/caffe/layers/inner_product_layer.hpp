@@ -6,6 +6,7 @@
 #include "caffe/blob.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/packed_gemm.hpp"
 
 namespace caffe {
 
@@ -44,6 +45,8 @@ class InnerProductLayer : public Layer<Dtype> {
   int N_;
   bool bias_term_;
   Blob<Dtype> bias_multiplier_;
+  // The weights packed for the TEST phase forward on the CPU.
+  PackedWeights<Dtype> packed_weights_;
 };
 
 }  // namespace caffe
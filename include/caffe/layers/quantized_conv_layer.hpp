@@ -0,0 +1,67 @@
+#ifndef CAFFE_QUANTIZED_CONV_LAYER_HPP_
+#define CAFFE_QUANTIZED_CONV_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+#include "caffe/layers/conv_layer.hpp"
+
+namespace caffe {
+
+/**
+ * @brief ConvolutionLayer for int8 inference on the CPU.
+ *
+ * As in QuantizedInnerProductLayer, the weights blobs_[0] hold integers in
+ * [-127, 127] with one scale per output channel in the last blob, and the
+ * bottom is quantized with QuantizationParameter.bottom_scale. The columns
+ * of each image are quantized and transposed so that every group runs one
+ * int8 GEMM with int32 accumulation, whose products are rescaled before the
+ * bias is added. Only 2D convolution is supported, and the layer is for
+ * inference only.
+ */
+template <typename Dtype>
+class QuantizedConvolutionLayer : public ConvolutionLayer<Dtype> {
+ public:
+  explicit QuantizedConvolutionLayer(const LayerParameter& param)
+      : ConvolutionLayer<Dtype>(param), weights_version_(0) {}
+  virtual ~QuantizedConvolutionLayer() {
+    ConvWorkspace::Register(&quantize_buffer_, 0);
+  }
+  virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void ToProto(LayerParameter* param, bool write_diff = false);
+
+  virtual inline const char* type() const { return "QuantizedConvolution"; }
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Forward_gpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+    Forward_cpu(bottom, top);
+  }
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+  virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+    Backward_cpu(top, propagate_down, bottom);
+  }
+
+  /// @brief The int8 copy of blobs_[0], refreshed when it is modified.
+  shared_ptr<SyncedMemory> quantized_weights_;
+  shared_ptr<SyncedMemory> weights_source_;
+  unsigned int weights_version_;
+  /// @brief The columns of one image, as Dtype and quantized, the quantized
+  ///        columns of one group transposed, and the int32 products of one
+  ///        group, borrowed from the ConvWorkspace.
+  Blob<Dtype> quantize_buffer_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_QUANTIZED_CONV_LAYER_HPP_
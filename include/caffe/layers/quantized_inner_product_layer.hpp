@@ -0,0 +1,65 @@
+#ifndef CAFFE_QUANTIZED_INNER_PRODUCT_LAYER_HPP_
+#define CAFFE_QUANTIZED_INNER_PRODUCT_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+#include "caffe/layers/inner_product_layer.hpp"
+
+namespace caffe {
+
+/**
+ * @brief InnerProductLayer for int8 inference on the CPU.
+ *
+ * The weights blobs_[0] hold integers in [-127, 127], with one scale per
+ * output in the last blob, and the bottom is quantized with
+ * QuantizationParameter.bottom_scale. The products then run as an int8 GEMM
+ * with int32 accumulation and are rescaled before the bias is added.
+ * Weights filled at setup are quantized in place; tools/quantize_net
+ * converts trained InnerProduct layers, and the weights are saved with one
+ * byte per value.
+ *
+ * The layer is for inference only and has no backward pass.
+ */
+template <typename Dtype>
+class QuantizedInnerProductLayer : public InnerProductLayer<Dtype> {
+ public:
+  explicit QuantizedInnerProductLayer(const LayerParameter& param)
+      : InnerProductLayer<Dtype>(param), weights_version_(0) {}
+  virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void ToProto(LayerParameter* param, bool write_diff = false);
+
+  virtual inline const char* type() const { return "QuantizedInnerProduct"; }
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Forward_gpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+    Forward_cpu(bottom, top);
+  }
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+  virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+    Backward_cpu(top, propagate_down, bottom);
+  }
+
+  /// @brief The int8 copy of blobs_[0], refreshed when it is modified.
+  shared_ptr<SyncedMemory> quantized_weights_;
+  shared_ptr<SyncedMemory> weights_source_;
+  unsigned int weights_version_;
+  /// @brief The quantized bottom and the int32 products.
+  shared_ptr<SyncedMemory> quantized_bottom_;
+  shared_ptr<SyncedMemory> products_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_QUANTIZED_INNER_PRODUCT_LAYER_HPP_
@@ -28,6 +28,12 @@ class SliceLayer : public Layer<Dtype> {
   virtual inline const char* type() const { return "Slice"; }
   virtual inline int ExactNumBottomBlobs() const { return 1; }
   virtual inline int MinTopBlobs() const { return 1; }
+  virtual inline bool TopsShareBottomData() const {
+    return this->layer_param_.top_size() == 1;
+  }
+  virtual inline int TopOffsetInBottom(int top_index) const {
+    return top_index < top_offsets_.size() ? top_offsets_[top_index] : -1;
+  }
 
  protected:
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
@@ -44,6 +50,9 @@ class SliceLayer : public Layer<Dtype> {
   int slice_size_;
   int slice_axis_;
   vector<int> slice_point_;
+  /// @brief The offsets of the tops in the bottom, if they are contiguous
+  ///        ranges of it (num_slices_ == 1), or -1.
+  vector<int> top_offsets_;
 };
 
 }  // namespace caffe
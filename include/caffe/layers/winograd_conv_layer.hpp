@@ -0,0 +1,82 @@
+#ifndef CAFFE_WINOGRAD_CONV_LAYER_HPP_
+#define CAFFE_WINOGRAD_CONV_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+#include "caffe/layers/conv_layer.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Winograd implementation of ConvolutionLayer for 3x3 filters on the
+ *        CPU. Fallback to ConvolutionLayer for other shapes and GPU mode.
+ *
+ * Winograd's minimal filtering algorithm F(m x m, 3 x 3) computes each
+ * m x m output tile from an (m + 2) x (m + 2) input tile with
+ * (m + 2)^2 multiplications per input and output channel instead of 9 m^2.
+ * Tiles are transformed into the Winograd domain, where the channel reduction
+ * becomes (m + 2)^2 independent matrix multiplications done by BLAS, and the
+ * products are transformed back. Output tiles of 4 x 4 (2.25 times fewer
+ * multiplications) are used when both output dimensions are at least 8, and
+ * 2 x 2 tiles (1.78 times fewer) otherwise.
+ *
+ * The forward pass and the gradient w.r.t. the bottom use Winograd; the
+ * gradient w.r.t. the filters uses the im2col implementation. The filters
+ * are transformed once and reused until blobs_[0] is modified. Only 3x3
+ * filters with stride 1 and no dilation are supported.
+ */
+template <typename Dtype>
+class WinogradConvolutionLayer : public ConvolutionLayer<Dtype> {
+ public:
+  explicit WinogradConvolutionLayer(const LayerParameter& param)
+      : ConvolutionLayer<Dtype>(param), filters_version_(0) {}
+  virtual ~WinogradConvolutionLayer() {
+    ConvWorkspace::Register(&transform_buffer_, 0);
+  }
+  virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+
+  // Transforms the filters for the forward and backward passes, unless
+  // they are still up to date with blobs_[0].
+  void TransformFilters();
+  // Convolves one image of channels x height x width with the transformed
+  // filters, which map each group of channels to one of num_output
+  // output channels, into num_output x output_h x output_w.
+  void WinogradConvolve(const Dtype* input, int channels, int height,
+      int width, int pad_h, int pad_w, const Dtype* filters, int num_output,
+      int output_h, int output_w, Dtype* output);
+
+  /// @brief Whether the filter shape is supported.
+  bool use_winograd_;
+  /// @brief The size m of the output tiles.
+  int tile_;
+  /// @brief The filters in the Winograd domain, (m + 2)^2 x num_output_ x
+  ///        channels_ / group_.
+  Blob<Dtype> forward_filters_;
+  /// @brief The flipped and transposed filters used to backpropagate,
+  ///        (m + 2)^2 x channels_ x num_output_ / group_.
+  Blob<Dtype> backward_filters_;
+  /// @brief The weights and tile size the transformed filters come from.
+  shared_ptr<SyncedMemory> filters_source_;
+  unsigned int filters_version_;
+  int filters_tile_;
+  /// @brief The transformed input tiles and their products with the filters,
+  ///        borrowed from the ConvWorkspace.
+  Blob<Dtype> transform_buffer_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_WINOGRAD_CONV_LAYER_HPP_
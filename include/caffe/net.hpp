@@ -11,6 +11,7 @@
 #include "caffe/common.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/layer_scheduler.hpp"
 
 namespace caffe {
 
@@ -237,6 +238,54 @@ class Net {
   /// @brief Append a new parameter blob to the net.
   void AppendParam(const NetParameter& param, const int layer_id,
                    const int param_id);
+  /**
+   * @brief Set (*owner)[blob_id] to the first blob of the group of blobs
+   *        holding the same data because of layers whose tops share their
+   *        bottom's data (see Layer::TopsShareBottomData).
+   */
+  void GroupSharedBlobs(vector<int>* owner) const;
+  /**
+   * @brief Find the blobs that can be views of a range of another blob, the
+   *        parts of Concat and Slice layers (see
+   *        NetParameter.share_blob_views), after giving the views of an
+   *        earlier call their own memory again.
+   *
+   * Called by Init, and again by Reshape as the offsets may have changed.
+   */
+  void FindBlobViews();
+  /// @brief Helper for FindBlobViews, recording blob_id as a view of
+  ///        parent_id unless it is one already or that would make a cycle.
+  bool AddBlobView(int blob_id, int parent_id, int offset);
+  /**
+   * @brief Make the blobs found by FindBlobViews views of their parents, and
+   *        let the first top of Split layers share the diff of their bottom.
+   */
+  void ShareBlobViews();
+  /**
+   * @brief Bring the parents of the views to the CPU before the scheduler
+   *        runs layers writing views of one parent on different threads.
+   */
+  void PrepareBlobViews();
+  /**
+   * @brief Let blobs whose lifetimes in the forward pass do not overlap share
+   *        SyncedMemory buffers (see NetParameter.share_activations).
+   *
+   * Called by Init, and again by Reshape as blob sizes may have changed.
+   */
+  void PlanActivationMemory();
+  /**
+   * @brief Find the layers each layer has to wait for when the layers run
+   *        concurrently (see NetParameter.layer_threads).
+   *
+   * A layer depends on the earlier layers that write the memory it reads or
+   * writes, or read the memory it writes, and on the earlier layers sharing
+   * one of its params, and the layers using the Caffe RNG on the earlier
+   * such layer. Backward runs along the same edges reversed.
+   */
+  void BuildLayerDependencies();
+  /// @brief The LayerScheduler tasks running one layer.
+  static void ForwardLayerTask(void* net, int layer_id);
+  static void BackwardLayerTask(void* net, int layer_id);
 
   /// @brief Helper for displaying debug info in Forward about input Blobs.
   void InputDebugInfo(const int layer_id);
@@ -302,6 +351,29 @@ class Net {
   vector<bool> has_params_decay_;
   /// The bytes of memory used by this net
   size_t memory_used_;
+  /// Whether blobs with disjoint lifetimes share memory
+  bool share_activations_;
+  /// Whether each blob is excluded from memory sharing, indexed by blob_id
+  vector<bool> blob_memory_pinned_;
+  /// Whether parts of Concat and Slice layers are views of the whole blob
+  bool share_blob_views_;
+  /// The blob each blob is a view of, or -1, and the offset in it
+  vector<int> blob_view_parents_;
+  vector<int> blob_view_offsets_;
+  /// Whether the diff of each view is a view of its parent's diff as well
+  vector<bool> blob_diff_views_;
+  /// Runs the layers concurrently if NetParameter.layer_threads > 1
+  shared_ptr<LayerScheduler> scheduler_;
+  /// The earlier layers each layer depends on, for the scheduler
+  vector<vector<int> > layer_dependencies_;
+  /// The same edges reversed for Backward, numbering the layers from the
+  /// last one: node i is layer layers_.size() - 1 - i
+  vector<vector<int> > backward_dependencies_;
+  /// Whether each layer must run on the thread calling Forward, see
+  /// Layer::UsesCaffeRNG
+  vector<bool> layer_uses_rng_;
+  /// The loss of each layer in the last concurrent forward pass
+  vector<Dtype> layer_losses_;
   /// Whether to compute and display debug info for the net.
   bool debug_info_;
   /// The root net that actually holds the shared layers in data parallelism
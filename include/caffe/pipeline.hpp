@@ -0,0 +1,117 @@
+#ifndef CAFFE_PIPELINE_HPP_
+#define CAFFE_PIPELINE_HPP_
+
+#include <string>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/blocking_queue.hpp"
+
+namespace caffe {
+
+/// @brief The blobs one stage of a Pipeline hands to the next for a
+///        micro-batch.
+template <typename Dtype>
+class PipelineBatch {
+ public:
+  int index_;
+  vector<shared_ptr<Blob<Dtype> > > blobs_;
+};
+
+/**
+ * @brief Runs a TEST phase net in CPU mode as a pipeline of stages, each a
+ *        contiguous range of layers on its own thread, streaming
+ *        micro-batches through them (see PipelineParameter).
+ *
+ * Each stage builds its part of the net on its own thread, after pinning it
+ * to a NUMA node, so that the weights and activations of the stage are first
+ * touched, and thus allocated, in the memory of that node. Stages only share
+ * the blobs crossing their boundaries, through bounded queues of
+ * queue_depth micro-batches each. Unless given, the boundaries are chosen
+ * from the time of each layer, measured on a copy of the whole net.
+ *
+ * The parallel_for loops of each stage run on a WorkerPool of its own rather
+ * than the process-wide pool. With pinned stages, the pool has one worker
+ * per core of the stage's share of its node, pinned to it, up to
+ * Caffe::cpu_threads(). Otherwise it has Caffe::cpu_threads() divided by the
+ * number of stages. The layers are timed on a pool of the first stage's size.
+ * Multithreaded BLAS libraries keep their own threads.
+ */
+template <typename Dtype>
+class Pipeline {
+ public:
+  /// @brief Builds the stages of the net param, with the weights of trained.
+  Pipeline(const NetParameter& param, const Net<Dtype>& trained,
+      const PipelineParameter& pipeline_param);
+  ~Pipeline();
+
+  /**
+   * @brief Runs inputs, shaped as the net inputs but for a batch size that
+   *        is a multiple of the micro-batch, through the pipeline.
+   *
+   * Returns the net outputs: those with the micro-batch as first axis
+   * concatenated along it, and the others, such as losses and accuracies,
+   * averaged over the micro-batches.
+   */
+  const vector<Blob<Dtype>*>& Forward(const vector<Blob<Dtype>*>& inputs);
+  /**
+   * @brief Runs micro_batches batches of a net reading its own data, for
+   *        throughput, and returns its outputs averaged over them.
+   */
+  const vector<Blob<Dtype>*>& Run(int micro_batches);
+
+  /// @brief The first layer of each stage, indexing the layers of the net
+  ///        param left for the TEST phase.
+  const vector<int>& stage_starts() const { return stage_starts_; }
+  const vector<string>& output_blob_names() const { return output_names_; }
+  int micro_batch() const { return micro_batch_; }
+
+ private:
+  class Stage;
+
+  // Times the layers and chooses the stage boundaries.
+  void PlanStages(Net<Dtype>* profile_net);
+  // Streams micro_batches micro-batches through the stages.
+  void RunMicroBatches(int micro_batches);
+
+  PipelineParameter pipeline_param_;
+  // The TEST phase layers of the net, and the trained weights.
+  NetParameter net_param_;
+  NetParameter weights_;
+  vector<int> stage_starts_;
+  // The cores each stage and its pool are pinned to, if any, and the
+  // threads of its pool.
+  vector<vector<int> > stage_cores_;
+  vector<int> stage_threads_;
+  // The blobs each stage receives from the previous one, or the net inputs
+  // for the first stage, with their shapes for one micro-batch.
+  vector<vector<string> > stage_inputs_;
+  vector<vector<BlobShape> > stage_input_shapes_;
+  vector<string> output_names_;
+  // Whether each output has the micro-batch as its first axis.
+  vector<bool> batch_outputs_;
+  int micro_batch_;
+  vector<shared_ptr<Stage> > stages_;
+  // The queues of free and full batches between stage i and i + 1.
+  vector<shared_ptr<BlockingQueue<PipelineBatch<Dtype>*> > > free_;
+  vector<shared_ptr<BlockingQueue<PipelineBatch<Dtype>*> > > full_;
+  vector<shared_ptr<PipelineBatch<Dtype> > > batches_;
+  // The micro-batches to run, and those done, by index.
+  BlockingQueue<int> jobs_;
+  BlockingQueue<int> done_;
+  // The current run.
+  const vector<Blob<Dtype>*>* inputs_;
+  int micro_batches_;
+  vector<bool> concat_outputs_;
+  vector<shared_ptr<Blob<Dtype> > > output_blobs_;
+  vector<Blob<Dtype>*> outputs_;
+
+  DISABLE_COPY_AND_ASSIGN(Pipeline);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_PIPELINE_HPP_
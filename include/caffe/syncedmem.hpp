@@ -4,6 +4,7 @@
 #include <cstdlib>
 
 #include "caffe/common.hpp"
+#include "caffe/util/host_allocator.hpp"
 
 namespace caffe {
 
@@ -12,27 +13,34 @@ namespace caffe {
 // The improvement in performance seems negligible in the single GPU case,
 // but might be more significant for parallel training. Most importantly,
 // it improved stability for large models on many GPUs.
-inline void CaffeMallocHost(void** ptr, size_t size, bool* use_cuda) {
+// Otherwise it comes from the host allocator selected with
+// Caffe::set_host_allocator, which is returned in *allocator and must be
+// passed back to CaffeFreeHost.
+inline void CaffeMallocHost(void** ptr, size_t size, bool* use_cuda,
+    HostAllocator** allocator) {
 #ifndef CPU_ONLY
   if (Caffe::mode() == Caffe::GPU) {
     CUDA_CHECK(cudaMallocHost(ptr, size));
     *use_cuda = true;
+    *allocator = NULL;
     return;
   }
 #endif
-  *ptr = malloc(size);
+  *allocator = GetHostAllocator(Caffe::host_allocator());
+  *ptr = (*allocator)->Allocate(size);
   *use_cuda = false;
   CHECK(*ptr) << "host allocation of size " << size << " failed";
 }
 
-inline void CaffeFreeHost(void* ptr, bool use_cuda) {
+inline void CaffeFreeHost(void* ptr, size_t size, bool use_cuda,
+    HostAllocator* allocator) {
 #ifndef CPU_ONLY
   if (use_cuda) {
     CUDA_CHECK(cudaFreeHost(ptr));
     return;
   }
 #endif
-  free(ptr);
+  allocator->Free(ptr, size);
 }
 
 
@@ -40,18 +48,26 @@ inline void CaffeFreeHost(void* ptr, bool use_cuda) {
  * @brief Manages memory allocation and synchronization between the host (CPU)
  *        and device (GPU).
  *
- * TODO(dox): more thorough description.
+ * A SyncedMemory may also be a view of a range of another one, its parent,
+ * which holds the memory and its synchronization state for both: the view
+ * returns pointers into the parent's memory, so that writing through it
+ * writes the parent's range. Views of views refer to the outermost parent.
+ * Once the parent's head is at the CPU, mutable_cpu_data() of a view leaves
+ * the parent's state alone, so that views of one parent may be written by
+ * different threads; bring the parent to the CPU before they start.
  */
 class SyncedMemory {
  public:
   SyncedMemory()
       : cpu_ptr_(NULL), gpu_ptr_(NULL), size_(0), head_(UNINITIALIZED),
         own_cpu_data_(false), cpu_malloc_use_cuda_(false), own_gpu_data_(false),
-        gpu_device_(-1) {}
+        gpu_device_(-1), cpu_allocator_(NULL), version_(0), offset_(0) {}
   explicit SyncedMemory(size_t size)
       : cpu_ptr_(NULL), gpu_ptr_(NULL), size_(size), head_(UNINITIALIZED),
         own_cpu_data_(false), cpu_malloc_use_cuda_(false), own_gpu_data_(false),
-        gpu_device_(-1) {}
+        gpu_device_(-1), cpu_allocator_(NULL), version_(0), offset_(0) {}
+  SyncedMemory(const shared_ptr<SyncedMemory>& parent, size_t offset,
+      size_t size);
   ~SyncedMemory();
   const void* cpu_data();
   void set_cpu_data(void* data);
@@ -60,8 +76,14 @@ class SyncedMemory {
   void* mutable_cpu_data();
   void* mutable_gpu_data();
   enum SyncedHead { UNINITIALIZED, HEAD_AT_CPU, HEAD_AT_GPU, SYNCED };
-  SyncedHead head() { return head_; }
+  SyncedHead head() { return parent_ ? parent_->head() : head_; }
   size_t size() { return size_; }
+  // Counts the calls that may have changed the data (the mutable accessors
+  // and setters), so that caches derived from it can tell when to refresh.
+  // A view adds the writes made through it to those of its parent.
+  unsigned int version() const {
+    return parent_ ? parent_->version() + version_ : version_;
+  }
 
 #ifndef CPU_ONLY
   void async_gpu_push(const cudaStream_t& stream);
@@ -78,6 +100,10 @@ class SyncedMemory {
   bool cpu_malloc_use_cuda_;
   bool own_gpu_data_;
   int gpu_device_;
+  HostAllocator* cpu_allocator_;
+  unsigned int version_;
+  shared_ptr<SyncedMemory> parent_;
+  size_t offset_;
 
   DISABLE_COPY_AND_ASSIGN(SyncedMemory);
 };  // class SyncedMemory
@@ -0,0 +1,39 @@
+#ifndef CAFFE_UTIL_ACTIVATION_HPP_
+#define CAFFE_UTIL_ACTIVATION_HPP_
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief Adds the biases to a rows x cols matrix and applies the activation
+ *        of param, in one pass over it.
+ *
+ * row_bias has one bias per row, as for the channels of a convolution
+ * output, and col_bias one per column, as for the outputs of an inner
+ * product; either may be NULL. The results are those of the ReLU, Sigmoid
+ * and TanH layers.
+ */
+template <typename Dtype>
+void activation_forward_cpu(const ActivationParameter& param, const int rows,
+    const int cols, const Dtype* row_bias, const Dtype* col_bias, Dtype* data);
+
+/// @brief Multiplies diff by the derivative of the activation of param, given
+///        its output data.
+template <typename Dtype>
+void activation_backward_cpu(const ActivationParameter& param, const int n,
+    const Dtype* data, Dtype* diff);
+
+/// @brief Applies the activation of param to data, in place.
+template <typename Dtype>
+void activation_forward_gpu(const ActivationParameter& param, const int n,
+    Dtype* data);
+
+template <typename Dtype>
+void activation_backward_gpu(const ActivationParameter& param, const int n,
+    const Dtype* data, Dtype* diff);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_ACTIVATION_HPP_
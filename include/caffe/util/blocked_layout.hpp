@@ -0,0 +1,37 @@
+#ifndef CAFFE_UTIL_BLOCKED_LAYOUT_HPP_
+#define CAFFE_UTIL_BLOCKED_LAYOUT_HPP_
+
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+// The channel-blocked layout of a (num, channels, spatial...) blob splits the
+// channels of each item into blocks of block channels, block dividing
+// channels, and stores each block pixel by pixel with the values of its
+// channels next to each other: channel c of pixel p of item n is at
+// ((n * channels / block + c / block) * spatial + p) * block + c % block.
+
+template <typename Dtype>
+void reorder_to_blocked_cpu(const int num, const int channels,
+    const int spatial, const int block, const Dtype* data,
+    Dtype* data_blocked);
+
+template <typename Dtype>
+void reorder_from_blocked_cpu(const int num, const int channels,
+    const int spatial, const int block, const Dtype* data_blocked,
+    Dtype* data);
+
+// Copy a NetParameter of the TEST phase with the layers that have a
+// channel-blocked kernel, and the elementwise layers between them, computing
+// in the channel-blocked layout with blocks of param.channel_block()
+// channels, and Reorder layers inserted where a blob changes layout. The
+// net inputs and outputs keep the usual layout and their names. Layers are
+// blocked only where the number of channels of their bottom, as given by the
+// net inputs and the layers before, is a multiple of the block. Returns the
+// number of blocked layers.
+int ConvertToBlockedLayout(const NetParameter& param,
+    NetParameter* param_blocked);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_BLOCKED_LAYOUT_HPP_
@@ -0,0 +1,33 @@
+#ifndef CAFFE_UTIL_BUILTIN_GEMM_HPP_
+#define CAFFE_UTIL_BUILTIN_GEMM_HPP_
+
+#include "caffe/common.hpp"
+#include "caffe/util/mkl_alternate.hpp"
+
+namespace caffe {
+
+// Caffe's own GEMM and GEMV, for builds whose BLAS is ATLAS or a reference
+// implementation. caffe_cpu_gemm and caffe_cpu_gemv call them instead of the
+// BLAS when Caffe is built with USE_BUILTIN_GEMM; they are built either way,
+// so that they can be tested and benchmarked against the linked BLAS.
+//
+// The GEMM packs blocks of op(A) and op(B) sized for the caches into panels
+// of a register block, and runs a micro-kernel the compiler vectorizes over
+// them on the CPU thread pool. Matrices are row-major, as in
+// cblas_?gemm(CblasRowMajor, ...).
+
+template <typename Dtype>
+void caffe_builtin_gemm(const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const Dtype alpha, const Dtype* A, const int lda, const Dtype* B,
+    const int ldb, const Dtype beta, Dtype* C, const int ldc);
+
+// y = alpha * op(A) * x + beta * y, with A a row-major M x N matrix.
+template <typename Dtype>
+void caffe_builtin_gemv(const CBLAS_TRANSPOSE TransA, const int M,
+    const int N, const Dtype alpha, const Dtype* A, const Dtype* x,
+    const Dtype beta, Dtype* y);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_BUILTIN_GEMM_HPP_
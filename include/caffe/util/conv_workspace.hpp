@@ -0,0 +1,57 @@
+#ifndef CAFFE_UTIL_CONV_WORKSPACE_HPP_
+#define CAFFE_UTIL_CONV_WORKSPACE_HPP_
+
+#include <cstddef>
+
+#include "caffe/common.hpp"
+#include "caffe/syncedmem.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Scratch memory shared by the im2col column buffers of all
+ *        convolution and deconvolution layers running on a thread.
+ *
+ * Layers only need their column buffer while one of their own Forward or
+ * Backward calls runs, and a thread runs one layer at a time, so a single
+ * buffer per thread, as large as the largest request, serves all of them.
+ * Layers announce their size with Register when they are reshaped and borrow
+ * the memory with Reserve right before each use; what they leave in it is
+ * only valid until another layer on the thread borrows it.
+ */
+class ConvWorkspace {
+ public:
+  /// @brief Returns the workspace of the calling thread.
+  static ConvWorkspace& Get();
+
+  /**
+   * @brief Returns the memory of the workspace after growing it to at least
+   *        size bytes. Memory handed out before growing stays valid for as
+   *        long as its holders keep it.
+   */
+  const shared_ptr<SyncedMemory>& Reserve(size_t size);
+  /// @brief Current size of the workspace in bytes.
+  size_t size() const { return memory_ ? memory_->size() : 0; }
+
+  /// @brief Records that user needs a buffer of size bytes (0 to forget it).
+  static void Register(const void* user, size_t size);
+  /// @brief Sum of the buffer sizes of all registered users.
+  static size_t requested_bytes();
+  /// @brief Sum of the workspace sizes over all threads.
+  static size_t allocated_bytes();
+  /// @brief How much memory sharing saves over a buffer per user.
+  static size_t saved_bytes();
+
+  ~ConvWorkspace();
+
+ private:
+  ConvWorkspace() {}
+
+  shared_ptr<SyncedMemory> memory_;
+
+  DISABLE_COPY_AND_ASSIGN(ConvWorkspace);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_CONV_WORKSPACE_HPP_
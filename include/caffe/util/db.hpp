@@ -18,6 +18,10 @@ class Cursor {
   virtual void Next() = 0;
   virtual string key() = 0;
   virtual string value() = 0;
+  // Points *data at the value, which stays in the database rather than
+  // being copied. The bytes are valid until the cursor moves, or for LMDB
+  // until the cursor and its read transaction are destroyed.
+  virtual void value_data(const char** data, size_t* size) = 0;
   virtual bool valid() = 0;
 
   DISABLE_COPY_AND_ASSIGN(Cursor);
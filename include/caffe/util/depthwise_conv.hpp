@@ -0,0 +1,48 @@
+#ifndef CAFFE_UTIL_DEPTHWISE_CONV_HPP_
+#define CAFFE_UTIL_DEPTHWISE_CONV_HPP_
+
+namespace caffe {
+
+// Direct 2D convolution of one image where every input channel has its own
+// multiplier filters (group == channels): output channel k only sees input
+// channel k / multiplier, with the kernel_h x kernel_w filter k. The output is
+// overwritten, while both gradients are accumulated into.
+
+template <typename Dtype>
+void depthwise_conv_cpu(const Dtype* data_im, const int channels,
+    const int height, const int width, const Dtype* weights,
+    const int multiplier, const int kernel_h, const int kernel_w,
+    const int pad_h, const int pad_w, const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w, const int output_h,
+    const int output_w, Dtype* data_out);
+
+// The same with multiplier 1 in the channel-blocked layout with blocks of
+// block channels (see util/blocked_layout.hpp), for both the image and the
+// output; the weights keep their usual layout.
+template <typename Dtype>
+void depthwise_conv_blocked_cpu(const Dtype* data_im, const int channels,
+    const int block, const int height, const int width, const Dtype* weights,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int dilation_h,
+    const int dilation_w, const int output_h, const int output_w,
+    Dtype* data_out);
+
+template <typename Dtype>
+void depthwise_conv_backward_data_cpu(const Dtype* diff_out,
+    const int channels, const int height, const int width,
+    const Dtype* weights, const int multiplier, const int kernel_h,
+    const int kernel_w, const int pad_h, const int pad_w, const int stride_h,
+    const int stride_w, const int dilation_h, const int dilation_w,
+    const int output_h, const int output_w, Dtype* diff_im);
+
+template <typename Dtype>
+void depthwise_conv_backward_weights_cpu(const Dtype* data_im,
+    const int channels, const int height, const int width,
+    const Dtype* diff_out, const int multiplier, const int kernel_h,
+    const int kernel_w, const int pad_h, const int pad_w, const int stride_h,
+    const int stride_w, const int dilation_h, const int dilation_w,
+    const int output_h, const int output_w, Dtype* diff_weights);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_DEPTHWISE_CONV_HPP_
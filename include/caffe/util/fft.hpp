@@ -0,0 +1,48 @@
+#ifndef CAFFE_UTIL_FFT_HPP_
+#define CAFFE_UTIL_FFT_HPP_
+
+#include <vector>
+
+namespace caffe {
+
+/**
+ * @brief Radix-2 discrete Fourier transform of height x width complex arrays
+ *        stored as separate row-major real and imaginary parts.
+ *
+ * Both sizes must be powers of two. The inverse transform is not scaled, so
+ * Inverse(Forward(x)) is height * width times x.
+ */
+template <typename Dtype>
+class FFT2D {
+ public:
+  FFT2D(int height, int width);
+
+  inline int height() const { return height_; }
+  inline int width() const { return width_; }
+
+  void Forward(Dtype* re, Dtype* im) const { Transform(re, im, false); }
+  void Inverse(Dtype* re, Dtype* im) const { Transform(re, im, true); }
+
+ private:
+  struct Plan {
+    explicit Plan(int n);
+    int n;
+    std::vector<int> reversed;
+    std::vector<Dtype> cos;
+    std::vector<Dtype> sin;
+  };
+  void Transform(Dtype* re, Dtype* im, bool inverse) const;
+  // Transforms the plan.n elements stride apart, each made of count
+  // consecutive values that are transformed side by side.
+  static void Transform1D(const Plan& plan, Dtype* re, Dtype* im, int stride,
+      int count, bool inverse);
+
+  int height_;
+  int width_;
+  Plan rows_;
+  Plan columns_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_FFT_HPP_
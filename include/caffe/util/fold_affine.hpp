@@ -0,0 +1,19 @@
+#ifndef CAFFE_UTIL_FOLD_AFFINE_HPP_
+#define CAFFE_UTIL_FOLD_AFFINE_HPP_
+
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+// Copy a NetParameter and its trained weights with the per-channel affine
+// layers that directly follow a Convolution or InnerProduct layer folded into
+// the weights and bias of that layer, saving a pass over their memory. The
+// folded layers are BatchNorm layers using their global statistics and Power
+// layers of power 1. The result computes the same as the original net in the
+// TEST phase. Returns the number of layers folded.
+int FoldAffineLayers(const NetParameter& param, const NetParameter& weights,
+    NetParameter* param_folded, NetParameter* weights_folded);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_FOLD_AFFINE_HPP_
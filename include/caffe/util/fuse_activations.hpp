@@ -0,0 +1,17 @@
+#ifndef CAFFE_UTIL_FUSE_ACTIVATIONS_HPP_
+#define CAFFE_UTIL_FUSE_ACTIVATIONS_HPP_
+
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+// Copy a NetParameter with the ReLU, Sigmoid and TanH layers that directly
+// follow a Convolution or InnerProduct layer fused into it as its
+// fused_activation, so that the activation is applied with the bias while
+// the output is still in cache, in the forward and backward passes alike.
+// Returns the number of layers fused.
+int FuseActivations(const NetParameter& param, NetParameter* param_fused);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_FUSE_ACTIVATIONS_HPP_
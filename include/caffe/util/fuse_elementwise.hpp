@@ -0,0 +1,19 @@
+#ifndef CAFFE_UTIL_FUSE_ELEMENTWISE_HPP_
+#define CAFFE_UTIL_FUSE_ELEMENTWISE_HPP_
+
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+// Copy a NetParameter with each chain of elementwise layers, an optional
+// Eltwise layer followed by neuron layers each reading only the top of the
+// one before, replaced by one ElementwiseChain layer computing it in a single
+// pass over the memory. A chain ends where another layer reads one of its
+// intermediate blobs. Dropout layers are chained in the TEST phase only.
+// Returns the number of layers removed.
+int FuseElementwiseChains(const NetParameter& param,
+    NetParameter* param_fused);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_FUSE_ELEMENTWISE_HPP_
@@ -0,0 +1,62 @@
+#ifndef CAFFE_UTIL_HOST_ALLOCATOR_HPP_
+#define CAFFE_UTIL_HOST_ALLOCATOR_HPP_
+
+#include <cstddef>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/// @brief Activity counters of a HostAllocator.
+struct HostAllocatorStats {
+  HostAllocatorStats()
+      : allocs(0), frees(0), cache_hits(0), bytes_in_use(0), bytes_cached(0),
+        bytes_reserved(0) {}
+  /// Calls to Allocate.
+  size_t allocs;
+  /// Calls to Free.
+  size_t frees;
+  /// Allocations served from previously freed blocks.
+  size_t cache_hits;
+  /// Bytes of blocks handed out and not freed yet.
+  size_t bytes_in_use;
+  /// Bytes of freed blocks kept for reuse.
+  size_t bytes_cached;
+  /// Bytes currently obtained from the system.
+  size_t bytes_reserved;
+};
+
+/**
+ * @brief Interface of the host (CPU) memory allocators used by
+ *        CaffeMallocHost, and thus by SyncedMemory.
+ *
+ * The allocator for new host memory is chosen process-wide with
+ * Caffe::set_host_allocator. Allocators live for the whole process, so memory
+ * is always returned to the allocator it came from.
+ */
+class HostAllocator {
+ public:
+  virtual ~HostAllocator() {}
+  /// @brief Returns a block of at least size bytes, or NULL on failure.
+  virtual void* Allocate(size_t size) = 0;
+  /// @brief Releases a block returned by Allocate(size).
+  virtual void Free(void* ptr, size_t size) = 0;
+  /// @brief Returns blocks kept for reuse to the system.
+  virtual void ReleaseCached() {}
+  virtual HostAllocatorStats stats() const = 0;
+};
+
+/**
+ * @brief Returns the allocator of the given type:
+ *  - MALLOC: plain malloc and free, without statistics.
+ *  - POOLED: a caching allocator of 64-byte-aligned blocks, rounded up to
+ *    size classes at most 25% larger than the request. Freed blocks are kept
+ *    for reuse, in small per-thread caches first and in a shared pool after
+ *    that. Blocks of 2MB and above are backed by transparent huge pages if
+ *    Caffe::host_huge_pages() was set when they were obtained.
+ */
+HostAllocator* GetHostAllocator(Caffe::HostAllocatorType type);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_HOST_ALLOCATOR_HPP_
@@ -29,6 +29,34 @@ void col2im_cpu(const Dtype* data_col, const int channels,
     const int stride_w, const int dilation_h, const int dilation_w,
     Dtype* data_im);
 
+// im2col_cpu and col2im_cpu restricted to the rows [row_begin, row_end) of
+// the column image, i.e. to a horizontal strip of the convolution output.
+// data_col then holds (row_end - row_begin) rows per column channel, and
+// col2im_rows_cpu adds to data_im instead of overwriting it.
+template <typename Dtype>
+void im2col_rows_cpu(const Dtype* data_im, const int channels,
+    const int height, const int width, const int kernel_h, const int kernel_w,
+    const int pad_h, const int pad_w, const int stride_h,
+    const int stride_w, const int dilation_h, const int dilation_w,
+    const int row_begin, const int row_end, Dtype* data_col);
+
+template <typename Dtype>
+void col2im_rows_cpu(const Dtype* data_col, const int channels,
+    const int height, const int width, const int kernel_h, const int kernel_w,
+    const int pad_h, const int pad_w, const int stride_h,
+    const int stride_w, const int dilation_h, const int dilation_w,
+    const int row_begin, const int row_end, Dtype* data_im);
+
+// im2col_cpu for one of several images whose columns lie side by side in
+// data_col: consecutive rows of the column matrix are col_stride elements
+// apart instead of height_col * width_col.
+template <typename Dtype>
+void im2col_strided_cpu(const Dtype* data_im, const int channels,
+    const int height, const int width, const int kernel_h, const int kernel_w,
+    const int pad_h, const int pad_w, const int stride_h,
+    const int stride_w, const int dilation_h, const int dilation_w,
+    const int col_stride, Dtype* data_col);
+
 template <typename Dtype>
 void im2col_nd_gpu(const Dtype* data_im, const int num_spatial_axes,
     const int col_size, const int* im_shape, const int* col_shape,
@@ -0,0 +1,48 @@
+#ifndef CAFFE_UTIL_JPEG_HPP_
+#define CAFFE_UTIL_JPEG_HPP_
+
+#ifdef USE_LIBJPEG
+
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+// Decoding of JPEG images with libjpeg-turbo, for the encoded Datums of the
+// data layers. Unlike cv::imdecode, it can decode an image at 1/2, 1/4 or 1/8
+// of its size, which libjpeg computes from fewer DCT coefficients, and only
+// the rows and columns of a crop. Pixels come out as in a cv::Mat of 8-bit
+// values, with interleaved BGR channels in color.
+//
+// color is 1 to decode in color, 0 in gray and -1 with the channels of the
+// image, as the flags of cv::imdecode. CMYK images are not supported.
+
+/**
+ * @brief Reads the header of the JPEG image in data. Gives the largest
+ *        scale of 1, 2, 4 and 8 at which both sides keep at least min_size
+ *        pixels (1 if min_size is 0), and the size and channels of the image
+ *        decoded at 1 / scale of its size. Returns false if data is not a
+ *        JPEG image libjpeg can decode.
+ */
+bool ReadJPEGShape(const string& data, int color, int min_size, int* scale,
+    int* height, int* width, int* channels);
+
+/**
+ * @brief Decodes rows [y, y + rows) and columns [x, x + cols) of the JPEG
+ *        image in data, decoded at 1 / scale of its size.
+ *
+ * libjpeg decodes whole blocks of columns, so *buffer receives rows of *step
+ * bytes, pixel (y + i, x + j) starting at byte i * *step + *offset + j *
+ * channels. Returns false if the image cannot be decoded.
+ */
+bool DecodeJPEG(const string& data, int color, int scale, int x, int y,
+    int cols, int rows, vector<unsigned char>* buffer, int* step,
+    int* offset);
+
+}  // namespace caffe
+
+#endif  // USE_LIBJPEG
+
+#endif  // CAFFE_UTIL_JPEG_HPP_
@@ -0,0 +1,54 @@
+#ifndef CAFFE_UTIL_LAYER_SCHEDULER_HPP_
+#define CAFFE_UTIL_LAYER_SCHEDULER_HPP_
+
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Runs the layers of a net on a pool of threads, each as soon as the
+ *        layers it depends on are done (see NetParameter.layer_threads).
+ *
+ * The scheduler only knows of a dependency graph over numbered nodes; the
+ * Net decides what a node does and which nodes depend on which. Among the
+ * nodes ready to run, the lowest numbered runs first, so that a chain runs
+ * in the order of the net definition.
+ */
+class LayerScheduler {
+ public:
+  /// @brief The function run for each node, with the context given to Run.
+  typedef void (*Task)(void* context, int node);
+
+  /// @brief Starts threads - 1 workers; the thread calling Run is the last.
+  explicit LayerScheduler(int threads);
+  ~LayerScheduler();
+
+  /**
+   * @brief Runs task for each node with active[node] set, after the nodes
+   *        among predecessors[node], and returns when all are done.
+   *
+   * Inactive nodes are skipped but still ordered, so that the nodes before
+   * and after them stay in order. The predecessors of a node must have lower
+   * numbers than the node. The nodes with on_caller[node] set run on the
+   * thread calling Run; on_caller may be empty if there are none.
+   */
+  void Run(const vector<vector<int> >& predecessors,
+      const vector<bool>& active, const vector<bool>& on_caller, Task task,
+      void* context);
+
+  int threads() const { return threads_; }
+
+ private:
+  class Impl;
+
+  const int threads_;
+  shared_ptr<Impl> impl_;
+
+  DISABLE_COPY_AND_ASSIGN(LayerScheduler);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_LAYER_SCHEDULER_HPP_
@@ -12,6 +12,9 @@
 
 namespace caffe {
 
+// Sets the number of threads of the BLAS library, for MKL and OpenBLAS.
+void caffe_set_blas_threads(const int threads);
+
 // Caffe gemm provides a simpler interface to the gemm functions, with the
 // limitation that the data has to be contiguous in memory.
 template <typename Dtype>
@@ -20,6 +23,19 @@ void caffe_cpu_gemm(const CBLAS_TRANSPOSE TransA,
     const Dtype alpha, const Dtype* A, const Dtype* B, const Dtype beta,
     Dtype* C);
 
+// Same as caffe_cpu_gemm, for matrices whose rows are lda, ldb and ldc
+// elements apart, such as a range of columns of a larger matrix.
+template <typename Dtype>
+void caffe_cpu_gemm(const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const Dtype alpha, const Dtype* A, const int lda, const Dtype* B,
+    const int ldb, const Dtype beta, Dtype* C, const int ldc);
+
+// Integer GEMM for quantized layers: C = A * B^T with int32 accumulation,
+// where A is M x K and B is N x K, both row-major int8, and C is M x N.
+void caffe_cpu_gemm_s8(const int M, const int N, const int K,
+    const int8_t* A, const int8_t* B, int32_t* C);
+
 template <typename Dtype>
 void caffe_cpu_gemv(const CBLAS_TRANSPOSE TransA, const int M, const int N,
     const Dtype alpha, const Dtype* A, const Dtype* x, const Dtype beta,
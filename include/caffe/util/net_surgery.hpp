@@ -0,0 +1,19 @@
+#ifndef CAFFE_UTIL_NET_SURGERY_HPP_
+#define CAFFE_UTIL_NET_SURGERY_HPP_
+
+#include <string>
+
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+// Helpers shared by the passes rewriting a NetParameter: FoldAffineLayers,
+// FuseActivations and FuseElementwiseChains.
+
+// Whether a layer after layer `after` of param reads blob before any layer
+// writes it again.
+bool BlobReadLater(const NetParameter& param, int after, const string& blob);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_NET_SURGERY_HPP_
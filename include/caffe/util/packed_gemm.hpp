@@ -0,0 +1,71 @@
+#ifndef CAFFE_UTIL_PACKED_GEMM_HPP_
+#define CAFFE_UTIL_PACKED_GEMM_HPP_
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/syncedmem.hpp"
+
+namespace caffe {
+
+/// @brief The most rows of the other operand for which products go through
+///        the built-in packed kernel rather than the BLAS GEMM, without MKL.
+const int kPackedGemmMaxRows = 4;
+
+/**
+ * @brief A copy of the weights of a layer packed once for the products the
+ *        layer computes with them in the TEST phase, so that the BLAS does
+ *        not pack the same panels again at every Forward.
+ *
+ * The weights hold groups matrices W of rows x cols, one after the other.
+ * A product is either Y = X W^T, with X m x cols and Y m x rows, as for
+ * inner products, or Y = W X, with X cols x m and Y rows x m, as for
+ * convolutions, where m is the number of items or of output pixels.
+ *
+ * With MKL the weights are packed by cblas_?gemm_pack for products with the
+ * given m, and all products go through cblas_?gemm_compute. Otherwise the
+ * weights are packed in panels of kPanel rows interleaved along cols, and a
+ * built-in kernel computes the kPanel outputs of a panel at once with
+ * contiguous loads, streaming the weights once per product. It is used up
+ * to kPackedGemmMaxRows, where the BLAS GEMM spends most of its time on
+ * packing, and the layers call the BLAS as before above it. Products with a
+ * single row or column go to the BLAS GEMV, which packs nothing.
+ *
+ * The copy is packed again when the memory of the weights blob changes or
+ * its data is modified, as told by the version of the memory.
+ */
+template <typename Dtype>
+class PackedWeights {
+ public:
+  PackedWeights()
+      : groups_(0), rows_(0), cols_(0), m_(0), transposed_(false),
+        version_(0), group_size_(0) {}
+
+  /// @brief Whether products with m rows of X (or columns, for Y = W X) use
+  ///        the packed weights.
+  static bool Packs(int m);
+
+  /// @brief Packs the weights for products with m, unless they are packed
+  ///        already for the same data and shape.
+  void Pack(const Blob<Dtype>& weights, int groups, int rows, int cols,
+      int m, bool transposed);
+  /// @brief Computes the product with the weights of group, as given to the
+  ///        last Pack.
+  void Multiply(int group, const Dtype* x, Dtype* y) const;
+
+  static const int kPanel = 8;
+
+ private:
+  int groups_, rows_, cols_, m_;
+  bool transposed_;
+  shared_ptr<SyncedMemory> source_;
+  unsigned int version_;
+  /// @brief The packed weights, group_size_ elements per group.
+  shared_ptr<SyncedMemory> packed_;
+  size_t group_size_;
+
+  DISABLE_COPY_AND_ASSIGN(PackedWeights);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_PACKED_GEMM_HPP_
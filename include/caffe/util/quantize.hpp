@@ -0,0 +1,37 @@
+#ifndef CAFFE_UTIL_QUANTIZE_HPP_
+#define CAFFE_UTIL_QUANTIZE_HPP_
+
+#include <stdint.h>
+
+#include "caffe/blob.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+// Symmetric linear quantization to 8 bits, as used by the quantized layers:
+// a real value x is represented by q = round(x / scale) clamped to
+// [-127, 127], so that x is approximately scale * q.
+
+// Returns the scale that maps the largest magnitude of x to 127, or 1 if x
+// is all zeros.
+template <typename Dtype>
+Dtype quantization_scale(const int n, const Dtype* x);
+
+template <typename Dtype>
+void quantize_cpu(const int n, const Dtype scale, const Dtype* x, int8_t* q);
+
+// Quantizes each of the rows of the rows x cols matrix x with its own
+// scale, writing the integers to q (which may be x) and the scales to
+// scales.
+template <typename Dtype>
+void quantize_rows_cpu(const int rows, const int cols, const Dtype* x,
+    Dtype* q, Dtype* scales);
+
+// Serializes a blob holding integers in [-127, 127] with one byte per
+// value, in BlobProto::int8_data.
+template <typename Dtype>
+void Int8BlobToProto(const Blob<Dtype>& blob, BlobProto* proto);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_QUANTIZE_HPP_
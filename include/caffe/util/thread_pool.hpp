@@ -0,0 +1,122 @@
+#ifndef CAFFE_UTIL_THREAD_POOL_HPP_
+#define CAFFE_UTIL_THREAD_POOL_HPP_
+
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/// @brief A grain for element-wise loops, large enough to pay for waking the
+///        workers.
+const int kElementwiseGrain = 1 << 14;
+
+/// @brief The function run by the pool over [begin, end) of a loop.
+typedef void (*ParallelTask)(const void* body, int begin, int end);
+
+/**
+ * @brief Runs task over [0, n) on the process-wide CPU thread pool, split in
+ *        contiguous ranges of at least grain iterations, and returns when
+ *        all of them are done.
+ *
+ * The pool has Caffe::cpu_threads() - 1 workers, the calling thread taking
+ * its share of the ranges, and is rebuilt when the settings change. Workers
+ * sleep on a condition variable between loops rather than spinning, so they
+ * leave the cores to the BLAS threads while a GEMM runs. One loop runs on the
+ * pool at a time: a loop started from a loop body, or from another thread
+ * while the pool is busy, runs serially on its caller. Threads given a pool
+ * of their own with SetParallelForPool run their loops on it instead.
+ */
+void RunParallel(const int n, const int grain, ParallelTask task,
+    const void* body);
+
+namespace thread_pool_internal {
+
+template <typename Body>
+void RunBody(const void* body, int begin, int end) {
+  (*static_cast<const Body*>(body))(begin, end);
+}
+
+}  // namespace thread_pool_internal
+
+/**
+ * @brief Calls body(begin, end) over contiguous ranges covering [0, n) on
+ *        the CPU thread pool.
+ *
+ * The ranges are at least grain iterations long, so loops too small to pay
+ * for waking the workers run in one call on the calling thread. The split
+ * only depends on n, grain and the threads of the pool, and the iterations
+ * must be independent of each other. Bodies should not call multithreaded BLAS
+ * routines, whose threads would compete with the pool, nor depend on the
+ * per-thread settings of Caffe such as mode(), which other threads do not
+ * share.
+ */
+template <typename Body>
+inline void parallel_for(const int n, const Body& body, const int grain = 1) {
+  if (n <= 0) { return; }
+  if (n < 2 * grain) {
+    body(0, n);
+    return;
+  }
+  RunParallel(n, grain, &thread_pool_internal::RunBody<Body>, &body);
+}
+
+class ThreadPool;
+
+/**
+ * @brief A pool of threads of its own, for loops that run beside those of
+ *        the process-wide pool, such as the batch transformations of the
+ *        prefetching data layers.
+ *
+ * It has threads - 1 workers, the thread calling parallel_for taking its
+ * share of the ranges as with the process-wide pool. Range i of a loop of n
+ * iterations over threads ranges is always [n * i / threads,
+ * n * (i + 1) / threads), whichever thread runs it. Loops started from the
+ * loop bodies run serially.
+ */
+class WorkerPool {
+ public:
+  explicit WorkerPool(int threads);
+  /// @brief A pool of one thread per core, pinning worker i to cores[i];
+  ///        the thread calling parallel_for should run on cores[0].
+  explicit WorkerPool(const vector<int>& cores);
+
+  int threads() const { return threads_; }
+
+  /// @brief Calls body(begin, end) over contiguous ranges covering [0, n).
+  template <typename Body>
+  void parallel_for(const int n, const Body& body, const int grain = 1)
+      const {
+    if (n <= 0) { return; }
+    if (n < 2 * grain || threads_ == 1) {
+      body(0, n);
+      return;
+    }
+    Run(n, grain, &thread_pool_internal::RunBody<Body>, &body);
+  }
+
+ private:
+  friend void RunParallel(const int n, const int grain, ParallelTask task,
+      const void* body);
+
+  void Run(int n, int grain, ParallelTask task, const void* body) const;
+
+  const int threads_;
+  shared_ptr<ThreadPool> pool_;
+
+  DISABLE_COPY_AND_ASSIGN(WorkerPool);
+};
+
+/**
+ * @brief Makes parallel_for run the loops of the calling thread on pool,
+ *        which must outlive its use, or on the process-wide pool again if
+ *        pool is NULL.
+ *
+ * This gives threads that must not share cores, such as the stages of a
+ * Pipeline, pools of their own.
+ */
+void SetParallelForPool(WorkerPool* pool);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_THREAD_POOL_HPP_
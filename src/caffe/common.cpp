@@ -1,10 +1,12 @@
 #include <boost/thread.hpp>
 #include <glog/logging.h>
+#include <algorithm>
 #include <cmath>
 #include <cstdio>
 #include <ctime>
 
 #include "caffe/common.hpp"
+#include "caffe/util/math_functions.hpp"
 #include "caffe/util/rng.hpp"
 
 namespace caffe {
@@ -19,6 +21,56 @@ Caffe& Caffe::Get() {
   return *(thread_instance_.get());
 }
 
+// Process-wide host allocation settings.
+static Caffe::HostAllocatorType host_allocator_ = Caffe::MALLOC;
+static bool host_huge_pages_ = false;
+
+Caffe::HostAllocatorType Caffe::host_allocator() { return host_allocator_; }
+
+void Caffe::set_host_allocator(HostAllocatorType type) {
+  host_allocator_ = type;
+}
+
+bool Caffe::host_huge_pages() { return host_huge_pages_; }
+
+void Caffe::set_host_huge_pages(bool val) { host_huge_pages_ = val; }
+
+// Process-wide CPU thread pool settings; 0 threads stands for one per core.
+// Any thread may ask for them first, so the default thread count is filled
+// in once, and the affinity flag is guarded by a mutex.
+static int cpu_threads_ = 0;
+static boost::once_flag cpu_threads_once_ = BOOST_ONCE_INIT;
+static bool cpu_thread_affinity_ = false;
+static boost::mutex cpu_thread_affinity_mutex_;
+
+static void InitCpuThreads() {
+  if (cpu_threads_ == 0) {
+    cpu_threads_ = std::max(1U, boost::thread::hardware_concurrency());
+  }
+}
+
+int Caffe::cpu_threads() {
+  boost::call_once(&InitCpuThreads, cpu_threads_once_);
+  return cpu_threads_;
+}
+
+void Caffe::set_cpu_threads(int threads) {
+  CHECK_GT(threads, 0) << "Need at least one CPU thread.";
+  boost::call_once(&InitCpuThreads, cpu_threads_once_);
+  cpu_threads_ = threads;
+  caffe_set_blas_threads(threads);
+}
+
+bool Caffe::cpu_thread_affinity() {
+  boost::mutex::scoped_lock lock(cpu_thread_affinity_mutex_);
+  return cpu_thread_affinity_;
+}
+
+void Caffe::set_cpu_thread_affinity(bool val) {
+  boost::mutex::scoped_lock lock(cpu_thread_affinity_mutex_);
+  cpu_thread_affinity_ = val;
+}
+
 // random seeding
 int64_t cluster_seedgen(void) {
   int64_t s, seed, pid;
@@ -16,8 +16,16 @@ map<const string, weak_ptr<DataReader::Body> > DataReader::bodies_;
 static boost::mutex bodies_mutex_;
 
 DataReader::DataReader(const LayerParameter& param)
-    : queue_pair_(new QueuePair(  //
-        param.data_param().prefetch() * param.data_param().batch_size())) {
+    : pop_index_(0), push_index_(0) {
+  const DataParameter& data_param = param.data_param();
+  CHECK_GE(data_param.readers(), 1);
+  // Each queue pair gets the full prefetch, so that a reader ahead of the
+  // others does not wait for the solver to catch up.
+  const int queue_pairs = data_param.ordered_read() ? data_param.readers() : 1;
+  for (int i = 0; i < queue_pairs; ++i) {
+    queue_pairs_.push_back(shared_ptr<QueuePair>(new QueuePair(  //
+        data_param.prefetch() * data_param.batch_size())));
+  }
   // Get or create a body
   boost::mutex::scoped_lock lock(bodies_mutex_);
   string key = source_key(param);
@@ -27,7 +35,10 @@ DataReader::DataReader(const LayerParameter& param)
     body_.reset(new Body(param));
     bodies_[key] = weak_ptr<Body>(body_);
   }
-  body_->new_queue_pairs_.push(queue_pair_);
+  // The lock keeps the queue pairs of each solver together.
+  for (int i = 0; i < queue_pairs; ++i) {
+    body_->new_queue_pairs_.push(queue_pairs_[i]);
+  }
 }
 
 DataReader::~DataReader() {
@@ -39,6 +50,21 @@ DataReader::~DataReader() {
   }
 }
 
+Datum* DataReader::pop(const string& log_on_wait) {
+  Datum* datum = queue_pairs_[pop_index_]->full_.pop(log_on_wait);
+  pop_index_ = (pop_index_ + 1) % queue_pairs_.size();
+  return datum;
+}
+
+Datum* DataReader::peek() {
+  return queue_pairs_[pop_index_]->full_.peek();
+}
+
+void DataReader::push(Datum* datum) {
+  queue_pairs_[push_index_]->free_.push(datum);
+  push_index_ = (push_index_ + 1) % queue_pairs_.size();
+}
+
 //
 
 DataReader::QueuePair::QueuePair(int size) {
@@ -62,7 +88,10 @@ DataReader::QueuePair::~QueuePair() {
 
 DataReader::Body::Body(const LayerParameter& param)
     : param_(param),
-      new_queue_pairs_() {
+      new_queue_pairs_(),
+      readers_(param.data_param().readers()),
+      queue_pairs_(param.data_param().ordered_read() ? readers_ : 1),
+      solver_count_(1) {
   StartInternalThread();
 }
 
@@ -73,24 +102,47 @@ DataReader::Body::~Body() {
 void DataReader::Body::InternalThreadEntry() {
   shared_ptr<db::DB> db(db::GetDB(param_.data_param().backend()));
   db->Open(param_.data_param().source(), db::READ);
-  shared_ptr<db::Cursor> cursor(db->NewCursor());
-  vector<shared_ptr<QueuePair> > qps;
+  // The cursors are all opened here, as opening one is not thread safe.
+  vector<shared_ptr<db::Cursor> > cursors;
+  for (int i = 0; i < readers_; ++i) {
+    cursors.push_back(shared_ptr<db::Cursor>(db->NewCursor()));
+  }
+  // Declared last, so that the reader threads stop before their cursors
+  // are closed.
+  vector<shared_ptr<Reader> > readers;
   try {
-    int solver_count = param_.phase() == TRAIN ? Caffe::solver_count() : 1;
+    solver_count_ = param_.phase() == TRAIN ? Caffe::solver_count() : 1;
 
     // To ensure deterministic runs, only start running once all solvers
     // are ready. But solvers need to peek on one item during initialization,
     // so read one item, then wait for the next solver.
-    for (int i = 0; i < solver_count; ++i) {
-      shared_ptr<QueuePair> qp(new_queue_pairs_.pop());
-      read_one(cursor.get(), qp.get());
-      qps.push_back(qp);
+    uint64_t record = 0;
+    for (int i = 0; i < solver_count_; ++i) {
+      for (int j = 0; j < queue_pairs_; ++j) {
+        qps_.push_back(new_queue_pairs_.pop());
+      }
+      read_one(cursors[0].get(), qps_[i * queue_pairs_].get());
+      ++record;
     }
-    // Main loop
-    while (!must_stop()) {
-      for (int i = 0; i < solver_count; ++i) {
-        read_one(cursor.get(), qps[i].get());
+    // Reader r starts at the first record r + k * readers_ not read yet.
+    const uint64_t start = record;
+    for (int r = 0; r < readers_; ++r) {
+      const uint64_t first = start + (r + readers_ - start % readers_)
+          % readers_;
+      for (uint64_t k = r ? 0 : start; k < first; ++k) {
+        next(cursors[r].get());
+      }
+      if (r > 0) {
+        readers.push_back(shared_ptr<Reader>(
+            new Reader(this, cursors[r].get(), first)));
+        readers.back()->StartInternalThread();
+      } else {
+        record = first;
       }
+    }
+    // Main loop, of the first reader
+    while (!must_stop()) {
+      read_record(cursors[0].get(), &record);
       // Check no additional readers have been created. This can happen if
       // more than one net is trained at a time per process, whether single
       // or multi solver. It might also happen if two data layers have same
@@ -102,12 +154,33 @@ void DataReader::Body::InternalThreadEntry() {
   }
 }
 
+void DataReader::Body::read_record(db::Cursor* cursor, uint64_t* record) {
+  // Record k is the (k / solvers)-th of solver k % solvers, which takes
+  // its datums from its queue pairs in turn.
+  const int solver = *record % solver_count_;
+  const int qp = (*record / solver_count_) % queue_pairs_;
+  read_one(cursor, qps_[solver * queue_pairs_ + qp].get());
+  for (int i = 1; i < readers_; ++i) {
+    next(cursor);
+  }
+  *record += readers_;
+}
+
 void DataReader::Body::read_one(db::Cursor* cursor, QueuePair* qp) {
   Datum* datum = qp->free_.pop();
-  // TODO deserialize in-place instead of copy?
-  datum->ParseFromString(cursor->value());
+  // Parse the value where the database keeps it. The datums are recycled,
+  // so the pixels are copied into the buffer of an earlier record rather
+  // than a new allocation.
+  const char* data;
+  size_t size;
+  cursor->value_data(&data, &size);
+  datum->ParseFromArray(data, size);
   qp->full_.push(datum);
 
+  next(cursor);
+}
+
+void DataReader::Body::next(db::Cursor* cursor) {
   // go to the next iter
   cursor->Next();
   if (!cursor->valid()) {
@@ -116,4 +189,20 @@ void DataReader::Body::read_one(db::Cursor* cursor, QueuePair* qp) {
   }
 }
 
+//
+
+DataReader::Body::Reader::~Reader() {
+  StopInternalThread();
+}
+
+void DataReader::Body::Reader::InternalThreadEntry() {
+  try {
+    while (!must_stop()) {
+      body_->read_record(cursor_, &record_);
+    }
+  } catch (boost::thread_interrupted&) {
+    // Interrupted exception is expected on shutdown
+  }
+}
+
 }  // namespace caffe
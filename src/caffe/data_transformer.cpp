@@ -2,11 +2,13 @@
 #include <opencv2/core/core.hpp>
 #endif  // USE_OPENCV
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
 #include "caffe/data_transformer.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/jpeg.hpp"
 #include "caffe/util/math_functions.hpp"
 #include "caffe/util/rng.hpp"
 
@@ -28,6 +30,12 @@ DataTransformer<Dtype>::DataTransformer(const TransformationParameter& param,
     ReadProtoFromBinaryFileOrDie(mean_file.c_str(), &blob_proto);
     data_mean_.FromProto(blob_proto);
   }
+#ifndef USE_LIBJPEG
+  if (param_.decode_min_size()) {
+    LOG(WARNING) << "decode_min_size needs Caffe built with USE_LIBJPEG; "
+        << "encoded images are decoded at their size.";
+  }
+#endif  // USE_LIBJPEG
   // check if we want to use mean_value
   if (param_.mean_value_size() > 0) {
     CHECK(param_.has_mean_file() == false) <<
@@ -132,9 +140,15 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
                                        Blob<Dtype>* transformed_blob) {
   // If datum is encoded, decoded and transform the cv::image.
   if (datum.encoded()) {
-#ifdef USE_OPENCV
     CHECK(!(param_.force_color() && param_.force_gray()))
         << "cannot set both force_color and force_gray";
+#ifdef USE_LIBJPEG
+    // JPEG images are decoded by libjpeg, only as far as the crop needs.
+    if (TransformJPEG(datum, transformed_blob)) {
+      return;
+    }
+#endif  // USE_LIBJPEG
+#ifdef USE_OPENCV
     cv::Mat cv_img;
     if (param_.force_color() || param_.force_gray()) {
     // If force_color then decode in color otherwise decode in gray.
@@ -243,36 +257,14 @@ void DataTransformer<Dtype>::Transform(const cv::Mat& cv_img,
 
   CHECK(cv_img.depth() == CV_8U) << "Image data type must be unsigned byte";
 
-  const Dtype scale = param_.scale();
   const bool do_mirror = param_.mirror() && Rand(2);
-  const bool has_mean_file = param_.has_mean_file();
-  const bool has_mean_values = mean_values_.size() > 0;
 
   CHECK_GT(img_channels, 0);
   CHECK_GE(img_height, crop_size);
   CHECK_GE(img_width, crop_size);
 
-  Dtype* mean = NULL;
-  if (has_mean_file) {
-    CHECK_EQ(img_channels, data_mean_.channels());
-    CHECK_EQ(img_height, data_mean_.height());
-    CHECK_EQ(img_width, data_mean_.width());
-    mean = data_mean_.mutable_cpu_data();
-  }
-  if (has_mean_values) {
-    CHECK(mean_values_.size() == 1 || mean_values_.size() == img_channels) <<
-     "Specify either 1 mean_value or as many as channels: " << img_channels;
-    if (img_channels > 1 && mean_values_.size() == 1) {
-      // Replicate the mean_value for simplicity
-      for (int c = 1; c < img_channels; ++c) {
-        mean_values_.push_back(mean_values_[0]);
-      }
-    }
-  }
-
   int h_off = 0;
   int w_off = 0;
-  cv::Mat cv_cropped_img = cv_img;
   if (crop_size) {
     CHECK_EQ(crop_size, height);
     CHECK_EQ(crop_size, width);
@@ -284,19 +276,50 @@ void DataTransformer<Dtype>::Transform(const cv::Mat& cv_img,
       h_off = (img_height - crop_size) / 2;
       w_off = (img_width - crop_size) / 2;
     }
-    cv::Rect roi(w_off, h_off, crop_size, crop_size);
-    cv_cropped_img = cv_img(roi);
   } else {
     CHECK_EQ(img_height, height);
     CHECK_EQ(img_width, width);
   }
 
-  CHECK(cv_cropped_img.data);
+  CHECK(cv_img.data);
+  TransformImage(cv_img.ptr<uchar>(h_off) + w_off * img_channels,
+      cv_img.step[0], img_channels, img_height, img_width, h_off, w_off,
+      do_mirror, transformed_blob);
+}
+#endif  // USE_OPENCV
+
+template<typename Dtype>
+void DataTransformer<Dtype>::TransformImage(const unsigned char* crop,
+    int step, int img_channels, int img_height, int img_width, int h_off,
+    int w_off, bool do_mirror, Blob<Dtype>* transformed_blob) {
+  const int height = transformed_blob->height();
+  const int width = transformed_blob->width();
+  const Dtype scale = param_.scale();
+  const bool has_mean_file = param_.has_mean_file();
+  const bool has_mean_values = mean_values_.size() > 0;
+
+  Dtype* mean = NULL;
+  if (has_mean_file) {
+    CHECK_EQ(img_channels, data_mean_.channels());
+    CHECK_EQ(img_height, data_mean_.height());
+    CHECK_EQ(img_width, data_mean_.width());
+    mean = data_mean_.mutable_cpu_data();
+  }
+  if (has_mean_values) {
+    CHECK(mean_values_.size() == 1 || mean_values_.size() == img_channels) <<
+     "Specify either 1 mean_value or as many as channels: " << img_channels;
+    if (img_channels > 1 && mean_values_.size() == 1) {
+      // Replicate the mean_value for simplicity
+      for (int c = 1; c < img_channels; ++c) {
+        mean_values_.push_back(mean_values_[0]);
+      }
+    }
+  }
 
   Dtype* transformed_data = transformed_blob->mutable_cpu_data();
   int top_index;
   for (int h = 0; h < height; ++h) {
-    const uchar* ptr = cv_cropped_img.ptr<uchar>(h);
+    const unsigned char* ptr = crop + h * step;
     int img_index = 0;
     for (int w = 0; w < width; ++w) {
       for (int c = 0; c < img_channels; ++c) {
@@ -323,7 +346,77 @@ void DataTransformer<Dtype>::Transform(const cv::Mat& cv_img,
     }
   }
 }
-#endif  // USE_OPENCV
+
+#ifdef USE_LIBJPEG
+template<typename Dtype>
+int DataTransformer<Dtype>::DecodeColor() const {
+  return param_.force_color() ? 1 : (param_.force_gray() ? 0 : -1);
+}
+
+template<typename Dtype>
+int DataTransformer<Dtype>::DecodeMinSize() const {
+  // The crop must fit in the scaled image.
+  return param_.decode_min_size() ?
+      std::max(param_.decode_min_size(), param_.crop_size()) : 0;
+}
+
+template<typename Dtype>
+bool DataTransformer<Dtype>::TransformJPEG(const Datum& datum,
+    Blob<Dtype>* transformed_blob) {
+  const string& data = datum.data();
+  const int crop_size = param_.crop_size();
+  const int color = DecodeColor();
+  int scale, img_height, img_width, img_channels;
+  if (!ReadJPEGShape(data, color, DecodeMinSize(), &scale, &img_height,
+      &img_width, &img_channels)) {
+    return false;
+  }
+
+  // Check dimensions, and draw the mirror and crop as Transform of a cv::Mat
+  // does, so that both decode paths give the same results.
+  const int channels = transformed_blob->channels();
+  const int height = transformed_blob->height();
+  const int width = transformed_blob->width();
+  const int num = transformed_blob->num();
+
+  CHECK_EQ(channels, img_channels);
+  CHECK_LE(height, img_height);
+  CHECK_LE(width, img_width);
+  CHECK_GE(num, 1);
+
+  const bool do_mirror = param_.mirror() && Rand(2);
+
+  CHECK_GT(img_channels, 0);
+  CHECK_GE(img_height, crop_size);
+  CHECK_GE(img_width, crop_size);
+
+  int h_off = 0;
+  int w_off = 0;
+  if (crop_size) {
+    CHECK_EQ(crop_size, height);
+    CHECK_EQ(crop_size, width);
+    // We only do random crop when we do training.
+    if (phase_ == TRAIN) {
+      h_off = Rand(img_height - crop_size + 1);
+      w_off = Rand(img_width - crop_size + 1);
+    } else {
+      h_off = (img_height - crop_size) / 2;
+      w_off = (img_width - crop_size) / 2;
+    }
+  } else {
+    CHECK_EQ(img_height, height);
+    CHECK_EQ(img_width, width);
+  }
+
+  // Only the rows and columns of the crop are decoded.
+  int step, offset;
+  CHECK(DecodeJPEG(data, color, scale, w_off, h_off, width, height,
+      &decode_buffer_, &step, &offset)) << "Could not decode datum";
+  TransformImage(&decode_buffer_[offset], step, img_channels, img_height,
+      img_width, h_off, w_off, do_mirror, transformed_blob);
+  return true;
+}
+#endif  // USE_LIBJPEG
 
 template<typename Dtype>
 void DataTransformer<Dtype>::Transform(Blob<Dtype>* input_blob,
@@ -441,9 +534,25 @@ void DataTransformer<Dtype>::Transform(Blob<Dtype>* input_blob,
 template<typename Dtype>
 vector<int> DataTransformer<Dtype>::InferBlobShape(const Datum& datum) {
   if (datum.encoded()) {
-#ifdef USE_OPENCV
     CHECK(!(param_.force_color() && param_.force_gray()))
         << "cannot set both force_color and force_gray";
+#ifdef USE_LIBJPEG
+    // The header of a JPEG image gives its shape without decoding it.
+    int scale, height, width, channels;
+    if (ReadJPEGShape(datum.data(), DecodeColor(), DecodeMinSize(), &scale,
+        &height, &width, &channels)) {
+      const int crop_size = param_.crop_size();
+      CHECK_GE(height, crop_size);
+      CHECK_GE(width, crop_size);
+      vector<int> shape(4);
+      shape[0] = 1;
+      shape[1] = channels;
+      shape[2] = crop_size ? crop_size : height;
+      shape[3] = crop_size ? crop_size : width;
+      return shape;
+    }
+#endif  // USE_LIBJPEG
+#ifdef USE_OPENCV
     cv::Mat cv_img;
     if (param_.force_color() || param_.force_gray()) {
     // If force_color then decode in color otherwise decode in gray.
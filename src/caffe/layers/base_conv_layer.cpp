@@ -3,6 +3,7 @@
 
 #include "caffe/filler.hpp"
 #include "caffe/layers/base_conv_layer.hpp"
+#include "caffe/util/activation.hpp"
 #include "caffe/util/im2col.hpp"
 #include "caffe/util/math_functions.hpp"
 
@@ -227,8 +228,9 @@ void BaseConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
     }
   }
   // The im2col result buffer will only hold one image at a time to avoid
-  // overly large memory usage. In the special case of 1x1 convolution
-  // it goes lazily unused to save memory.
+  // overly large memory usage, and its memory is borrowed from the workspace
+  // shared by all convolutions of the thread. In the special case of 1x1
+  // convolution it goes unused to save memory.
   col_buffer_shape_.clear();
   col_buffer_shape_.push_back(kernel_dim_ * group_);
   for (int i = 0; i < num_spatial_axes_; ++i) {
@@ -238,7 +240,63 @@ void BaseConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
       col_buffer_shape_.push_back(output_shape_[i]);
     }
   }
-  col_buffer_.Reshape(col_buffer_shape_);
+  // A col_buffer_limit too small for whole images makes the CPU helpers
+  // work on strips of rows of the column image (2D im2col only).
+  col_tile_rows_ = 0;
+  const uint64_t col_buffer_limit =
+      this->layer_param_.convolution_param().col_buffer_limit();
+  if (col_buffer_limit > 0 && Caffe::mode() == Caffe::CPU && !is_1x1_ &&
+      !force_nd_im2col_ && num_spatial_axes_ == 2) {
+    const uint64_t row_size = static_cast<uint64_t>(col_buffer_shape_[0]) *
+        col_buffer_shape_[2] * sizeof(Dtype);
+    const uint64_t rows = std::max<uint64_t>(col_buffer_limit / row_size, 1);
+    if (rows < static_cast<uint64_t>(col_buffer_shape_[1])) {
+      col_tile_rows_ = rows;
+    }
+  }
+  // A batch_gemm_limit lets the batched CPU helpers of convolution work on
+  // as many images at once as fit, each taking its columns and the staging
+  // for its GEMM output.
+  gemm_batch_ = 1;
+  const uint64_t batch_gemm_limit =
+      this->layer_param_.convolution_param().batch_gemm_limit();
+  if (batch_gemm_limit > 0 && Caffe::mode() == Caffe::CPU &&
+      !reverse_dimensions() && col_tile_rows_ == 0 && !force_nd_im2col_ &&
+      num_spatial_axes_ == 2) {
+    const uint64_t image_size = static_cast<uint64_t>(kernel_dim_ * group_ +
+        conv_out_channels_) * conv_out_spatial_dim_ * sizeof(Dtype);
+    gemm_batch_ = std::max<uint64_t>(std::min<uint64_t>(
+        batch_gemm_limit / image_size, num_), 1);
+  }
+  // Depthwise convolution has one input channel per group, so its GEMMs are
+  // too thin to pay for im2col; it is done directly and needs no columns.
+  depthwise_ = Caffe::mode() == Caffe::CPU && !reverse_dimensions() &&
+      !force_nd_im2col_ && num_spatial_axes_ == 2 && group_ > 1 &&
+      group_ == channels_ && col_tile_rows_ == 0 && gemm_batch_ == 1;
+  const int block = this->layer_param_.channel_block();
+  if (block > 0) {
+    CHECK(!reverse_dimensions() && num_spatial_axes_ == 2 &&
+        group_ == channels_ && num_output_ == channels_)
+        << "Only 2D depthwise convolution with group == num_output == "
+        << "channels computes in the channel-blocked layout.";
+    CHECK_EQ(channels_ % block, 0) << "The channels must be a multiple of "
+        << "the channel block.";
+  }
+  if (col_tile_rows_ > 0) {
+    vector<int> col_tile_shape(col_buffer_shape_);
+    col_tile_shape[1] = col_tile_rows_;
+    col_buffer_.Reshape(col_tile_shape);
+  } else if (gemm_batch_ > 1) {
+    col_buffer_.Reshape(vector<int>(1, gemm_batch_ *
+        (kernel_dim_ * group_ + conv_out_channels_) * conv_out_spatial_dim_));
+  } else {
+    col_buffer_.Reshape(col_buffer_shape_);
+  }
+  const size_t col_buffer_size =
+      (is_1x1_ && gemm_batch_ == 1) || depthwise_ || block > 0 ?
+      0 : col_buffer_.count() * sizeof(Dtype);
+  ConvWorkspace::Register(this, col_buffer_size);
+  ConvWorkspace::Get().Reserve(col_buffer_size);
   bottom_dim_ = bottom[0]->count(channel_axis_);
   top_dim_ = top[0]->count(channel_axis_);
   num_kernels_im2col_ = conv_in_channels_ * conv_out_spatial_dim_;
@@ -256,18 +314,86 @@ void BaseConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
     const Dtype* weights, Dtype* output, bool skip_im2col) {
+  if (col_tile_rows_ > 0) {
+    // The buffer only holds the last strip, so skip_im2col cannot apply.
+    borrow_col_buffer();
+    Dtype* col_buff = col_buffer_.mutable_cpu_data();
+    const int height = col_buffer_shape_[1];
+    const int width = col_buffer_shape_[2];
+    for (int row = 0; row < height; row += col_tile_rows_) {
+      const int row_end = std::min(row + col_tile_rows_, height);
+      const int strip_dim = (row_end - row) * width;
+      conv_im2col_rows_cpu(input, row, row_end, col_buff);
+      for (int g = 0; g < group_; ++g) {
+        caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, conv_out_channels_ /
+            group_, strip_dim, kernel_dim_,
+            (Dtype)1., weights + weight_offset_ * g, kernel_dim_,
+            col_buff + kernel_dim_ * strip_dim * g, strip_dim,
+            (Dtype)0., output + output_offset_ * g + row * width,
+            conv_out_spatial_dim_);
+      }
+    }
+    return;
+  }
   const Dtype* col_buff = input;
   if (!is_1x1_) {
+    borrow_col_buffer();
     if (!skip_im2col) {
       conv_im2col_cpu(input, col_buffer_.mutable_cpu_data());
     }
     col_buff = col_buffer_.cpu_data();
   }
+  const bool packed = this->phase_ == TEST && conv_out_spatial_dim_ > 1 &&
+      PackedWeights<Dtype>::Packs(conv_out_spatial_dim_) &&
+      weights == this->blobs_[0]->cpu_data();
+  if (packed) {
+    // The weights are packed once rather than by every GEMM.
+    packed_weights_.Pack(*this->blobs_[0], group_, conv_out_channels_ / group_,
+        kernel_dim_, conv_out_spatial_dim_, false);
+  }
+  for (int g = 0; g < group_; ++g) {
+    if (conv_out_spatial_dim_ == 1) {
+      caffe_cpu_gemv<Dtype>(CblasNoTrans, conv_out_channels_ / group_,
+          kernel_dim_, (Dtype)1., weights + weight_offset_ * g,
+          col_buff + col_offset_ * g, (Dtype)0., output + output_offset_ * g);
+    } else if (packed) {
+      packed_weights_.Multiply(g, col_buff + col_offset_ * g,
+          output + output_offset_ * g);
+    } else {
+      caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, conv_out_channels_ /
+          group_, conv_out_spatial_dim_, kernel_dim_,
+          (Dtype)1., weights + weight_offset_ * g, col_buff + col_offset_ * g,
+          (Dtype)0., output + output_offset_ * g);
+    }
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_gemm_batch(const Dtype* input,
+    const Dtype* weights, Dtype* output, int num) {
+  CHECK_LE(num, gemm_batch_);
+  borrow_col_buffer();
+  // The columns of the images lie side by side, followed by the staging for
+  // the GEMM output, which holds the outputs of the images side by side too.
+  const int batch_dim = num * conv_out_spatial_dim_;
+  Dtype* col_buff = col_buffer_.mutable_cpu_data();
+  Dtype* output_buff = col_buff + kernel_dim_ * group_ * batch_dim;
+  for (int n = 0; n < num; ++n) {
+    conv_im2col_batch_cpu(input + n * bottom_dim_, n, num, col_buff);
+  }
   for (int g = 0; g < group_; ++g) {
     caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, conv_out_channels_ /
-        group_, conv_out_spatial_dim_, kernel_dim_,
-        (Dtype)1., weights + weight_offset_ * g, col_buff + col_offset_ * g,
-        (Dtype)0., output + output_offset_ * g);
+        group_, batch_dim, kernel_dim_,
+        (Dtype)1., weights + weight_offset_ * g,
+        col_buff + col_offset_ * num * g,
+        (Dtype)0., output_buff + output_offset_ * num * g);
+  }
+  for (int n = 0; n < num; ++n) {
+    for (int c = 0; c < conv_out_channels_; ++c) {
+      caffe_copy(conv_out_spatial_dim_,
+          output_buff + c * batch_dim + n * conv_out_spatial_dim_,
+          output + n * top_dim_ + c * conv_out_spatial_dim_);
+    }
   }
 }
 
@@ -279,12 +405,76 @@ void BaseConvolutionLayer<Dtype>::forward_cpu_bias(Dtype* output,
       (Dtype)1., output);
 }
 
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_bias_activation(Dtype* output) {
+  const ActivationParameter& activation =
+      this->layer_param_.convolution_param().fused_activation();
+  if (activation.type() == ActivationParameter_Type_NONE) {
+    if (bias_term_) {
+      forward_cpu_bias(output, this->blobs_[1]->cpu_data());
+    }
+    return;
+  }
+  activation_forward_cpu(activation, num_output_, out_spatial_dim_,
+      bias_term_ ? this->blobs_[1]->cpu_data() : NULL,
+      static_cast<const Dtype*>(NULL), output);
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_bias_activation_blocked(
+    Dtype* output) {
+  const ActivationParameter& activation =
+      this->layer_param_.convolution_param().fused_activation();
+  const int block = this->layer_param_.channel_block();
+  // Each block is an out_spatial_dim_ x block matrix with a bias per column.
+  for (int b = 0; b < num_output_ / block; ++b) {
+    activation_forward_cpu(activation, out_spatial_dim_, block,
+        static_cast<const Dtype*>(NULL),
+        bias_term_ ? this->blobs_[1]->cpu_data() + b * block : NULL,
+        output + b * out_spatial_dim_ * block);
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::backward_cpu_activation(
+    const vector<Blob<Dtype>*>& top) {
+  const ActivationParameter& activation =
+      this->layer_param_.convolution_param().fused_activation();
+  if (activation.type() == ActivationParameter_Type_NONE) { return; }
+  for (int i = 0; i < top.size(); ++i) {
+    activation_backward_cpu(activation, top[i]->count(), top[i]->cpu_data(),
+        top[i]->mutable_cpu_diff());
+  }
+}
+
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::backward_cpu_gemm(const Dtype* output,
     const Dtype* weights, Dtype* input) {
-  Dtype* col_buff = col_buffer_.mutable_cpu_data();
-  if (is_1x1_) {
-    col_buff = input;
+  if (col_tile_rows_ > 0) {
+    borrow_col_buffer();
+    Dtype* col_buff = col_buffer_.mutable_cpu_data();
+    const int height = col_buffer_shape_[1];
+    const int width = col_buffer_shape_[2];
+    caffe_set(conv_in_channels_ * conv_input_shape_.cpu_data()[1] *
+        conv_input_shape_.cpu_data()[2], Dtype(0), input);
+    for (int row = 0; row < height; row += col_tile_rows_) {
+      const int row_end = std::min(row + col_tile_rows_, height);
+      const int strip_dim = (row_end - row) * width;
+      for (int g = 0; g < group_; ++g) {
+        caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, kernel_dim_,
+            strip_dim, conv_out_channels_ / group_,
+            (Dtype)1., weights + weight_offset_ * g, kernel_dim_,
+            output + output_offset_ * g + row * width, conv_out_spatial_dim_,
+            (Dtype)0., col_buff + kernel_dim_ * strip_dim * g, strip_dim);
+      }
+      conv_col2im_rows_cpu(col_buff, row, row_end, input);
+    }
+    return;
+  }
+  Dtype* col_buff = input;
+  if (!is_1x1_) {
+    borrow_col_buffer();
+    col_buff = col_buffer_.mutable_cpu_data();
   }
   for (int g = 0; g < group_; ++g) {
     caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, kernel_dim_,
@@ -300,8 +490,28 @@ void BaseConvolutionLayer<Dtype>::backward_cpu_gemm(const Dtype* output,
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::weight_cpu_gemm(const Dtype* input,
     const Dtype* output, Dtype* weights) {
+  if (col_tile_rows_ > 0) {
+    borrow_col_buffer();
+    Dtype* col_buff = col_buffer_.mutable_cpu_data();
+    const int height = col_buffer_shape_[1];
+    const int width = col_buffer_shape_[2];
+    for (int row = 0; row < height; row += col_tile_rows_) {
+      const int row_end = std::min(row + col_tile_rows_, height);
+      const int strip_dim = (row_end - row) * width;
+      conv_im2col_rows_cpu(input, row, row_end, col_buff);
+      for (int g = 0; g < group_; ++g) {
+        caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans,
+            conv_out_channels_ / group_, kernel_dim_, strip_dim,
+            (Dtype)1., output + output_offset_ * g + row * width,
+            conv_out_spatial_dim_, col_buff + kernel_dim_ * strip_dim * g,
+            strip_dim, (Dtype)1., weights + weight_offset_ * g, kernel_dim_);
+      }
+    }
+    return;
+  }
   const Dtype* col_buff = input;
   if (!is_1x1_) {
+    borrow_col_buffer();
     conv_im2col_cpu(input, col_buffer_.mutable_cpu_data());
     col_buff = col_buffer_.cpu_data();
   }
@@ -313,6 +523,33 @@ void BaseConvolutionLayer<Dtype>::weight_cpu_gemm(const Dtype* input,
   }
 }
 
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::weight_cpu_gemm_batch(const Dtype* input,
+    const Dtype* output, Dtype* weights, int num) {
+  CHECK_LE(num, gemm_batch_);
+  borrow_col_buffer();
+  // Lay the columns and the output gradients of the images side by side, as
+  // in forward_cpu_gemm_batch, so a single GEMM sums over all of them.
+  const int batch_dim = num * conv_out_spatial_dim_;
+  Dtype* col_buff = col_buffer_.mutable_cpu_data();
+  Dtype* output_buff = col_buff + kernel_dim_ * group_ * batch_dim;
+  for (int n = 0; n < num; ++n) {
+    conv_im2col_batch_cpu(input + n * bottom_dim_, n, num, col_buff);
+    for (int c = 0; c < conv_out_channels_; ++c) {
+      caffe_copy(conv_out_spatial_dim_,
+          output + n * top_dim_ + c * conv_out_spatial_dim_,
+          output_buff + c * batch_dim + n * conv_out_spatial_dim_);
+    }
+  }
+  for (int g = 0; g < group_; ++g) {
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, conv_out_channels_ / group_,
+        kernel_dim_, batch_dim,
+        (Dtype)1., output_buff + output_offset_ * num * g,
+        col_buff + col_offset_ * num * g,
+        (Dtype)1., weights + weight_offset_ * g);
+  }
+}
+
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::backward_cpu_bias(Dtype* bias,
     const Dtype* input) {
@@ -327,6 +564,7 @@ void BaseConvolutionLayer<Dtype>::forward_gpu_gemm(const Dtype* input,
     const Dtype* weights, Dtype* output, bool skip_im2col) {
   const Dtype* col_buff = input;
   if (!is_1x1_) {
+    borrow_col_buffer();
     if (!skip_im2col) {
       conv_im2col_gpu(input, col_buffer_.mutable_gpu_data());
     }
@@ -351,9 +589,10 @@ void BaseConvolutionLayer<Dtype>::forward_gpu_bias(Dtype* output,
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::backward_gpu_gemm(const Dtype* output,
     const Dtype* weights, Dtype* input) {
-  Dtype* col_buff = col_buffer_.mutable_gpu_data();
-  if (is_1x1_) {
-    col_buff = input;
+  Dtype* col_buff = input;
+  if (!is_1x1_) {
+    borrow_col_buffer();
+    col_buff = col_buffer_.mutable_gpu_data();
   }
   for (int g = 0; g < group_; ++g) {
     caffe_gpu_gemm<Dtype>(CblasTrans, CblasNoTrans, kernel_dim_,
@@ -371,6 +610,7 @@ void BaseConvolutionLayer<Dtype>::weight_gpu_gemm(const Dtype* input,
     const Dtype* output, Dtype* weights) {
   const Dtype* col_buff = input;
   if (!is_1x1_) {
+    borrow_col_buffer();
     conv_im2col_gpu(input, col_buffer_.mutable_gpu_data());
     col_buff = col_buffer_.gpu_data();
   }
@@ -389,6 +629,30 @@ void BaseConvolutionLayer<Dtype>::backward_gpu_bias(Dtype* bias,
       input, bias_multiplier_.gpu_data(), 1., bias);
 }
 
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_gpu_activation(
+    const vector<Blob<Dtype>*>& top) {
+  const ActivationParameter& activation =
+      this->layer_param_.convolution_param().fused_activation();
+  if (activation.type() == ActivationParameter_Type_NONE) { return; }
+  for (int i = 0; i < top.size(); ++i) {
+    activation_forward_gpu(activation, top[i]->count(),
+        top[i]->mutable_gpu_data());
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::backward_gpu_activation(
+    const vector<Blob<Dtype>*>& top) {
+  const ActivationParameter& activation =
+      this->layer_param_.convolution_param().fused_activation();
+  if (activation.type() == ActivationParameter_Type_NONE) { return; }
+  for (int i = 0; i < top.size(); ++i) {
+    activation_backward_gpu(activation, top[i]->count(), top[i]->gpu_data(),
+        top[i]->mutable_gpu_diff());
+  }
+}
+
 #endif  // !CPU_ONLY
 
 INSTANTIATE_CLASS(BaseConvolutionLayer);
@@ -7,6 +7,7 @@
 #include "caffe/layer.hpp"
 #include "caffe/layers/base_data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/benchmark.hpp"
 #include "caffe/util/blocking_queue.hpp"
 
 namespace caffe {
@@ -36,9 +37,19 @@ template <typename Dtype>
 BasePrefetchingDataLayer<Dtype>::BasePrefetchingDataLayer(
     const LayerParameter& param)
     : BaseDataLayer<Dtype>(param),
-      prefetch_free_(), prefetch_full_() {
-  for (int i = 0; i < PREFETCH_COUNT; ++i) {
-    prefetch_free_.push(&prefetch_[i]);
+      prefetch_free_(), prefetch_full_(), prefetch_batches_(0),
+      prefetch_stalls_(0), consumer_wait_ms_(0), producer_wait_ms_(0) {
+  // ImageData has its own prefetch parameters, the other layers use those of
+  // DataParameter.
+  const bool image = param.has_image_data_param();
+  const int prefetch = image ? param.image_data_param().prefetch() :
+      param.data_param().prefetch();
+  max_prefetch_ = image ? param.image_data_param().max_prefetch() :
+      param.data_param().max_prefetch();
+  CHECK_GT(prefetch, 0) << "Prefetch at least one batch.";
+  for (int i = 0; i < prefetch; ++i) {
+    prefetch_.push_back(shared_ptr<Batch<Dtype> >(new Batch<Dtype>()));
+    prefetch_free_.push(prefetch_[i].get());
   }
 }
 
@@ -50,24 +61,35 @@ void BasePrefetchingDataLayer<Dtype>::LayerSetUp(
   // calls so that the prefetch thread does not accidentally make simultaneous
   // cudaMalloc calls when the main thread is running. In some GPUs this
   // seems to cause failures if we do not so.
-  for (int i = 0; i < PREFETCH_COUNT; ++i) {
-    prefetch_[i].data_.mutable_cpu_data();
+  for (int i = 0; i < prefetch_.size(); ++i) {
+    prefetch_[i]->data_.mutable_cpu_data();
     if (this->output_labels_) {
-      prefetch_[i].label_.mutable_cpu_data();
+      prefetch_[i]->label_.mutable_cpu_data();
     }
   }
 #ifndef CPU_ONLY
   if (Caffe::mode() == Caffe::GPU) {
-    for (int i = 0; i < PREFETCH_COUNT; ++i) {
-      prefetch_[i].data_.mutable_gpu_data();
+    for (int i = 0; i < prefetch_.size(); ++i) {
+      prefetch_[i]->data_.mutable_gpu_data();
       if (this->output_labels_) {
-        prefetch_[i].label_.mutable_gpu_data();
+        prefetch_[i]->label_.mutable_gpu_data();
       }
     }
   }
 #endif
   DLOG(INFO) << "Initializing prefetch";
   this->data_transformer_->InitRand();
+  // The transformers of the other workers draw their seeds in turn from the
+  // random generator of Caffe, so that a seeded net repeats its batches.
+  const int threads = this->transform_param_.threads();
+  CHECK_GE(threads, 1) << "The transformations need at least one thread.";
+  transformers_.assign(1, this->data_transformer_);
+  for (int i = 1; i < threads; ++i) {
+    transformers_.push_back(shared_ptr<DataTransformer<Dtype> >(
+        new DataTransformer<Dtype>(this->transform_param_, this->phase_)));
+    transformers_.back()->InitRand();
+  }
+  transform_pool_.reset(new WorkerPool(threads));
   StartInternalThread();
   DLOG(INFO) << "Prefetch initialized.";
 }
@@ -82,9 +104,13 @@ void BasePrefetchingDataLayer<Dtype>::InternalThreadEntry() {
 #endif
 
   try {
+    CPUTimer timer;
     while (!must_stop()) {
+      timer.Start();
       Batch<Dtype>* batch = prefetch_free_.pop();
+      const double wait_ms = timer.MilliSeconds();
       load_batch(batch);
+      batch->wait_ms_ = wait_ms;
 #ifndef CPU_ONLY
       if (Caffe::mode() == Caffe::GPU) {
         batch->data_.data().get()->async_gpu_push(stream);
@@ -103,10 +129,85 @@ void BasePrefetchingDataLayer<Dtype>::InternalThreadEntry() {
 #endif
 }
 
+// Runs the workers of a range, each over its own items of the batch.
+template <typename Dtype>
+class BasePrefetchingDataLayer<Dtype>::TransformWorkers {
+ public:
+  TransformWorkers(BasePrefetchingDataLayer<Dtype>* layer,
+      Batch<Dtype>* batch, int items, Dtype* data)
+      : layer_(layer), batch_(batch), items_(items), data_(data) {}
+  void operator()(int begin, int end) const {
+    const int workers = layer_->transformers_.size();
+    vector<int> shape = batch_->data_.shape();
+    shape[0] = 1;
+    Blob<Dtype> transformed(shape);
+    for (int w = begin; w < end; ++w) {
+      DataTransformer<Dtype>* transformer = layer_->transformers_[w].get();
+      const int item_end = static_cast<int64_t>(items_) * (w + 1) / workers;
+      for (int item = static_cast<int64_t>(items_) * w / workers;
+           item < item_end; ++item) {
+        transformed.set_cpu_data(data_ + batch_->data_.offset(item));
+        layer_->transform_item(item, transformer, &transformed);
+      }
+    }
+  }
+
+ private:
+  BasePrefetchingDataLayer<Dtype>* const layer_;
+  Batch<Dtype>* const batch_;
+  const int items_;
+  Dtype* const data_;
+};
+
+template <typename Dtype>
+void BasePrefetchingDataLayer<Dtype>::TransformBatch(Batch<Dtype>* batch,
+    int items) {
+  CHECK_LE(items, batch->data_.shape(0));
+  transform_pool_->parallel_for(transformers_.size(),
+      TransformWorkers(this, batch, items, batch->data_.mutable_cpu_data()));
+}
+
+template <typename Dtype>
+Batch<Dtype>* BasePrefetchingDataLayer<Dtype>::NextBatch() {
+  Batch<Dtype>* batch = NULL;
+  if (!prefetch_full_.try_pop(&batch)) {
+    CPUTimer timer;
+    timer.Start();
+    batch = prefetch_full_.pop("Data layer prefetch queue empty");
+    consumer_wait_ms_ += timer.MilliSeconds();
+    ++prefetch_stalls_;
+    // The first batch is left out, the prefetch thread having just started.
+    if (prefetch_batches_ > 0 && prefetch_depth() < max_prefetch_) {
+      shared_ptr<Batch<Dtype> > grown(new Batch<Dtype>());
+      grown->data_.ReshapeLike(batch->data_);
+      grown->data_.mutable_cpu_data();
+      if (this->output_labels_) {
+        grown->label_.ReshapeLike(batch->label_);
+        grown->label_.mutable_cpu_data();
+      }
+#ifndef CPU_ONLY
+      if (Caffe::mode() == Caffe::GPU) {
+        grown->data_.mutable_gpu_data();
+        if (this->output_labels_) {
+          grown->label_.mutable_gpu_data();
+        }
+      }
+#endif
+      prefetch_.push_back(grown);
+      prefetch_free_.push(grown.get());
+      LOG(INFO) << this->layer_param_.name() << " waited for its data, "
+          << "prefetching " << prefetch_.size() << " batches.";
+    }
+  }
+  ++prefetch_batches_;
+  producer_wait_ms_ += batch->wait_ms_;
+  return batch;
+}
+
 template <typename Dtype>
 void BasePrefetchingDataLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
-  Batch<Dtype>* batch = prefetch_full_.pop("Data layer prefetch queue empty");
+  Batch<Dtype>* batch = NextBatch();
   // Reshape to loaded data.
   top[0]->ReshapeLike(batch->data_);
   // Copy the data
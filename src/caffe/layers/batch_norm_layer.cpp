@@ -3,9 +3,58 @@
 
 #include "caffe/layers/batch_norm_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+namespace {
+
+// Normalizes ranges of the channels of all images: output = (input - mean)
+// / deviation, skipping the steps whose statistics are NULL, and copies the
+// deviation of each channel to temp and the output to x_norm if not NULL.
+template <typename Dtype>
+struct BatchNormPlanes {
+  BatchNormPlanes(int channels, int spatial_dim, const Dtype* input,
+      const Dtype* mean, const Dtype* deviation, Dtype* output, Dtype* temp,
+      Dtype* x_norm)
+      : channels(channels), spatial_dim(spatial_dim), input(input),
+        mean(mean), deviation(deviation), output(output), temp(temp),
+        x_norm(x_norm) {}
+  void operator()(int begin, int end) const {
+    for (int plane = begin; plane < end; ++plane) {
+      const int c = plane % channels;
+      const int offset = plane * spatial_dim;
+      const Dtype* x = input + offset;
+      Dtype* y = output + offset;
+      if (mean) {
+        for (int i = 0; i < spatial_dim; ++i) {
+          y[i] = x[i] - mean[c];
+        }
+        x = y;
+      }
+      if (deviation) {
+        for (int i = 0; i < spatial_dim; ++i) {
+          y[i] = x[i] / deviation[c];
+        }
+        std::fill(temp + offset, temp + offset + spatial_dim, deviation[c]);
+      }
+      if (x_norm) {
+        std::copy(y, y + spatial_dim, x_norm + offset);
+      }
+    }
+  }
+  const int channels;
+  const int spatial_dim;
+  const Dtype* const input;
+  const Dtype* const mean;
+  const Dtype* const deviation;
+  Dtype* const output;
+  Dtype* const temp;
+  Dtype* const x_norm;
+};
+
+}  // namespace
+
 template <typename Dtype>
 void BatchNormLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -79,9 +128,8 @@ void BatchNormLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   int num = bottom[0]->shape(0);
   int spatial_dim = bottom[0]->count()/(bottom[0]->shape(0)*channels_);
 
-  if (bottom[0] != top[0]) {
-    caffe_copy(bottom[0]->count(), bottom_data, top_data);
-  }
+  const int planes = channels_ * num;
+  const int grain = std::max(1, kElementwiseGrain / spatial_dim);
 
   if (use_global_stats_) {
     // use the stored mean/variance estimates.
@@ -100,17 +148,11 @@ void BatchNormLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     caffe_cpu_gemv<Dtype>(CblasTrans, num, channels_, 1.,
         num_by_chans_.cpu_data(), batch_sum_multiplier_.cpu_data(), 0.,
         mean_.mutable_cpu_data());
-  }
 
-  // subtract mean
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num, channels_, 1, 1,
-      batch_sum_multiplier_.cpu_data(), mean_.cpu_data(), 0.,
-      num_by_chans_.mutable_cpu_data());
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, channels_ * num,
-      spatial_dim, 1, -1, num_by_chans_.cpu_data(),
-      spatial_sum_multiplier_.cpu_data(), 1., top_data);
+    // subtract mean
+    parallel_for(planes, BatchNormPlanes<Dtype>(channels_, spatial_dim,
+        bottom_data, mean_.cpu_data(), NULL, top_data, NULL, NULL), grain);
 
-  if (!use_global_stats_) {
     // compute variance using var(X) = E((X-EX)^2)
     caffe_powx(top[0]->count(), top_data, Dtype(2),
         temp_.mutable_cpu_data());  // (X-EX)^2
@@ -139,18 +181,15 @@ void BatchNormLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   caffe_powx(variance_.count(), variance_.cpu_data(), Dtype(0.5),
              variance_.mutable_cpu_data());
 
-  // replicate variance to input size
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num, channels_, 1, 1,
-      batch_sum_multiplier_.cpu_data(), variance_.cpu_data(), 0.,
-      num_by_chans_.mutable_cpu_data());
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, channels_ * num,
-      spatial_dim, 1, 1., num_by_chans_.cpu_data(),
-      spatial_sum_multiplier_.cpu_data(), 0., temp_.mutable_cpu_data());
-  caffe_div(temp_.count(), top_data, temp_.cpu_data(), top_data);
+  // Divide by the deviation, subtracting the stored mean first with global
+  // stats, and replicate the deviation to input size in temp_ for the
+  // backward pass.
   // TODO(cdoersch): The caching is only needed because later in-place layers
   //                 might clobber the data.  Can we skip this if they won't?
-  caffe_copy(x_norm_.count(), top_data,
-      x_norm_.mutable_cpu_data());
+  parallel_for(planes, BatchNormPlanes<Dtype>(channels_, spatial_dim,
+      use_global_stats_ ? bottom_data : top_data,
+      use_global_stats_ ? mean_.cpu_data() : NULL, variance_.cpu_data(),
+      top_data, temp_.mutable_cpu_data(), x_norm_.mutable_cpu_data()), grain);
 }
 
 template <typename Dtype>
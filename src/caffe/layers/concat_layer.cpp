@@ -51,12 +51,20 @@ void ConcatLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
     top[0]->ShareData(*bottom[0]);
     top[0]->ShareDiff(*bottom[0]);
   }
+  bottom_offsets_.assign(bottom.size(), -1);
+  if (bottom.size() > 1 && num_concats_ == 1) {
+    for (int i = 0, offset = 0; i < bottom.size(); ++i) {
+      bottom_offsets_[i] = offset;
+      offset += bottom[i]->count();
+    }
+  }
 }
 
 template <typename Dtype>
 void ConcatLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   if (bottom.size() == 1) { return; }
+  // caffe_copy skips the bottoms that the net made views of the top.
   Dtype* top_data = top[0]->mutable_cpu_data();
   int offset_concat_axis = 0;
   const int top_concat_axis = top[0]->shape(concat_axis_);
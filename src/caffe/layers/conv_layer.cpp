@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <vector>
 
 #include "caffe/layers/conv_layer.hpp"
@@ -29,12 +30,30 @@ void ConvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const Dtype* bottom_data = bottom[i]->cpu_data();
     Dtype* top_data = top[i]->mutable_cpu_data();
     for (int n = 0; n < this->num_; ++n) {
-      this->forward_cpu_gemm(bottom_data + n * this->bottom_dim_, weight,
-          top_data + n * this->top_dim_);
-      if (this->bias_term_) {
-        const Dtype* bias = this->blobs_[1]->cpu_data();
-        this->forward_cpu_bias(top_data + n * this->top_dim_, bias);
+      if (this->layer_param_.channel_block() > 0) {
+        this->forward_cpu_depthwise_blocked(
+            bottom_data + n * this->bottom_dim_, weight,
+            top_data + n * this->top_dim_);
+        this->forward_cpu_bias_activation_blocked(
+            top_data + n * this->top_dim_);
+        continue;
       }
+      if (this->depthwise_) {
+        this->forward_cpu_depthwise(bottom_data + n * this->bottom_dim_,
+            weight, top_data + n * this->top_dim_);
+      } else if (this->gemm_batch_ > 1) {
+        // With batched GEMMs, the first image of each chunk does the whole
+        // chunk.
+        if (n % this->gemm_batch_ == 0) {
+          this->forward_cpu_gemm_batch(bottom_data + n * this->bottom_dim_,
+              weight, top_data + n * this->top_dim_,
+              std::min(this->gemm_batch_, this->num_ - n));
+        }
+      } else {
+        this->forward_cpu_gemm(bottom_data + n * this->bottom_dim_, weight,
+            top_data + n * this->top_dim_);
+      }
+      this->forward_cpu_bias_activation(top_data + n * this->top_dim_);
     }
   }
 }
@@ -42,6 +61,10 @@ void ConvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void ConvolutionLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+  CHECK(!this->layer_param_.channel_block()) << "Convolution in the "
+      << "channel-blocked layout only computes Forward.";
+  // Turn the diffs of the activation outputs into those of the convolution.
+  this->backward_cpu_activation(top);
   const Dtype* weight = this->blobs_[0]->cpu_data();
   Dtype* weight_diff = this->blobs_[0]->mutable_cpu_diff();
   for (int i = 0; i < top.size(); ++i) {
@@ -55,15 +78,28 @@ void ConvolutionLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
         this->backward_cpu_bias(bias_diff, top_diff + n * this->top_dim_);
       }
     }
+    if (this->param_propagate_down_[0] && this->gemm_batch_ > 1) {
+      for (int n = 0; n < this->num_; n += this->gemm_batch_) {
+        this->weight_cpu_gemm_batch(bottom_data + n * this->bottom_dim_,
+            top_diff + n * this->top_dim_, weight_diff,
+            std::min(this->gemm_batch_, this->num_ - n));
+      }
+    }
     if (this->param_propagate_down_[0] || propagate_down[i]) {
       for (int n = 0; n < this->num_; ++n) {
         // gradient w.r.t. weight. Note that we will accumulate diffs.
-        if (this->param_propagate_down_[0]) {
+        if (this->param_propagate_down_[0] && this->depthwise_) {
+          this->weight_cpu_depthwise(bottom_data + n * this->bottom_dim_,
+              top_diff + n * this->top_dim_, weight_diff);
+        } else if (this->param_propagate_down_[0] && this->gemm_batch_ == 1) {
           this->weight_cpu_gemm(bottom_data + n * this->bottom_dim_,
               top_diff + n * this->top_dim_, weight_diff);
         }
         // gradient w.r.t. bottom data, if necessary.
-        if (propagate_down[i]) {
+        if (propagate_down[i] && this->depthwise_) {
+          this->backward_cpu_depthwise(top_diff + n * this->top_dim_, weight,
+              bottom_diff + n * this->bottom_dim_);
+        } else if (propagate_down[i]) {
           this->backward_cpu_gemm(top_diff + n * this->top_dim_, weight,
               bottom_diff + n * this->bottom_dim_);
         }
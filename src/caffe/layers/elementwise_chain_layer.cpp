@@ -0,0 +1,432 @@
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "caffe/layers/elementwise_chain_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+namespace {
+
+// The elements are processed in blocks of this many, which stay in cache
+// through the whole chain.
+const int kChainBlock = 512;
+
+// As in BNLLLayer.
+const float kBNLL_THRESHOLD = 50.;
+
+// Applies op to the n values x, writing y; x and y may be the same.
+template <typename Dtype>
+void ApplyOp(const typename ElementwiseChainLayer<Dtype>::Op& op, int n,
+    const Dtype* x, Dtype* y) {
+  typedef typename ElementwiseChainLayer<Dtype>::Op Op;
+  switch (op.type) {
+  case Op::ABSVAL:
+    for (int i = 0; i < n; ++i) { y[i] = std::abs(x[i]); }
+    break;
+  case Op::BNLL:
+    for (int i = 0; i < n; ++i) {
+      y[i] = x[i] > 0 ? x[i] + log(1. + exp(-x[i])) : log(1. + exp(x[i]));
+    }
+    break;
+  case Op::EXP:
+    // y = b * exp(a * x)
+    for (int i = 0; i < n; ++i) { y[i] = op.b * exp(op.a * x[i]); }
+    break;
+  case Op::LOG:
+    // y = c * log(a * x + b)
+    for (int i = 0; i < n; ++i) { y[i] = op.c * log(op.a * x[i] + op.b); }
+    break;
+  case Op::POWER:
+    // y = (b * x + c)^a
+    if (op.a * op.b == 0) {
+      const Dtype value = op.a == 0 ? Dtype(1) : pow(op.c, op.a);
+      for (int i = 0; i < n; ++i) { y[i] = value; }
+    } else if (op.a == 1) {
+      for (int i = 0; i < n; ++i) { y[i] = op.b * x[i] + op.c; }
+    } else if (op.a == 2) {
+      for (int i = 0; i < n; ++i) {
+        const Dtype base = op.b * x[i] + op.c;
+        y[i] = base * base;
+      }
+    } else {
+      for (int i = 0; i < n; ++i) { y[i] = pow(op.b * x[i] + op.c, op.a); }
+    }
+    break;
+  case Op::RELU:
+    for (int i = 0; i < n; ++i) {
+      y[i] = std::max(x[i], Dtype(0)) + op.a * std::min(x[i], Dtype(0));
+    }
+    break;
+  case Op::SIGMOID:
+    for (int i = 0; i < n; ++i) { y[i] = 1. / (1. + exp(-x[i])); }
+    break;
+  case Op::TANH:
+    for (int i = 0; i < n; ++i) { y[i] = tanh(x[i]); }
+    break;
+  case Op::THRESHOLD:
+    for (int i = 0; i < n; ++i) { y[i] = x[i] > op.a ? 1 : 0; }
+    break;
+  }
+}
+
+// Multiplies the n diffs by the derivative of op at the inputs x, where it
+// gave the outputs y.
+template <typename Dtype>
+void ApplyDerivative(const typename ElementwiseChainLayer<Dtype>::Op& op,
+    int n, const Dtype* x, const Dtype* y, Dtype* diff) {
+  typedef typename ElementwiseChainLayer<Dtype>::Op Op;
+  switch (op.type) {
+  case Op::ABSVAL:
+    for (int i = 0; i < n; ++i) { diff[i] *= (0 < x[i]) - (x[i] < 0); }
+    break;
+  case Op::BNLL:
+    for (int i = 0; i < n; ++i) {
+      const Dtype expval = exp(std::min(x[i], Dtype(kBNLL_THRESHOLD)));
+      diff[i] *= expval / (expval + 1.);
+    }
+    break;
+  case Op::EXP:
+    for (int i = 0; i < n; ++i) { diff[i] *= op.a * y[i]; }
+    break;
+  case Op::LOG:
+    for (int i = 0; i < n; ++i) {
+      diff[i] *= op.c * op.a / (op.a * x[i] + op.b);
+    }
+    break;
+  case Op::POWER:
+    if (op.a * op.b == 0) {
+      for (int i = 0; i < n; ++i) { diff[i] = 0; }
+    } else if (op.a == 1) {
+      for (int i = 0; i < n; ++i) { diff[i] *= op.b; }
+    } else if (op.a == 2) {
+      for (int i = 0; i < n; ++i) {
+        diff[i] *= 2 * op.b * (op.b * x[i] + op.c);
+      }
+    } else {
+      for (int i = 0; i < n; ++i) {
+        diff[i] *= op.a * op.b * pow(op.b * x[i] + op.c, op.a - 1);
+      }
+    }
+    break;
+  case Op::RELU:
+    for (int i = 0; i < n; ++i) { diff[i] *= (x[i] > 0) + op.a * (x[i] <= 0); }
+    break;
+  case Op::SIGMOID:
+    for (int i = 0; i < n; ++i) { diff[i] *= y[i] * (1. - y[i]); }
+    break;
+  case Op::TANH:
+    for (int i = 0; i < n; ++i) { diff[i] *= 1 - y[i] * y[i]; }
+    break;
+  case Op::THRESHOLD:
+    LOG(FATAL) << "Threshold has no gradient.";
+    break;
+  }
+}
+
+// What the chain computes from its bottoms.
+template <typename Dtype>
+struct Chain {
+  bool eltwise;
+  EltwiseParameter_EltwiseOp eltwise_op;
+  const vector<Dtype>* coeffs;
+  const vector<typename ElementwiseChainLayer<Dtype>::Op>* ops;
+  vector<const Dtype*> bottom_data;
+
+  // Writes the n values that the chain starts from at offset start.
+  void Head(int start, int n, Dtype* values) const {
+    if (!eltwise) {
+      if (values != bottom_data[0] + start) {
+        caffe_copy(n, bottom_data[0] + start, values);
+      }
+      return;
+    }
+    switch (eltwise_op) {
+    case EltwiseParameter_EltwiseOp_PROD:
+      caffe_mul(n, bottom_data[0] + start, bottom_data[1] + start, values);
+      for (int j = 2; j < bottom_data.size(); ++j) {
+        caffe_mul(n, values, bottom_data[j] + start, values);
+      }
+      break;
+    case EltwiseParameter_EltwiseOp_SUM:
+      for (int i = 0; i < n; ++i) {
+        values[i] = (*coeffs)[0] * bottom_data[0][start + i];
+      }
+      for (int j = 1; j < bottom_data.size(); ++j) {
+        const Dtype coeff = (*coeffs)[j];
+        const Dtype* data = bottom_data[j] + start;
+        for (int i = 0; i < n; ++i) { values[i] += coeff * data[i]; }
+      }
+      break;
+    case EltwiseParameter_EltwiseOp_MAX:
+      for (int i = 0; i < n; ++i) {
+        values[i] = std::max(bottom_data[0][start + i],
+            bottom_data[1][start + i]);
+      }
+      for (int j = 2; j < bottom_data.size(); ++j) {
+        const Dtype* data = bottom_data[j] + start;
+        for (int i = 0; i < n; ++i) {
+          values[i] = std::max(values[i], data[i]);
+        }
+      }
+      break;
+    default:
+      LOG(FATAL) << "Unknown elementwise operation.";
+    }
+  }
+
+  // The index of the bottom an Eltwise MAX takes element index from, ties
+  // resolved as EltwiseLayer does.
+  int MaxIndex(int index) const {
+    int max_idx = bottom_data[0][index] > bottom_data[1][index] ? 0 : 1;
+    for (int j = 2; j < bottom_data.size(); ++j) {
+      if (bottom_data[j][index] > bottom_data[max_idx][index]) { max_idx = j; }
+    }
+    return max_idx;
+  }
+
+  // The derivative of the Eltwise layer with respect to bottom j at element
+  // index.
+  Dtype HeadDerivative(int j, int index) const {
+    switch (eltwise_op) {
+    case EltwiseParameter_EltwiseOp_PROD: {
+      Dtype product = 1;
+      for (int k = 0; k < bottom_data.size(); ++k) {
+        if (k != j) { product *= bottom_data[k][index]; }
+      }
+      return product;
+    }
+    case EltwiseParameter_EltwiseOp_SUM:
+      return (*coeffs)[j];
+    case EltwiseParameter_EltwiseOp_MAX:
+      return MaxIndex(index) == j;
+    default:
+      LOG(FATAL) << "Unknown elementwise operation.";
+    }
+    return 0;
+  }
+};
+
+template <typename Dtype>
+struct ChainForward {
+  ChainForward(const Chain<Dtype>& chain, Dtype* top_data)
+      : chain(chain), top_data(top_data) {}
+  void operator()(int begin, int end) const {
+    const vector<typename ElementwiseChainLayer<Dtype>::Op>& ops = *chain.ops;
+    for (int start = begin; start < end; start += kChainBlock) {
+      const int n = std::min(kChainBlock, end - start);
+      Dtype* values = top_data + start;
+      chain.Head(start, n, values);
+      for (int k = 0; k < ops.size(); ++k) {
+        ApplyOp(ops[k], n, values, values);
+      }
+    }
+  }
+  const Chain<Dtype>& chain;
+  Dtype* const top_data;
+};
+
+template <typename Dtype>
+struct ChainBackward {
+  ChainBackward(const Chain<Dtype>& chain, const Dtype* top_diff,
+      const vector<bool>& propagate_down, const vector<Dtype*>& bottom_diff)
+      : chain(chain), top_diff(top_diff), propagate_down(propagate_down),
+        bottom_diff(bottom_diff) {}
+  void operator()(int begin, int end) const {
+    const vector<typename ElementwiseChainLayer<Dtype>::Op>& ops = *chain.ops;
+    // The values before and after each function of the chain, for a block.
+    vector<Dtype> values((ops.size() + 1) * kChainBlock);
+    vector<Dtype> diff(kChainBlock);
+    for (int start = begin; start < end; start += kChainBlock) {
+      const int n = std::min(kChainBlock, end - start);
+      chain.Head(start, n, &values[0]);
+      for (int k = 0; k < ops.size(); ++k) {
+        ApplyOp(ops[k], n, &values[k * kChainBlock],
+            &values[(k + 1) * kChainBlock]);
+      }
+      caffe_copy(n, top_diff + start, &diff[0]);
+      for (int k = ops.size() - 1; k >= 0; --k) {
+        ApplyDerivative(ops[k], n, &values[k * kChainBlock],
+            &values[(k + 1) * kChainBlock], &diff[0]);
+      }
+      for (int j = 0; j < bottom_diff.size(); ++j) {
+        if (!propagate_down[j]) { continue; }
+        Dtype* block_diff = bottom_diff[j] + start;
+        if (!chain.eltwise) {
+          caffe_copy(n, &diff[0], block_diff);
+        } else if (chain.eltwise_op == EltwiseParameter_EltwiseOp_SUM) {
+          caffe_cpu_scale(n, (*chain.coeffs)[j], &diff[0], block_diff);
+        } else {
+          for (int i = 0; i < n; ++i) {
+            block_diff[i] = diff[i] * chain.HeadDerivative(j, start + i);
+          }
+        }
+      }
+    }
+  }
+  const Chain<Dtype>& chain;
+  const Dtype* const top_diff;
+  const vector<bool>& propagate_down;
+  const vector<Dtype*>& bottom_diff;
+};
+
+}  // namespace
+
+template <typename Dtype>
+void ElementwiseChainLayer<Dtype>::LayerSetUp(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const ElementwiseChainParameter& chain_param =
+      this->layer_param_.elementwise_chain_param();
+  CHECK_GT(chain_param.layer_size(), 0) << "The chain has no layer.";
+  eltwise_ = chain_param.layer(0).type() == "Eltwise";
+  if (eltwise_) {
+    const EltwiseParameter& eltwise_param =
+        chain_param.layer(0).eltwise_param();
+    CHECK_GE(bottom.size(), 2) << "Eltwise takes at least two bottoms.";
+    CHECK(eltwise_param.coeff_size() == 0
+        || eltwise_param.coeff_size() == bottom.size())
+        << "Eltwise Layer takes one coefficient per bottom blob.";
+    CHECK(!(eltwise_param.operation() == EltwiseParameter_EltwiseOp_PROD
+        && eltwise_param.coeff_size()))
+        << "Eltwise layer only takes coefficients for summation.";
+    eltwise_op_ = eltwise_param.operation();
+    coeffs_ = vector<Dtype>(bottom.size(), 1);
+    for (int i = 0; i < eltwise_param.coeff_size(); ++i) {
+      coeffs_[i] = eltwise_param.coeff(i);
+    }
+    for (int i = 0; i < bottom.size(); ++i) {
+      CHECK_NE(bottom[i], top[0]) << "An Eltwise chain cannot be in place.";
+    }
+  } else {
+    CHECK_EQ(bottom.size(), 1) << "Only an Eltwise chain has several bottoms.";
+  }
+  ops_.clear();
+  has_threshold_ = false;
+  for (int i = eltwise_ ? 1 : 0; i < chain_param.layer_size(); ++i) {
+    const LayerParameter& layer = chain_param.layer(i);
+    const string& type = layer.type();
+    Op op;
+    op.a = op.b = op.c = 0;
+    if (type == "AbsVal") {
+      op.type = Op::ABSVAL;
+    } else if (type == "BNLL") {
+      op.type = Op::BNLL;
+    } else if (type == "Dropout") {
+      // The identity at test time.
+      CHECK_EQ(this->phase_, TEST) << "Dropout is only chained in TEST.";
+      continue;
+    } else if (type == "Exp") {
+      // As in ExpLayer.
+      const Dtype base = layer.exp_param().base();
+      if (base != Dtype(-1)) {
+        CHECK_GT(base, 0) << "base must be strictly positive.";
+      }
+      const Dtype log_base = (base == Dtype(-1)) ? Dtype(1) : log(base);
+      const Dtype shift = layer.exp_param().shift();
+      op.type = Op::EXP;
+      op.a = log_base * layer.exp_param().scale();
+      op.b = (shift == Dtype(0)) ? Dtype(1) : pow(base, shift);
+    } else if (type == "Log") {
+      // As in LogLayer.
+      const Dtype base = layer.log_param().base();
+      if (base != Dtype(-1)) {
+        CHECK_GT(base, 0) << "base must be strictly positive.";
+      }
+      const Dtype log_base = (base == Dtype(-1)) ? Dtype(1) : log(base);
+      op.type = Op::LOG;
+      op.a = layer.log_param().scale();
+      op.b = layer.log_param().shift();
+      op.c = Dtype(1) / log_base;
+    } else if (type == "Power") {
+      op.type = Op::POWER;
+      op.a = layer.power_param().power();
+      op.b = layer.power_param().scale();
+      op.c = layer.power_param().shift();
+    } else if (type == "ReLU") {
+      op.type = Op::RELU;
+      op.a = layer.relu_param().negative_slope();
+    } else if (type == "Sigmoid") {
+      op.type = Op::SIGMOID;
+    } else if (type == "TanH") {
+      op.type = Op::TANH;
+    } else if (type == "Threshold") {
+      op.type = Op::THRESHOLD;
+      op.a = layer.threshold_param().threshold();
+      has_threshold_ = true;
+    } else {
+      LOG(FATAL) << "Layer " << layer.name() << " of type " << type
+          << " cannot be chained.";
+    }
+    ops_.push_back(op);
+  }
+}
+
+template <typename Dtype>
+void ElementwiseChainLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  for (int i = 1; i < bottom.size(); ++i) {
+    CHECK(bottom[i]->shape() == bottom[0]->shape());
+  }
+  top[0]->ReshapeLike(*bottom[0]);
+  if (bottom[0] == top[0] && this->phase_ == TRAIN) {
+    bottom_copy_.ReshapeLike(*bottom[0]);
+  }
+}
+
+template <typename Dtype>
+void ElementwiseChainLayer<Dtype>::Forward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  if (bottom[0] == top[0] && this->phase_ == TRAIN) {
+    caffe_copy(bottom[0]->count(), bottom[0]->cpu_data(),
+        bottom_copy_.mutable_cpu_data());
+  }
+  Chain<Dtype> chain;
+  chain.eltwise = eltwise_;
+  chain.eltwise_op = eltwise_op_;
+  chain.coeffs = &coeffs_;
+  chain.ops = &ops_;
+  for (int i = 0; i < bottom.size(); ++i) {
+    chain.bottom_data.push_back(bottom[i]->cpu_data());
+  }
+  parallel_for(top[0]->count(),
+      ChainForward<Dtype>(chain, top[0]->mutable_cpu_data()),
+      kElementwiseGrain);
+}
+
+template <typename Dtype>
+void ElementwiseChainLayer<Dtype>::Backward_cpu(
+    const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
+    const vector<Blob<Dtype>*>& bottom) {
+  if (std::find(propagate_down.begin(), propagate_down.end(), true) ==
+      propagate_down.end()) {
+    return;
+  }
+  CHECK(!has_threshold_) << "Threshold has no gradient.";
+  CHECK(bottom[0] != top[0] || this->phase_ == TRAIN)
+      << "An in-place chain keeps its bottom for Backward in TRAIN only.";
+  Chain<Dtype> chain;
+  chain.eltwise = eltwise_;
+  chain.eltwise_op = eltwise_op_;
+  chain.coeffs = &coeffs_;
+  chain.ops = &ops_;
+  vector<Dtype*> bottom_diff;
+  for (int i = 0; i < bottom.size(); ++i) {
+    // The bottom of an in-place chain was overwritten by Forward.
+    chain.bottom_data.push_back(bottom[i] == top[0] ?
+        bottom_copy_.cpu_data() : bottom[i]->cpu_data());
+    bottom_diff.push_back(propagate_down[i] ?
+        bottom[i]->mutable_cpu_diff() : NULL);
+  }
+  parallel_for(top[0]->count(),
+      ChainBackward<Dtype>(chain, top[0]->cpu_diff(), propagate_down,
+          bottom_diff),
+      kElementwiseGrain);
+}
+
+INSTANTIATE_CLASS(ElementwiseChainLayer);
+REGISTER_LAYER_CLASS(ElementwiseChain);
+
+}  // namespace caffe
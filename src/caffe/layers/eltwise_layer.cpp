@@ -1,11 +1,140 @@
-#include <cfloat>
+#include <algorithm>
 #include <vector>
 
 #include "caffe/layers/eltwise_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+namespace {
+
+// The element-wise loops run over ranges of the elements of all bottoms.
+template <typename Dtype>
+struct EltwiseForward {
+  EltwiseForward(EltwiseParameter_EltwiseOp op,
+      const vector<const Dtype*>& bottom_data, const vector<Dtype>& coeffs,
+      Dtype* top_data, int* mask)
+      : op(op), bottom_data(bottom_data), coeffs(coeffs), top_data(top_data),
+        mask(mask) {}
+  void operator()(int begin, int end) const {
+    const int count = end - begin;
+    Dtype* top = top_data + begin;
+    const Dtype* bottom_data_a = NULL;
+    const Dtype* bottom_data_b = NULL;
+    switch (op) {
+    case EltwiseParameter_EltwiseOp_PROD:
+      caffe_mul(count, bottom_data[0] + begin, bottom_data[1] + begin, top);
+      for (int i = 2; i < bottom_data.size(); ++i) {
+        caffe_mul(count, top, bottom_data[i] + begin, top);
+      }
+      break;
+    case EltwiseParameter_EltwiseOp_SUM:
+      caffe_set(count, Dtype(0), top);
+      // TODO(shelhamer) does BLAS optimize to sum for coeff = 1?
+      for (int i = 0; i < bottom_data.size(); ++i) {
+        caffe_axpy(count, coeffs[i], bottom_data[i] + begin, top);
+      }
+      break;
+    case EltwiseParameter_EltwiseOp_MAX:
+      // bottom 0 & 1
+      bottom_data_a = bottom_data[0];
+      bottom_data_b = bottom_data[1];
+      for (int idx = begin; idx < end; ++idx) {
+        if (bottom_data_a[idx] > bottom_data_b[idx]) {
+          top_data[idx] = bottom_data_a[idx];  // maxval
+          mask[idx] = 0;  // maxid
+        } else {
+          top_data[idx] = bottom_data_b[idx];  // maxval
+          mask[idx] = 1;  // maxid
+        }
+      }
+      // bottom 2++
+      for (int blob_idx = 2; blob_idx < bottom_data.size(); ++blob_idx) {
+        bottom_data_b = bottom_data[blob_idx];
+        for (int idx = begin; idx < end; ++idx) {
+          if (bottom_data_b[idx] > top_data[idx]) {
+            top_data[idx] = bottom_data_b[idx];  // maxval
+            mask[idx] = blob_idx;  // maxid
+          }
+        }
+      }
+      break;
+    default:
+      LOG(FATAL) << "Unknown elementwise operation.";
+    }
+  }
+  const EltwiseParameter_EltwiseOp op;
+  const vector<const Dtype*>& bottom_data;
+  const vector<Dtype>& coeffs;
+  Dtype* const top_data;
+  int* const mask;
+};
+
+// Computes the diff of bottom i.
+template <typename Dtype>
+struct EltwiseBackward {
+  EltwiseBackward(EltwiseParameter_EltwiseOp op, bool stable_prod_grad,
+      int i, const vector<const Dtype*>& bottom_data,
+      const vector<Dtype>& coeffs, const Dtype* top_data,
+      const Dtype* top_diff, const int* mask, Dtype* bottom_diff)
+      : op(op), stable_prod_grad(stable_prod_grad), i(i),
+        bottom_data(bottom_data), coeffs(coeffs), top_data(top_data),
+        top_diff(top_diff), mask(mask), bottom_diff(bottom_diff) {}
+  void operator()(int begin, int end) const {
+    const int count = end - begin;
+    Dtype* diff = bottom_diff + begin;
+    switch (op) {
+    case EltwiseParameter_EltwiseOp_PROD:
+      if (stable_prod_grad) {
+        bool initialized = false;
+        for (int j = 0; j < bottom_data.size(); ++j) {
+          if (i == j) { continue; }
+          if (!initialized) {
+            std::copy(bottom_data[j] + begin, bottom_data[j] + end, diff);
+            initialized = true;
+          } else {
+            caffe_mul(count, bottom_data[j] + begin, diff, diff);
+          }
+        }
+      } else {
+        caffe_div(count, top_data + begin, bottom_data[i] + begin, diff);
+      }
+      caffe_mul(count, diff, top_diff + begin, diff);
+      break;
+    case EltwiseParameter_EltwiseOp_SUM:
+      if (coeffs[i] == Dtype(1)) {
+        std::copy(top_diff + begin, top_diff + end, diff);
+      } else {
+        caffe_cpu_scale(count, coeffs[i], top_diff + begin, diff);
+      }
+      break;
+    case EltwiseParameter_EltwiseOp_MAX:
+      for (int index = begin; index < end; ++index) {
+        Dtype gradient = 0;
+        if (mask[index] == i) {
+          gradient += top_diff[index];
+        }
+        bottom_diff[index] = gradient;
+      }
+      break;
+    default:
+      LOG(FATAL) << "Unknown elementwise operation.";
+    }
+  }
+  const EltwiseParameter_EltwiseOp op;
+  const bool stable_prod_grad;
+  const int i;
+  const vector<const Dtype*>& bottom_data;
+  const vector<Dtype>& coeffs;
+  const Dtype* const top_data;
+  const Dtype* const top_diff;
+  const int* const mask;
+  Dtype* const bottom_diff;
+};
+
+}  // namespace
+
 template <typename Dtype>
 void EltwiseLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -44,108 +173,31 @@ void EltwiseLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void EltwiseLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
-  int* mask = NULL;
-  const Dtype* bottom_data_a = NULL;
-  const Dtype* bottom_data_b = NULL;
-  const int count = top[0]->count();
-  Dtype* top_data = top[0]->mutable_cpu_data();
-  switch (op_) {
-  case EltwiseParameter_EltwiseOp_PROD:
-    caffe_mul(count, bottom[0]->cpu_data(), bottom[1]->cpu_data(), top_data);
-    for (int i = 2; i < bottom.size(); ++i) {
-      caffe_mul(count, top_data, bottom[i]->cpu_data(), top_data);
-    }
-    break;
-  case EltwiseParameter_EltwiseOp_SUM:
-    caffe_set(count, Dtype(0), top_data);
-    // TODO(shelhamer) does BLAS optimize to sum for coeff = 1?
-    for (int i = 0; i < bottom.size(); ++i) {
-      caffe_axpy(count, coeffs_[i], bottom[i]->cpu_data(), top_data);
-    }
-    break;
-  case EltwiseParameter_EltwiseOp_MAX:
-    // Initialize
-    mask = max_idx_.mutable_cpu_data();
-    caffe_set(count, -1, mask);
-    caffe_set(count, Dtype(-FLT_MAX), top_data);
-    // bottom 0 & 1
-    bottom_data_a = bottom[0]->cpu_data();
-    bottom_data_b = bottom[1]->cpu_data();
-    for (int idx = 0; idx < count; ++idx) {
-      if (bottom_data_a[idx] > bottom_data_b[idx]) {
-        top_data[idx] = bottom_data_a[idx];  // maxval
-        mask[idx] = 0;  // maxid
-      } else {
-        top_data[idx] = bottom_data_b[idx];  // maxval
-        mask[idx] = 1;  // maxid
-      }
-    }
-    // bottom 2++
-    for (int blob_idx = 2; blob_idx < bottom.size(); ++blob_idx) {
-      bottom_data_b = bottom[blob_idx]->cpu_data();
-      for (int idx = 0; idx < count; ++idx) {
-        if (bottom_data_b[idx] > top_data[idx]) {
-          top_data[idx] = bottom_data_b[idx];  // maxval
-          mask[idx] = blob_idx;  // maxid
-        }
-      }
-    }
-    break;
-  default:
-    LOG(FATAL) << "Unknown elementwise operation.";
+  vector<const Dtype*> bottom_data(bottom.size());
+  for (int i = 0; i < bottom.size(); ++i) {
+    bottom_data[i] = bottom[i]->cpu_data();
   }
+  int* mask = op_ == EltwiseParameter_EltwiseOp_MAX ?
+      max_idx_.mutable_cpu_data() : NULL;
+  parallel_for(top[0]->count(), EltwiseForward<Dtype>(op_, bottom_data,
+      coeffs_, top[0]->mutable_cpu_data(), mask), kElementwiseGrain);
 }
 
 template <typename Dtype>
 void EltwiseLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
-  const int* mask = NULL;
-  const int count = top[0]->count();
-  const Dtype* top_data = top[0]->cpu_data();
-  const Dtype* top_diff = top[0]->cpu_diff();
+  vector<const Dtype*> bottom_data(bottom.size());
+  for (int i = 0; i < bottom.size(); ++i) {
+    bottom_data[i] = bottom[i]->cpu_data();
+  }
+  const int* mask = op_ == EltwiseParameter_EltwiseOp_MAX ?
+      max_idx_.cpu_data() : NULL;
   for (int i = 0; i < bottom.size(); ++i) {
     if (propagate_down[i]) {
-      const Dtype* bottom_data = bottom[i]->cpu_data();
-      Dtype* bottom_diff = bottom[i]->mutable_cpu_diff();
-      switch (op_) {
-      case EltwiseParameter_EltwiseOp_PROD:
-        if (stable_prod_grad_) {
-          bool initialized = false;
-          for (int j = 0; j < bottom.size(); ++j) {
-            if (i == j) { continue; }
-            if (!initialized) {
-              caffe_copy(count, bottom[j]->cpu_data(), bottom_diff);
-              initialized = true;
-            } else {
-              caffe_mul(count, bottom[j]->cpu_data(), bottom_diff,
-                        bottom_diff);
-            }
-          }
-        } else {
-          caffe_div(count, top_data, bottom_data, bottom_diff);
-        }
-        caffe_mul(count, bottom_diff, top_diff, bottom_diff);
-        break;
-      case EltwiseParameter_EltwiseOp_SUM:
-        if (coeffs_[i] == Dtype(1)) {
-          caffe_copy(count, top_diff, bottom_diff);
-        } else {
-          caffe_cpu_scale(count, coeffs_[i], top_diff, bottom_diff);
-        }
-        break;
-      case EltwiseParameter_EltwiseOp_MAX:
-        mask = max_idx_.cpu_data();
-        for (int index = 0; index < count; ++index) {
-          Dtype gradient = 0;
-          if (mask[index] == i) {
-            gradient += top_diff[index];
-          }
-          bottom_diff[index] = gradient;
-        }
-        break;
-      default:
-        LOG(FATAL) << "Unknown elementwise operation.";
-      }
+      parallel_for(top[0]->count(), EltwiseBackward<Dtype>(op_,
+          stable_prod_grad_, i, bottom_data, coeffs_, top[0]->cpu_data(),
+          top[0]->cpu_diff(), mask, bottom[i]->mutable_cpu_diff()),
+          kElementwiseGrain);
     }
   }
 }
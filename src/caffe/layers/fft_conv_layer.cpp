@@ -0,0 +1,309 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "caffe/layers/fft_conv_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Estimates the arithmetic of the forward pass with fft_h x fft_w tiles:
+// one transform per input and output channel of every tile, plus the complex
+// products summed over the input channels of each group.
+double fft_conv_cost(int fft_h, int fft_w, int extent_h, int extent_w,
+    int dense_h, int dense_w, int channels, int num_output, int group) {
+  const double tiles =
+      std::ceil(static_cast<double>(dense_h) / (fft_h - extent_h + 1)) *
+      std::ceil(static_cast<double>(dense_w) / (fft_w - extent_w + 1));
+  const double points = static_cast<double>(fft_h) * fft_w;
+  return tiles * points * (5 * std::log(points) / std::log(2.) *
+      (channels + num_output) + 8. * channels * num_output / group);
+}
+
+// Smallest power of two at least n.
+int fft_size(int n) {
+  int size = 1;
+  while (size < n) { size *= 2; }
+  return size;
+}
+
+template <typename Dtype>
+void fft_correlate(const FFT2D<Dtype>& fft, const Dtype* input,
+    int channels, int height, int width, int pad_h, int pad_w, int stride_h,
+    int stride_w, int extent_h, int extent_w, const Dtype* spectra,
+    int num_output, int group, int output_h, int output_w, Dtype* buffer,
+    Dtype* output) {
+  const int fft_h = fft.height();
+  const int fft_w = fft.width();
+  const int points = fft_h * fft_w;
+  const int tile_h = fft_h - extent_h + 1;
+  const int tile_w = fft_w - extent_w + 1;
+  const int dense_h = (output_h - 1) * stride_h + 1;
+  const int dense_w = (output_w - 1) * stride_w + 1;
+  const int group_channels = channels / group;
+  const int group_output = num_output / group;
+  const Dtype* spectra_re = spectra;
+  const Dtype* spectra_im = spectra + num_output * group_channels * points;
+  Dtype* input_re = buffer;
+  Dtype* input_im = buffer + channels * points;
+  Dtype* output_re = buffer + 2 * channels * points;
+  Dtype* output_im = output_re + points;
+  for (int h0 = 0; h0 < dense_h; h0 += tile_h) {
+    for (int w0 = 0; w0 < dense_w; w0 += tile_w) {
+      // Transform the tile of every input channel.
+      for (int c = 0; c < channels; ++c) {
+        const Dtype* image = input + c * height * width;
+        Dtype* re = input_re + c * points;
+        Dtype* im = input_im + c * points;
+        caffe_set(points, Dtype(0), im);
+        for (int a = 0; a < fft_h; ++a) {
+          const int h = h0 - pad_h + a;
+          Dtype* row = re + a * fft_w;
+          if (h < 0 || h >= height) {
+            caffe_set(fft_w, Dtype(0), row);
+            continue;
+          }
+          for (int b = 0; b < fft_w; ++b) {
+            const int w = w0 - pad_w + b;
+            row[b] = (w >= 0 && w < width) ? image[h * width + w] : 0;
+          }
+        }
+        fft.Forward(re, im);
+      }
+      // Sum the products with the filter spectra over the channels of the
+      // group, and transform each output channel back.
+      for (int k = 0; k < num_output; ++k) {
+        const int g = k / group_output;
+        caffe_set(points, Dtype(0), output_re);
+        caffe_set(points, Dtype(0), output_im);
+        for (int c = 0; c < group_channels; ++c) {
+          const Dtype* xr = input_re + (g * group_channels + c) * points;
+          const Dtype* xi = input_im + (g * group_channels + c) * points;
+          const Dtype* sr = spectra_re + (k * group_channels + c) * points;
+          const Dtype* si = spectra_im + (k * group_channels + c) * points;
+          for (int p = 0; p < points; ++p) {
+            output_re[p] += xr[p] * sr[p] - xi[p] * si[p];
+            output_im[p] += xr[p] * si[p] + xi[p] * sr[p];
+          }
+        }
+        fft.Inverse(output_re, output_im);
+        Dtype* output_map = output + k * output_h * output_w;
+        for (int a = 0; a < tile_h && h0 + a < dense_h; ++a) {
+          if ((h0 + a) % stride_h) { continue; }
+          Dtype* output_row = output_map + (h0 + a) / stride_h * output_w;
+          for (int b = 0; b < tile_w && w0 + b < dense_w; ++b) {
+            if ((w0 + b) % stride_w) { continue; }
+            output_row[(w0 + b) / stride_w] = output_re[a * fft_w + b];
+          }
+        }
+      }
+    }
+  }
+}
+
+}  // namespace
+
+template <typename Dtype>
+void FFTConvolutionLayer<Dtype>::LayerSetUp(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  ConvolutionLayer<Dtype>::LayerSetUp(bottom, top);
+  use_fft_ = this->num_spatial_axes_ == 2;
+  if (!use_fft_) {
+    LOG(INFO) << "Layer " << this->layer_param_.name() << ": FFT "
+        << "convolution needs 2D filters; falling back to the default CPU "
+        << "implementation.";
+  }
+}
+
+template <typename Dtype>
+void FFTConvolutionLayer<Dtype>::Reshape(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  ConvolutionLayer<Dtype>::Reshape(bottom, top);
+  if (!use_fft_) { return; }
+  const int* kernel_shape_data = this->kernel_shape_.cpu_data();
+  const int* stride_data = this->stride_.cpu_data();
+  const int* dilation_data = this->dilation_.cpu_data();
+  const int extent_h = dilation_data[0] * (kernel_shape_data[0] - 1) + 1;
+  const int extent_w = dilation_data[1] * (kernel_shape_data[1] - 1) + 1;
+  const int dense_h = (this->output_shape_[0] - 1) * stride_data[0] + 1;
+  const int dense_w = (this->output_shape_[1] - 1) * stride_data[1] + 1;
+  // Try every power of two from the smallest that holds a filter to the
+  // smallest that holds the whole padded input.
+  int best_h = 0;
+  int best_w = 0;
+  double best_cost = 0;
+  for (int fft_h = fft_size(extent_h); ; fft_h *= 2) {
+    for (int fft_w = fft_size(extent_w); ; fft_w *= 2) {
+      const double cost = fft_conv_cost(fft_h, fft_w, extent_h, extent_w,
+          dense_h, dense_w, this->channels_, this->num_output_,
+          this->group_);
+      if (best_h == 0 || cost < best_cost) {
+        best_h = fft_h;
+        best_w = fft_w;
+        best_cost = cost;
+      }
+      if (fft_w >= dense_w + extent_w - 1) { break; }
+    }
+    if (fft_h >= dense_h + extent_h - 1) { break; }
+  }
+  if (!fft_ || fft_->height() != best_h || fft_->width() != best_w) {
+    fft_.reset(new FFT2D<Dtype>(best_h, best_w));
+  }
+  // Room for the spectra of the input tile of the forward pass or of the
+  // bottom gradient, whichever has more channels, and of one output tile.
+  fft_buffer_.Reshape(vector<int>(1, 2 * best_h * best_w *
+      (std::max(this->channels_, this->num_output_) + 1)));
+  const size_t fft_buffer_size = fft_buffer_.count() * sizeof(Dtype);
+  ConvWorkspace::Register(&fft_buffer_, fft_buffer_size);
+  ConvWorkspace::Get().Reserve(fft_buffer_size);
+}
+
+template <typename Dtype>
+void FFTConvolutionLayer<Dtype>::ComputeSpectra() {
+  const shared_ptr<SyncedMemory>& weights = this->blobs_[0]->data();
+  if (weights == spectra_source_ && weights->version() == spectra_version_
+      && fft_ == spectra_fft_) {
+    return;
+  }
+  const int fft_h = fft_->height();
+  const int fft_w = fft_->width();
+  const int points = fft_h * fft_w;
+  const int* kernel_shape_data = this->kernel_shape_.cpu_data();
+  const int* dilation_data = this->dilation_.cpu_data();
+  const int kernel_h = kernel_shape_data[0];
+  const int kernel_w = kernel_shape_data[1];
+  const int extent_h = dilation_data[0] * (kernel_h - 1) + 1;
+  const int extent_w = dilation_data[1] * (kernel_w - 1) + 1;
+  const int group_channels = this->channels_ / this->group_;
+  const int group_output = this->num_output_ / this->group_;
+  vector<int> shape(5);
+  shape[0] = 2;
+  shape[1] = this->num_output_;
+  shape[2] = group_channels;
+  shape[3] = fft_h;
+  shape[4] = fft_w;
+  forward_spectra_.Reshape(shape);
+  shape[1] = this->channels_;
+  shape[2] = group_output;
+  backward_spectra_.Reshape(shape);
+  // The inverse transform is unscaled, so the scale goes into the filters.
+  const Dtype scale = Dtype(1) / points;
+  const int half = forward_spectra_.count() / 2;
+  const Dtype* weight = this->blobs_[0]->cpu_data();
+  Dtype* forward = forward_spectra_.mutable_cpu_data();
+  Dtype* backward = backward_spectra_.mutable_cpu_data();
+  caffe_set(forward_spectra_.count(), Dtype(0), forward);
+  caffe_set(backward_spectra_.count(), Dtype(0), backward);
+  for (int k = 0; k < this->num_output_; ++k) {
+    const int g = k / group_output;
+    for (int c = 0; c < group_channels; ++c) {
+      const Dtype* filter = weight + (k * group_channels + c) * kernel_h *
+          kernel_w;
+      Dtype* forward_re = forward + (k * group_channels + c) * points;
+      Dtype* backward_re = backward + ((g * group_channels + c) *
+          group_output + k % group_output) * points;
+      // Lay out the dilated filter, and the same rotated by 180 degrees.
+      for (int i = 0; i < kernel_h; ++i) {
+        for (int j = 0; j < kernel_w; ++j) {
+          const int h = i * dilation_data[0];
+          const int w = j * dilation_data[1];
+          const Dtype value = scale * filter[i * kernel_w + j];
+          forward_re[h * fft_w + w] = value;
+          backward_re[(extent_h - 1 - h) * fft_w + extent_w - 1 - w] = value;
+        }
+      }
+      fft_->Forward(forward_re, forward_re + half);
+      fft_->Forward(backward_re, backward_re + half);
+    }
+  }
+  // Correlation multiplies by the conjugate of the filter spectrum.
+  caffe_scal(half, Dtype(-1), forward + half);
+  caffe_scal(half, Dtype(-1), backward + half);
+  spectra_source_ = weights;
+  spectra_version_ = weights->version();
+  spectra_fft_ = fft_;
+}
+
+template <typename Dtype>
+void FFTConvolutionLayer<Dtype>::FFTCorrelate(const Dtype* input,
+    int channels, int height, int width, int pad_h, int pad_w, int stride_h,
+    int stride_w, const Dtype* spectra, int num_output, int output_h,
+    int output_w, Dtype* output) {
+  fft_buffer_.ShareDataMemory(ConvWorkspace::Get().Reserve(
+      fft_buffer_.count() * sizeof(Dtype)));
+  const int* kernel_shape_data = this->kernel_shape_.cpu_data();
+  const int* dilation_data = this->dilation_.cpu_data();
+  fft_correlate(*fft_, input, channels, height, width, pad_h, pad_w,
+      stride_h, stride_w, dilation_data[0] * (kernel_shape_data[0] - 1) + 1,
+      dilation_data[1] * (kernel_shape_data[1] - 1) + 1, spectra, num_output,
+      this->group_, output_h, output_w, fft_buffer_.mutable_cpu_data(),
+      output);
+}
+
+template <typename Dtype>
+void FFTConvolutionLayer<Dtype>::Forward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  if (!use_fft_) {
+    ConvolutionLayer<Dtype>::Forward_cpu(bottom, top);
+    return;
+  }
+  ComputeSpectra();
+  const Dtype* spectra = forward_spectra_.cpu_data();
+  const int* pad_data = this->pad_.cpu_data();
+  const int* stride_data = this->stride_.cpu_data();
+  for (int i = 0; i < bottom.size(); ++i) {
+    const Dtype* bottom_data = bottom[i]->cpu_data();
+    Dtype* top_data = top[i]->mutable_cpu_data();
+    for (int n = 0; n < this->num_; ++n) {
+      FFTCorrelate(bottom_data + n * this->bottom_dim_, this->channels_,
+          this->input_shape(1), this->input_shape(2), pad_data[0],
+          pad_data[1], stride_data[0], stride_data[1], spectra,
+          this->num_output_, this->output_shape_[0], this->output_shape_[1],
+          top_data + n * this->top_dim_);
+      this->forward_cpu_bias_activation(top_data + n * this->top_dim_);
+    }
+  }
+}
+
+template <typename Dtype>
+void FFTConvolutionLayer<Dtype>::Backward_cpu(
+    const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
+    const vector<Blob<Dtype>*>& bottom) {
+  const int* stride_data = this->stride_.cpu_data();
+  if (!use_fft_ || stride_data[0] != 1 || stride_data[1] != 1) {
+    ConvolutionLayer<Dtype>::Backward_cpu(top, propagate_down, bottom);
+    return;
+  }
+  // The bias and filter gradients come from the im2col implementation.
+  ConvolutionLayer<Dtype>::Backward_cpu(top,
+      vector<bool>(bottom.size(), false), bottom);
+  // The bottom gradient is the correlation of the top gradient, padded by
+  // extent - 1 - pad, with the flipped filters mapping outputs back to
+  // inputs.
+  const int* kernel_shape_data = this->kernel_shape_.cpu_data();
+  const int* pad_data = this->pad_.cpu_data();
+  const int* dilation_data = this->dilation_.cpu_data();
+  const int pad_h = dilation_data[0] * (kernel_shape_data[0] - 1) -
+      pad_data[0];
+  const int pad_w = dilation_data[1] * (kernel_shape_data[1] - 1) -
+      pad_data[1];
+  for (int i = 0; i < top.size(); ++i) {
+    if (!propagate_down[i]) { continue; }
+    ComputeSpectra();
+    const Dtype* spectra = backward_spectra_.cpu_data();
+    const Dtype* top_diff = top[i]->cpu_diff();
+    Dtype* bottom_diff = bottom[i]->mutable_cpu_diff();
+    for (int n = 0; n < this->num_; ++n) {
+      FFTCorrelate(top_diff + n * this->top_dim_, this->num_output_,
+          this->output_shape_[0], this->output_shape_[1], pad_h, pad_w, 1, 1,
+          spectra, this->channels_, this->input_shape(1),
+          this->input_shape(2), bottom_diff + n * this->bottom_dim_);
+    }
+  }
+}
+
+INSTANTIATE_CLASS(FFTConvolutionLayer);
+
+}  // namespace caffe
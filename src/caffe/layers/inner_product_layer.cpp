@@ -2,6 +2,7 @@
 
 #include "caffe/filler.hpp"
 #include "caffe/layers/inner_product_layer.hpp"
+#include "caffe/util/activation.hpp"
 #include "caffe/util/math_functions.hpp"
 
 namespace caffe {
@@ -80,9 +81,24 @@ void InnerProductLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   const Dtype* weight = this->blobs_[0]->cpu_data();
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, M_, N_, K_, (Dtype)1.,
-      bottom_data, weight, (Dtype)0., top_data);
-  if (bias_term_) {
+  if (M_ == 1) {
+    caffe_cpu_gemv<Dtype>(CblasNoTrans, N_, K_, (Dtype)1., weight,
+        bottom_data, (Dtype)0., top_data);
+  } else if (this->phase_ == TEST && PackedWeights<Dtype>::Packs(M_)) {
+    // The weights are packed once rather than by every GEMM.
+    packed_weights_.Pack(*this->blobs_[0], 1, N_, K_, M_, true);
+    packed_weights_.Multiply(0, bottom_data, top_data);
+  } else {
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, M_, N_, K_, (Dtype)1.,
+        bottom_data, weight, (Dtype)0., top_data);
+  }
+  const ActivationParameter& activation =
+      this->layer_param_.inner_product_param().fused_activation();
+  if (activation.type() != ActivationParameter_Type_NONE) {
+    // Add the bias and apply the activation in one pass over the output.
+    activation_forward_cpu(activation, M_, N_, static_cast<const Dtype*>(NULL),
+        bias_term_ ? this->blobs_[1]->cpu_data() : NULL, top_data);
+  } else if (bias_term_) {
     caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M_, N_, 1, (Dtype)1.,
         bias_multiplier_.cpu_data(),
         this->blobs_[1]->cpu_data(), (Dtype)1., top_data);
@@ -93,6 +109,10 @@ template <typename Dtype>
 void InnerProductLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down,
     const vector<Blob<Dtype>*>& bottom) {
+  // Turn the diff of the activation output into that of the inner product.
+  activation_backward_cpu(
+      this->layer_param_.inner_product_param().fused_activation(),
+      top[0]->count(), top[0]->cpu_data(), top[0]->mutable_cpu_diff());
   if (this->param_propagate_down_[0]) {
     const Dtype* top_diff = top[0]->cpu_diff();
     const Dtype* bottom_data = bottom[0]->cpu_data();
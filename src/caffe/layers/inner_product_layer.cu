@@ -2,6 +2,7 @@
 
 #include "caffe/filler.hpp"
 #include "caffe/layers/inner_product_layer.hpp"
+#include "caffe/util/activation.hpp"
 #include "caffe/util/math_functions.hpp"
 
 namespace caffe {
@@ -26,12 +27,19 @@ void InnerProductLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
                             bias_multiplier_.gpu_data(),
                             this->blobs_[1]->gpu_data(), (Dtype)1., top_data);
   }
+  activation_forward_gpu(
+      this->layer_param_.inner_product_param().fused_activation(),
+      top[0]->count(), top_data);
 }
 
 template <typename Dtype>
 void InnerProductLayer<Dtype>::Backward_gpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down,
     const vector<Blob<Dtype>*>& bottom) {
+  // Turn the diff of the activation output into that of the inner product.
+  activation_backward_gpu(
+      this->layer_param_.inner_product_param().fused_activation(),
+      top[0]->count(), top[0]->gpu_data(), top[0]->mutable_gpu_diff());
   if (this->param_propagate_down_[0]) {
     const Dtype* top_diff = top[0]->gpu_diff();
     const Dtype* bottom_data = bottom[0]->gpu_data();
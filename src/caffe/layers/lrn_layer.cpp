@@ -1,10 +1,180 @@
+#include <algorithm>
+#include <cmath>
 #include <vector>
 
 #include "caffe/layers/lrn_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+namespace {
+
+// The parameters of a cross channel LRN over images of spatial pixels.
+template <typename Dtype>
+struct CrossChannelLRN {
+  int channels, spatial, size, pre_pad;
+  Dtype alpha, beta, k;
+};
+
+// The cross channel loops run over ranges of images, each with its own
+// padded scratch channels.
+template <typename Dtype>
+struct CrossChannelForward {
+  CrossChannelForward(const CrossChannelLRN<Dtype>& lrn,
+      const Dtype* bottom_data, Dtype* scale_data, Dtype* top_data)
+      : lrn(lrn), bottom_data(bottom_data), scale_data(scale_data),
+        top_data(top_data) {}
+  void operator()(int begin, int end) const {
+    const int spatial = lrn.spatial;
+    const int dim = lrn.channels * spatial;
+    vector<Dtype> padded_square((lrn.channels + lrn.size - 1) * spatial);
+    Dtype* padded_square_data = &padded_square[0];
+    const Dtype alpha_over_size = lrn.alpha / lrn.size;
+    for (int n = begin; n < end; ++n) {
+      const Dtype* bottom = bottom_data + n * dim;
+      Dtype* scale = scale_data + n * dim;
+      // start with the constant value
+      caffe_set(dim, lrn.k, scale);
+      // compute the padded square
+      caffe_sqr(dim, bottom, padded_square_data + lrn.pre_pad * spatial);
+      // Create the first channel scale
+      for (int c = 0; c < lrn.size; ++c) {
+        caffe_axpy<Dtype>(spatial, alpha_over_size,
+            padded_square_data + c * spatial, scale);
+      }
+      for (int c = 1; c < lrn.channels; ++c) {
+        // copy previous scale
+        std::copy(scale + (c - 1) * spatial, scale + c * spatial,
+            scale + c * spatial);
+        // add head
+        caffe_axpy<Dtype>(spatial, alpha_over_size,
+            padded_square_data + (c + lrn.size - 1) * spatial,
+            scale + c * spatial);
+        // subtract tail
+        caffe_axpy<Dtype>(spatial, -alpha_over_size,
+            padded_square_data + (c - 1) * spatial, scale + c * spatial);
+      }
+      // In the end, compute output
+      caffe_powx<Dtype>(dim, scale, -lrn.beta, top_data + n * dim);
+      caffe_mul<Dtype>(dim, top_data + n * dim, bottom, top_data + n * dim);
+    }
+  }
+  const CrossChannelLRN<Dtype> lrn;
+  const Dtype* const bottom_data;
+  Dtype* const scale_data;
+  Dtype* const top_data;
+};
+
+template <typename Dtype>
+struct CrossChannelBackward {
+  CrossChannelBackward(const CrossChannelLRN<Dtype>& lrn,
+      const Dtype* top_diff, const Dtype* top_data, const Dtype* bottom_data,
+      const Dtype* scale_data, Dtype* bottom_diff)
+      : lrn(lrn), top_diff(top_diff), top_data(top_data),
+        bottom_data(bottom_data), scale_data(scale_data),
+        bottom_diff(bottom_diff) {}
+  void operator()(int begin, int end) const {
+    const int spatial = lrn.spatial;
+    const int dim = lrn.channels * spatial;
+    const int size = lrn.size;
+    vector<Dtype> padded_ratio((lrn.channels + size - 1) * spatial);
+    vector<Dtype> accum_ratio(spatial);
+    vector<Dtype> accum_ratio_times_bottom(spatial);
+    Dtype* padded_ratio_data = &padded_ratio[0];
+    Dtype* accum_ratio_data = &accum_ratio[0];
+    const Dtype cache_ratio_value = 2. * lrn.alpha * lrn.beta / size;
+    const int inverse_pre_pad = size - (size + 1) / 2;
+    Dtype* ratio = padded_ratio_data + inverse_pre_pad * spatial;
+    for (int n = begin; n < end; ++n) {
+      const int block_offset = n * dim;
+      Dtype* diff = bottom_diff + block_offset;
+      caffe_powx<Dtype>(dim, scale_data + block_offset, -lrn.beta, diff);
+      caffe_mul<Dtype>(dim, top_diff + block_offset, diff, diff);
+      // first, compute diff_i * y_i / s_i
+      caffe_mul<Dtype>(dim, top_diff + block_offset, top_data + block_offset,
+          ratio);
+      caffe_div<Dtype>(dim, ratio, scale_data + block_offset, ratio);
+      // Now, compute the accumulated ratios and the bottom diff
+      caffe_set(spatial, Dtype(0), accum_ratio_data);
+      for (int c = 0; c < size - 1; ++c) {
+        caffe_axpy<Dtype>(spatial, 1., padded_ratio_data + c * spatial,
+            accum_ratio_data);
+      }
+      for (int c = 0; c < lrn.channels; ++c) {
+        caffe_axpy<Dtype>(spatial, 1.,
+            padded_ratio_data + (c + size - 1) * spatial, accum_ratio_data);
+        // compute bottom diff
+        caffe_mul<Dtype>(spatial, bottom_data + block_offset + c * spatial,
+            accum_ratio_data, &accum_ratio_times_bottom[0]);
+        caffe_axpy<Dtype>(spatial, -cache_ratio_value,
+            &accum_ratio_times_bottom[0], diff + c * spatial);
+        caffe_axpy<Dtype>(spatial, -1., padded_ratio_data + c * spatial,
+            accum_ratio_data);
+      }
+    }
+  }
+  const CrossChannelLRN<Dtype> lrn;
+  const Dtype* const top_diff;
+  const Dtype* const top_data;
+  const Dtype* const bottom_data;
+  const Dtype* const scale_data;
+  Dtype* const bottom_diff;
+};
+
+// The same in the channel-blocked layout, with blocks of block channels, over
+// ranges of the pixels of all images. Each pixel gathers the squares of its
+// channels, which its window then slides over.
+template <typename Dtype>
+struct BlockedCrossChannelForward {
+  BlockedCrossChannelForward(const CrossChannelLRN<Dtype>& lrn, int block,
+      const Dtype* bottom_data, Dtype* scale_data, Dtype* top_data)
+      : lrn(lrn), block(block), bottom_data(bottom_data),
+        scale_data(scale_data), top_data(top_data) {}
+  void operator()(int begin, int end) const {
+    const int spatial = lrn.spatial;
+    const int blocks = lrn.channels / block;
+    vector<Dtype> padded_square(lrn.channels + lrn.size - 1);
+    Dtype* square = &padded_square[lrn.pre_pad];
+    const Dtype alpha_over_size = lrn.alpha / lrn.size;
+    for (int i = begin; i < end; ++i) {
+      const int n = i / spatial;
+      const int p = i % spatial;
+      // The offset of the pixel in the first block of its image.
+      const int offset = (n * blocks * spatial + p) * block;
+      for (int b = 0; b < blocks; ++b) {
+        const Dtype* bottom = bottom_data + offset + b * spatial * block;
+        for (int l = 0; l < block; ++l) {
+          square[b * block + l] = bottom[l] * bottom[l];
+        }
+      }
+      Dtype sum = 0;
+      for (int c = 0; c < lrn.size - 1; ++c) {
+        sum += padded_square[c];
+      }
+      for (int b = 0; b < blocks; ++b) {
+        const int index = offset + b * spatial * block;
+        for (int l = 0; l < block; ++l) {
+          const int c = b * block + l;
+          sum += padded_square[c + lrn.size - 1];
+          const Dtype scale = lrn.k + alpha_over_size * sum;
+          scale_data[index + l] = scale;
+          top_data[index + l] =
+              bottom_data[index + l] * std::pow(scale, -lrn.beta);
+          sum -= padded_square[c];
+        }
+      }
+    }
+  }
+  const CrossChannelLRN<Dtype> lrn;
+  const int block;
+  const Dtype* const bottom_data;
+  Dtype* const scale_data;
+  Dtype* const top_data;
+};
+
+}  // namespace
+
 template <typename Dtype>
 void LRNLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -74,6 +244,14 @@ void LRNLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   channels_ = bottom[0]->channels();
   height_ = bottom[0]->height();
   width_ = bottom[0]->width();
+  const int block = this->layer_param_.channel_block();
+  if (block > 0) {
+    CHECK_EQ(this->layer_param_.lrn_param().norm_region(),
+        LRNParameter_NormRegion_ACROSS_CHANNELS)
+        << "Only ACROSS_CHANNELS LRN computes in the channel-blocked layout.";
+    CHECK_EQ(channels_ % block, 0) << "The channels must be a multiple of "
+        << "the channel block.";
+  }
   switch (this->layer_param_.lrn_param().norm_region()) {
   case LRNParameter_NormRegion_ACROSS_CHANNELS:
     top[0]->Reshape(num_, channels_, height_, width_);
@@ -107,48 +285,19 @@ void LRNLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void LRNLayer<Dtype>::CrossChannelForward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
-  const Dtype* bottom_data = bottom[0]->cpu_data();
-  Dtype* top_data = top[0]->mutable_cpu_data();
-  Dtype* scale_data = scale_.mutable_cpu_data();
-  // start with the constant value
-  for (int i = 0; i < scale_.count(); ++i) {
-    scale_data[i] = k_;
+  const CrossChannelLRN<Dtype> lrn = { channels_, height_ * width_, size_,
+      pre_pad_, alpha_, beta_, k_ };
+  const int block = this->layer_param_.channel_block();
+  if (block > 0) {
+    parallel_for(num_ * height_ * width_,
+        BlockedCrossChannelForward<Dtype>(lrn, block, bottom[0]->cpu_data(),
+        scale_.mutable_cpu_data(), top[0]->mutable_cpu_data()),
+        std::max(1, kElementwiseGrain / channels_));
+    return;
   }
-  Blob<Dtype> padded_square(1, channels_ + size_ - 1, height_, width_);
-  Dtype* padded_square_data = padded_square.mutable_cpu_data();
-  caffe_set(padded_square.count(), Dtype(0), padded_square_data);
-  Dtype alpha_over_size = alpha_ / size_;
   // go through the images
-  for (int n = 0; n < num_; ++n) {
-    // compute the padded square
-    caffe_sqr(channels_ * height_ * width_,
-        bottom_data + bottom[0]->offset(n),
-        padded_square_data + padded_square.offset(0, pre_pad_));
-    // Create the first channel scale
-    for (int c = 0; c < size_; ++c) {
-      caffe_axpy<Dtype>(height_ * width_, alpha_over_size,
-          padded_square_data + padded_square.offset(0, c),
-          scale_data + scale_.offset(n, 0));
-    }
-    for (int c = 1; c < channels_; ++c) {
-      // copy previous scale
-      caffe_copy<Dtype>(height_ * width_,
-          scale_data + scale_.offset(n, c - 1),
-          scale_data + scale_.offset(n, c));
-      // add head
-      caffe_axpy<Dtype>(height_ * width_, alpha_over_size,
-          padded_square_data + padded_square.offset(0, c + size_ - 1),
-          scale_data + scale_.offset(n, c));
-      // subtract tail
-      caffe_axpy<Dtype>(height_ * width_, -alpha_over_size,
-          padded_square_data + padded_square.offset(0, c - 1),
-          scale_data + scale_.offset(n, c));
-    }
-  }
-
-  // In the end, compute output
-  caffe_powx<Dtype>(scale_.count(), scale_data, -beta_, top_data);
-  caffe_mul<Dtype>(scale_.count(), top_data, bottom_data, top_data);
+  parallel_for(num_, CrossChannelForward<Dtype>(lrn, bottom[0]->cpu_data(),
+      scale_.mutable_cpu_data(), top[0]->mutable_cpu_data()));
 }
 
 template <typename Dtype>
@@ -164,6 +313,8 @@ void LRNLayer<Dtype>::WithinChannelForward(
 template <typename Dtype>
 void LRNLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+  CHECK(!this->layer_param_.channel_block()) << "LRN in the "
+      << "channel-blocked layout only computes Forward.";
   switch (this->layer_param_.lrn_param().norm_region()) {
   case LRNParameter_NormRegion_ACROSS_CHANNELS:
     CrossChannelBackward_cpu(top, propagate_down, bottom);
@@ -180,55 +331,12 @@ template <typename Dtype>
 void LRNLayer<Dtype>::CrossChannelBackward_cpu(
     const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
     const vector<Blob<Dtype>*>& bottom) {
-  const Dtype* top_diff = top[0]->cpu_diff();
-  const Dtype* top_data = top[0]->cpu_data();
-  const Dtype* bottom_data = bottom[0]->cpu_data();
-  const Dtype* scale_data = scale_.cpu_data();
-  Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
-  Blob<Dtype> padded_ratio(1, channels_ + size_ - 1, height_, width_);
-  Blob<Dtype> accum_ratio(1, 1, height_, width_);
-  Dtype* padded_ratio_data = padded_ratio.mutable_cpu_data();
-  Dtype* accum_ratio_data = accum_ratio.mutable_cpu_data();
-  // We hack a little bit by using the diff() to store an additional result
-  Dtype* accum_ratio_times_bottom = accum_ratio.mutable_cpu_diff();
-  caffe_set(padded_ratio.count(), Dtype(0), padded_ratio_data);
-  Dtype cache_ratio_value = 2. * alpha_ * beta_ / size_;
-
-  caffe_powx<Dtype>(scale_.count(), scale_data, -beta_, bottom_diff);
-  caffe_mul<Dtype>(scale_.count(), top_diff, bottom_diff, bottom_diff);
-
+  const CrossChannelLRN<Dtype> lrn = { channels_, height_ * width_, size_,
+      pre_pad_, alpha_, beta_, k_ };
   // go through individual data
-  int inverse_pre_pad = size_ - (size_ + 1) / 2;
-  for (int n = 0; n < num_; ++n) {
-    int block_offset = scale_.offset(n);
-    // first, compute diff_i * y_i / s_i
-    caffe_mul<Dtype>(channels_ * height_ * width_,
-        top_diff + block_offset, top_data + block_offset,
-        padded_ratio_data + padded_ratio.offset(0, inverse_pre_pad));
-    caffe_div<Dtype>(channels_ * height_ * width_,
-        padded_ratio_data + padded_ratio.offset(0, inverse_pre_pad),
-        scale_data + block_offset,
-        padded_ratio_data + padded_ratio.offset(0, inverse_pre_pad));
-    // Now, compute the accumulated ratios and the bottom diff
-    caffe_set(accum_ratio.count(), Dtype(0), accum_ratio_data);
-    for (int c = 0; c < size_ - 1; ++c) {
-      caffe_axpy<Dtype>(height_ * width_, 1.,
-          padded_ratio_data + padded_ratio.offset(0, c), accum_ratio_data);
-    }
-    for (int c = 0; c < channels_; ++c) {
-      caffe_axpy<Dtype>(height_ * width_, 1.,
-          padded_ratio_data + padded_ratio.offset(0, c + size_ - 1),
-          accum_ratio_data);
-      // compute bottom diff
-      caffe_mul<Dtype>(height_ * width_,
-          bottom_data + top[0]->offset(n, c),
-          accum_ratio_data, accum_ratio_times_bottom);
-      caffe_axpy<Dtype>(height_ * width_, -cache_ratio_value,
-          accum_ratio_times_bottom, bottom_diff + top[0]->offset(n, c));
-      caffe_axpy<Dtype>(height_ * width_, -1.,
-          padded_ratio_data + padded_ratio.offset(0, c), accum_ratio_data);
-    }
-  }
+  parallel_for(num_, CrossChannelBackward<Dtype>(lrn, top[0]->cpu_diff(),
+      top[0]->cpu_data(), bottom[0]->cpu_data(), scale_.cpu_data(),
+      bottom[0]->mutable_cpu_diff()));
 }
 
 template <typename Dtype>
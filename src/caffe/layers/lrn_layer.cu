@@ -55,6 +55,11 @@ __global__ void LRNFillScale(const int nthreads, const Dtype* const in,
 template <typename Dtype>
 void LRNLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
+  if (this->layer_param_.channel_block() > 0) {
+    // The channel-blocked layout is computed on the CPU only.
+    Forward_cpu(bottom, top);
+    return;
+  }
   switch (this->layer_param_.lrn_param().norm_region()) {
   case LRNParameter_NormRegion_ACROSS_CHANNELS:
     CrossChannelForward_gpu(bottom, top);
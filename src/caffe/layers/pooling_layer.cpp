@@ -4,6 +4,7 @@
 
 #include "caffe/layers/pooling_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -81,6 +82,18 @@ void PoolingLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   CHECK_EQ(4, bottom[0]->num_axes()) << "Input must have 4 axes, "
       << "corresponding to (num, channels, height, width)";
   channels_ = bottom[0]->channels();
+  const int block = this->layer_param_.channel_block();
+  if (block > 0) {
+    CHECK(this->layer_param_.pooling_param().pool() ==
+        PoolingParameter_PoolMethod_MAX ||
+        this->layer_param_.pooling_param().pool() ==
+        PoolingParameter_PoolMethod_AVE)
+        << "Only MAX and AVE pooling compute in the channel-blocked layout.";
+    CHECK_EQ(top.size(), 1) << "Pooling in the channel-blocked layout "
+        << "outputs no mask.";
+    CHECK_EQ(channels_ % block, 0) << "The channels must be a multiple of "
+        << "the channel block.";
+  }
   height_ = bottom[0]->height();
   width_ = bottom[0]->width();
   if (global_pooling_) {
@@ -110,7 +123,7 @@ void PoolingLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   }
   // If max pooling, we will initialize the vector index part.
   if (this->layer_param_.pooling_param().pool() ==
-      PoolingParameter_PoolMethod_MAX && top.size() == 1) {
+      PoolingParameter_PoolMethod_MAX && top.size() == 1 && block == 0) {
     max_idx_.Reshape(bottom[0]->num(), channels_, pooled_height_,
         pooled_width_);
   }
@@ -122,101 +135,298 @@ void PoolingLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   }
 }
 
-// TODO(Yangqing): Is there a faster way to do pooling in the channel-first
-// case?
+namespace {
+
+// The geometry of the pooling windows of one channel.
+struct PoolingGeometry {
+  int height, width, pooled_height, pooled_width;
+  int kernel_h, kernel_w, stride_h, stride_w, pad_h, pad_w;
+};
+
+// The pooling loops run over ranges of the channels of all images, each
+// channel being pooled on its own.
 template <typename Dtype>
-void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
-      const vector<Blob<Dtype>*>& top) {
-  const Dtype* bottom_data = bottom[0]->cpu_data();
-  Dtype* top_data = top[0]->mutable_cpu_data();
-  const int top_count = top[0]->count();
-  // We'll output the mask to top[1] if it's of size >1.
-  const bool use_top_mask = top.size() > 1;
-  int* mask = NULL;  // suppress warnings about uninitalized variables
-  Dtype* top_mask = NULL;
-  // Different pooling methods. We explicitly do the switch outside the for
-  // loop to save time, although this results in more code.
-  switch (this->layer_param_.pooling_param().pool()) {
-  case PoolingParameter_PoolMethod_MAX:
-    // Initialize
-    if (use_top_mask) {
-      top_mask = top[1]->mutable_cpu_data();
-      caffe_set(top_count, Dtype(-1), top_mask);
-    } else {
-      mask = max_idx_.mutable_cpu_data();
-      caffe_set(top_count, -1, mask);
-    }
-    caffe_set(top_count, Dtype(-FLT_MAX), top_data);
-    // The main loop
-    for (int n = 0; n < bottom[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
-        for (int ph = 0; ph < pooled_height_; ++ph) {
-          for (int pw = 0; pw < pooled_width_; ++pw) {
-            int hstart = ph * stride_h_ - pad_h_;
-            int wstart = pw * stride_w_ - pad_w_;
-            int hend = min(hstart + kernel_h_, height_);
-            int wend = min(wstart + kernel_w_, width_);
-            hstart = max(hstart, 0);
-            wstart = max(wstart, 0);
-            const int pool_index = ph * pooled_width_ + pw;
-            for (int h = hstart; h < hend; ++h) {
-              for (int w = wstart; w < wend; ++w) {
-                const int index = h * width_ + w;
-                if (bottom_data[index] > top_data[pool_index]) {
-                  top_data[pool_index] = bottom_data[index];
-                  if (use_top_mask) {
-                    top_mask[pool_index] = static_cast<Dtype>(index);
-                  } else {
-                    mask[pool_index] = index;
-                  }
-                }
+struct MaxPoolForward {
+  MaxPoolForward(const PoolingGeometry& geometry, const Dtype* bottom_data,
+      Dtype* top_data, Dtype* top_mask, int* mask)
+      : g(geometry), bottom_data(bottom_data), top_data(top_data),
+        top_mask(top_mask), mask(mask) {}
+  void operator()(int begin, int end) const {
+    const int bottom_dim = g.height * g.width;
+    const int top_dim = g.pooled_height * g.pooled_width;
+    for (int nc = begin; nc < end; ++nc) {
+      const Dtype* bottom_map = bottom_data + nc * bottom_dim;
+      Dtype* top_map = top_data + nc * top_dim;
+      for (int ph = 0; ph < g.pooled_height; ++ph) {
+        for (int pw = 0; pw < g.pooled_width; ++pw) {
+          int hstart = ph * g.stride_h - g.pad_h;
+          int wstart = pw * g.stride_w - g.pad_w;
+          int hend = min(hstart + g.kernel_h, g.height);
+          int wend = min(wstart + g.kernel_w, g.width);
+          hstart = max(hstart, 0);
+          wstart = max(wstart, 0);
+          const int pool_index = ph * g.pooled_width + pw;
+          Dtype maxval = -FLT_MAX;
+          int maxidx = -1;
+          for (int h = hstart; h < hend; ++h) {
+            for (int w = wstart; w < wend; ++w) {
+              const int index = h * g.width + w;
+              if (bottom_map[index] > maxval) {
+                maxval = bottom_map[index];
+                maxidx = index;
               }
             }
           }
+          top_map[pool_index] = maxval;
+          if (top_mask) {
+            top_mask[nc * top_dim + pool_index] = static_cast<Dtype>(maxidx);
+          } else {
+            mask[nc * top_dim + pool_index] = maxidx;
+          }
+        }
+      }
+    }
+  }
+  const PoolingGeometry g;
+  const Dtype* const bottom_data;
+  Dtype* const top_data;
+  Dtype* const top_mask;
+  int* const mask;
+};
+
+template <typename Dtype>
+struct AvePoolForward {
+  AvePoolForward(const PoolingGeometry& geometry, const Dtype* bottom_data,
+      Dtype* top_data)
+      : g(geometry), bottom_data(bottom_data), top_data(top_data) {}
+  void operator()(int begin, int end) const {
+    const int bottom_dim = g.height * g.width;
+    const int top_dim = g.pooled_height * g.pooled_width;
+    for (int nc = begin; nc < end; ++nc) {
+      const Dtype* bottom_map = bottom_data + nc * bottom_dim;
+      Dtype* top_map = top_data + nc * top_dim;
+      for (int ph = 0; ph < g.pooled_height; ++ph) {
+        for (int pw = 0; pw < g.pooled_width; ++pw) {
+          int hstart = ph * g.stride_h - g.pad_h;
+          int wstart = pw * g.stride_w - g.pad_w;
+          int hend = min(hstart + g.kernel_h, g.height + g.pad_h);
+          int wend = min(wstart + g.kernel_w, g.width + g.pad_w);
+          int pool_size = (hend - hstart) * (wend - wstart);
+          hstart = max(hstart, 0);
+          wstart = max(wstart, 0);
+          hend = min(hend, g.height);
+          wend = min(wend, g.width);
+          Dtype sum = 0;
+          for (int h = hstart; h < hend; ++h) {
+            for (int w = wstart; w < wend; ++w) {
+              sum += bottom_map[h * g.width + w];
+            }
+          }
+          top_map[ph * g.pooled_width + pw] = sum / pool_size;
         }
-        // compute offset
-        bottom_data += bottom[0]->offset(0, 1);
-        top_data += top[0]->offset(0, 1);
-        if (use_top_mask) {
-          top_mask += top[0]->offset(0, 1);
-        } else {
-          mask += top[0]->offset(0, 1);
+      }
+    }
+  }
+  const PoolingGeometry g;
+  const Dtype* const bottom_data;
+  Dtype* const top_data;
+};
+
+template <typename Dtype>
+struct MaxPoolBackward {
+  MaxPoolBackward(const PoolingGeometry& geometry, const Dtype* top_diff,
+      const Dtype* top_mask, const int* mask, Dtype* bottom_diff)
+      : g(geometry), top_diff(top_diff), top_mask(top_mask), mask(mask),
+        bottom_diff(bottom_diff) {}
+  void operator()(int begin, int end) const {
+    const int bottom_dim = g.height * g.width;
+    const int top_dim = g.pooled_height * g.pooled_width;
+    for (int nc = begin; nc < end; ++nc) {
+      Dtype* bottom_map = bottom_diff + nc * bottom_dim;
+      caffe_set(bottom_dim, Dtype(0), bottom_map);
+      for (int index = nc * top_dim; index < (nc + 1) * top_dim; ++index) {
+        const int bottom_index =
+            top_mask ? static_cast<int>(top_mask[index]) : mask[index];
+        bottom_map[bottom_index] += top_diff[index];
+      }
+    }
+  }
+  const PoolingGeometry g;
+  const Dtype* const top_diff;
+  const Dtype* const top_mask;
+  const int* const mask;
+  Dtype* const bottom_diff;
+};
+
+template <typename Dtype>
+struct AvePoolBackward {
+  AvePoolBackward(const PoolingGeometry& geometry, const Dtype* top_diff,
+      Dtype* bottom_diff)
+      : g(geometry), top_diff(top_diff), bottom_diff(bottom_diff) {}
+  void operator()(int begin, int end) const {
+    const int bottom_dim = g.height * g.width;
+    const int top_dim = g.pooled_height * g.pooled_width;
+    for (int nc = begin; nc < end; ++nc) {
+      const Dtype* top_map = top_diff + nc * top_dim;
+      Dtype* bottom_map = bottom_diff + nc * bottom_dim;
+      caffe_set(bottom_dim, Dtype(0), bottom_map);
+      for (int ph = 0; ph < g.pooled_height; ++ph) {
+        for (int pw = 0; pw < g.pooled_width; ++pw) {
+          int hstart = ph * g.stride_h - g.pad_h;
+          int wstart = pw * g.stride_w - g.pad_w;
+          int hend = min(hstart + g.kernel_h, g.height + g.pad_h);
+          int wend = min(wstart + g.kernel_w, g.width + g.pad_w);
+          int pool_size = (hend - hstart) * (wend - wstart);
+          hstart = max(hstart, 0);
+          wstart = max(wstart, 0);
+          hend = min(hend, g.height);
+          wend = min(wend, g.width);
+          for (int h = hstart; h < hend; ++h) {
+            for (int w = wstart; w < wend; ++w) {
+              bottom_map[h * g.width + w] +=
+                top_map[ph * g.pooled_width + pw] / pool_size;
+            }
+          }
         }
       }
     }
-    break;
-  case PoolingParameter_PoolMethod_AVE:
-    for (int i = 0; i < top_count; ++i) {
-      top_data[i] = 0;
+  }
+  const PoolingGeometry g;
+  const Dtype* const top_diff;
+  Dtype* const bottom_diff;
+};
+
+// The same in the channel-blocked layout, over ranges of the channel blocks of
+// all images, with the channels of a block pooled together.
+template <typename Dtype>
+struct BlockedMaxPoolForward {
+  BlockedMaxPoolForward(const PoolingGeometry& geometry, int block,
+      const Dtype* bottom_data, Dtype* top_data)
+      : g(geometry), block(block), bottom_data(bottom_data),
+        top_data(top_data) {}
+  void operator()(int begin, int end) const {
+    const int bottom_dim = g.height * g.width * block;
+    const int top_dim = g.pooled_height * g.pooled_width * block;
+    for (int nb = begin; nb < end; ++nb) {
+      const Dtype* bottom_map = bottom_data + nb * bottom_dim;
+      Dtype* top_pixel = top_data + nb * top_dim;
+      for (int ph = 0; ph < g.pooled_height; ++ph) {
+        for (int pw = 0; pw < g.pooled_width; ++pw, top_pixel += block) {
+          int hstart = ph * g.stride_h - g.pad_h;
+          int wstart = pw * g.stride_w - g.pad_w;
+          const int hend = min(hstart + g.kernel_h, g.height);
+          const int wend = min(wstart + g.kernel_w, g.width);
+          hstart = max(hstart, 0);
+          wstart = max(wstart, 0);
+          for (int l = 0; l < block; ++l) {
+            top_pixel[l] = -FLT_MAX;
+          }
+          for (int h = hstart; h < hend; ++h) {
+            for (int w = wstart; w < wend; ++w) {
+              const Dtype* bottom_pixel =
+                  bottom_map + (h * g.width + w) * block;
+              for (int l = 0; l < block; ++l) {
+                top_pixel[l] = max(top_pixel[l], bottom_pixel[l]);
+              }
+            }
+          }
+        }
+      }
     }
-    // The main loop
-    for (int n = 0; n < bottom[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
-        for (int ph = 0; ph < pooled_height_; ++ph) {
-          for (int pw = 0; pw < pooled_width_; ++pw) {
-            int hstart = ph * stride_h_ - pad_h_;
-            int wstart = pw * stride_w_ - pad_w_;
-            int hend = min(hstart + kernel_h_, height_ + pad_h_);
-            int wend = min(wstart + kernel_w_, width_ + pad_w_);
-            int pool_size = (hend - hstart) * (wend - wstart);
-            hstart = max(hstart, 0);
-            wstart = max(wstart, 0);
-            hend = min(hend, height_);
-            wend = min(wend, width_);
-            for (int h = hstart; h < hend; ++h) {
-              for (int w = wstart; w < wend; ++w) {
-                top_data[ph * pooled_width_ + pw] +=
-                    bottom_data[h * width_ + w];
+  }
+  const PoolingGeometry g;
+  const int block;
+  const Dtype* const bottom_data;
+  Dtype* const top_data;
+};
+
+template <typename Dtype>
+struct BlockedAvePoolForward {
+  BlockedAvePoolForward(const PoolingGeometry& geometry, int block,
+      const Dtype* bottom_data, Dtype* top_data)
+      : g(geometry), block(block), bottom_data(bottom_data),
+        top_data(top_data) {}
+  void operator()(int begin, int end) const {
+    const int bottom_dim = g.height * g.width * block;
+    const int top_dim = g.pooled_height * g.pooled_width * block;
+    for (int nb = begin; nb < end; ++nb) {
+      const Dtype* bottom_map = bottom_data + nb * bottom_dim;
+      Dtype* top_pixel = top_data + nb * top_dim;
+      for (int ph = 0; ph < g.pooled_height; ++ph) {
+        for (int pw = 0; pw < g.pooled_width; ++pw, top_pixel += block) {
+          int hstart = ph * g.stride_h - g.pad_h;
+          int wstart = pw * g.stride_w - g.pad_w;
+          int hend = min(hstart + g.kernel_h, g.height + g.pad_h);
+          int wend = min(wstart + g.kernel_w, g.width + g.pad_w);
+          const Dtype pool_size = (hend - hstart) * (wend - wstart);
+          hstart = max(hstart, 0);
+          wstart = max(wstart, 0);
+          hend = min(hend, g.height);
+          wend = min(wend, g.width);
+          caffe_set(block, Dtype(0), top_pixel);
+          for (int h = hstart; h < hend; ++h) {
+            for (int w = wstart; w < wend; ++w) {
+              const Dtype* bottom_pixel =
+                  bottom_map + (h * g.width + w) * block;
+              for (int l = 0; l < block; ++l) {
+                top_pixel[l] += bottom_pixel[l];
               }
             }
-            top_data[ph * pooled_width_ + pw] /= pool_size;
+          }
+          for (int l = 0; l < block; ++l) {
+            top_pixel[l] /= pool_size;
           }
         }
-        // compute offset
-        bottom_data += bottom[0]->offset(0, 1);
-        top_data += top[0]->offset(0, 1);
       }
     }
+  }
+  const PoolingGeometry g;
+  const int block;
+  const Dtype* const bottom_data;
+  Dtype* const top_data;
+};
+
+}  // namespace
+
+template <typename Dtype>
+void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  Dtype* top_data = top[0]->mutable_cpu_data();
+  const int planes = bottom[0]->num() * channels_;
+  const PoolingGeometry geometry = { height_, width_, pooled_height_,
+      pooled_width_, kernel_h_, kernel_w_, stride_h_, stride_w_, pad_h_,
+      pad_w_ };
+  const int grain = max(1, kElementwiseGrain / (height_ * width_));
+  const int block = this->layer_param_.channel_block();
+  if (block > 0) {
+    const int blocked_grain = max(1, grain / block);
+    if (this->layer_param_.pooling_param().pool() ==
+        PoolingParameter_PoolMethod_MAX) {
+      parallel_for(planes / block, BlockedMaxPoolForward<Dtype>(geometry,
+          block, bottom_data, top_data), blocked_grain);
+    } else {
+      parallel_for(planes / block, BlockedAvePoolForward<Dtype>(geometry,
+          block, bottom_data, top_data), blocked_grain);
+    }
+    return;
+  }
+  // Different pooling methods. We explicitly do the switch outside the for
+  // loop to save time, although this results in more code.
+  switch (this->layer_param_.pooling_param().pool()) {
+  case PoolingParameter_PoolMethod_MAX:
+    // We'll output the mask to top[1] if it's of size >1.
+    if (top.size() > 1) {
+      parallel_for(planes, MaxPoolForward<Dtype>(geometry, bottom_data,
+          top_data, top[1]->mutable_cpu_data(), NULL), grain);
+    } else {
+      parallel_for(planes, MaxPoolForward<Dtype>(geometry, bottom_data,
+          top_data, NULL, max_idx_.mutable_cpu_data()), grain);
+    }
+    break;
+  case PoolingParameter_PoolMethod_AVE:
+    parallel_for(planes, AvePoolForward<Dtype>(geometry, bottom_data,
+        top_data), grain);
     break;
   case PoolingParameter_PoolMethod_STOCHASTIC:
     NOT_IMPLEMENTED;
@@ -232,71 +442,31 @@ void PoolingLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   if (!propagate_down[0]) {
     return;
   }
+  CHECK(!this->layer_param_.channel_block()) << "Pooling in the "
+      << "channel-blocked layout only computes Forward.";
   const Dtype* top_diff = top[0]->cpu_diff();
   Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
+  const int planes = top[0]->num() * channels_;
+  const PoolingGeometry geometry = { height_, width_, pooled_height_,
+      pooled_width_, kernel_h_, kernel_w_, stride_h_, stride_w_, pad_h_,
+      pad_w_ };
+  const int grain = max(1, kElementwiseGrain / (height_ * width_));
   // Different pooling methods. We explicitly do the switch outside the for
   // loop to save time, although this results in more codes.
-  caffe_set(bottom[0]->count(), Dtype(0), bottom_diff);
-  // We'll output the mask to top[1] if it's of size >1.
-  const bool use_top_mask = top.size() > 1;
-  const int* mask = NULL;  // suppress warnings about uninitialized variables
-  const Dtype* top_mask = NULL;
   switch (this->layer_param_.pooling_param().pool()) {
   case PoolingParameter_PoolMethod_MAX:
-    // The main loop
-    if (use_top_mask) {
-      top_mask = top[1]->cpu_data();
+    // We'll read the mask from top[1] if it's of size >1.
+    if (top.size() > 1) {
+      parallel_for(planes, MaxPoolBackward<Dtype>(geometry, top_diff,
+          top[1]->cpu_data(), NULL, bottom_diff), grain);
     } else {
-      mask = max_idx_.cpu_data();
-    }
-    for (int n = 0; n < top[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
-        for (int ph = 0; ph < pooled_height_; ++ph) {
-          for (int pw = 0; pw < pooled_width_; ++pw) {
-            const int index = ph * pooled_width_ + pw;
-            const int bottom_index =
-                use_top_mask ? top_mask[index] : mask[index];
-            bottom_diff[bottom_index] += top_diff[index];
-          }
-        }
-        bottom_diff += bottom[0]->offset(0, 1);
-        top_diff += top[0]->offset(0, 1);
-        if (use_top_mask) {
-          top_mask += top[0]->offset(0, 1);
-        } else {
-          mask += top[0]->offset(0, 1);
-        }
-      }
+      parallel_for(planes, MaxPoolBackward<Dtype>(geometry, top_diff, NULL,
+          max_idx_.cpu_data(), bottom_diff), grain);
     }
     break;
   case PoolingParameter_PoolMethod_AVE:
-    // The main loop
-    for (int n = 0; n < top[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
-        for (int ph = 0; ph < pooled_height_; ++ph) {
-          for (int pw = 0; pw < pooled_width_; ++pw) {
-            int hstart = ph * stride_h_ - pad_h_;
-            int wstart = pw * stride_w_ - pad_w_;
-            int hend = min(hstart + kernel_h_, height_ + pad_h_);
-            int wend = min(wstart + kernel_w_, width_ + pad_w_);
-            int pool_size = (hend - hstart) * (wend - wstart);
-            hstart = max(hstart, 0);
-            wstart = max(wstart, 0);
-            hend = min(hend, height_);
-            wend = min(wend, width_);
-            for (int h = hstart; h < hend; ++h) {
-              for (int w = wstart; w < wend; ++w) {
-                bottom_diff[h * width_ + w] +=
-                  top_diff[ph * pooled_width_ + pw] / pool_size;
-              }
-            }
-          }
-        }
-        // offset
-        bottom_diff += bottom[0]->offset(0, 1);
-        top_diff += top[0]->offset(0, 1);
-      }
-    }
+    parallel_for(planes, AvePoolBackward<Dtype>(geometry, top_diff,
+        bottom_diff), grain);
     break;
   case PoolingParameter_PoolMethod_STOCHASTIC:
     NOT_IMPLEMENTED;
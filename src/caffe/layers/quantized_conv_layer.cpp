@@ -0,0 +1,160 @@
+#include <vector>
+
+#include "caffe/layers/quantized_conv_layer.hpp"
+#include "caffe/util/im2col.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/quantize.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Rounds a size in bytes up to whole cache lines, to align the parts of the
+// buffer.
+inline size_t cache_lines(size_t size) { return (size + 63) / 64 * 64; }
+
+}  // namespace
+
+template <typename Dtype>
+void QuantizedConvolutionLayer<Dtype>::LayerSetUp(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  // The base class only knows of the weights and the bias.
+  shared_ptr<Blob<Dtype> > scales;
+  const bool bias_term = this->layer_param_.convolution_param().bias_term();
+  if (this->blobs_.size() == 2 + bias_term) {
+    scales = this->blobs_.back();
+    this->blobs_.pop_back();
+  }
+  const bool initialized = this->blobs_.size() > 0;
+  ConvolutionLayer<Dtype>::LayerSetUp(bottom, top);
+  CHECK_EQ(this->num_spatial_axes_, 2)
+      << "Quantized convolution only supports 2D convolution.";
+  CHECK(!this->force_nd_im2col_)
+      << "Quantized convolution does not support force_nd_im2col.";
+  const int outputs = this->blobs_[0]->shape(0);
+  if (!initialized) {
+    // Quantize the freshly filled weights, one scale per output channel.
+    scales.reset(new Blob<Dtype>(vector<int>(1, outputs)));
+    quantize_rows_cpu(outputs, this->blobs_[0]->count(1),
+        this->blobs_[0]->cpu_data(), this->blobs_[0]->mutable_cpu_data(),
+        scales->mutable_cpu_data());
+  }
+  CHECK(scales) << "Quantized layers need a blob of weight scales.";
+  CHECK_EQ(scales->count(), outputs);
+  this->blobs_.push_back(scales);
+  this->param_propagate_down_.assign(this->blobs_.size(), false);
+}
+
+template <typename Dtype>
+void QuantizedConvolutionLayer<Dtype>::Reshape(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  ConvolutionLayer<Dtype>::Reshape(bottom, top);
+  const int* kernel_shape_data = this->kernel_shape_.cpu_data();
+  const size_t spatial = this->output_shape_[0] * this->output_shape_[1];
+  const size_t columns = static_cast<size_t>(this->channels_) *
+      kernel_shape_data[0] * kernel_shape_data[1] * spatial;
+  const size_t size =
+      (this->is_1x1_ ? 0 : cache_lines(columns * sizeof(Dtype))) +
+      cache_lines(columns) + cache_lines(columns / this->group_) +
+      cache_lines(this->num_output_ / this->group_ * spatial *
+      sizeof(int32_t));
+  quantize_buffer_.Reshape(vector<int>(1,
+      (size + sizeof(Dtype) - 1) / sizeof(Dtype)));
+  const size_t quantize_buffer_size = quantize_buffer_.count() * sizeof(Dtype);
+  ConvWorkspace::Register(&quantize_buffer_, quantize_buffer_size);
+  ConvWorkspace::Get().Reserve(quantize_buffer_size);
+}
+
+template <typename Dtype>
+void QuantizedConvolutionLayer<Dtype>::ToProto(LayerParameter* param,
+    bool write_diff) {
+  ConvolutionLayer<Dtype>::ToProto(param, write_diff);
+  Int8BlobToProto(*this->blobs_[0], param->mutable_blobs(0));
+}
+
+template <typename Dtype>
+void QuantizedConvolutionLayer<Dtype>::Forward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const shared_ptr<SyncedMemory>& weights = this->blobs_[0]->data();
+  if (weights != weights_source_ || weights->version() != weights_version_) {
+    quantized_weights_.reset(new SyncedMemory(this->blobs_[0]->count()));
+    // The weights already hold integers, so a unit scale keeps them as is.
+    quantize_cpu(this->blobs_[0]->count(), Dtype(1),
+        this->blobs_[0]->cpu_data(),
+        static_cast<int8_t*>(quantized_weights_->mutable_cpu_data()));
+    weights_source_ = weights;
+    weights_version_ = weights->version();
+  }
+  const int8_t* quantized_weights =
+      static_cast<const int8_t*>(quantized_weights_->cpu_data());
+  const Dtype bottom_scale =
+      this->layer_param_.quantization_param().bottom_scale();
+  const Dtype* scales = this->blobs_.back()->cpu_data();
+  const int* kernel_shape_data = this->kernel_shape_.cpu_data();
+  const int* pad_data = this->pad_.cpu_data();
+  const int* stride_data = this->stride_.cpu_data();
+  const int* dilation_data = this->dilation_.cpu_data();
+  const int spatial = this->output_shape_[0] * this->output_shape_[1];
+  const int group_dim = this->channels_ / this->group_ *
+      kernel_shape_data[0] * kernel_shape_data[1];
+  const int group_output = this->num_output_ / this->group_;
+  const int columns = group_dim * this->group_ * spatial;
+  quantize_buffer_.ShareDataMemory(ConvWorkspace::Get().Reserve(
+      quantize_buffer_.count() * sizeof(Dtype)));
+  char* buffer = reinterpret_cast<char*>(quantize_buffer_.mutable_cpu_data());
+  Dtype* col = reinterpret_cast<Dtype*>(buffer);
+  if (!this->is_1x1_) { buffer += cache_lines(columns * sizeof(Dtype)); }
+  int8_t* quantized_col = reinterpret_cast<int8_t*>(buffer);
+  int8_t* transposed_col = quantized_col + cache_lines(columns);
+  int32_t* products = reinterpret_cast<int32_t*>(transposed_col +
+      cache_lines(columns / this->group_));
+  for (int i = 0; i < bottom.size(); ++i) {
+    const Dtype* bottom_data = bottom[i]->cpu_data();
+    Dtype* top_data = top[i]->mutable_cpu_data();
+    for (int n = 0; n < this->num_; ++n) {
+      const Dtype* input = bottom_data + n * this->bottom_dim_;
+      if (!this->is_1x1_) {
+        im2col_cpu(input, this->channels_, this->input_shape(1),
+            this->input_shape(2), kernel_shape_data[0], kernel_shape_data[1],
+            pad_data[0], pad_data[1], stride_data[0], stride_data[1],
+            dilation_data[0], dilation_data[1], col);
+        input = col;
+      }
+      quantize_cpu(columns, bottom_scale, input, quantized_col);
+      Dtype* output = top_data + n * this->top_dim_;
+      for (int g = 0; g < this->group_; ++g) {
+        // The int8 GEMM wants both operands contiguous along the reduction.
+        const int8_t* group_col = quantized_col + g * group_dim * spatial;
+        for (int k = 0; k < group_dim; ++k) {
+          for (int s = 0; s < spatial; ++s) {
+            transposed_col[s * group_dim + k] = group_col[k * spatial + s];
+          }
+        }
+        caffe_cpu_gemm_s8(group_output, spatial, group_dim,
+            quantized_weights + g * group_output * group_dim, transposed_col,
+            products);
+        for (int o = 0; o < group_output; ++o) {
+          const int channel = g * group_output + o;
+          const Dtype scale = bottom_scale * scales[channel];
+          Dtype* output_map = output + channel * spatial;
+          for (int s = 0; s < spatial; ++s) {
+            output_map[s] = products[o * spatial + s] * scale;
+          }
+        }
+      }
+      this->forward_cpu_bias_activation(output);
+    }
+  }
+}
+
+template <typename Dtype>
+void QuantizedConvolutionLayer<Dtype>::Backward_cpu(
+    const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
+    const vector<Blob<Dtype>*>& bottom) {
+  LOG(FATAL) << this->type() << " Layer is for inference only.";
+}
+
+INSTANTIATE_CLASS(QuantizedConvolutionLayer);
+REGISTER_LAYER_CLASS(QuantizedConvolution);
+
+}  // namespace caffe
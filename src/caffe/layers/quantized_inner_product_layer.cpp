@@ -0,0 +1,94 @@
+#include <vector>
+
+#include "caffe/layers/quantized_inner_product_layer.hpp"
+#include "caffe/util/activation.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/quantize.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void QuantizedInnerProductLayer<Dtype>::LayerSetUp(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const bool initialized = this->blobs_.size() > 0;
+  InnerProductLayer<Dtype>::LayerSetUp(bottom, top);
+  if (!initialized) {
+    // Quantize the freshly filled weights, one scale per output.
+    Blob<Dtype>* scales = new Blob<Dtype>(vector<int>(1, this->N_));
+    quantize_rows_cpu(this->N_, this->K_, this->blobs_[0]->cpu_data(),
+        this->blobs_[0]->mutable_cpu_data(), scales->mutable_cpu_data());
+    this->blobs_.push_back(shared_ptr<Blob<Dtype> >(scales));
+  }
+  CHECK_EQ(this->blobs_.size(), this->bias_term_ ? 3 : 2)
+      << "Quantized layers need a blob of weight scales.";
+  CHECK_EQ(this->blobs_.back()->count(), this->N_);
+  this->param_propagate_down_.assign(this->blobs_.size(), false);
+}
+
+template <typename Dtype>
+void QuantizedInnerProductLayer<Dtype>::Reshape(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  InnerProductLayer<Dtype>::Reshape(bottom, top);
+  const size_t bottom_size = this->M_ * this->K_ * sizeof(int8_t);
+  if (!quantized_bottom_ || quantized_bottom_->size() != bottom_size) {
+    quantized_bottom_.reset(new SyncedMemory(bottom_size));
+    products_.reset(new SyncedMemory(this->M_ * this->N_ * sizeof(int32_t)));
+  }
+}
+
+template <typename Dtype>
+void QuantizedInnerProductLayer<Dtype>::ToProto(LayerParameter* param,
+    bool write_diff) {
+  InnerProductLayer<Dtype>::ToProto(param, write_diff);
+  Int8BlobToProto(*this->blobs_[0], param->mutable_blobs(0));
+}
+
+template <typename Dtype>
+void QuantizedInnerProductLayer<Dtype>::Forward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const shared_ptr<SyncedMemory>& weights = this->blobs_[0]->data();
+  if (weights != weights_source_ || weights->version() != weights_version_) {
+    quantized_weights_.reset(new SyncedMemory(this->blobs_[0]->count()));
+    // The weights already hold integers, so a unit scale keeps them as is.
+    quantize_cpu(this->blobs_[0]->count(), Dtype(1),
+        this->blobs_[0]->cpu_data(),
+        static_cast<int8_t*>(quantized_weights_->mutable_cpu_data()));
+    weights_source_ = weights;
+    weights_version_ = weights->version();
+  }
+  const Dtype bottom_scale =
+      this->layer_param_.quantization_param().bottom_scale();
+  int8_t* quantized_bottom =
+      static_cast<int8_t*>(quantized_bottom_->mutable_cpu_data());
+  quantize_cpu(this->M_ * this->K_, bottom_scale, bottom[0]->cpu_data(),
+      quantized_bottom);
+  int32_t* products = static_cast<int32_t*>(products_->mutable_cpu_data());
+  caffe_cpu_gemm_s8(this->M_, this->N_, this->K_, quantized_bottom,
+      static_cast<const int8_t*>(quantized_weights_->cpu_data()), products);
+  const Dtype* scales = this->blobs_.back()->cpu_data();
+  const Dtype* bias = this->bias_term_ ? this->blobs_[1]->cpu_data() : NULL;
+  Dtype* top_data = top[0]->mutable_cpu_data();
+  for (int m = 0; m < this->M_; ++m) {
+    for (int n = 0; n < this->N_; ++n) {
+      const int index = m * this->N_ + n;
+      top_data[index] = products[index] * bottom_scale * scales[n] +
+          (bias ? bias[n] : Dtype(0));
+    }
+  }
+  activation_forward_cpu(
+      this->layer_param_.inner_product_param().fused_activation(), this->M_,
+      this->N_, static_cast<const Dtype*>(NULL),
+      static_cast<const Dtype*>(NULL), top_data);
+}
+
+template <typename Dtype>
+void QuantizedInnerProductLayer<Dtype>::Backward_cpu(
+    const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
+    const vector<Blob<Dtype>*>& bottom) {
+  LOG(FATAL) << this->type() << " Layer is for inference only.";
+}
+
+INSTANTIATE_CLASS(QuantizedInnerProductLayer);
+REGISTER_LAYER_CLASS(QuantizedInnerProduct);
+
+}  // namespace caffe
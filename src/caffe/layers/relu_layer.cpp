@@ -2,9 +2,48 @@
 #include <vector>
 
 #include "caffe/layers/relu_layer.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+namespace {
+
+template <typename Dtype>
+struct ReLUForward {
+  ReLUForward(const Dtype* bottom_data, Dtype* top_data, Dtype negative_slope)
+      : bottom_data(bottom_data), top_data(top_data),
+        negative_slope(negative_slope) {}
+  void operator()(int begin, int end) const {
+    for (int i = begin; i < end; ++i) {
+      top_data[i] = std::max(bottom_data[i], Dtype(0))
+          + negative_slope * std::min(bottom_data[i], Dtype(0));
+    }
+  }
+  const Dtype* const bottom_data;
+  Dtype* const top_data;
+  const Dtype negative_slope;
+};
+
+template <typename Dtype>
+struct ReLUBackward {
+  ReLUBackward(const Dtype* bottom_data, const Dtype* top_diff,
+      Dtype* bottom_diff, Dtype negative_slope)
+      : bottom_data(bottom_data), top_diff(top_diff),
+        bottom_diff(bottom_diff), negative_slope(negative_slope) {}
+  void operator()(int begin, int end) const {
+    for (int i = begin; i < end; ++i) {
+      bottom_diff[i] = top_diff[i] * ((bottom_data[i] > 0)
+          + negative_slope * (bottom_data[i] <= 0));
+    }
+  }
+  const Dtype* const bottom_data;
+  const Dtype* const top_diff;
+  Dtype* const bottom_diff;
+  const Dtype negative_slope;
+};
+
+}  // namespace
+
 template <typename Dtype>
 void ReLULayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
@@ -12,10 +51,9 @@ void ReLULayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   Dtype* top_data = top[0]->mutable_cpu_data();
   const int count = bottom[0]->count();
   Dtype negative_slope = this->layer_param_.relu_param().negative_slope();
-  for (int i = 0; i < count; ++i) {
-    top_data[i] = std::max(bottom_data[i], Dtype(0))
-        + negative_slope * std::min(bottom_data[i], Dtype(0));
-  }
+  parallel_for(count,
+      ReLUForward<Dtype>(bottom_data, top_data, negative_slope),
+      kElementwiseGrain);
 }
 
 template <typename Dtype>
@@ -28,10 +66,8 @@ void ReLULayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
     const int count = bottom[0]->count();
     Dtype negative_slope = this->layer_param_.relu_param().negative_slope();
-    for (int i = 0; i < count; ++i) {
-      bottom_diff[i] = top_diff[i] * ((bottom_data[i] > 0)
-          + negative_slope * (bottom_data[i] <= 0));
-    }
+    parallel_for(count, ReLUBackward<Dtype>(bottom_data, top_diff,
+        bottom_diff, negative_slope), kElementwiseGrain);
   }
 }
 
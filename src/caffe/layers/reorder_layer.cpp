@@ -0,0 +1,58 @@
+#include <vector>
+
+#include "caffe/layers/reorder_layer.hpp"
+#include "caffe/util/blocked_layout.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void ReorderLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  CHECK_NE(top[0], bottom[0]) << this->type() << " Layer does not "
+      "allow in-place computation.";
+  CHECK_GE(bottom[0]->num_axes(), 2);
+  const int block = this->layer_param_.channel_block();
+  CHECK_GT(block, 0) << "Reorder layers need a channel_block.";
+  CHECK_EQ(bottom[0]->shape(1) % block, 0) << "The channels ("
+      << bottom[0]->shape(1) << ") must be a multiple of the channel block ("
+      << block << ").";
+  top[0]->ReshapeLike(*bottom[0]);
+}
+
+template <typename Dtype>
+void ReorderLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  const int num = bottom[0]->shape(0);
+  const int channels = bottom[0]->shape(1);
+  const int spatial = bottom[0]->count(2);
+  const int block = this->layer_param_.channel_block();
+  if (this->layer_param_.reorder_param().to_blocked()) {
+    reorder_to_blocked_cpu(num, channels, spatial, block,
+        bottom[0]->cpu_data(), top[0]->mutable_cpu_data());
+  } else {
+    reorder_from_blocked_cpu(num, channels, spatial, block,
+        bottom[0]->cpu_data(), top[0]->mutable_cpu_data());
+  }
+}
+
+template <typename Dtype>
+void ReorderLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+  if (!propagate_down[0]) { return; }
+  const int num = bottom[0]->shape(0);
+  const int channels = bottom[0]->shape(1);
+  const int spatial = bottom[0]->count(2);
+  const int block = this->layer_param_.channel_block();
+  if (this->layer_param_.reorder_param().to_blocked()) {
+    reorder_from_blocked_cpu(num, channels, spatial, block,
+        top[0]->cpu_diff(), bottom[0]->mutable_cpu_diff());
+  } else {
+    reorder_to_blocked_cpu(num, channels, spatial, block,
+        top[0]->cpu_diff(), bottom[0]->mutable_cpu_diff());
+  }
+}
+
+INSTANTIATE_CLASS(ReorderLayer);
+REGISTER_LAYER_CLASS(Reorder);
+
+}  // namespace caffe
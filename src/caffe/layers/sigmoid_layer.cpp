@@ -2,6 +2,7 @@
 #include <vector>
 
 #include "caffe/layers/sigmoid_layer.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -10,15 +11,47 @@ inline Dtype sigmoid(Dtype x) {
   return 1. / (1. + exp(-x));
 }
 
+namespace {
+
+template <typename Dtype>
+struct SigmoidForward {
+  SigmoidForward(const Dtype* bottom_data, Dtype* top_data)
+      : bottom_data(bottom_data), top_data(top_data) {}
+  void operator()(int begin, int end) const {
+    for (int i = begin; i < end; ++i) {
+      top_data[i] = sigmoid(bottom_data[i]);
+    }
+  }
+  const Dtype* const bottom_data;
+  Dtype* const top_data;
+};
+
+template <typename Dtype>
+struct SigmoidBackward {
+  SigmoidBackward(const Dtype* top_data, const Dtype* top_diff,
+      Dtype* bottom_diff)
+      : top_data(top_data), top_diff(top_diff), bottom_diff(bottom_diff) {}
+  void operator()(int begin, int end) const {
+    for (int i = begin; i < end; ++i) {
+      const Dtype sigmoid_x = top_data[i];
+      bottom_diff[i] = top_diff[i] * sigmoid_x * (1. - sigmoid_x);
+    }
+  }
+  const Dtype* const top_data;
+  const Dtype* const top_diff;
+  Dtype* const bottom_diff;
+};
+
+}  // namespace
+
 template <typename Dtype>
 void SigmoidLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   const int count = bottom[0]->count();
-  for (int i = 0; i < count; ++i) {
-    top_data[i] = sigmoid(bottom_data[i]);
-  }
+  parallel_for(count, SigmoidForward<Dtype>(bottom_data, top_data),
+      kElementwiseGrain);
 }
 
 template <typename Dtype>
@@ -30,10 +63,9 @@ void SigmoidLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const Dtype* top_diff = top[0]->cpu_diff();
     Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
     const int count = bottom[0]->count();
-    for (int i = 0; i < count; ++i) {
-      const Dtype sigmoid_x = top_data[i];
-      bottom_diff[i] = top_diff[i] * sigmoid_x * (1. - sigmoid_x);
-    }
+    parallel_for(count,
+        SigmoidBackward<Dtype>(top_data, top_diff, bottom_diff),
+        kElementwiseGrain);
   }
 }
 
@@ -70,12 +70,20 @@ void SliceLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
     top[0]->ShareData(*bottom[0]);
     top[0]->ShareDiff(*bottom[0]);
   }
+  top_offsets_.assign(top.size(), -1);
+  if (top.size() > 1 && num_slices_ == 1) {
+    for (int i = 0, offset = 0; i < top.size(); ++i) {
+      top_offsets_[i] = offset;
+      offset += top[i]->count();
+    }
+  }
 }
 
 template <typename Dtype>
 void SliceLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   if (top.size() == 1) { return; }
+  // caffe_copy skips the tops that the net made views of the bottom.
   int offset_slice_axis = 0;
   const Dtype* bottom_data = bottom[0]->cpu_data();
   const int bottom_slice_axis = bottom[0]->shape(slice_axis_);
@@ -3,9 +3,99 @@
 
 #include "caffe/layers/softmax_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+namespace {
+
+// The softmax loops run over ranges of the outer_num_ slices, each with its
+// inner_num_ values of scale_.
+template <typename Dtype>
+struct SoftmaxForward {
+  SoftmaxForward(int channels, int inner_num, const Dtype* bottom_data,
+      Dtype* scale_data, Dtype* top_data)
+      : channels(channels), inner_num(inner_num), bottom_data(bottom_data),
+        scale_data(scale_data), top_data(top_data) {}
+  void operator()(int begin, int end) const {
+    const int dim = channels * inner_num;
+    for (int i = begin; i < end; ++i) {
+      const Dtype* bottom = bottom_data + i * dim;
+      Dtype* scale = scale_data + i * inner_num;
+      Dtype* top = top_data + i * dim;
+      // We need to subtract the max to avoid numerical issues, compute the
+      // exp, and then normalize.
+      std::copy(bottom, bottom + inner_num, scale);
+      for (int j = 0; j < channels; j++) {
+        for (int k = 0; k < inner_num; k++) {
+          scale[k] = std::max(scale[k], bottom[j * inner_num + k]);
+        }
+      }
+      // subtraction
+      for (int j = 0; j < channels; j++) {
+        for (int k = 0; k < inner_num; k++) {
+          top[j * inner_num + k] = bottom[j * inner_num + k] - scale[k];
+        }
+      }
+      // exponentiation
+      caffe_exp<Dtype>(dim, top, top);
+      // sum after exp
+      std::fill(scale, scale + inner_num, Dtype(0));
+      for (int j = 0; j < channels; j++) {
+        for (int k = 0; k < inner_num; k++) {
+          scale[k] += top[j * inner_num + k];
+        }
+      }
+      // division
+      for (int j = 0; j < channels; j++) {
+        caffe_div(inner_num, top + j * inner_num, scale, top + j * inner_num);
+      }
+    }
+  }
+  const int channels;
+  const int inner_num;
+  const Dtype* const bottom_data;
+  Dtype* const scale_data;
+  Dtype* const top_data;
+};
+
+template <typename Dtype>
+struct SoftmaxBackward {
+  SoftmaxBackward(int channels, int inner_num, const Dtype* top_data,
+      const Dtype* top_diff, Dtype* scale_data, Dtype* bottom_diff)
+      : channels(channels), inner_num(inner_num), top_data(top_data),
+        top_diff(top_diff), scale_data(scale_data), bottom_diff(bottom_diff) {}
+  void operator()(int begin, int end) const {
+    const int dim = channels * inner_num;
+    for (int i = begin; i < end; ++i) {
+      const Dtype* data = top_data + i * dim;
+      const Dtype* top = top_diff + i * dim;
+      Dtype* scale = scale_data + i * inner_num;
+      Dtype* bottom = bottom_diff + i * dim;
+      // compute dot(top_diff, top_data) and subtract them from the top diff
+      for (int k = 0; k < inner_num; ++k) {
+        scale[k] = caffe_cpu_strided_dot<Dtype>(channels, top + k, inner_num,
+            data + k, inner_num);
+      }
+      // subtraction and elementwise multiplication
+      for (int j = 0; j < channels; j++) {
+        for (int k = 0; k < inner_num; k++) {
+          const int index = j * inner_num + k;
+          bottom[index] = (top[index] - scale[k]) * data[index];
+        }
+      }
+    }
+  }
+  const int channels;
+  const int inner_num;
+  const Dtype* const top_data;
+  const Dtype* const top_diff;
+  Dtype* const scale_data;
+  Dtype* const bottom_diff;
+};
+
+}  // namespace
+
 template <typename Dtype>
 void SoftmaxLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -26,63 +116,22 @@ void SoftmaxLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void SoftmaxLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
-  const Dtype* bottom_data = bottom[0]->cpu_data();
-  Dtype* top_data = top[0]->mutable_cpu_data();
-  Dtype* scale_data = scale_.mutable_cpu_data();
-  int channels = bottom[0]->shape(softmax_axis_);
-  int dim = bottom[0]->count() / outer_num_;
-  caffe_copy(bottom[0]->count(), bottom_data, top_data);
-  // We need to subtract the max to avoid numerical issues, compute the exp,
-  // and then normalize.
-  for (int i = 0; i < outer_num_; ++i) {
-    // initialize scale_data to the first plane
-    caffe_copy(inner_num_, bottom_data + i * dim, scale_data);
-    for (int j = 0; j < channels; j++) {
-      for (int k = 0; k < inner_num_; k++) {
-        scale_data[k] = std::max(scale_data[k],
-            bottom_data[i * dim + j * inner_num_ + k]);
-      }
-    }
-    // subtraction
-    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, channels, inner_num_,
-        1, -1., sum_multiplier_.cpu_data(), scale_data, 1., top_data);
-    // exponentiation
-    caffe_exp<Dtype>(dim, top_data, top_data);
-    // sum after exp
-    caffe_cpu_gemv<Dtype>(CblasTrans, channels, inner_num_, 1.,
-        top_data, sum_multiplier_.cpu_data(), 0., scale_data);
-    // division
-    for (int j = 0; j < channels; j++) {
-      caffe_div(inner_num_, top_data, scale_data, top_data);
-      top_data += inner_num_;
-    }
-  }
+  const int channels = bottom[0]->shape(softmax_axis_);
+  const int dim = bottom[0]->count() / outer_num_;
+  parallel_for(outer_num_, SoftmaxForward<Dtype>(channels, inner_num_,
+      bottom[0]->cpu_data(), scale_.mutable_cpu_data(),
+      top[0]->mutable_cpu_data()), std::max(1, kElementwiseGrain / dim));
 }
 
 template <typename Dtype>
 void SoftmaxLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down,
     const vector<Blob<Dtype>*>& bottom) {
-  const Dtype* top_diff = top[0]->cpu_diff();
-  const Dtype* top_data = top[0]->cpu_data();
-  Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
-  Dtype* scale_data = scale_.mutable_cpu_data();
-  int channels = top[0]->shape(softmax_axis_);
-  int dim = top[0]->count() / outer_num_;
-  caffe_copy(top[0]->count(), top_diff, bottom_diff);
-  for (int i = 0; i < outer_num_; ++i) {
-    // compute dot(top_diff, top_data) and subtract them from the bottom diff
-    for (int k = 0; k < inner_num_; ++k) {
-      scale_data[k] = caffe_cpu_strided_dot<Dtype>(channels,
-          bottom_diff + i * dim + k, inner_num_,
-          top_data + i * dim + k, inner_num_);
-    }
-    // subtraction
-    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, channels, inner_num_, 1,
-        -1., sum_multiplier_.cpu_data(), scale_data, 1., bottom_diff + i * dim);
-  }
-  // elementwise multiplication
-  caffe_mul(top[0]->count(), bottom_diff, top_data, bottom_diff);
+  const int channels = top[0]->shape(softmax_axis_);
+  const int dim = top[0]->count() / outer_num_;
+  parallel_for(outer_num_, SoftmaxBackward<Dtype>(channels, inner_num_,
+      top[0]->cpu_data(), top[0]->cpu_diff(), scale_.mutable_cpu_data(),
+      bottom[0]->mutable_cpu_diff()), std::max(1, kElementwiseGrain / dim));
 }
 
 
@@ -14,7 +14,8 @@ void SplitLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
     // by reference in the forward pass, and keep separate diff allocations in
     // the backward pass.  (Technically, it should be possible to share the diff
     // blob of the first split output with the input, but this seems to cause
-    // some strange effects in practice...)
+    // some strange effects in practice...  Net does so with share_blob_views
+    // where the layers reading the first output all write its diff.)
     CHECK_NE(top[i], bottom[0]) << this->type() << " Layer does not "
         "allow in-place computation.";
     top[i]->ReshapeLike(*bottom[0]);
@@ -34,6 +35,14 @@ template <typename Dtype>
 void SplitLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
   if (!propagate_down[0]) { return; }
+  if (top[0]->diff() == bottom[0]->diff()) {
+    // The bottom already holds the first diff; add the others to it.
+    Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
+    for (int i = 1; i < top.size(); ++i) {
+      caffe_axpy(count_, Dtype(1.), top[i]->cpu_diff(), bottom_diff);
+    }
+    return;
+  }
   if (top.size() == 1) {
     caffe_copy(count_, top[0]->cpu_diff(), bottom[0]->mutable_cpu_diff());
     return;
@@ -17,6 +17,13 @@ template <typename Dtype>
 void SplitLayer<Dtype>::Backward_gpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
   if (!propagate_down[0]) { return; }
+  if (top[0]->diff() == bottom[0]->diff()) {
+    Dtype* bottom_diff = bottom[0]->mutable_gpu_diff();
+    for (int i = 1; i < top.size(); ++i) {
+      caffe_gpu_axpy(count_, Dtype(1.), top[i]->gpu_diff(), bottom_diff);
+    }
+    return;
+  }
   if (top.size() == 1) {
     caffe_copy(count_, top[0]->gpu_diff(), bottom[0]->mutable_gpu_diff());
     return;
@@ -4,18 +4,51 @@
 #include <vector>
 
 #include "caffe/layers/tanh_layer.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+namespace {
+
+template <typename Dtype>
+struct TanHForward {
+  TanHForward(const Dtype* bottom_data, Dtype* top_data)
+      : bottom_data(bottom_data), top_data(top_data) {}
+  void operator()(int begin, int end) const {
+    for (int i = begin; i < end; ++i) {
+      top_data[i] = tanh(bottom_data[i]);
+    }
+  }
+  const Dtype* const bottom_data;
+  Dtype* const top_data;
+};
+
+template <typename Dtype>
+struct TanHBackward {
+  TanHBackward(const Dtype* top_data, const Dtype* top_diff,
+      Dtype* bottom_diff)
+      : top_data(top_data), top_diff(top_diff), bottom_diff(bottom_diff) {}
+  void operator()(int begin, int end) const {
+    for (int i = begin; i < end; ++i) {
+      const Dtype tanhx = top_data[i];
+      bottom_diff[i] = top_diff[i] * (1 - tanhx * tanhx);
+    }
+  }
+  const Dtype* const top_data;
+  const Dtype* const top_diff;
+  Dtype* const bottom_diff;
+};
+
+}  // namespace
+
 template <typename Dtype>
 void TanHLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   const int count = bottom[0]->count();
-  for (int i = 0; i < count; ++i) {
-    top_data[i] = tanh(bottom_data[i]);
-  }
+  parallel_for(count, TanHForward<Dtype>(bottom_data, top_data),
+      kElementwiseGrain);
 }
 
 template <typename Dtype>
@@ -27,11 +60,8 @@ void TanHLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const Dtype* top_diff = top[0]->cpu_diff();
     Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
     const int count = bottom[0]->count();
-    Dtype tanhx;
-    for (int i = 0; i < count; ++i) {
-      tanhx = top_data[i];
-      bottom_diff[i] = top_diff[i] * (1 - tanhx * tanhx);
-    }
+    parallel_for(count, TanHBackward<Dtype>(top_data, top_diff, bottom_diff),
+        kElementwiseGrain);
   }
 }
 
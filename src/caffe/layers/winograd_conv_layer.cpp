@@ -0,0 +1,349 @@
+#include <algorithm>
+#include <vector>
+
+#include "caffe/layers/winograd_conv_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+namespace {
+
+// The transforms of F(m x m, 3 x 3) (Lavin & Gray, "Fast Algorithms for
+// Convolutional Neural Networks", 2015): filters g go to G g G^T, input tiles
+// d to B^T d B, and products p come back as A^T p A.
+template <int M> struct WinogradMatrices;
+
+template <> struct WinogradMatrices<2> {
+  static const int T = 4;
+  static const double BT[4][4];
+  static const double G[4][3];
+  static const double AT[2][4];
+};
+
+const double WinogradMatrices<2>::BT[4][4] = {
+  { 1,  0, -1,  0 },
+  { 0,  1,  1,  0 },
+  { 0, -1,  1,  0 },
+  { 0,  1,  0, -1 }
+};
+const double WinogradMatrices<2>::G[4][3] = {
+  { 1,    0,   0   },
+  { 0.5,  0.5, 0.5 },
+  { 0.5, -0.5, 0.5 },
+  { 0,    0,   1   }
+};
+const double WinogradMatrices<2>::AT[2][4] = {
+  { 1, 1,  1,  0 },
+  { 0, 1, -1, -1 }
+};
+
+template <> struct WinogradMatrices<4> {
+  static const int T = 6;
+  static const double BT[6][6];
+  static const double G[6][3];
+  static const double AT[4][6];
+};
+
+const double WinogradMatrices<4>::BT[6][6] = {
+  { 4,  0, -5,  0, 1, 0 },
+  { 0, -4, -4,  1, 1, 0 },
+  { 0,  4, -4, -1, 1, 0 },
+  { 0, -2, -1,  2, 1, 0 },
+  { 0,  2, -1, -2, 1, 0 },
+  { 0,  4,  0, -5, 0, 1 }
+};
+const double WinogradMatrices<4>::G[6][3] = {
+  {  1.0 / 4,        0,       0 },
+  { -1.0 / 6, -1.0 / 6, -1.0 / 6 },
+  { -1.0 / 6,  1.0 / 6, -1.0 / 6 },
+  {  1.0 / 24, 1.0 / 12, 1.0 / 6 },
+  {  1.0 / 24, -1.0 / 12, 1.0 / 6 },
+  {        0,        0,       1 }
+};
+const double WinogradMatrices<4>::AT[4][6] = {
+  { 1, 1,  1, 1,  1, 0 },
+  { 0, 1, -1, 2, -2, 0 },
+  { 0, 1,  1, 4,  4, 0 },
+  { 0, 1, -1, 8, -8, 1 }
+};
+
+// Transforms the 3x3 filter g, rotated by 180 degrees if flip is set, into
+// the T x T values u[0], u[stride], ...
+template <typename Dtype, int M>
+void winograd_filter_transform(const Dtype* g, bool flip, int stride,
+    Dtype* u) {
+  typedef WinogradMatrices<M> W;
+  const int T = W::T;
+  Dtype f[3][3];
+  for (int a = 0; a < 3; ++a) {
+    for (int b = 0; b < 3; ++b) {
+      f[a][b] = flip ? g[(2 - a) * 3 + 2 - b] : g[a * 3 + b];
+    }
+  }
+  Dtype tmp[T][3];
+  for (int i = 0; i < T; ++i) {
+    for (int b = 0; b < 3; ++b) {
+      tmp[i][b] = W::G[i][0] * f[0][b] + W::G[i][1] * f[1][b] +
+          W::G[i][2] * f[2][b];
+    }
+  }
+  for (int i = 0; i < T; ++i) {
+    for (int j = 0; j < T; ++j) {
+      u[(i * T + j) * stride] = tmp[i][0] * W::G[j][0] +
+          tmp[i][1] * W::G[j][1] + tmp[i][2] * W::G[j][2];
+    }
+  }
+}
+
+template <typename Dtype, int M>
+void winograd_convolve(const Dtype* input, int channels, int height,
+    int width, int pad_h, int pad_w, const Dtype* filters, int num_output,
+    int group, int output_h, int output_w, Dtype* buffer, Dtype* output) {
+  typedef WinogradMatrices<M> W;
+  const int T = W::T;
+  const int tiles_w = (output_w + M - 1) / M;
+  const int tiles = (output_h + M - 1) / M * tiles_w;
+  // Transform the input tiles into T^2 matrices of channels x tiles.
+  Dtype* transformed_input = buffer;
+  for (int c = 0; c < channels; ++c) {
+    const Dtype* image = input + c * height * width;
+    for (int tile = 0; tile < tiles; ++tile) {
+      const int h0 = tile / tiles_w * M - pad_h;
+      const int w0 = tile % tiles_w * M - pad_w;
+      Dtype d[T][T];
+      for (int a = 0; a < T; ++a) {
+        for (int b = 0; b < T; ++b) {
+          const int h = h0 + a;
+          const int w = w0 + b;
+          d[a][b] = (h >= 0 && h < height && w >= 0 && w < width) ?
+              image[h * width + w] : 0;
+        }
+      }
+      Dtype tmp[T][T];
+      for (int i = 0; i < T; ++i) {
+        for (int b = 0; b < T; ++b) {
+          Dtype sum = 0;
+          for (int a = 0; a < T; ++a) {
+            sum += W::BT[i][a] * d[a][b];
+          }
+          tmp[i][b] = sum;
+        }
+      }
+      Dtype* v = transformed_input + c * tiles + tile;
+      for (int i = 0; i < T; ++i) {
+        for (int j = 0; j < T; ++j) {
+          Dtype sum = 0;
+          for (int b = 0; b < T; ++b) {
+            sum += tmp[i][b] * W::BT[j][b];
+          }
+          v[(i * T + j) * channels * tiles] = sum;
+        }
+      }
+    }
+  }
+  // Reduce over the input channels of each group, one GEMM per position of
+  // the transformed tiles.
+  Dtype* products = buffer + T * T * channels * tiles;
+  const int group_channels = channels / group;
+  const int group_output = num_output / group;
+  for (int xi = 0; xi < T * T; ++xi) {
+    for (int g = 0; g < group; ++g) {
+      caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, group_output, tiles,
+          group_channels, (Dtype)1.,
+          filters + (xi * num_output + g * group_output) * group_channels,
+          transformed_input + (xi * channels + g * group_channels) * tiles,
+          (Dtype)0., products + (xi * num_output + g * group_output) * tiles);
+    }
+  }
+  // Transform the products back into output tiles.
+  for (int k = 0; k < num_output; ++k) {
+    Dtype* output_map = output + k * output_h * output_w;
+    for (int tile = 0; tile < tiles; ++tile) {
+      const Dtype* p = products + k * tiles + tile;
+      Dtype tmp[M][T];
+      for (int i = 0; i < M; ++i) {
+        for (int b = 0; b < T; ++b) {
+          Dtype sum = 0;
+          for (int a = 0; a < T; ++a) {
+            sum += W::AT[i][a] * p[(a * T + b) * num_output * tiles];
+          }
+          tmp[i][b] = sum;
+        }
+      }
+      const int h0 = tile / tiles_w * M;
+      const int w0 = tile % tiles_w * M;
+      for (int i = 0; i < M && h0 + i < output_h; ++i) {
+        for (int j = 0; j < M && w0 + j < output_w; ++j) {
+          Dtype sum = 0;
+          for (int b = 0; b < T; ++b) {
+            sum += tmp[i][b] * W::AT[j][b];
+          }
+          output_map[(h0 + i) * output_w + w0 + j] = sum;
+        }
+      }
+    }
+  }
+}
+
+}  // namespace
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::LayerSetUp(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  ConvolutionLayer<Dtype>::LayerSetUp(bottom, top);
+  use_winograd_ = this->num_spatial_axes_ == 2;
+  for (int i = 0; i < this->num_spatial_axes_; ++i) {
+    use_winograd_ &= this->kernel_shape_.cpu_data()[i] == 3 &&
+        this->stride_.cpu_data()[i] == 1 && this->dilation_.cpu_data()[i] == 1;
+  }
+  if (!use_winograd_) {
+    LOG(INFO) << "Layer " << this->layer_param_.name() << ": Winograd "
+        << "convolution needs 2D 3x3 filters with stride 1 and no dilation; "
+        << "falling back to the default CPU implementation.";
+  }
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::Reshape(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  ConvolutionLayer<Dtype>::Reshape(bottom, top);
+  if (!use_winograd_) { return; }
+  const int output_h = this->output_shape_[0];
+  const int output_w = this->output_shape_[1];
+  tile_ = (output_h >= 8 && output_w >= 8) ? 4 : 2;
+  // Room for the transformed tiles of the forward pass or of the bottom
+  // gradient, whichever has more, and their products with the filters.
+  const int tiles = std::max(
+      (output_h + tile_ - 1) / tile_ * ((output_w + tile_ - 1) / tile_),
+      (this->input_shape(1) + tile_ - 1) / tile_ *
+      ((this->input_shape(2) + tile_ - 1) / tile_));
+  const int positions = (tile_ + 2) * (tile_ + 2);
+  transform_buffer_.Reshape(vector<int>(1,
+      positions * (this->channels_ + this->num_output_) * tiles));
+  const size_t transform_buffer_size =
+      transform_buffer_.count() * sizeof(Dtype);
+  ConvWorkspace::Register(&transform_buffer_, transform_buffer_size);
+  ConvWorkspace::Get().Reserve(transform_buffer_size);
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::TransformFilters() {
+  const shared_ptr<SyncedMemory>& weights = this->blobs_[0]->data();
+  if (weights == filters_source_ && weights->version() == filters_version_
+      && tile_ == filters_tile_) {
+    return;
+  }
+  const int positions = (tile_ + 2) * (tile_ + 2);
+  const int group_channels = this->channels_ / this->group_;
+  const int group_output = this->num_output_ / this->group_;
+  vector<int> shape(3);
+  shape[0] = positions;
+  shape[1] = this->num_output_;
+  shape[2] = group_channels;
+  forward_filters_.Reshape(shape);
+  shape[1] = this->channels_;
+  shape[2] = group_output;
+  backward_filters_.Reshape(shape);
+  const Dtype* weight = this->blobs_[0]->cpu_data();
+  Dtype* forward = forward_filters_.mutable_cpu_data();
+  Dtype* backward = backward_filters_.mutable_cpu_data();
+  for (int k = 0; k < this->num_output_; ++k) {
+    const int g = k / group_output;
+    for (int c = 0; c < group_channels; ++c) {
+      const Dtype* filter = weight + (k * group_channels + c) * 9;
+      const int backward_offset = (g * group_channels + c) * group_output +
+          k % group_output;
+      if (tile_ == 2) {
+        winograd_filter_transform<Dtype, 2>(filter, false,
+            this->num_output_ * group_channels,
+            forward + k * group_channels + c);
+        winograd_filter_transform<Dtype, 2>(filter, true,
+            this->channels_ * group_output, backward + backward_offset);
+      } else {
+        winograd_filter_transform<Dtype, 4>(filter, false,
+            this->num_output_ * group_channels,
+            forward + k * group_channels + c);
+        winograd_filter_transform<Dtype, 4>(filter, true,
+            this->channels_ * group_output, backward + backward_offset);
+      }
+    }
+  }
+  filters_source_ = weights;
+  filters_version_ = weights->version();
+  filters_tile_ = tile_;
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::WinogradConvolve(const Dtype* input,
+    int channels, int height, int width, int pad_h, int pad_w,
+    const Dtype* filters, int num_output, int output_h, int output_w,
+    Dtype* output) {
+  transform_buffer_.ShareDataMemory(ConvWorkspace::Get().Reserve(
+      transform_buffer_.count() * sizeof(Dtype)));
+  Dtype* buffer = transform_buffer_.mutable_cpu_data();
+  if (tile_ == 2) {
+    winograd_convolve<Dtype, 2>(input, channels, height, width, pad_h, pad_w,
+        filters, num_output, this->group_, output_h, output_w, buffer,
+        output);
+  } else {
+    winograd_convolve<Dtype, 4>(input, channels, height, width, pad_h, pad_w,
+        filters, num_output, this->group_, output_h, output_w, buffer,
+        output);
+  }
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::Forward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  if (!use_winograd_) {
+    ConvolutionLayer<Dtype>::Forward_cpu(bottom, top);
+    return;
+  }
+  TransformFilters();
+  const Dtype* filters = forward_filters_.cpu_data();
+  const int* pad_data = this->pad_.cpu_data();
+  for (int i = 0; i < bottom.size(); ++i) {
+    const Dtype* bottom_data = bottom[i]->cpu_data();
+    Dtype* top_data = top[i]->mutable_cpu_data();
+    for (int n = 0; n < this->num_; ++n) {
+      WinogradConvolve(bottom_data + n * this->bottom_dim_, this->channels_,
+          this->input_shape(1), this->input_shape(2), pad_data[0],
+          pad_data[1], filters, this->num_output_, this->output_shape_[0],
+          this->output_shape_[1], top_data + n * this->top_dim_);
+      this->forward_cpu_bias_activation(top_data + n * this->top_dim_);
+    }
+  }
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::Backward_cpu(
+    const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
+    const vector<Blob<Dtype>*>& bottom) {
+  if (!use_winograd_) {
+    ConvolutionLayer<Dtype>::Backward_cpu(top, propagate_down, bottom);
+    return;
+  }
+  // The bias and filter gradients come from the im2col implementation.
+  ConvolutionLayer<Dtype>::Backward_cpu(top,
+      vector<bool>(bottom.size(), false), bottom);
+  // The bottom gradient is the convolution of the top gradient, padded by
+  // 2 - pad, with the flipped filters mapping outputs back to inputs.
+  const int* pad_data = this->pad_.cpu_data();
+  for (int i = 0; i < top.size(); ++i) {
+    if (!propagate_down[i]) { continue; }
+    TransformFilters();
+    const Dtype* filters = backward_filters_.cpu_data();
+    const Dtype* top_diff = top[i]->cpu_diff();
+    Dtype* bottom_diff = bottom[i]->mutable_cpu_diff();
+    for (int n = 0; n < this->num_; ++n) {
+      WinogradConvolve(top_diff + n * this->top_dim_, this->num_output_,
+          this->output_shape_[0], this->output_shape_[1], 2 - pad_data[0],
+          2 - pad_data[1], filters, this->channels_, this->input_shape(1),
+          this->input_shape(2), bottom_diff + n * this->bottom_dim_);
+    }
+  }
+}
+
+INSTANTIATE_CLASS(WinogradConvolutionLayer);
+
+}  // namespace caffe
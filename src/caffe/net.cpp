@@ -12,6 +12,10 @@
 #include "caffe/net.hpp"
 #include "caffe/parallel.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/blocked_layout.hpp"
+#include "caffe/util/conv_workspace.hpp"
+#include "caffe/util/fuse_activations.hpp"
+#include "caffe/util/fuse_elementwise.hpp"
 #include "caffe/util/hdf5.hpp"
 #include "caffe/util/insert_splits.hpp"
 #include "caffe/util/math_functions.hpp"
@@ -46,6 +50,32 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
   // the current NetState.
   NetParameter filtered_param;
   FilterNet(in_param, &filtered_param);
+  if (filtered_param.fuse_activations()) {
+    NetParameter fused_param;
+    const int fused = FuseActivations(filtered_param, &fused_param);
+    LOG_IF(INFO, Caffe::root_solver()) << "Fused " << fused
+        << " activation layers.";
+    filtered_param.CopyFrom(fused_param);
+  }
+  if (filtered_param.fuse_elementwise()) {
+    NetParameter fused_param;
+    const int fused = FuseElementwiseChains(filtered_param, &fused_param);
+    LOG_IF(INFO, Caffe::root_solver()) << "Fused " << fused
+        << " elementwise layers into chains.";
+    filtered_param.CopyFrom(fused_param);
+  }
+  if (filtered_param.channel_block() > 0) {
+    if (phase_ == TEST) {
+      NetParameter blocked_param;
+      const int blocked = ConvertToBlockedLayout(filtered_param,
+          &blocked_param);
+      LOG_IF(INFO, Caffe::root_solver()) << "Converted " << blocked
+          << " layers to the channel-blocked layout.";
+      filtered_param.CopyFrom(blocked_param);
+    } else {
+      LOG(WARNING) << "channel_block only applies to the TEST phase.";
+    }
+  }
   LOG_IF(INFO, Caffe::root_solver())
       << "Initializing net from parameters: " << std::endl
       << filtered_param.DebugString();
@@ -279,7 +309,73 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
     layer_names_index_[layer_names_[layer_id]] = layer_id;
   }
   ShareWeights();
+  // Let intermediate blobs share memory, if requested and safe to do so.
+  share_activations_ = false;
+  const int layer_threads = param.layer_threads();
+  CHECK_GE(layer_threads, 1) << "layer_threads must be positive.";
+  if (param.share_activations() && layer_threads > 1) {
+    LOG(WARNING) << "Ignoring share_activations for net " << name_
+        << ": the layers of nets with layer_threads > 1 may run in any order "
+        << "the dependencies allow.";
+  } else if (param.share_activations()) {
+    bool need_backward = false;
+    for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+      need_backward |= layer_need_backward_[layer_id];
+    }
+    if (phase_ != TEST || need_backward) {
+      LOG(WARNING) << "Ignoring share_activations for net " << name_
+          << ": only TEST phase nets without backward computation may share "
+          << "activation memory.";
+    } else {
+      share_activations_ = true;
+    }
+  }
+  share_blob_views_ = param.share_blob_views();
+  if (share_activations_ || share_blob_views_) {
+    blob_memory_pinned_.assign(blobs_.size(), false);
+    for (int i = 0; i < net_input_blob_indices_.size(); ++i) {
+      blob_memory_pinned_[net_input_blob_indices_[i]] = true;
+    }
+    for (int i = 0; i < net_output_blob_indices_.size(); ++i) {
+      blob_memory_pinned_[net_output_blob_indices_[i]] = true;
+    }
+    // Data layers may fill their tops once or point them at their own
+    // memory, so never hand those tops to anyone else.
+    for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+      if (bottom_id_vecs_[layer_id].size() > 0) { continue; }
+      for (int top_id = 0; top_id < top_id_vecs_[layer_id].size();
+           ++top_id) {
+        blob_memory_pinned_[top_id_vecs_[layer_id][top_id]] = true;
+      }
+    }
+    for (int i = 0; i < param.keep_blob_size(); ++i) {
+      const string& blob_name = param.keep_blob(i);
+      CHECK(has_blob(blob_name)) << "Unknown keep_blob '" << blob_name
+          << "' in net " << name_;
+      blob_memory_pinned_[blob_names_index_[blob_name]] = true;
+    }
+  }
+  if (share_blob_views_) {
+    FindBlobViews();
+  }
+  if (share_activations_) {
+    PlanActivationMemory();
+  }
+  if (share_blob_views_) {
+    ShareBlobViews();
+  }
+  if (layer_threads > 1) {
+    BuildLayerDependencies();
+    scheduler_.reset(new LayerScheduler(layer_threads));
+    layer_losses_.resize(layers_.size());
+  }
   debug_info_ = param.debug_info();
+  if (ConvWorkspace::requested_bytes() > 0) {
+    LOG_IF(INFO, Caffe::root_solver())
+        << "Convolution column buffers use " << ConvWorkspace::allocated_bytes()
+        << " bytes of shared workspace instead of "
+        << ConvWorkspace::requested_bytes();
+  }
   LOG_IF(INFO, Caffe::root_solver()) << "Network initialization done.";
 }
 
@@ -561,6 +657,366 @@ void Net<Dtype>::AppendParam(const NetParameter& param, const int layer_id,
   }
 }
 
+template <typename Dtype>
+void Net<Dtype>::GroupSharedBlobs(vector<int>* owner) const {
+  owner->resize(blobs_.size());
+  for (int blob_id = 0; blob_id < blobs_.size(); ++blob_id) {
+    (*owner)[blob_id] = blob_id;
+  }
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    if (!layers_[layer_id]->TopsShareBottomData()) { continue; }
+    const int bottom_owner = (*owner)[bottom_id_vecs_[layer_id][0]];
+    for (int top_id = 0; top_id < top_id_vecs_[layer_id].size(); ++top_id) {
+      (*owner)[top_id_vecs_[layer_id][top_id]] = bottom_owner;
+    }
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::FindBlobViews() {
+  const int num_blobs = blobs_.size();
+  const int num_layers = layers_.size();
+  for (int blob_id = 0; blob_id < blob_view_parents_.size(); ++blob_id) {
+    if (blob_view_parents_[blob_id] >= 0) {
+      blobs_[blob_id]->UnshareMemory();
+    }
+  }
+  blob_view_parents_.assign(num_blobs, -1);
+  blob_view_offsets_.assign(num_blobs, 0);
+  blob_diff_views_.assign(num_blobs, false);
+  // A view stands for its whole group of blobs sharing data, through the
+  // first blob of the group, and must not be read or written where its
+  // parent may be written. Find the last layers reading and writing each
+  // group; the tops of layers sharing their bottom's data are not written.
+  vector<int> owner;
+  GroupSharedBlobs(&owner);
+  vector<bool> pinned(num_blobs, false);
+  vector<int> last_read(num_blobs, -1);
+  vector<int> last_write(num_blobs, -1);
+  for (int blob_id = 0; blob_id < num_blobs; ++blob_id) {
+    if (blob_memory_pinned_[blob_id]) { pinned[owner[blob_id]] = true; }
+  }
+  for (int layer_id = 0; layer_id < num_layers; ++layer_id) {
+    for (int i = 0; i < bottom_id_vecs_[layer_id].size(); ++i) {
+      last_read[owner[bottom_id_vecs_[layer_id][i]]] = layer_id;
+    }
+    if (layers_[layer_id]->TopsShareBottomData()) { continue; }
+    for (int i = 0; i < top_id_vecs_[layer_id].size(); ++i) {
+      last_write[owner[top_id_vecs_[layer_id][i]]] = layer_id;
+    }
+  }
+  // Walk the layers backwards, so that a concatenation becomes a view of an
+  // enclosing one before its own parts become views of it.
+  for (int layer_id = num_layers - 1; layer_id >= 0; --layer_id) {
+    const vector<int>& bottom_ids = bottom_id_vecs_[layer_id];
+    const vector<int>& top_ids = top_id_vecs_[layer_id];
+    // The parts of a concatenation that are not used after it are written
+    // in place by the layers computing them.
+    for (int i = 0; i < bottom_ids.size(); ++i) {
+      const int offset = layers_[layer_id]->BottomOffsetInTop(i);
+      const int group = owner[bottom_ids[i]];
+      if (offset < 0 || pinned[group] || last_read[group] > layer_id ||
+          last_write[group] > layer_id) {
+        continue;
+      }
+      if (AddBlobView(group, top_ids[0], offset)) {
+        blob_diff_views_[group] = group == bottom_ids[i];
+      }
+    }
+    // The parts of a slice are read in place, as long as neither they nor
+    // the sliced blob are written after it.
+    for (int i = 0; i < top_ids.size(); ++i) {
+      const int offset = layers_[layer_id]->TopOffsetInBottom(i);
+      const int group = owner[bottom_ids[0]];
+      if (offset < 0 || pinned[top_ids[i]] || last_write[group] > layer_id ||
+          last_write[top_ids[i]] > layer_id) {
+        continue;
+      }
+      if (AddBlobView(top_ids[i], group, offset)) {
+        blob_diff_views_[top_ids[i]] = group == bottom_ids[0];
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+bool Net<Dtype>::AddBlobView(int blob_id, int parent_id, int offset) {
+  if (blob_view_parents_[blob_id] >= 0) { return false; }
+  for (int ancestor = parent_id; ancestor >= 0;
+       ancestor = blob_view_parents_[ancestor]) {
+    if (ancestor == blob_id) { return false; }
+  }
+  blob_view_parents_[blob_id] = parent_id;
+  blob_view_offsets_[blob_id] = offset;
+  return true;
+}
+
+template <typename Dtype>
+void Net<Dtype>::ShareBlobViews() {
+  const int num_blobs = blobs_.size();
+  const int num_layers = layers_.size();
+  // Set up the views of each parent after the parent's own view, if any, so
+  // that they refer to its final memory.
+  vector<bool> shared(num_blobs, false);
+  int num_views = 0;
+  for (bool changed = true; changed; ) {
+    changed = false;
+    for (int blob_id = 0; blob_id < num_blobs; ++blob_id) {
+      const int parent = blob_view_parents_[blob_id];
+      if (parent < 0 || shared[blob_id] ||
+          (blob_view_parents_[parent] >= 0 && !shared[parent])) {
+        continue;
+      }
+      const int offset = blob_view_offsets_[blob_id];
+      blobs_[blob_id]->ShareDataView(*blobs_[parent], offset);
+      if (blob_diff_views_[blob_id]) {
+        blobs_[blob_id]->ShareDiffView(*blobs_[parent], offset);
+      }
+      shared[blob_id] = true;
+      changed = true;
+      ++num_views;
+    }
+  }
+  // The first top of a Split layer holds the diff of its bottom if the
+  // layers reading it all write its diff in Backward, so that the layer only
+  // adds the diffs of the other tops to it.
+  int num_split_diffs = 0;
+  for (int layer_id = 0; layer_id < num_layers; ++layer_id) {
+    if (layers_[layer_id]->layer_param().type() != "Split" ||
+        !layer_need_backward_[layer_id]) {
+      continue;
+    }
+    const int bottom_id = bottom_id_vecs_[layer_id][0];
+    const int top_id = top_id_vecs_[layer_id][0];
+    bool all_write = true;
+    int num_readers = 0;
+    for (int j = layer_id + 1; j < num_layers; ++j) {
+      for (int k = 0; k < bottom_id_vecs_[j].size(); ++k) {
+        if (bottom_id_vecs_[j][k] != top_id) { continue; }
+        ++num_readers;
+        all_write &= bottom_need_backward_[j][k];
+      }
+      for (int k = 0; k < top_id_vecs_[j].size(); ++k) {
+        all_write &= top_id_vecs_[j][k] != bottom_id;
+      }
+    }
+    if (num_readers > 0 && all_write) {
+      blobs_[top_id]->ShareDiff(*blobs_[bottom_id]);
+      ++num_split_diffs;
+    }
+  }
+  LOG_IF(INFO, Caffe::root_solver())
+      << "Sharing " << num_views << " blobs as views of others, and the diffs "
+      << "of " << num_split_diffs << " Split layers with their first tops";
+}
+
+template <typename Dtype>
+void Net<Dtype>::PrepareBlobViews() {
+  // Writing a view then only changes the view itself (see SyncedMemory), and
+  // the parents are allocated here rather than by whichever thread gets
+  // there first.
+  for (int blob_id = 0; blob_id < blob_view_parents_.size(); ++blob_id) {
+    if (blob_view_parents_[blob_id] < 0) { continue; }
+    Blob<Dtype>* blob = blobs_[blob_id].get();
+    if (blob->data()->head() != SyncedMemory::HEAD_AT_CPU) {
+      blob->mutable_cpu_data();
+    }
+    if (blob_diff_views_[blob_id] &&
+        blob->diff()->head() != SyncedMemory::HEAD_AT_CPU) {
+      blob->mutable_cpu_diff();
+    }
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::PlanActivationMemory() {
+  const int num_blobs = blobs_.size();
+  const int num_layers = layers_.size();
+  // Tops that hold their bottom's data by reference (Split, Flatten, ...)
+  // form one buffer with that bottom, and so do views and their parents;
+  // plan each group by its first blob.
+  vector<int> owner;
+  GroupSharedBlobs(&owner);
+  for (int blob_id = 0; blob_id < blob_view_parents_.size(); ++blob_id) {
+    const int parent = blob_view_parents_[blob_id];
+    if (parent < 0) { continue; }
+    const int group = owner[blob_id];
+    for (int other = 0; other < num_blobs; ++other) {
+      if (owner[other] == group) { owner[other] = owner[parent]; }
+    }
+  }
+  // Find the layers that first define and last use each buffer, its size,
+  // and whether any blob in it must keep its own memory.
+  vector<int> first_use(num_blobs, num_layers);
+  vector<int> last_use(num_blobs, -1);
+  vector<size_t> size(num_blobs, 0);
+  vector<bool> pinned(num_blobs, false);
+  for (int blob_id = 0; blob_id < num_blobs; ++blob_id) {
+    const int group = owner[blob_id];
+    size[group] = std::max(size[group], blobs_[blob_id]->count() *
+        sizeof(Dtype));
+    if (blob_memory_pinned_[blob_id]) { pinned[group] = true; }
+  }
+  for (int layer_id = 0; layer_id < num_layers; ++layer_id) {
+    for (int i = 0; i < bottom_id_vecs_[layer_id].size(); ++i) {
+      const int group = owner[bottom_id_vecs_[layer_id][i]];
+      last_use[group] = std::max(last_use[group], layer_id);
+    }
+    for (int i = 0; i < top_id_vecs_[layer_id].size(); ++i) {
+      const int group = owner[top_id_vecs_[layer_id][i]];
+      first_use[group] = std::min(first_use[group], layer_id);
+      last_use[group] = std::max(last_use[group], layer_id);
+    }
+  }
+  // Walk the layers in order, giving each buffer defined by a layer the
+  // best-fitting buffer released by an earlier layer, and releasing the
+  // buffers whose last use is this layer afterwards.
+  vector<int> slot(num_blobs, -1);
+  vector<size_t> slot_size;
+  vector<int> free_slots;
+  size_t unshared_size = 0;
+  for (int layer_id = 0; layer_id < num_layers; ++layer_id) {
+    for (int i = 0; i < top_id_vecs_[layer_id].size(); ++i) {
+      const int group = owner[top_id_vecs_[layer_id][i]];
+      if (pinned[group] || size[group] == 0 || slot[group] >= 0 ||
+          first_use[group] != layer_id) {
+        continue;
+      }
+      unshared_size += size[group];
+      int best = -1;
+      for (int j = 0; j < free_slots.size(); ++j) {
+        const size_t candidate = slot_size[free_slots[j]];
+        if (best < 0) {
+          best = j;
+        } else if (candidate >= size[group]) {
+          const size_t best_size = slot_size[free_slots[best]];
+          if (best_size < size[group] || candidate < best_size) { best = j; }
+        } else if (candidate > slot_size[free_slots[best]]) {
+          best = j;
+        }
+      }
+      if (best < 0) {
+        slot[group] = slot_size.size();
+        slot_size.push_back(size[group]);
+      } else {
+        slot[group] = free_slots[best];
+        free_slots.erase(free_slots.begin() + best);
+        slot_size[slot[group]] = std::max(slot_size[slot[group]], size[group]);
+      }
+    }
+    for (int group = 0; group < num_blobs; ++group) {
+      if (slot[group] >= 0 && last_use[group] == layer_id) {
+        free_slots.push_back(slot[group]);
+      }
+    }
+  }
+  vector<shared_ptr<SyncedMemory> > buffers(slot_size.size());
+  size_t shared_size = 0;
+  for (int i = 0; i < slot_size.size(); ++i) {
+    buffers[i].reset(new SyncedMemory(slot_size[i]));
+    shared_size += slot_size[i];
+  }
+  int num_shared_blobs = 0;
+  for (int blob_id = 0; blob_id < num_blobs; ++blob_id) {
+    const int group_slot = slot[owner[blob_id]];
+    if (group_slot < 0) { continue; }
+    blobs_[blob_id]->ShareDataMemory(buffers[group_slot]);
+    ++num_shared_blobs;
+  }
+  LOG_IF(INFO, Caffe::root_solver())
+      << "Sharing " << num_shared_blobs << " activation blobs in "
+      << buffers.size() << " buffers: " << shared_size << " bytes instead of "
+      << unshared_size;
+}
+
+template <typename Dtype>
+void Net<Dtype>::BuildLayerDependencies() {
+  const int num_blobs = blobs_.size();
+  const int num_layers = layers_.size();
+  // Tops holding their bottom's data by reference are the same memory. Views
+  // (see FindBlobViews) are not: they are disjoint ranges of their parent,
+  // which nothing writes while they are in use, so the layers computing the
+  // parts of a concatenation still run concurrently.
+  vector<int> owner;
+  GroupSharedBlobs(&owner);
+  // Walk the layers in order, tracking the last writer of each memory and
+  // the readers since.
+  vector<int> writer(num_blobs, -1);
+  vector<vector<int> > readers(num_blobs);
+  vector<set<int> > dependencies(num_layers);
+  for (int layer_id = 0; layer_id < num_layers; ++layer_id) {
+    set<int>& depends = dependencies[layer_id];
+    for (int i = 0; i < bottom_id_vecs_[layer_id].size(); ++i) {
+      const int group = owner[bottom_id_vecs_[layer_id][i]];
+      if (writer[group] >= 0) { depends.insert(writer[group]); }
+    }
+    for (int i = 0; i < top_id_vecs_[layer_id].size(); ++i) {
+      const int group = owner[top_id_vecs_[layer_id][i]];
+      if (writer[group] >= 0) { depends.insert(writer[group]); }
+      depends.insert(readers[group].begin(), readers[group].end());
+    }
+    for (int i = 0; i < bottom_id_vecs_[layer_id].size(); ++i) {
+      readers[owner[bottom_id_vecs_[layer_id][i]]].push_back(layer_id);
+    }
+    for (int i = 0; i < top_id_vecs_[layer_id].size(); ++i) {
+      const int group = owner[top_id_vecs_[layer_id][i]];
+      writer[group] = layer_id;
+      readers[group].clear();
+    }
+    depends.erase(layer_id);
+  }
+  // Layers sharing a param accumulate into the same diff, so keep them in
+  // order.
+  vector<int> last_user(params_.size(), -1);
+  for (int param_id = 0; param_id < params_.size(); ++param_id) {
+    const int owner_id =
+        param_owners_[param_id] < 0 ? param_id : param_owners_[param_id];
+    const int layer_id = param_layer_indices_[param_id].first;
+    if (last_user[owner_id] >= 0 && last_user[owner_id] != layer_id) {
+      dependencies[layer_id].insert(last_user[owner_id]);
+    }
+    last_user[owner_id] = layer_id;
+  }
+  // Layers drawing random numbers run on the thread calling Forward, and
+  // in order, so that they draw what a sequential pass would.
+  layer_uses_rng_.assign(num_layers, false);
+  int last_rng_user = -1;
+  for (int layer_id = 0; layer_id < num_layers; ++layer_id) {
+    if (!layers_[layer_id]->UsesCaffeRNG()) { continue; }
+    layer_uses_rng_[layer_id] = true;
+    if (last_rng_user >= 0) {
+      dependencies[layer_id].insert(last_rng_user);
+    }
+    last_rng_user = layer_id;
+  }
+  layer_dependencies_.assign(num_layers, vector<int>());
+  backward_dependencies_.assign(num_layers, vector<int>());
+  for (int layer_id = 0; layer_id < num_layers; ++layer_id) {
+    layer_dependencies_[layer_id].assign(dependencies[layer_id].begin(),
+        dependencies[layer_id].end());
+    for (set<int>::const_iterator it = dependencies[layer_id].begin();
+         it != dependencies[layer_id].end(); ++it) {
+      backward_dependencies_[num_layers - 1 - *it].push_back(
+          num_layers - 1 - layer_id);
+    }
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::ForwardLayerTask(void* net, int layer_id) {
+  Net<Dtype>* self = static_cast<Net<Dtype>*>(net);
+  self->layer_losses_[layer_id] = self->layers_[layer_id]->Forward(
+      self->bottom_vecs_[layer_id], self->top_vecs_[layer_id]);
+}
+
+template <typename Dtype>
+void Net<Dtype>::BackwardLayerTask(void* net, int node) {
+  Net<Dtype>* self = static_cast<Net<Dtype>*>(net);
+  const int layer_id = self->layers_.size() - 1 - node;
+  self->layers_[layer_id]->Backward(self->top_vecs_[layer_id],
+      self->bottom_need_backward_[layer_id], self->bottom_vecs_[layer_id]);
+}
+
 template <typename Dtype>
 Dtype Net<Dtype>::ForwardFromTo(int start, int end) {
   CHECK_GE(start, 0);
@@ -571,6 +1027,23 @@ Dtype Net<Dtype>::ForwardFromTo(int start, int end) {
       InputDebugInfo(i);
     }
   }
+  if (scheduler_ && !debug_info_ && Caffe::mode() == Caffe::CPU) {
+    vector<bool> active(layers_.size(), false);
+    for (int i = start; i <= end; ++i) {
+      active[i] = true;
+      layer_losses_[i] = 0;
+    }
+    if (share_blob_views_) {
+      PrepareBlobViews();
+    }
+    scheduler_->Run(layer_dependencies_, active, layer_uses_rng_,
+        &ForwardLayerTask, this);
+    // Sum in order, as the sequential pass does.
+    for (int i = start; i <= end; ++i) {
+      loss += layer_losses_[i];
+    }
+    return loss;
+  }
   for (int i = start; i <= end; ++i) {
     // LOG(ERROR) << "Forwarding " << layer_names_[i];
     Dtype layer_loss = layers_[i]->Forward(bottom_vecs_[i], top_vecs_[i]);
@@ -635,6 +1108,19 @@ template <typename Dtype>
 void Net<Dtype>::BackwardFromTo(int start, int end) {
   CHECK_GE(end, 0);
   CHECK_LT(start, layers_.size());
+  if (scheduler_ && !debug_info_ && Caffe::mode() == Caffe::CPU) {
+    const int num_layers = layers_.size();
+    vector<bool> active(num_layers, false);
+    for (int i = start; i >= end; --i) {
+      active[num_layers - 1 - i] = layer_need_backward_[i];
+    }
+    if (share_blob_views_) {
+      PrepareBlobViews();
+    }
+    scheduler_->Run(backward_dependencies_, active, vector<bool>(),
+        &BackwardLayerTask, this);
+    return;
+  }
   for (int i = start; i >= end; --i) {
     if (layer_need_backward_[i]) {
       layers_[i]->Backward(
@@ -799,6 +1285,15 @@ void Net<Dtype>::Reshape() {
   for (int i = 0; i < layers_.size(); ++i) {
     layers_[i]->Reshape(bottom_vecs_[i], top_vecs_[i]);
   }
+  if (share_blob_views_) {
+    FindBlobViews();
+  }
+  if (share_activations_) {
+    PlanActivationMemory();
+  }
+  if (share_blob_views_) {
+    ShareBlobViews();
+  }
 }
 
 template <typename Dtype>
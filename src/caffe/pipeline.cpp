@@ -0,0 +1,507 @@
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>  // NOLINT(readability/streams)
+#include <limits>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "caffe/internal_thread.hpp"
+#include "caffe/pipeline.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/blocked_layout.hpp"
+#include "caffe/util/format.hpp"
+#include "caffe/util/fuse_activations.hpp"
+#include "caffe/util/fuse_elementwise.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+namespace {
+
+// The cores of each NUMA node with cores, or none if the topology is unknown.
+vector<vector<int> > NumaNodeCores() {
+  vector<vector<int> > nodes;
+#ifdef __linux__
+  for (int node = 0; ; ++node) {
+    const string path = "/sys/devices/system/node/node" + format_int(node) +
+        "/cpulist";
+    std::ifstream file(path.c_str());
+    if (!file) { break; }
+    // A list of ranges such as 0-7,16-23.
+    vector<int> cores;
+    string range;
+    while (std::getline(file, range, ',')) {
+      int first, last;
+      const int fields = sscanf(range.c_str(), "%d-%d", &first, &last);
+      if (fields < 1) { continue; }
+      if (fields == 1) { last = first; }
+      for (int core = first; core <= last; ++core) {
+        cores.push_back(core);
+      }
+    }
+    if (cores.size() > 0) { nodes.push_back(cores); }
+  }
+#endif
+  return nodes;
+}
+
+BlobShape ToBlobShape(const vector<int>& shape) {
+  BlobShape blob_shape;
+  for (int i = 0; i < shape.size(); ++i) {
+    blob_shape.add_dim(shape[i]);
+  }
+  return blob_shape;
+}
+
+}  // namespace
+
+template <typename Dtype>
+class Pipeline<Dtype>::Stage : public InternalThread {
+ public:
+  Stage(Pipeline* pipeline, int id, const vector<int>& cores, int threads)
+      : pipeline_(pipeline), id_(id), cores_(cores), threads_(threads) {}
+  virtual ~Stage() { StopInternalThread(); }
+
+ protected:
+  virtual void InternalThreadEntry();
+
+ private:
+  void Build();
+  // Fills the net inputs for the next micro-batch and returns its index.
+  int Receive();
+  // Hands the results of micro-batch index to the next stage.
+  void Send(int index);
+
+  Pipeline* const pipeline_;
+  const int id_;
+  const vector<int> cores_;
+  const int threads_;
+  shared_ptr<Net<Dtype> > net_;
+};
+
+template <typename Dtype>
+void Pipeline<Dtype>::Stage::InternalThreadEntry() {
+#ifdef __linux__
+  if (cores_.size() > 0) {
+    // The stage runs on the first of its cores, the workers of its pool on
+    // the others.
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cores_[0], &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  }
+#endif
+  // The loops of the layers run on a pool of the stage's own, rather than
+  // waiting for the process-wide pool or running on the cores of others.
+  shared_ptr<WorkerPool> pool(cores_.size() > 0 ? new WorkerPool(cores_) :
+      new WorkerPool(threads_));
+  SetParallelForPool(pool.get());
+  Build();
+  pipeline_->done_.push(-1);
+  try {
+    while (!must_stop()) {
+      const int index = Receive();
+      net_->ForwardPrefilled();
+      Send(index);
+    }
+  } catch (boost::thread_interrupted&) {
+    // Interrupted exception is expected on shutdown
+  }
+  SetParallelForPool(NULL);
+}
+
+template <typename Dtype>
+void Pipeline<Dtype>::Stage::Build() {
+  const Pipeline& pipeline = *pipeline_;
+  const NetParameter& net_param = pipeline.net_param_;
+  NetParameter param;
+  param.set_name(net_param.name() + "_stage" + format_int(id_));
+  param.mutable_state()->CopyFrom(net_param.state());
+  for (int i = 0; i < pipeline.stage_inputs_[id_].size(); ++i) {
+    param.add_input(pipeline.stage_inputs_[id_][i]);
+    param.add_input_shape()->CopyFrom(pipeline.stage_input_shapes_[id_][i]);
+  }
+  const int end = id_ + 1 < pipeline.stage_starts_.size() ?
+      pipeline.stage_starts_[id_ + 1] : net_param.layer_size();
+  for (int i = pipeline.stage_starts_[id_]; i < end; ++i) {
+    param.add_layer()->CopyFrom(net_param.layer(i));
+  }
+  net_.reset(new Net<Dtype>(param));
+  net_->CopyTrainedLayersFrom(pipeline.weights_);
+}
+
+template <typename Dtype>
+int Pipeline<Dtype>::Stage::Receive() {
+  const vector<Blob<Dtype>*>& inputs = net_->input_blobs();
+  if (id_ == 0) {
+    const int index = pipeline_->jobs_.pop();
+    if (pipeline_->inputs_) {
+      for (int i = 0; i < inputs.size(); ++i) {
+        const Blob<Dtype>& source = *(*pipeline_->inputs_)[i];
+        vector<int> shape = source.shape();
+        shape[0] = pipeline_->micro_batch_;
+        inputs[i]->Reshape(shape);
+        caffe_copy(inputs[i]->count(),
+            source.cpu_data() + index * inputs[i]->count(),
+            inputs[i]->mutable_cpu_data());
+      }
+    }
+    return index;
+  }
+  PipelineBatch<Dtype>* batch = pipeline_->full_[id_ - 1]->pop();
+  for (int i = 0; i < inputs.size(); ++i) {
+    const Blob<Dtype>& source = *batch->blobs_[i];
+    inputs[i]->ReshapeLike(source);
+    caffe_copy(source.count(), source.cpu_data(),
+        inputs[i]->mutable_cpu_data());
+  }
+  const int index = batch->index_;
+  pipeline_->free_[id_ - 1]->push(batch);
+  return index;
+}
+
+template <typename Dtype>
+void Pipeline<Dtype>::Stage::Send(int index) {
+  Pipeline& pipeline = *pipeline_;
+  if (id_ + 1 < pipeline.stage_starts_.size()) {
+    PipelineBatch<Dtype>* batch = pipeline.free_[id_]->pop();
+    batch->index_ = index;
+    for (int i = 0; i < batch->blobs_.size(); ++i) {
+      const Blob<Dtype>& source =
+          *net_->blob_by_name(pipeline.stage_inputs_[id_ + 1][i]);
+      batch->blobs_[i]->ReshapeLike(source);
+      caffe_copy(source.count(), source.cpu_data(),
+          batch->blobs_[i]->mutable_cpu_data());
+    }
+    pipeline.full_[id_]->push(batch);
+    return;
+  }
+  // The micro-batches arrive in order, the first one shaping the outputs.
+  for (int i = 0; i < pipeline.output_names_.size(); ++i) {
+    const Blob<Dtype>& source = *net_->blob_by_name(pipeline.output_names_[i]);
+    Blob<Dtype>* output = pipeline.output_blobs_[i].get();
+    if (pipeline.concat_outputs_[i]) {
+      if (index == 0) {
+        vector<int> shape = source.shape();
+        shape[0] *= pipeline.micro_batches_;
+        output->Reshape(shape);
+      }
+      caffe_copy(source.count(), source.cpu_data(),
+          output->mutable_cpu_data() + index * source.count());
+    } else {
+      if (index == 0) {
+        output->ReshapeLike(source);
+        caffe_set(output->count(), Dtype(0), output->mutable_cpu_data());
+      }
+      caffe_axpy(source.count(), Dtype(1), source.cpu_data(),
+          output->mutable_cpu_data());
+    }
+  }
+  pipeline.done_.push(index);
+}
+
+template <typename Dtype>
+Pipeline<Dtype>::Pipeline(const NetParameter& param,
+    const Net<Dtype>& trained, const PipelineParameter& pipeline_param)
+    : pipeline_param_(pipeline_param), micro_batch_(0), inputs_(NULL),
+      micro_batches_(0) {
+  CHECK(Caffe::mode() == Caffe::CPU) << "Pipelines run in CPU mode.";
+  CHECK_GE(pipeline_param_.stages(), 1);
+  CHECK_GE(pipeline_param_.queue_depth(), 1);
+  NetParameter test_param(param);
+  test_param.mutable_state()->set_phase(TEST);
+  Net<Dtype>::FilterNet(test_param, &net_param_);
+  // Fuse once here, so that the stages split the layers the nets run.
+  if (net_param_.fuse_activations()) {
+    NetParameter fused_param;
+    FuseActivations(net_param_, &fused_param);
+    net_param_.CopyFrom(fused_param);
+    net_param_.clear_fuse_activations();
+  }
+  if (net_param_.fuse_elementwise()) {
+    NetParameter fused_param;
+    FuseElementwiseChains(net_param_, &fused_param);
+    net_param_.CopyFrom(fused_param);
+    net_param_.clear_fuse_elementwise();
+  }
+  if (net_param_.channel_block() > 0) {
+    NetParameter blocked_param;
+    ConvertToBlockedLayout(net_param_, &blocked_param);
+    net_param_.CopyFrom(blocked_param);
+    net_param_.clear_channel_block();
+  }
+  trained.ToProto(&weights_, false);
+
+  // Each stage runs the loops of its layers on a pool of its own. Pinned
+  // stages split the cores of their node with the other stages on it, up to
+  // Caffe::cpu_threads() each, and the others split Caffe::cpu_threads().
+  const int num_stages = pipeline_param_.stages();
+  const vector<vector<int> > nodes = pipeline_param_.pin_stages() ?
+      NumaNodeCores() : vector<vector<int> >();
+  for (int stage_id = 0; stage_id < num_stages; ++stage_id) {
+    if (nodes.size() == 0) {
+      stage_cores_.push_back(vector<int>());
+      stage_threads_.push_back(
+          std::max(1, Caffe::cpu_threads() / num_stages));
+      continue;
+    }
+    // Stages k, k + N, k + 2N... share node k of N.
+    const int num_nodes = nodes.size();
+    const vector<int>& node = nodes[stage_id % num_nodes];
+    const int node_stages =
+        (num_stages - stage_id % num_nodes + num_nodes - 1) / num_nodes;
+    const int node_cores = node.size();
+    const int index = stage_id / num_nodes;
+    int begin = node_cores * index / node_stages;
+    int end = node_cores * (index + 1) / node_stages;
+    if (begin == end) {
+      // More stages than cores on the node.
+      begin = index % node_cores;
+      end = begin + 1;
+    }
+    end = std::min(end, begin + Caffe::cpu_threads());
+    stage_cores_.push_back(vector<int>(node.begin() + begin,
+        node.begin() + end));
+    stage_threads_.push_back(end - begin);
+  }
+
+  // A whole copy of the net gives the shapes of the blobs for a micro-batch
+  // and the time of each layer.
+  Net<Dtype> profile_net(net_param_);
+  profile_net.CopyTrainedLayersFrom(weights_);
+  const vector<Blob<Dtype>*>& net_inputs = profile_net.input_blobs();
+  if (net_inputs.size() > 0) {
+    micro_batch_ = pipeline_param_.micro_batch() > 0 ?
+        pipeline_param_.micro_batch() : net_inputs[0]->shape(0);
+    for (int i = 0; i < net_inputs.size(); ++i) {
+      vector<int> shape = net_inputs[i]->shape();
+      shape[0] = micro_batch_;
+      net_inputs[i]->Reshape(shape);
+    }
+    profile_net.Reshape();
+  }
+  PlanStages(&profile_net);
+  for (int i = 0; i < profile_net.output_blob_indices().size(); ++i) {
+    const int blob_id = profile_net.output_blob_indices()[i];
+    const Blob<Dtype>& output = *profile_net.blobs()[blob_id];
+    output_names_.push_back(profile_net.blob_names()[blob_id]);
+    batch_outputs_.push_back(micro_batch_ > 0 && output.num_axes() > 0 &&
+        output.shape(0) == micro_batch_);
+    output_blobs_.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+    outputs_.push_back(output_blobs_.back().get());
+  }
+
+  // Each stage receives the blobs written before it and read in it or after
+  // it, or output by the net.
+  set<string> needed(output_names_.begin(), output_names_.end());
+  vector<set<string> > stage_needed(num_stages);
+  for (int layer_id = net_param_.layer_size() - 1, stage_id = num_stages - 1;
+       layer_id >= 0; --layer_id) {
+    const LayerParameter& layer_param = net_param_.layer(layer_id);
+    needed.insert(layer_param.bottom().begin(), layer_param.bottom().end());
+    if (layer_id == stage_starts_[stage_id]) {
+      stage_needed[stage_id--] = needed;
+    }
+  }
+  vector<string> written(net_param_.input().begin(), net_param_.input().end());
+  stage_inputs_.resize(num_stages);
+  stage_input_shapes_.resize(num_stages);
+  for (int stage_id = 0, layer_id = 0; stage_id < num_stages; ++stage_id) {
+    for (; layer_id < stage_starts_[stage_id]; ++layer_id) {
+      const LayerParameter& layer_param = net_param_.layer(layer_id);
+      for (int i = 0; i < layer_param.top_size(); ++i) {
+        if (std::find(written.begin(), written.end(), layer_param.top(i)) ==
+            written.end()) {
+          written.push_back(layer_param.top(i));
+        }
+      }
+    }
+    for (int i = 0; i < written.size(); ++i) {
+      if (stage_id > 0 && !stage_needed[stage_id].count(written[i])) {
+        continue;
+      }
+      stage_inputs_[stage_id].push_back(written[i]);
+      stage_input_shapes_[stage_id].push_back(
+          ToBlobShape(profile_net.blob_by_name(written[i])->shape()));
+    }
+    if (stage_id > 0) {
+      LOG(INFO) << "Pipeline stage " << stage_id << " receives "
+          << stage_inputs_[stage_id].size() << " blobs";
+    }
+  }
+
+  for (int stage_id = 0; stage_id + 1 < num_stages; ++stage_id) {
+    free_.push_back(shared_ptr<BlockingQueue<PipelineBatch<Dtype>*> >(
+        new BlockingQueue<PipelineBatch<Dtype>*>()));
+    full_.push_back(shared_ptr<BlockingQueue<PipelineBatch<Dtype>*> >(
+        new BlockingQueue<PipelineBatch<Dtype>*>()));
+    for (int i = 0; i < pipeline_param_.queue_depth(); ++i) {
+      shared_ptr<PipelineBatch<Dtype> > batch(new PipelineBatch<Dtype>());
+      for (int j = 0; j < stage_inputs_[stage_id + 1].size(); ++j) {
+        batch->blobs_.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+      }
+      batches_.push_back(batch);
+      free_.back()->push(batch.get());
+    }
+  }
+  for (int stage_id = 0; stage_id < num_stages; ++stage_id) {
+    stages_.push_back(shared_ptr<Stage>(new Stage(this, stage_id,
+        stage_cores_[stage_id], stage_threads_[stage_id])));
+    stages_.back()->StartInternalThread();
+  }
+  // Wait for the stages to build their nets.
+  for (int stage_id = 0; stage_id < num_stages; ++stage_id) {
+    done_.pop();
+  }
+}
+
+template <typename Dtype>
+Pipeline<Dtype>::~Pipeline() {
+  // Stop the stages before the queues they wait on go away.
+  for (int i = 0; i < stages_.size(); ++i) {
+    stages_[i]->StopInternalThread();
+  }
+}
+
+template <typename Dtype>
+void Pipeline<Dtype>::PlanStages(Net<Dtype>* profile_net) {
+  const int num_layers = net_param_.layer_size();
+  const int num_stages = pipeline_param_.stages();
+  CHECK_LE(num_stages, num_layers) << "A pipeline of " << num_stages
+      << " stages needs as many layers.";
+  map<string, int> layer_ids;
+  for (int i = 0; i < num_layers; ++i) {
+    layer_ids[net_param_.layer(i).name()] = i;
+  }
+  stage_starts_.assign(1, 0);
+  if (pipeline_param_.stage_start_size() > 0) {
+    CHECK_EQ(pipeline_param_.stage_start_size(), num_stages - 1)
+        << "Specify the first layer of each stage but the first.";
+    for (int i = 0; i < pipeline_param_.stage_start_size(); ++i) {
+      const string& name = pipeline_param_.stage_start(i);
+      CHECK(layer_ids.count(name)) << "Unknown stage_start layer " << name;
+      CHECK_GT(layer_ids[name], stage_starts_.back())
+          << "The stage_start layers must follow each other in the net.";
+      stage_starts_.push_back(layer_ids[name]);
+    }
+    return;
+  }
+  CHECK_GT(pipeline_param_.profile_iterations(), 0)
+      << "Without stage_start layers, the stages are chosen from layer times "
+      << "measured over profile_iterations > 0 passes.";
+  // Time the layers, after a first pass to warm up, on a pool of as many
+  // threads as the first stage's. The split layers the net inserts are not
+  // in net_param_, and cost next to nothing.
+  vector<double> times(num_layers, 0);
+  const vector<string>& layer_names = profile_net->layer_names();
+  WorkerPool pool(stage_threads_[0]);
+  SetParallelForPool(&pool);
+  Timer timer;
+  for (int iter = 0; iter <= pipeline_param_.profile_iterations(); ++iter) {
+    for (int i = 0; i < layer_names.size(); ++i) {
+      timer.Start();
+      profile_net->ForwardFromTo(i, i);
+      const double time = timer.MicroSeconds();
+      map<string, int>::const_iterator it = layer_ids.find(layer_names[i]);
+      if (iter > 0 && it != layer_ids.end()) {
+        times[it->second] += time;
+      }
+    }
+  }
+  SetParallelForPool(NULL);
+  vector<double> prefix(num_layers + 1, 0);
+  for (int i = 0; i < num_layers; ++i) {
+    prefix[i + 1] = prefix[i] + times[i];
+  }
+  // slowest[s][i] is the smallest time of the slowest stage when the first i
+  // layers make s + 1 stages, the last of them starting at layer start[s][i].
+  vector<vector<double> > slowest(num_stages, vector<double>(num_layers + 1,
+      std::numeric_limits<double>::max()));
+  vector<vector<int> > start(num_stages, vector<int>(num_layers + 1, 0));
+  for (int i = 1; i <= num_layers; ++i) {
+    slowest[0][i] = prefix[i];
+  }
+  for (int s = 1; s < num_stages; ++s) {
+    for (int i = s + 1; i <= num_layers; ++i) {
+      for (int j = s; j < i; ++j) {
+        const double time = std::max(slowest[s - 1][j], prefix[i] - prefix[j]);
+        if (time < slowest[s][i]) {
+          slowest[s][i] = time;
+          start[s][i] = j;
+        }
+      }
+    }
+  }
+  stage_starts_.resize(num_stages);
+  for (int s = num_stages - 1, i = num_layers; s > 0; --s) {
+    i = start[s][i];
+    stage_starts_[s] = i;
+  }
+  for (int s = 0; s < num_stages; ++s) {
+    const int end = s + 1 < num_stages ? stage_starts_[s + 1] : num_layers;
+    LOG(INFO) << "Pipeline stage " << s << ": layers "
+        << net_param_.layer(stage_starts_[s]).name() << " to "
+        << net_param_.layer(end - 1).name() << ", "
+        << (prefix[end] - prefix[stage_starts_[s]]) /
+           pipeline_param_.profile_iterations() / 1000 << " ms";
+  }
+}
+
+template <typename Dtype>
+void Pipeline<Dtype>::RunMicroBatches(int micro_batches) {
+  CHECK_GT(micro_batches, 0);
+  micro_batches_ = micro_batches;
+  for (int i = 0; i < micro_batches; ++i) {
+    jobs_.push(i);
+  }
+  for (int i = 0; i < micro_batches; ++i) {
+    done_.pop();
+  }
+  for (int i = 0; i < outputs_.size(); ++i) {
+    if (!concat_outputs_[i]) {
+      caffe_scal(outputs_[i]->count(), Dtype(1) / micro_batches,
+          outputs_[i]->mutable_cpu_data());
+    }
+  }
+}
+
+template <typename Dtype>
+const vector<Blob<Dtype>*>& Pipeline<Dtype>::Forward(
+    const vector<Blob<Dtype>*>& inputs) {
+  CHECK_GT(stage_inputs_[0].size(), 0)
+      << "Use Run for nets reading their own data.";
+  CHECK_EQ(inputs.size(), stage_inputs_[0].size()) << "Incorrect input size.";
+  const int batch_size = inputs[0]->shape(0);
+  CHECK_EQ(batch_size % micro_batch_, 0) << "The batch size " << batch_size
+      << " is not a multiple of the micro-batch " << micro_batch_;
+  for (int i = 1; i < inputs.size(); ++i) {
+    CHECK_EQ(inputs[i]->shape(0), batch_size);
+  }
+  inputs_ = &inputs;
+  concat_outputs_ = batch_outputs_;
+  RunMicroBatches(batch_size / micro_batch_);
+  inputs_ = NULL;
+  return outputs_;
+}
+
+template <typename Dtype>
+const vector<Blob<Dtype>*>& Pipeline<Dtype>::Run(int micro_batches) {
+  CHECK_EQ(stage_inputs_[0].size(), 0)
+      << "Use Forward for nets with inputs.";
+  concat_outputs_.assign(outputs_.size(), false);
+  RunMicroBatches(micro_batches);
+  return outputs_;
+}
+
+INSTANTIATE_CLASS(Pipeline);
+
+}  // namespace caffe
@@ -3,6 +3,7 @@
 #include <string>
 #include <vector>
 
+#include "caffe/layers/base_data_layer.hpp"
 #include "caffe/solver.hpp"
 #include "caffe/util/format.hpp"
 #include "caffe/util/hdf5.hpp"
@@ -255,6 +256,19 @@ void Solver<Dtype>::Step(int iters) {
               << result_vec[k] << loss_msg_stream.str();
         }
       }
+      // Whether the net waits for its data, or the data for the net.
+      for (int j = 0; j < net_->layers().size(); ++j) {
+        const BasePrefetchingDataLayer<Dtype>* data_layer =
+            dynamic_cast<const BasePrefetchingDataLayer<Dtype>*>(
+                net_->layers()[j].get());
+        if (!data_layer) { continue; }
+        LOG_IF(INFO, Caffe::root_solver()) << "    " << net_->layer_names()[j]
+            << " prefetch: waited " << data_layer->consumer_wait_ms()
+            << " ms for " << data_layer->prefetch_stalls() << " of "
+            << data_layer->prefetch_batches() << " batches, loader idle "
+            << data_layer->producer_wait_ms() << " ms, depth "
+            << data_layer->prefetch_depth();
+      }
     }
     for (int i = 0; i < callbacks_.size(); ++i) {
       callbacks_[i]->on_gradients_ready();
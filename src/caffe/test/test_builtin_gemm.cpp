@@ -0,0 +1,133 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/builtin_gemm.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class BuiltinGemmTest : public ::testing::Test {
+ protected:
+  BuiltinGemmTest() : threads_(Caffe::cpu_threads()) {}
+  virtual void SetUp() { Caffe::set_cpu_threads(4); }
+  virtual void TearDown() { Caffe::set_cpu_threads(threads_); }
+
+  void Fill(int count, vector<Dtype>* data) {
+    data->resize(count);
+    caffe_rng_uniform<Dtype>(count, -1, 1, &(*data)[0]);
+  }
+
+  // Checks caffe_builtin_gemm against the plain triple loop, with C in a
+  // matrix of ldc = N + 3 columns whose extra columns must be left alone.
+  void TestGemm(CBLAS_TRANSPOSE trans_a, CBLAS_TRANSPOSE trans_b, int M,
+      int N, int K, Dtype alpha, Dtype beta) {
+    const int lda = (trans_a == CblasNoTrans ? K : M) + 1;
+    const int ldb = (trans_b == CblasNoTrans ? N : K) + 2;
+    const int ldc = N + 3;
+    vector<Dtype> A, B, C;
+    Fill((trans_a == CblasNoTrans ? M : K) * lda, &A);
+    Fill((trans_b == CblasNoTrans ? K : N) * ldb, &B);
+    Fill(M * ldc, &C);
+    vector<Dtype> expected(C);
+    for (int i = 0; i < M; ++i) {
+      for (int j = 0; j < N; ++j) {
+        Dtype sum = 0;
+        for (int k = 0; k < K; ++k) {
+          const Dtype a = trans_a == CblasNoTrans ? A[i * lda + k] :
+              A[k * lda + i];
+          const Dtype b = trans_b == CblasNoTrans ? B[k * ldb + j] :
+              B[j * ldb + k];
+          sum += a * b;
+        }
+        expected[i * ldc + j] = alpha * sum + beta * C[i * ldc + j];
+      }
+    }
+    caffe_builtin_gemm<Dtype>(trans_a, trans_b, M, N, K, alpha, &A[0], lda,
+        &B[0], ldb, beta, &C[0], ldc);
+    for (int i = 0; i < M * ldc; ++i) {
+      EXPECT_NEAR(C[i], expected[i], 1e-4 * (K + 1));
+    }
+  }
+
+  void TestGemv(CBLAS_TRANSPOSE trans, int M, int N, Dtype alpha,
+      Dtype beta) {
+    const int x_size = trans == CblasNoTrans ? N : M;
+    const int y_size = trans == CblasNoTrans ? M : N;
+    vector<Dtype> A, x, y;
+    Fill(M * N, &A);
+    Fill(x_size, &x);
+    Fill(y_size, &y);
+    vector<Dtype> expected(y);
+    for (int i = 0; i < y_size; ++i) {
+      Dtype sum = 0;
+      for (int k = 0; k < x_size; ++k) {
+        sum += (trans == CblasNoTrans ? A[i * N + k] : A[k * N + i]) * x[k];
+      }
+      expected[i] = alpha * sum + beta * y[i];
+    }
+    caffe_builtin_gemv<Dtype>(trans, M, N, alpha, &A[0], &x[0], beta, &y[0]);
+    for (int i = 0; i < y_size; ++i) {
+      EXPECT_NEAR(y[i], expected[i], 1e-4 * (x_size + 1));
+    }
+  }
+
+  const int threads_;
+};
+
+TYPED_TEST_CASE(BuiltinGemmTest, TestDtypes);
+
+TYPED_TEST(BuiltinGemmTest, TestGemmSmall) {
+  // [1, 2, 3; 4 5 6] * [1, 2, 3, 4; 5, 6, 7, 8; 9, 10, 11, 12];
+  TypeParam A[6] = {1, 2, 3, 4, 5, 6};
+  TypeParam B[12] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+  TypeParam C[8];
+  TypeParam result[8] = {38, 44, 50, 56, 83, 98, 113, 128};
+  caffe_builtin_gemm<TypeParam>(CblasNoTrans, CblasNoTrans, 2, 4, 3, 1., A,
+      3, B, 4, 0., C, 4);
+  for (int i = 0; i < 8; ++i) {
+    EXPECT_EQ(C[i], result[i]);
+  }
+}
+
+TYPED_TEST(BuiltinGemmTest, TestGemmTransposes) {
+  const CBLAS_TRANSPOSE trans[2] = {CblasNoTrans, CblasTrans};
+  for (int a = 0; a < 2; ++a) {
+    for (int b = 0; b < 2; ++b) {
+      this->TestGemm(trans[a], trans[b], 7, 13, 5, 1, 0);
+      this->TestGemm(trans[a], trans[b], 19, 11, 23, 0.5, 2);
+    }
+  }
+}
+
+TYPED_TEST(BuiltinGemmTest, TestGemmBlocks) {
+  // More rows, columns and depth than one cache block of each, with partial
+  // register blocks at the edges.
+  this->TestGemm(CblasNoTrans, CblasNoTrans, 131, 37, 301, 1, 0);
+  this->TestGemm(CblasTrans, CblasNoTrans, 5, 4101, 3, 1, 1);
+  this->TestGemm(CblasNoTrans, CblasTrans, 130, 9, 520, -1, 0.5);
+}
+
+TYPED_TEST(BuiltinGemmTest, TestGemmBetaOnly) {
+  // C is set to 0 with beta = 0, even where it held NaN.
+  vector<TypeParam> C(6, NAN);
+  caffe_builtin_gemm<TypeParam>(CblasNoTrans, CblasNoTrans, 2, 3, 0, 1.,
+      NULL, 1, NULL, 3, 0., &C[0], 3);
+  for (int i = 0; i < 6; ++i) {
+    EXPECT_EQ(C[i], 0);
+  }
+  this->TestGemm(CblasNoTrans, CblasNoTrans, 3, 5, 4, 0, 3);
+}
+
+TYPED_TEST(BuiltinGemmTest, TestGemv) {
+  this->TestGemv(CblasNoTrans, 7, 13, 1, 0);
+  this->TestGemv(CblasTrans, 7, 13, 1, 0);
+  this->TestGemv(CblasNoTrans, 300, 4097, 0.5, 2);
+  this->TestGemv(CblasTrans, 4097, 300, -1, 0.5);
+}
+
+}  // namespace caffe
@@ -117,6 +117,24 @@ TYPED_TEST(DBTest, TestKeyValue) {
   EXPECT_FALSE(cursor->valid());
 }
 
+TYPED_TEST(DBTest, TestValueData) {
+  scoped_ptr<db::DB> db(db::GetDB(TypeParam::backend));
+  db->Open(this->source_, db::READ);
+  scoped_ptr<db::Cursor> cursor(db->NewCursor());
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_TRUE(cursor->valid());
+    const char* data;
+    size_t size;
+    cursor->value_data(&data, &size);
+    EXPECT_EQ(cursor->value(), string(data, size));
+    Datum datum;
+    EXPECT_TRUE(datum.ParseFromArray(data, size));
+    EXPECT_EQ(datum.label(), i);
+    cursor->Next();
+  }
+  EXPECT_FALSE(cursor->valid());
+}
+
 TYPED_TEST(DBTest, TestWrite) {
   scoped_ptr<db::DB> db(db::GetDB(TypeParam::backend));
   db->Open(this->source_, db::WRITE);
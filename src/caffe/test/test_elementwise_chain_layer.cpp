@@ -0,0 +1,151 @@
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layer_factory.hpp"
+#include "caffe/layers/elementwise_chain_layer.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+#include "caffe/test/test_gradient_check_util.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class ElementwiseChainLayerTest : public CPUDeviceTest<Dtype> {
+ protected:
+  ElementwiseChainLayerTest()
+      : blob_bottom_a_(new Blob<Dtype>(2, 3, 4, 5)),
+        blob_bottom_b_(new Blob<Dtype>(2, 3, 4, 5)),
+        blob_bottom_c_(new Blob<Dtype>(2, 3, 4, 5)),
+        blob_top_(new Blob<Dtype>()) {
+    Caffe::set_random_seed(1701);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_a_);
+    filler.Fill(this->blob_bottom_b_);
+    filler.Fill(this->blob_bottom_c_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+  virtual ~ElementwiseChainLayerTest() {
+    delete blob_bottom_a_;
+    delete blob_bottom_b_;
+    delete blob_bottom_c_;
+    delete blob_top_;
+  }
+
+  // Checks the chain against its layers run one after the other, and its
+  // gradient.
+  void CheckChain(const string& chain_proto, int num_bottoms) {
+    Blob<Dtype>* bottoms[] = { blob_bottom_a_, blob_bottom_b_,
+        blob_bottom_c_ };
+    blob_bottom_vec_.assign(bottoms, bottoms + num_bottoms);
+    LayerParameter layer_param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(chain_proto,
+        layer_param.mutable_elementwise_chain_param()));
+    ElementwiseChainLayer<Dtype> layer(layer_param);
+    layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    layer.Forward(blob_bottom_vec_, blob_top_vec_);
+    const ElementwiseChainParameter& chain_param =
+        layer_param.elementwise_chain_param();
+    vector<Blob<Dtype>*> bottom_vec(blob_bottom_vec_);
+    vector<shared_ptr<Blob<Dtype> > > tops;
+    for (int i = 0; i < chain_param.layer_size(); ++i) {
+      shared_ptr<Layer<Dtype> > step =
+          LayerRegistry<Dtype>::CreateLayer(chain_param.layer(i));
+      tops.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+      vector<Blob<Dtype>*> top_vec(1, tops.back().get());
+      step->SetUp(bottom_vec, top_vec);
+      step->Forward(bottom_vec, top_vec);
+      bottom_vec = top_vec;
+    }
+    const Blob<Dtype>& expected = *tops.back();
+    ASSERT_EQ(expected.count(), blob_top_->count());
+    for (int i = 0; i < expected.count(); ++i) {
+      EXPECT_NEAR(expected.cpu_data()[i], blob_top_->cpu_data()[i], 1e-5);
+    }
+    GradientChecker<Dtype> checker(1e-3, 1e-2, 1701, 0., 0.01);
+    checker.CheckGradientExhaustive(&layer, blob_bottom_vec_, blob_top_vec_);
+  }
+
+  Blob<Dtype>* const blob_bottom_a_;
+  Blob<Dtype>* const blob_bottom_b_;
+  Blob<Dtype>* const blob_bottom_c_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(ElementwiseChainLayerTest, TestDtypes);
+
+TYPED_TEST(ElementwiseChainLayerTest, TestNeuronChain) {
+  this->CheckChain(
+      "layer { type: 'ReLU' relu_param { negative_slope: 0.1 } } "
+      "layer { type: 'Power' "
+      "        power_param { power: 2 scale: 0.5 shift: 1 } } "
+      "layer { type: 'Log' log_param { shift: 1 } } "
+      "layer { type: 'TanH' } "
+      "layer { type: 'BNLL' } "
+      "layer { type: 'Sigmoid' } "
+      "layer { type: 'Exp' exp_param { base: 2 scale: 0.5 } } "
+      "layer { type: 'AbsVal' } ", 1);
+}
+
+TYPED_TEST(ElementwiseChainLayerTest, TestSumChain) {
+  this->CheckChain(
+      "layer { type: 'Eltwise' "
+      "        eltwise_param { operation: SUM coeff: 1 coeff: -0.5 "
+      "                        coeff: 2 } } "
+      "layer { type: 'Sigmoid' } "
+      "layer { type: 'Power' power_param { power: 3 scale: 2 } } ", 3);
+}
+
+TYPED_TEST(ElementwiseChainLayerTest, TestProdChain) {
+  this->CheckChain(
+      "layer { type: 'Eltwise' eltwise_param { operation: PROD } } "
+      "layer { type: 'TanH' } ", 3);
+}
+
+TYPED_TEST(ElementwiseChainLayerTest, TestMaxChain) {
+  this->CheckChain(
+      "layer { type: 'Eltwise' eltwise_param { operation: MAX } } "
+      "layer { type: 'Power' power_param { scale: -1 shift: 0.5 } } "
+      "layer { type: 'ReLU' } ", 2);
+}
+
+TYPED_TEST(ElementwiseChainLayerTest, TestInPlace) {
+  typedef TypeParam Dtype;
+  LayerParameter layer_param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(
+      "layer { type: 'TanH' } "
+      "layer { type: 'Power' power_param { power: 2 shift: 1 } } ",
+      layer_param.mutable_elementwise_chain_param()));
+  this->blob_bottom_vec_.push_back(this->blob_bottom_a_);
+  ElementwiseChainLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  caffe_rng_gaussian<Dtype>(this->blob_top_->count(), 0, 1,
+      this->blob_top_->mutable_cpu_diff());
+  layer.Backward(this->blob_top_vec_, vector<bool>(1, true),
+      this->blob_bottom_vec_);
+  // The same, in place.
+  Blob<Dtype> in_place;
+  in_place.CopyFrom(*this->blob_bottom_a_, false, true);
+  vector<Blob<Dtype>*> in_place_vec(1, &in_place);
+  ElementwiseChainLayer<Dtype> in_place_layer(layer_param);
+  in_place_layer.SetUp(in_place_vec, in_place_vec);
+  in_place_layer.Forward(in_place_vec, in_place_vec);
+  caffe_copy(in_place.count(), this->blob_top_->cpu_diff(),
+      in_place.mutable_cpu_diff());
+  in_place_layer.Backward(in_place_vec, vector<bool>(1, true), in_place_vec);
+  for (int i = 0; i < in_place.count(); ++i) {
+    EXPECT_EQ(this->blob_top_->cpu_data()[i], in_place.cpu_data()[i]);
+    EXPECT_EQ(this->blob_bottom_a_->cpu_diff()[i], in_place.cpu_diff()[i]);
+  }
+}
+
+}  // namespace caffe
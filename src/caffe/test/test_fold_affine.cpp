@@ -0,0 +1,172 @@
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/fold_affine.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class FoldAffineTest : public CPUDeviceTest<Dtype> {
+ protected:
+  // Builds the net, with random statistics for its BatchNorm layers, folds
+  // it, and checks that both compute the same.
+  void CheckFold(const string& proto, int expected_folded) {
+    NetParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+    param.mutable_state()->set_phase(TEST);
+    Caffe::set_random_seed(1701);
+    Net<Dtype> net(param);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    for (int i = 0; i < net.layers().size(); ++i) {
+      if (net.layers()[i]->type() != string("BatchNorm")) { continue; }
+      const vector<shared_ptr<Blob<Dtype> > >& blobs = net.layers()[i]->blobs();
+      filler.Fill(blobs[0].get());
+      caffe_rng_uniform<Dtype>(blobs[1]->count(), 1, 4,
+          blobs[1]->mutable_cpu_data());
+      blobs[2]->mutable_cpu_data()[0] = 2;
+    }
+    NetParameter weights;
+    net.ToProto(&weights, false);
+    NetParameter folded_param;
+    NetParameter folded_weights;
+    EXPECT_EQ(expected_folded,
+        FoldAffineLayers(param, weights, &folded_param, &folded_weights));
+    EXPECT_EQ(param.layer_size() - expected_folded,
+        folded_param.layer_size());
+    Net<Dtype> folded_net(folded_param);
+    folded_net.CopyTrainedLayersFrom(folded_weights);
+    filler.Fill(net.input_blobs()[0]);
+    folded_net.input_blobs()[0]->CopyFrom(*net.input_blobs()[0]);
+    const Blob<Dtype>& expected = *net.ForwardPrefilled()[0];
+    const Blob<Dtype>& actual = *folded_net.ForwardPrefilled()[0];
+    ASSERT_EQ(expected.count(), actual.count());
+    for (int i = 0; i < expected.count(); ++i) {
+      EXPECT_NEAR(expected.cpu_data()[i], actual.cpu_data()[i], 1e-4);
+    }
+  }
+};
+
+TYPED_TEST_CASE(FoldAffineTest, TestDtypes);
+
+TYPED_TEST(FoldAffineTest, TestFold) {
+  this->CheckFold(
+      "input: 'data' "
+      "input_shape { dim: 2 dim: 3 dim: 6 dim: 6 } "
+      "layer { "
+      "  name: 'conv' "
+      "  type: 'Convolution' "
+      "  bottom: 'data' "
+      "  top: 'conv' "
+      "  convolution_param { "
+      "    num_output: 4 "
+      "    kernel_size: 3 "
+      "    bias_term: false "
+      "    weight_filler { type: 'gaussian' } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'conv_bn' "
+      "  type: 'BatchNorm' "
+      "  bottom: 'conv' "
+      "  top: 'conv_bn' "
+      "} "
+      "layer { "
+      "  name: 'relu' "
+      "  type: 'ReLU' "
+      "  bottom: 'conv_bn' "
+      "  top: 'conv_bn' "
+      "} "
+      "layer { "
+      "  name: 'ip' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'conv_bn' "
+      "  top: 'ip' "
+      "  inner_product_param { "
+      "    num_output: 5 "
+      "    weight_filler { type: 'gaussian' } "
+      "    bias_filler { type: 'gaussian' } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'ip_bn' "
+      "  type: 'BatchNorm' "
+      "  bottom: 'ip' "
+      "  top: 'ip' "
+      "} "
+      "layer { "
+      "  name: 'ip_power' "
+      "  type: 'Power' "
+      "  bottom: 'ip' "
+      "  top: 'out' "
+      "  power_param { scale: 2 shift: 0.5 } "
+      "} ", 3);
+}
+
+TYPED_TEST(FoldAffineTest, TestNoFold) {
+  // The convolution output is read by another layer, the batch statistics
+  // are not fixed, and the power is not 1.
+  this->CheckFold(
+      "input: 'data' "
+      "input_shape { dim: 2 dim: 3 dim: 6 dim: 6 } "
+      "layer { "
+      "  name: 'conv' "
+      "  type: 'Convolution' "
+      "  bottom: 'data' "
+      "  top: 'conv' "
+      "  convolution_param { "
+      "    num_output: 4 "
+      "    kernel_size: 3 "
+      "    weight_filler { type: 'gaussian' } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'conv_bn' "
+      "  type: 'BatchNorm' "
+      "  bottom: 'conv' "
+      "  top: 'conv_bn' "
+      "} "
+      "layer { "
+      "  name: 'sum' "
+      "  type: 'Eltwise' "
+      "  bottom: 'conv' "
+      "  bottom: 'conv_bn' "
+      "  top: 'sum' "
+      "} "
+      "layer { "
+      "  name: 'ip' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'sum' "
+      "  top: 'ip' "
+      "  inner_product_param { "
+      "    num_output: 5 "
+      "    weight_filler { type: 'gaussian' } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'ip_bn' "
+      "  type: 'BatchNorm' "
+      "  bottom: 'ip' "
+      "  top: 'ip_bn' "
+      "  batch_norm_param { use_global_stats: false } "
+      "} "
+      "layer { "
+      "  name: 'ip_power' "
+      "  type: 'Power' "
+      "  bottom: 'ip_bn' "
+      "  top: 'out' "
+      "  power_param { power: 2 } "
+      "} ", 0);
+}
+
+}  // namespace caffe
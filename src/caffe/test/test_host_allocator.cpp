@@ -0,0 +1,116 @@
+#include <boost/thread.hpp>
+#include <stdint.h>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/syncedmem.hpp"
+#include "caffe/util/host_allocator.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class HostAllocatorTest : public ::testing::Test {
+ protected:
+  HostAllocatorTest() : allocator_(GetHostAllocator(Caffe::POOLED)) {}
+  virtual void SetUp() { allocator_->ReleaseCached(); }
+  virtual void TearDown() {
+    Caffe::set_host_allocator(Caffe::MALLOC);
+    allocator_->ReleaseCached();
+  }
+
+  HostAllocator* allocator_;
+};
+
+TEST_F(HostAllocatorTest, TestAlignment) {
+  const size_t sizes[] = { 1, 10, 64, 100, 1000, 4097, 1 << 20, 3 << 20 };
+  for (int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+    void* ptr = allocator_->Allocate(sizes[i]);
+    ASSERT_TRUE(ptr);
+    EXPECT_EQ(0, reinterpret_cast<uintptr_t>(ptr) % 64);
+    // The whole requested range must be writable.
+    caffe_memset(sizes[i], 1, ptr);
+    allocator_->Free(ptr, sizes[i]);
+  }
+}
+
+TEST_F(HostAllocatorTest, TestReuse) {
+  const HostAllocatorStats before = allocator_->stats();
+  void* ptr = allocator_->Allocate(1000);
+  allocator_->Free(ptr, 1000);
+  // A request of the same size class gets the freed block back.
+  void* ptr2 = allocator_->Allocate(1010);
+  EXPECT_EQ(ptr, ptr2);
+  HostAllocatorStats stats = allocator_->stats();
+  EXPECT_EQ(before.allocs + 2, stats.allocs);
+  EXPECT_EQ(before.frees + 1, stats.frees);
+  EXPECT_EQ(before.cache_hits + 1, stats.cache_hits);
+  EXPECT_GE(stats.bytes_in_use, before.bytes_in_use + 1010);
+  allocator_->Free(ptr2, 1010);
+  stats = allocator_->stats();
+  EXPECT_EQ(before.bytes_in_use, stats.bytes_in_use);
+  EXPECT_GE(stats.bytes_cached, 1010);
+  allocator_->ReleaseCached();
+  stats = allocator_->stats();
+  EXPECT_EQ(0, stats.bytes_cached);
+  EXPECT_EQ(stats.bytes_in_use, stats.bytes_reserved);
+}
+
+TEST_F(HostAllocatorTest, TestLargeBlocks) {
+  const HostAllocatorStats before = allocator_->stats();
+  // Blocks too large for the per-thread cache go through the shared pool.
+  const size_t size = 5 << 20;
+  void* ptr = allocator_->Allocate(size);
+  allocator_->Free(ptr, size);
+  void* ptr2 = allocator_->Allocate(size);
+  EXPECT_EQ(ptr, ptr2);
+  allocator_->Free(ptr2, size);
+  const HostAllocatorStats stats = allocator_->stats();
+  EXPECT_EQ(before.cache_hits + 1, stats.cache_hits);
+  EXPECT_EQ(before.bytes_in_use, stats.bytes_in_use);
+}
+
+TEST_F(HostAllocatorTest, TestSyncedMemory) {
+  Caffe::set_host_allocator(Caffe::POOLED);
+  const HostAllocatorStats before = allocator_->stats();
+  {
+    SyncedMemory mem(100);
+    void* cpu_data = mem.mutable_cpu_data();
+    EXPECT_EQ(0, reinterpret_cast<uintptr_t>(cpu_data) % 64);
+    for (int i = 0; i < mem.size(); ++i) {
+      EXPECT_EQ(0, static_cast<char*>(cpu_data)[i]);
+    }
+    EXPECT_EQ(before.allocs + 1, allocator_->stats().allocs);
+  }
+  EXPECT_EQ(before.frees + 1, allocator_->stats().frees);
+  // Memory allocated before switching back is freed by the pooled allocator.
+  SyncedMemory* mem = new SyncedMemory(100);
+  mem->mutable_cpu_data();
+  Caffe::set_host_allocator(Caffe::MALLOC);
+  delete mem;
+  EXPECT_EQ(before.frees + 2, allocator_->stats().frees);
+  EXPECT_EQ(before.bytes_in_use, allocator_->stats().bytes_in_use);
+}
+
+void FreeOnThread(HostAllocator* allocator, void* ptr, size_t size) {
+  allocator->Free(ptr, size);
+}
+
+TEST_F(HostAllocatorTest, TestFreeOnOtherThread) {
+  const HostAllocatorStats before = allocator_->stats();
+  void* ptr = allocator_->Allocate(256);
+  boost::thread thread(FreeOnThread, allocator_, ptr, 256);
+  thread.join();
+  // The exited thread hands its cached block and counters to the pool.
+  const HostAllocatorStats stats = allocator_->stats();
+  EXPECT_EQ(before.frees + 1, stats.frees);
+  EXPECT_EQ(before.bytes_in_use, stats.bytes_in_use);
+  EXPECT_EQ(before.bytes_cached + 256, stats.bytes_cached);
+  void* ptr2 = allocator_->Allocate(256);
+  EXPECT_EQ(ptr, ptr2);
+  allocator_->Free(ptr2, 256);
+}
+
+}  // namespace caffe
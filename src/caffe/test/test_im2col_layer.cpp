@@ -6,6 +6,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/im2col_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
@@ -75,6 +76,73 @@ TYPED_TEST(Im2colLayerTest, TestForward) {
   }
 }
 
+TYPED_TEST(Im2colLayerTest, TestGeometries) {
+  typedef typename TypeParam::Dtype Dtype;
+  vector<int> bottom_shape;
+  bottom_shape.push_back(2);
+  bottom_shape.push_back(3);
+  bottom_shape.push_back(10);
+  bottom_shape.push_back(11);
+  this->blob_bottom_->Reshape(bottom_shape);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  // Kernel size, stride, pad and dilation, covering the specialized CPU
+  // versions and the generic ones.
+  const int geometries[][4] = {
+    {1, 2, 0, 1}, {1, 1, 1, 1}, {3, 1, 1, 1}, {3, 2, 1, 1}, {3, 1, 2, 2},
+    {5, 1, 2, 1}, {7, 2, 3, 1}, {4, 3, 1, 1}, {2, 1, 0, 3}
+  };
+  const int num_geometries = sizeof(geometries) / sizeof(geometries[0]);
+  for (int g = 0; g < num_geometries; ++g) {
+    const int kernel = geometries[g][0];
+    const int stride = geometries[g][1];
+    const int pad = geometries[g][2];
+    const int dilation = geometries[g][3];
+    for (int force_nd = 0; force_nd < 2; ++force_nd) {
+      LayerParameter layer_param;
+      ConvolutionParameter* convolution_param =
+          layer_param.mutable_convolution_param();
+      convolution_param->add_kernel_size(kernel);
+      convolution_param->add_stride(stride);
+      convolution_param->add_pad(pad);
+      convolution_param->add_dilation(dilation);
+      convolution_param->set_force_nd_im2col(force_nd);
+      Im2colLayer<Dtype> layer(layer_param);
+      layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      for (int n = 0; n < this->blob_top_->num(); ++n) {
+        for (int c = 0; c < this->blob_top_->channels(); ++c) {
+          for (int h = 0; h < this->blob_top_->height(); ++h) {
+            for (int w = 0; w < this->blob_top_->width(); ++w) {
+              const int h_im = h * stride - pad +
+                  (c / kernel) % kernel * dilation;
+              const int w_im = w * stride - pad + c % kernel * dilation;
+              const bool inside = h_im >= 0 && h_im < 10 && w_im >= 0 &&
+                  w_im < 11;
+              EXPECT_EQ(inside ? this->blob_bottom_->data_at(n,
+                  c / kernel / kernel, h_im, w_im) : 0,
+                  this->blob_top_->data_at(n, c, h, w));
+            }
+          }
+        }
+      }
+      // col2im is the adjoint of im2col: <im2col(x), y> = <x, col2im(y)>.
+      filler.Fill(this->blob_top_);
+      caffe_copy(this->blob_top_->count(), this->blob_top_->cpu_data(),
+          this->blob_top_->mutable_cpu_diff());
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      layer.Backward(this->blob_top_vec_, vector<bool>(1, true),
+          this->blob_bottom_vec_);
+      EXPECT_NEAR(caffe_cpu_dot(this->blob_top_->count(),
+          this->blob_top_->cpu_data(), this->blob_top_->cpu_diff()),
+          caffe_cpu_dot(this->blob_bottom_->count(),
+          this->blob_bottom_->cpu_data(), this->blob_bottom_->cpu_diff()),
+          1e-3);
+    }
+  }
+}
+
 TYPED_TEST(Im2colLayerTest, TestGradient) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -88,6 +88,44 @@ TYPED_TEST(ImageDataLayerTest, TestRead) {
   }
 }
 
+TYPED_TEST(ImageDataLayerTest, TestReadThreads) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter param;
+  ImageDataParameter* image_data_param = param.mutable_image_data_param();
+  image_data_param->set_batch_size(5);
+  image_data_param->set_source(this->filename_.c_str());
+  image_data_param->set_shuffle(false);
+  TransformationParameter* transform_param = param.mutable_transform_param();
+  transform_param->set_crop_size(100);
+  transform_param->set_mirror(true);
+  transform_param->set_threads(3);
+  // The same seed gives the same random crops, whichever thread runs first.
+  vector<vector<Dtype> > batches;
+  for (int run = 0; run < 2; ++run) {
+    Caffe::set_random_seed(this->seed_);
+    ImageDataLayer<Dtype> layer(param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    EXPECT_EQ(this->blob_top_data_->num(), 5);
+    EXPECT_EQ(this->blob_top_data_->height(), 100);
+    EXPECT_EQ(this->blob_top_data_->width(), 100);
+    for (int iter = 0; iter < 2; ++iter) {
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      for (int i = 0; i < 5; ++i) {
+        EXPECT_EQ(i, this->blob_top_label_->cpu_data()[i]);
+      }
+      const Dtype* data = this->blob_top_data_->cpu_data();
+      if (run == 0) {
+        batches.push_back(vector<Dtype>(data,
+            data + this->blob_top_data_->count()));
+        continue;
+      }
+      for (int i = 0; i < this->blob_top_data_->count(); ++i) {
+        EXPECT_EQ(batches[iter][i], data[i]) << "iter " << iter << " i " << i;
+      }
+    }
+  }
+}
+
 TYPED_TEST(ImageDataLayerTest, TestResize) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter param;
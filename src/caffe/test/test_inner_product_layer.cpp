@@ -6,6 +6,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/inner_product_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
@@ -122,6 +123,81 @@ TYPED_TEST(InnerProductLayerTest, TestForwardNoBatch) {
   }
 }
 
+TYPED_TEST(InnerProductLayerTest, TestForwardPackedWeights) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->blob_bottom_vec_.push_back(this->blob_bottom_);
+  LayerParameter layer_param;
+  layer_param.set_phase(TEST);
+  InnerProductParameter* inner_product_param =
+      layer_param.mutable_inner_product_param();
+  // Not a multiple of the panel, so that the last panel is padded.
+  inner_product_param->set_num_output(11);
+  inner_product_param->mutable_weight_filler()->set_type("uniform");
+  inner_product_param->set_bias_term(false);
+  InnerProductLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  const int num = this->blob_bottom_->num();
+  const int dim = this->blob_bottom_->count(1);
+  for (int pass = 0; pass < 2; ++pass) {
+    if (pass == 1) {
+      // Modifying the weights must discard the packed ones.
+      caffe_scal(layer.blobs()[0]->count(), Dtype(-2),
+          layer.blobs()[0]->mutable_cpu_data());
+    }
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    const Dtype* bottom = this->blob_bottom_->cpu_data();
+    const Dtype* weights = layer.blobs()[0]->cpu_data();
+    const Dtype* top = this->blob_top_->cpu_data();
+    for (int n = 0; n < num; ++n) {
+      for (int o = 0; o < 11; ++o) {
+        Dtype expected = 0;
+        for (int k = 0; k < dim; ++k) {
+          expected += bottom[n * dim + k] * weights[o * dim + k];
+        }
+        EXPECT_NEAR(top[n * 11 + o], expected, 1e-4);
+      }
+    }
+  }
+}
+
+TYPED_TEST(InnerProductLayerTest, TestForwardFusedActivation) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->blob_bottom_vec_.push_back(this->blob_bottom_);
+  bool IS_VALID_CUDA = false;
+#ifndef CPU_ONLY
+  IS_VALID_CUDA = CAFFE_TEST_CUDA_PROP.major >= 2;
+#endif
+  if (Caffe::mode() == Caffe::CPU ||
+      sizeof(Dtype) == 4 || IS_VALID_CUDA) {
+    LayerParameter layer_param;
+    InnerProductParameter* inner_product_param =
+        layer_param.mutable_inner_product_param();
+    inner_product_param->set_num_output(10);
+    inner_product_param->mutable_weight_filler()->set_type("gaussian");
+    inner_product_param->mutable_bias_filler()->set_type("gaussian");
+    InnerProductLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    Blob<Dtype> expected;
+    expected.CopyFrom(*this->blob_top_, false, true);
+    // The same weights, with the sigmoid fused.
+    inner_product_param->mutable_fused_activation()->set_type(
+        ActivationParameter_Type_SIGMOID);
+    InnerProductLayer<Dtype> fused_layer(layer_param);
+    fused_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    for (int i = 0; i < layer.blobs().size(); ++i) {
+      fused_layer.blobs()[i]->CopyFrom(*layer.blobs()[i]);
+    }
+    fused_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    const Dtype* data = this->blob_top_->cpu_data();
+    for (int i = 0; i < expected.count(); ++i) {
+      EXPECT_NEAR(data[i], 1. / (1. + exp(-expected.cpu_data()[i])), 1e-5);
+    }
+  } else {
+    LOG(ERROR) << "Skipping test due to old architecture.";
+  }
+}
+
 TYPED_TEST(InnerProductLayerTest, TestGradient) {
   typedef typename TypeParam::Dtype Dtype;
   this->blob_bottom_vec_.push_back(this->blob_bottom_);
@@ -148,4 +224,30 @@ TYPED_TEST(InnerProductLayerTest, TestGradient) {
   }
 }
 
+TYPED_TEST(InnerProductLayerTest, TestGradientFusedActivation) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->blob_bottom_vec_.push_back(this->blob_bottom_);
+  bool IS_VALID_CUDA = false;
+#ifndef CPU_ONLY
+  IS_VALID_CUDA = CAFFE_TEST_CUDA_PROP.major >= 2;
+#endif
+  if (Caffe::mode() == Caffe::CPU ||
+      sizeof(Dtype) == 4 || IS_VALID_CUDA) {
+    LayerParameter layer_param;
+    InnerProductParameter* inner_product_param =
+        layer_param.mutable_inner_product_param();
+    inner_product_param->set_num_output(10);
+    inner_product_param->mutable_weight_filler()->set_type("gaussian");
+    inner_product_param->mutable_bias_filler()->set_type("gaussian");
+    inner_product_param->mutable_fused_activation()->set_type(
+        ActivationParameter_Type_SIGMOID);
+    InnerProductLayer<Dtype> layer(layer_param);
+    GradientChecker<Dtype> checker(1e-2, 1e-3);
+    checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+        this->blob_top_vec_);
+  } else {
+    LOG(ERROR) << "Skipping test due to old architecture.";
+  }
+}
+
 }  // namespace caffe
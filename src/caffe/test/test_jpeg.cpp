@@ -0,0 +1,211 @@
+#ifdef USE_LIBJPEG
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/data_transformer.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/io.hpp"
+#include "caffe/util/jpeg.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class JPEGTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    const string filename = EXAMPLES_SOURCE_DIR "images/cat.jpg";
+    ASSERT_TRUE(ReadFileToDatum(filename, &datum_));
+  }
+
+  // Checks that decoding rows x cols at (x, y) gives the same pixels as
+  // decoding the whole image.
+  void TestCrop(int color, int scale, int x, int y, int cols, int rows) {
+    int min_size = scale > 1 ? 360 / scale : 0;
+    int image_scale, height, width, channels;
+    ASSERT_TRUE(ReadJPEGShape(datum_.data(), color, min_size, &image_scale,
+        &height, &width, &channels));
+    ASSERT_EQ(scale, image_scale);
+    vector<unsigned char> image, crop;
+    int image_step, image_offset, crop_step, crop_offset;
+    ASSERT_TRUE(DecodeJPEG(datum_.data(), color, scale, 0, 0, width, height,
+        &image, &image_step, &image_offset));
+    EXPECT_EQ(width * channels, image_step);
+    EXPECT_EQ(0, image_offset);
+    ASSERT_TRUE(DecodeJPEG(datum_.data(), color, scale, x, y, cols, rows,
+        &crop, &crop_step, &crop_offset));
+    for (int i = 0; i < rows; ++i) {
+      for (int j = 0; j < cols * channels; ++j) {
+        ASSERT_EQ(image[(y + i) * image_step + x * channels + j],
+            crop[i * crop_step + crop_offset + j]);
+      }
+    }
+  }
+
+  Datum datum_;
+};
+
+TEST_F(JPEGTest, TestReadShape) {
+  int scale, height, width, channels;
+  EXPECT_TRUE(ReadJPEGShape(datum_.data(), 1, 0, &scale, &height, &width,
+      &channels));
+  EXPECT_EQ(1, scale);
+  EXPECT_EQ(360, height);
+  EXPECT_EQ(480, width);
+  EXPECT_EQ(3, channels);
+  EXPECT_TRUE(ReadJPEGShape(datum_.data(), 0, 0, &scale, &height, &width,
+      &channels));
+  EXPECT_EQ(1, channels);
+  EXPECT_TRUE(ReadJPEGShape(datum_.data(), -1, 0, &scale, &height, &width,
+      &channels));
+  EXPECT_EQ(3, channels);
+}
+
+TEST_F(JPEGTest, TestReadShapeScaled) {
+  int scale, height, width, channels;
+  EXPECT_TRUE(ReadJPEGShape(datum_.data(), 1, 100, &scale, &height, &width,
+      &channels));
+  EXPECT_EQ(2, scale);
+  EXPECT_EQ(180, height);
+  EXPECT_EQ(240, width);
+  EXPECT_TRUE(ReadJPEGShape(datum_.data(), 1, 90, &scale, &height, &width,
+      &channels));
+  EXPECT_EQ(4, scale);
+  EXPECT_EQ(90, height);
+  EXPECT_EQ(120, width);
+  EXPECT_TRUE(ReadJPEGShape(datum_.data(), 1, 40, &scale, &height, &width,
+      &channels));
+  EXPECT_EQ(8, scale);
+  EXPECT_EQ(45, height);
+  EXPECT_EQ(60, width);
+  EXPECT_TRUE(ReadJPEGShape(datum_.data(), 1, 361, &scale, &height, &width,
+      &channels));
+  EXPECT_EQ(1, scale);
+}
+
+TEST_F(JPEGTest, TestReadNotJPEG) {
+  int scale, height, width, channels;
+  EXPECT_FALSE(ReadJPEGShape("", 1, 0, &scale, &height, &width, &channels));
+  EXPECT_FALSE(ReadJPEGShape("\x89PNG\r\n", 1, 0, &scale, &height, &width,
+      &channels));
+  const string truncated = datum_.data().substr(0, 20);
+  EXPECT_FALSE(ReadJPEGShape(truncated, 1, 0, &scale, &height, &width,
+      &channels));
+}
+
+TEST_F(JPEGTest, TestDecodeCrop) {
+  TestCrop(1, 1, 0, 0, 480, 100);
+  TestCrop(1, 1, 61, 37, 227, 227);
+  TestCrop(1, 1, 253, 133, 227, 227);
+  TestCrop(0, 1, 61, 37, 227, 227);
+}
+
+TEST_F(JPEGTest, TestDecodeCropScaled) {
+  TestCrop(1, 2, 13, 5, 100, 100);
+  TestCrop(1, 4, 3, 1, 80, 80);
+  TestCrop(0, 8, 7, 2, 40, 40);
+}
+
+template <typename Dtype>
+class JPEGTransformTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    const string filename = EXAMPLES_SOURCE_DIR "images/cat.jpg";
+    ASSERT_TRUE(ReadFileToDatum(filename, &datum_));
+  }
+
+  Datum datum_;
+};
+
+TYPED_TEST_CASE(JPEGTransformTest, TestDtypes);
+
+TYPED_TEST(JPEGTransformTest, TestCropTest) {
+  TransformationParameter transform_param;
+  transform_param.set_crop_size(227);
+  DataTransformer<TypeParam> transformer(transform_param, TEST);
+  vector<int> shape = transformer.InferBlobShape(this->datum_);
+  EXPECT_EQ(3, shape[1]);
+  EXPECT_EQ(227, shape[2]);
+  EXPECT_EQ(227, shape[3]);
+  Blob<TypeParam> blob(shape);
+  transformer.Transform(this->datum_, &blob);
+  // The center crop of the whole image.
+  vector<unsigned char> image;
+  int step, offset;
+  ASSERT_TRUE(DecodeJPEG(this->datum_.data(), -1, 1, 0, 0, 480, 360, &image,
+      &step, &offset));
+  const int h_off = (360 - 227) / 2;
+  const int w_off = (480 - 227) / 2;
+  for (int c = 0; c < 3; ++c) {
+    for (int h = 0; h < 227; ++h) {
+      for (int w = 0; w < 227; ++w) {
+        ASSERT_EQ(image[(h_off + h) * step + (w_off + w) * 3 + c],
+            blob.data_at(0, c, h, w));
+      }
+    }
+  }
+}
+
+TYPED_TEST(JPEGTransformTest, TestDecodeMinSize) {
+  TransformationParameter transform_param;
+  transform_param.set_decode_min_size(100);
+  transform_param.set_force_gray(true);
+  DataTransformer<TypeParam> transformer(transform_param, TEST);
+  vector<int> shape = transformer.InferBlobShape(this->datum_);
+  EXPECT_EQ(1, shape[1]);
+  EXPECT_EQ(180, shape[2]);
+  EXPECT_EQ(240, shape[3]);
+  Blob<TypeParam> blob(shape);
+  transformer.Transform(this->datum_, &blob);
+  vector<unsigned char> image;
+  int step, offset;
+  ASSERT_TRUE(DecodeJPEG(this->datum_.data(), 0, 2, 0, 0, 240, 180, &image,
+      &step, &offset));
+  for (int i = 0; i < blob.count(); ++i) {
+    ASSERT_EQ(image[i], blob.cpu_data()[i]);
+  }
+  // The crop size bounds the reduction.
+  transform_param.set_crop_size(150);
+  DataTransformer<TypeParam> crop_transformer(transform_param, TEST);
+  shape = crop_transformer.InferBlobShape(this->datum_);
+  EXPECT_EQ(150, shape[2]);
+  EXPECT_EQ(150, shape[3]);
+  int scale, height, width, channels;
+  ASSERT_TRUE(ReadJPEGShape(this->datum_.data(), 0, 150, &scale, &height,
+      &width, &channels));
+  EXPECT_EQ(2, scale);
+}
+
+TYPED_TEST(JPEGTransformTest, TestCropTrainSequence) {
+  TransformationParameter transform_param;
+  transform_param.set_crop_size(100);
+  transform_param.set_mirror(true);
+  transform_param.set_decode_min_size(1);
+  DataTransformer<TypeParam> transformer(transform_param, TRAIN);
+  Caffe::set_random_seed(1701);
+  transformer.InitRand();
+  Blob<TypeParam> blob(transformer.InferBlobShape(this->datum_));
+  // The crops fit in the image scaled down to 1/2 or less, and vary.
+  int num_matches = 0;
+  vector<TypeParam> first;
+  for (int iter = 0; iter < 10; ++iter) {
+    transformer.Transform(this->datum_, &blob);
+    if (iter == 0) {
+      first.assign(blob.cpu_data(), blob.cpu_data() + blob.count());
+      continue;
+    }
+    bool match = true;
+    for (int j = 0; j < blob.count() && match; ++j) {
+      match = first[j] == blob.cpu_data()[j];
+    }
+    num_matches += match;
+  }
+  EXPECT_LT(num_matches, 9);
+}
+
+}  // namespace caffe
+#endif  // USE_LIBJPEG
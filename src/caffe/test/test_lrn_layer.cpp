@@ -7,6 +7,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/lrn_layer.hpp"
+#include "caffe/util/blocked_layout.hpp"
 
 #ifdef USE_CUDNN
 #include "caffe/layers/cudnn_lcn_layer.hpp"
@@ -201,6 +202,38 @@ TYPED_TEST(LRNLayerTest, TestGradientAcrossChannelsLargeRegion) {
       this->blob_top_vec_);
 }
 
+TYPED_TEST(LRNLayerTest, TestForwardAcrossChannelsBlocked) {
+  typedef typename TypeParam::Dtype Dtype;
+  const int block = 4;
+  this->blob_bottom_->Reshape(2, 12, 3, 5);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  LayerParameter layer_param;
+  layer_param.mutable_lrn_param()->set_local_size(7);
+  LRNLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // The same on the reordered bottom, with windows across blocks.
+  Blob<Dtype> bottom_blocked, top_blocked, top;
+  bottom_blocked.ReshapeLike(*this->blob_bottom_);
+  reorder_to_blocked_cpu(2, 12, 3 * 5, block, this->blob_bottom_->cpu_data(),
+      bottom_blocked.mutable_cpu_data());
+  vector<Blob<Dtype>*> bottom_blocked_vec(1, &bottom_blocked);
+  vector<Blob<Dtype>*> top_blocked_vec(1, &top_blocked);
+  layer_param.set_channel_block(block);
+  LRNLayer<Dtype> blocked_layer(layer_param);
+  blocked_layer.SetUp(bottom_blocked_vec, top_blocked_vec);
+  blocked_layer.Forward(bottom_blocked_vec, top_blocked_vec);
+  top.ReshapeLike(top_blocked);
+  reorder_from_blocked_cpu(2, 12, 3 * 5, block, top_blocked.cpu_data(),
+      top.mutable_cpu_data());
+  for (int i = 0; i < top.count(); ++i) {
+    EXPECT_NEAR(this->blob_top_->cpu_data()[i], top.cpu_data()[i],
+        this->epsilon_);
+  }
+}
+
 TYPED_TEST(LRNLayerTest, TestSetupWithinChannel) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
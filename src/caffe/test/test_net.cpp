@@ -713,6 +713,383 @@ class NetTest : public MultiDeviceTest<TypeParam> {
     InitNetFromProtoString(proto);
   }
 
+  virtual void InitBranchyNet(const string& memory_options) {
+    const string& proto =
+        "name: 'BranchyNetwork' " + memory_options +
+        "input: 'data' "
+        "input_shape { dim: 2 dim: 3 dim: 8 dim: 8 } "
+        "layer { "
+        "  name: 'conv1' "
+        "  type: 'Convolution' "
+        "  bottom: 'data' "
+        "  top: 'conv1' "
+        "  convolution_param { "
+        "    num_output: 4 "
+        "    kernel_size: 3 "
+        "    pad: 1 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "      std: 0.1 "
+        "    } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'relu1' "
+        "  type: 'ReLU' "
+        "  bottom: 'conv1' "
+        "  top: 'conv1' "
+        "} "
+        "layer { "
+        "  name: 'conv2a' "
+        "  type: 'Convolution' "
+        "  bottom: 'conv1' "
+        "  top: 'conv2a' "
+        "  convolution_param { "
+        "    num_output: 4 "
+        "    kernel_size: 1 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "      std: 0.1 "
+        "    } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'conv2b' "
+        "  type: 'Convolution' "
+        "  bottom: 'conv1' "
+        "  top: 'conv2b' "
+        "  convolution_param { "
+        "    num_output: 4 "
+        "    kernel_size: 3 "
+        "    pad: 1 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "      std: 0.1 "
+        "    } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'sum' "
+        "  type: 'Eltwise' "
+        "  bottom: 'conv2a' "
+        "  bottom: 'conv2b' "
+        "  top: 'sum' "
+        "} "
+        "layer { "
+        "  name: 'pool' "
+        "  type: 'Pooling' "
+        "  bottom: 'sum' "
+        "  top: 'pool' "
+        "  pooling_param { "
+        "    pool: MAX "
+        "    kernel_size: 2 "
+        "    stride: 2 "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'flat' "
+        "  type: 'Flatten' "
+        "  bottom: 'pool' "
+        "  top: 'flat' "
+        "} "
+        "layer { "
+        "  name: 'ip' "
+        "  type: 'InnerProduct' "
+        "  bottom: 'flat' "
+        "  top: 'out' "
+        "  inner_product_param { "
+        "    num_output: 3 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "      std: 0.1 "
+        "    } "
+        "  } "
+        "} ";
+    InitNetFromProtoString(proto);
+  }
+
+  virtual void InitDropoutBranchNet(const string& options) {
+    const string& proto =
+        "name: 'DropoutBranchNetwork' state { phase: TRAIN } " + options +
+        "input: 'data' "
+        "input_shape { dim: 2 dim: 3 dim: 8 dim: 8 } "
+        "layer { "
+        "  name: 'conv' "
+        "  type: 'Convolution' "
+        "  bottom: 'data' "
+        "  top: 'conv' "
+        "  convolution_param { "
+        "    num_output: 3 "
+        "    kernel_size: 3 "
+        "    pad: 1 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "      std: 0.1 "
+        "    } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'dropa' "
+        "  type: 'Dropout' "
+        "  bottom: 'conv' "
+        "  top: 'a' "
+        "} "
+        "layer { "
+        "  name: 'dropb' "
+        "  type: 'Dropout' "
+        "  bottom: 'data' "
+        "  top: 'b' "
+        "} "
+        "layer { "
+        "  name: 'sum' "
+        "  type: 'Eltwise' "
+        "  bottom: 'a' "
+        "  bottom: 'b' "
+        "  top: 'out' "
+        "} ";
+    InitNetFromProtoString(proto);
+  }
+
+  virtual void InitElementwiseNet(const string& options) {
+    const string& proto =
+        "name: 'ElementwiseNetwork' force_backward: true " + options +
+        "input: 'a' "
+        "input_shape { dim: 2 dim: 3 dim: 4 dim: 4 } "
+        "input: 'b' "
+        "input_shape { dim: 2 dim: 3 dim: 4 dim: 4 } "
+        "layer { "
+        "  name: 'sum' "
+        "  type: 'Eltwise' "
+        "  bottom: 'a' "
+        "  bottom: 'b' "
+        "  top: 'sum' "
+        "} "
+        "layer { "
+        "  name: 'relu' "
+        "  type: 'ReLU' "
+        "  bottom: 'sum' "
+        "  top: 'sum' "
+        "} "
+        "layer { "
+        "  name: 'power' "
+        "  type: 'Power' "
+        "  bottom: 'sum' "
+        "  top: 'power' "
+        "  power_param { power: 2 scale: 0.5 shift: 1 } "
+        "} "
+        "layer { "
+        "  name: 'tanh' "
+        "  type: 'TanH' "
+        "  bottom: 'power' "
+        "  top: 'tanh' "
+        "} "
+        "layer { "
+        "  name: 'exp' "
+        "  type: 'Exp' "
+        "  bottom: 'power' "
+        "  top: 'exp' "
+        "  exp_param { scale: -1 } "
+        "} "
+        "layer { "
+        "  name: 'ip_tanh' "
+        "  type: 'InnerProduct' "
+        "  bottom: 'tanh' "
+        "  top: 'out_tanh' "
+        "  inner_product_param { "
+        "    num_output: 3 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "      std: 0.1 "
+        "    } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'ip_exp' "
+        "  type: 'InnerProduct' "
+        "  bottom: 'exp' "
+        "  top: 'out_exp' "
+        "  inner_product_param { "
+        "    num_output: 3 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "      std: 0.1 "
+        "    } "
+        "  } "
+        "} ";
+    InitNetFromProtoString(proto);
+  }
+
+  virtual void InitSliceConcatNet(const string& options) {
+    const string& proto =
+        "name: 'SliceConcatNetwork' force_backward: true " + options +
+        "input: 'data' "
+        "input_shape { dim: 1 dim: 4 dim: 3 dim: 3 } "
+        "layer { "
+        "  name: 'slice' "
+        "  type: 'Slice' "
+        "  bottom: 'data' "
+        "  top: 's1' "
+        "  top: 's2' "
+        "  slice_param { slice_point: 1 } "
+        "} "
+        "layer { "
+        "  name: 'conv' "
+        "  type: 'Convolution' "
+        "  bottom: 's1' "
+        "  top: 'conv' "
+        "  convolution_param { "
+        "    num_output: 2 "
+        "    kernel_size: 1 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "      std: 1 "
+        "    } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'tanh' "
+        "  type: 'TanH' "
+        "  bottom: 's2' "
+        "  top: 'tanh' "
+        "} "
+        "layer { "
+        "  name: 'relu' "
+        "  type: 'ReLU' "
+        "  bottom: 'tanh' "
+        "  top: 'tanh' "
+        "} "
+        "layer { "
+        "  name: 'concat' "
+        "  type: 'Concat' "
+        "  bottom: 'conv' "
+        "  bottom: 'tanh' "
+        "  bottom: 's1' "
+        "  top: 'concat' "
+        "} "
+        "layer { "
+        "  name: 'out' "
+        "  type: 'Convolution' "
+        "  bottom: 'concat' "
+        "  top: 'out' "
+        "  convolution_param { "
+        "    num_output: 3 "
+        "    kernel_size: 1 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "      std: 1 "
+        "    } "
+        "  } "
+        "} ";
+    InitNetFromProtoString(proto);
+  }
+
+  virtual void InitBlockedNet(const string& options) {
+    const string& proto =
+        "name: 'BlockedNetwork' state { phase: TEST } " + options +
+        "input: 'data' "
+        "input_shape { dim: 2 dim: 3 dim: 8 dim: 8 } "
+        "layer { "
+        "  name: 'conv1' "
+        "  type: 'Convolution' "
+        "  bottom: 'data' "
+        "  top: 'conv1' "
+        "  convolution_param { "
+        "    num_output: 8 "
+        "    kernel_size: 3 "
+        "    pad: 1 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "      std: 0.5 "
+        "    } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'relu1' "
+        "  type: 'ReLU' "
+        "  bottom: 'conv1' "
+        "  top: 'conv1' "
+        "} "
+        "layer { "
+        "  name: 'pool1' "
+        "  type: 'Pooling' "
+        "  bottom: 'conv1' "
+        "  top: 'pool1' "
+        "  pooling_param { "
+        "    pool: MAX "
+        "    kernel_size: 3 "
+        "    stride: 2 "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'norm1' "
+        "  type: 'LRN' "
+        "  bottom: 'pool1' "
+        "  top: 'norm1' "
+        "  lrn_param { "
+        "    local_size: 5 "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'dw' "
+        "  type: 'Convolution' "
+        "  bottom: 'norm1' "
+        "  top: 'dw' "
+        "  convolution_param { "
+        "    num_output: 8 "
+        "    group: 8 "
+        "    kernel_size: 3 "
+        "    pad: 1 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "      std: 0.5 "
+        "    } "
+        "    bias_filler { "
+        "      type: 'gaussian' "
+        "      std: 0.5 "
+        "    } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'relu2' "
+        "  type: 'ReLU' "
+        "  bottom: 'dw' "
+        "  top: 'dw' "
+        "} "
+        "layer { "
+        "  name: 'sum' "
+        "  type: 'Eltwise' "
+        "  bottom: 'dw' "
+        "  bottom: 'pool1' "
+        "  top: 'sum' "
+        "} "
+        "layer { "
+        "  name: 'out' "
+        "  type: 'Convolution' "
+        "  bottom: 'sum' "
+        "  top: 'out' "
+        "  convolution_param { "
+        "    num_output: 4 "
+        "    kernel_size: 1 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "      std: 0.5 "
+        "    } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'pool2' "
+        "  type: 'Pooling' "
+        "  bottom: 'sum' "
+        "  top: 'pool2' "
+        "  pooling_param { "
+        "    pool: AVE "
+        "    kernel_size: 2 "
+        "    stride: 2 "
+        "  } "
+        "} ";
+    InitNetFromProtoString(proto);
+  }
+
   int seed_;
   shared_ptr<Net<Dtype> > net_;
 };
@@ -2379,4 +2756,430 @@ TYPED_TEST(NetTest, TestSkipPropagateDown) {
   }
 }
 
+TYPED_TEST(NetTest, TestShareActivations) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Run the same net with and without shared activation memory and check
+  // that the outputs agree.
+  Caffe::set_random_seed(this->seed_);
+  this->InitBranchyNet("");
+  shared_ptr<Net<Dtype> > unshared_net = this->net_;
+  this->InitBranchyNet("share_activations: true ");
+  this->net_->ShareTrainedLayersWith(unshared_net.get());
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(unshared_net->input_blobs()[0]);
+  this->net_->input_blobs()[0]->CopyFrom(*unshared_net->input_blobs()[0]);
+  const Blob<Dtype>* expected = unshared_net->ForwardPrefilled()[0];
+  const Blob<Dtype>* actual = this->net_->ForwardPrefilled()[0];
+  ASSERT_EQ(expected->count(), actual->count());
+  for (int i = 0; i < expected->count(); ++i) {
+    EXPECT_EQ(expected->cpu_data()[i], actual->cpu_data()[i]);
+  }
+  // conv1 is dead once both branches have read it, so the branch sum may
+  // reuse its memory; the inputs and outputs keep their own.
+  EXPECT_EQ(this->net_->blob_by_name("conv1")->data(),
+            this->net_->blob_by_name("sum")->data());
+  EXPECT_EQ(this->net_->blob_by_name("pool")->data(),
+            this->net_->blob_by_name("flat")->data());
+  EXPECT_NE(this->net_->blob_by_name("conv2a")->data(),
+            this->net_->blob_by_name("conv2b")->data());
+  const vector<shared_ptr<Blob<Dtype> > >& blobs = this->net_->blobs();
+  for (int i = 0; i < blobs.size(); ++i) {
+    if (this->net_->blob_names()[i] == "data" ||
+        this->net_->blob_names()[i] == "out") { continue; }
+    EXPECT_NE(blobs[i]->data(), this->net_->blob_by_name("data")->data());
+    EXPECT_NE(blobs[i]->data(), this->net_->blob_by_name("out")->data());
+  }
+}
+
+TYPED_TEST(NetTest, TestShareActivationsKeepBlob) {
+  this->InitBranchyNet("share_activations: true keep_blob: 'conv1' ");
+  this->net_->ForwardPrefilled();
+  const vector<shared_ptr<Blob<typename TypeParam::Dtype> > >& blobs =
+      this->net_->blobs();
+  const shared_ptr<SyncedMemory>& kept =
+      this->net_->blob_by_name("conv1")->data();
+  for (int i = 0; i < blobs.size(); ++i) {
+    // Only the splits of conv1 may refer to its memory.
+    if (this->net_->blob_names()[i].find("conv1") == 0) { continue; }
+    EXPECT_NE(blobs[i]->data(), kept);
+  }
+}
+
+TYPED_TEST(NetTest, TestShareActivationsReshape) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_random_seed(this->seed_);
+  this->InitBranchyNet("");
+  shared_ptr<Net<Dtype> > unshared_net = this->net_;
+  this->InitBranchyNet("share_activations: true ");
+  this->net_->ShareTrainedLayersWith(unshared_net.get());
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<Dtype> filler(filler_param);
+  // Grow the input and check that the re-planned net still agrees.
+  unshared_net->input_blobs()[0]->Reshape(3, 3, 8, 8);
+  this->net_->input_blobs()[0]->Reshape(3, 3, 8, 8);
+  unshared_net->Reshape();
+  this->net_->Reshape();
+  filler.Fill(unshared_net->input_blobs()[0]);
+  this->net_->input_blobs()[0]->CopyFrom(*unshared_net->input_blobs()[0]);
+  const Blob<Dtype>* expected = unshared_net->ForwardPrefilled()[0];
+  const Blob<Dtype>* actual = this->net_->ForwardPrefilled()[0];
+  ASSERT_EQ(expected->count(), actual->count());
+  for (int i = 0; i < expected->count(); ++i) {
+    EXPECT_EQ(expected->cpu_data()[i], actual->cpu_data()[i]);
+  }
+  EXPECT_EQ(this->net_->blob_by_name("conv1")->data(),
+            this->net_->blob_by_name("sum")->data());
+}
+
+TYPED_TEST(NetTest, TestShareActivationsShrinkThenGrow) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->InitBranchyNet("share_activations: true ");
+  // Re-plan the shared buffers for a smaller input.
+  this->net_->input_blobs()[0]->Reshape(1, 3, 8, 8);
+  this->net_->Reshape();
+  // Then grow the input back through the layers' own Reshape only: the
+  // blobs must not keep writing to the smaller shared buffers.
+  this->net_->input_blobs()[0]->Reshape(2, 3, 8, 8);
+  this->net_->ForwardPrefilled();
+  const vector<shared_ptr<Blob<Dtype> > >& blobs = this->net_->blobs();
+  for (int i = 0; i < blobs.size(); ++i) {
+    EXPECT_GE(blobs[i]->data()->size(), blobs[i]->count() * sizeof(Dtype))
+        << this->net_->blob_names()[i];
+  }
+}
+
+TYPED_TEST(NetTest, TestLayerThreads) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Run the same net on one thread and on four, where the two branches may
+  // run concurrently, and check that Forward and Backward agree exactly.
+  Caffe::set_random_seed(this->seed_);
+  this->InitBranchyNet("force_backward: true ");
+  shared_ptr<Net<Dtype> > serial_net = this->net_;
+  this->InitBranchyNet("force_backward: true layer_threads: 4 ");
+  this->net_->ShareTrainedLayersWith(serial_net.get());
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(serial_net->input_blobs()[0]);
+  this->net_->input_blobs()[0]->CopyFrom(*serial_net->input_blobs()[0]);
+  Net<Dtype>* nets[] = { serial_net.get(), this->net_.get() };
+  for (int n = 0; n < 2; ++n) {
+    Blob<Dtype>* out = nets[n]->ForwardPrefilled()[0];
+    for (int i = 0; i < out->count(); ++i) {
+      out->mutable_cpu_diff()[i] = out->cpu_data()[i];
+    }
+    nets[n]->ClearParamDiffs();
+    nets[n]->Backward();
+  }
+  const Blob<Dtype>* expected = serial_net->output_blobs()[0];
+  const Blob<Dtype>* actual = this->net_->output_blobs()[0];
+  ASSERT_EQ(expected->count(), actual->count());
+  for (int i = 0; i < expected->count(); ++i) {
+    EXPECT_EQ(expected->cpu_data()[i], actual->cpu_data()[i]);
+  }
+  const Blob<Dtype>* expected_input = serial_net->input_blobs()[0];
+  const Blob<Dtype>* actual_input = this->net_->input_blobs()[0];
+  for (int i = 0; i < expected_input->count(); ++i) {
+    EXPECT_EQ(expected_input->cpu_diff()[i], actual_input->cpu_diff()[i]);
+  }
+  // The nets share their weights but not the diffs.
+  const vector<shared_ptr<Blob<Dtype> > >& expected_params =
+      serial_net->params();
+  const vector<shared_ptr<Blob<Dtype> > >& actual_params =
+      this->net_->params();
+  ASSERT_EQ(expected_params.size(), actual_params.size());
+  for (int j = 0; j < expected_params.size(); ++j) {
+    ASSERT_NE(expected_params[j]->diff(), actual_params[j]->diff());
+    for (int i = 0; i < expected_params[j]->count(); ++i) {
+      EXPECT_EQ(expected_params[j]->cpu_diff()[i],
+                actual_params[j]->cpu_diff()[i]);
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestLayerThreadsDropout) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Seeded TRAIN nets draw the same Dropout masks on one thread and on two,
+  // whichever thread is free when a Dropout layer is ready.
+  const char* options[] = { "", "layer_threads: 2 ", "layer_threads: 2 " };
+  vector<vector<Dtype> > outputs;
+  for (int n = 0; n < 3; ++n) {
+    Caffe::set_random_seed(this->seed_);
+    this->InitDropoutBranchNet(options[n]);
+    FillerParameter filler_param;
+    filler_param.set_std(1);
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->net_->input_blobs()[0]);
+    const Blob<Dtype>* out = this->net_->ForwardPrefilled()[0];
+    outputs.push_back(vector<Dtype>(out->cpu_data(),
+        out->cpu_data() + out->count()));
+  }
+  for (int n = 1; n < 3; ++n) {
+    ASSERT_EQ(outputs[0].size(), outputs[n].size());
+    for (int i = 0; i < outputs[0].size(); ++i) {
+      EXPECT_EQ(outputs[0][i], outputs[n][i]);
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestFuseActivations) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Fusing the ReLU into the first convolution drops a layer but computes
+  // the same Forward and Backward.
+  Caffe::set_random_seed(this->seed_);
+  this->InitBranchyNet("force_backward: true ");
+  shared_ptr<Net<Dtype> > unfused_net = this->net_;
+  this->InitBranchyNet("force_backward: true fuse_activations: true ");
+  EXPECT_EQ(unfused_net->layers().size() - 1, this->net_->layers().size());
+  EXPECT_FALSE(this->net_->has_layer("relu1"));
+  this->net_->ShareTrainedLayersWith(unfused_net.get());
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(unfused_net->input_blobs()[0]);
+  this->net_->input_blobs()[0]->CopyFrom(*unfused_net->input_blobs()[0]);
+  Net<Dtype>* nets[] = { unfused_net.get(), this->net_.get() };
+  for (int n = 0; n < 2; ++n) {
+    Blob<Dtype>* out = nets[n]->ForwardPrefilled()[0];
+    caffe_copy(out->count(), out->cpu_data(), out->mutable_cpu_diff());
+    nets[n]->ClearParamDiffs();
+    nets[n]->Backward();
+  }
+  const Blob<Dtype>* expected = unfused_net->output_blobs()[0];
+  const Blob<Dtype>* actual = this->net_->output_blobs()[0];
+  ASSERT_EQ(expected->count(), actual->count());
+  for (int i = 0; i < expected->count(); ++i) {
+    EXPECT_NEAR(expected->cpu_data()[i], actual->cpu_data()[i], 1e-5);
+  }
+  const Blob<Dtype>* expected_input = unfused_net->input_blobs()[0];
+  const Blob<Dtype>* actual_input = this->net_->input_blobs()[0];
+  for (int i = 0; i < expected_input->count(); ++i) {
+    EXPECT_NEAR(expected_input->cpu_diff()[i], actual_input->cpu_diff()[i],
+        1e-5);
+  }
+  const vector<shared_ptr<Blob<Dtype> > >& expected_params =
+      unfused_net->params();
+  const vector<shared_ptr<Blob<Dtype> > >& actual_params =
+      this->net_->params();
+  ASSERT_EQ(expected_params.size(), actual_params.size());
+  for (int j = 0; j < expected_params.size(); ++j) {
+    for (int i = 0; i < expected_params[j]->count(); ++i) {
+      EXPECT_NEAR(expected_params[j]->cpu_diff()[i],
+                  actual_params[j]->cpu_diff()[i], 1e-5);
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestFuseElementwise) {
+  typedef typename TypeParam::Dtype Dtype;
+  // The sum, ReLU and power make one chain, which stops there as both the
+  // TanH and the Exp read its top.
+  Caffe::set_random_seed(this->seed_);
+  this->InitElementwiseNet("");
+  shared_ptr<Net<Dtype> > unfused_net = this->net_;
+  this->InitElementwiseNet("fuse_elementwise: true ");
+  EXPECT_EQ(unfused_net->layers().size() - 2, this->net_->layers().size());
+  EXPECT_TRUE(this->net_->has_layer("sum_chain"));
+  this->net_->ShareTrainedLayersWith(unfused_net.get());
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<Dtype> filler(filler_param);
+  for (int i = 0; i < 2; ++i) {
+    filler.Fill(unfused_net->input_blobs()[i]);
+    this->net_->input_blobs()[i]->CopyFrom(*unfused_net->input_blobs()[i]);
+  }
+  Net<Dtype>* nets[] = { unfused_net.get(), this->net_.get() };
+  for (int n = 0; n < 2; ++n) {
+    const vector<Blob<Dtype>*>& outs = nets[n]->ForwardPrefilled();
+    for (int j = 0; j < outs.size(); ++j) {
+      caffe_copy(outs[j]->count(), outs[j]->cpu_data(),
+          outs[j]->mutable_cpu_diff());
+    }
+    nets[n]->ClearParamDiffs();
+    nets[n]->Backward();
+  }
+  ASSERT_EQ(unfused_net->output_blobs().size(),
+      this->net_->output_blobs().size());
+  for (int j = 0; j < unfused_net->output_blobs().size(); ++j) {
+    const Blob<Dtype>* expected = unfused_net->output_blobs()[j];
+    const Blob<Dtype>* actual = this->net_->output_blobs()[j];
+    ASSERT_EQ(expected->count(), actual->count());
+    for (int i = 0; i < expected->count(); ++i) {
+      EXPECT_NEAR(expected->cpu_data()[i], actual->cpu_data()[i], 1e-5);
+    }
+  }
+  for (int j = 0; j < 2; ++j) {
+    const Blob<Dtype>* expected_input = unfused_net->input_blobs()[j];
+    const Blob<Dtype>* actual_input = this->net_->input_blobs()[j];
+    for (int i = 0; i < expected_input->count(); ++i) {
+      EXPECT_NEAR(expected_input->cpu_diff()[i], actual_input->cpu_diff()[i],
+          1e-5);
+    }
+  }
+  const vector<shared_ptr<Blob<Dtype> > >& expected_params =
+      unfused_net->params();
+  const vector<shared_ptr<Blob<Dtype> > >& actual_params =
+      this->net_->params();
+  ASSERT_EQ(expected_params.size(), actual_params.size());
+  for (int j = 0; j < expected_params.size(); ++j) {
+    for (int i = 0; i < expected_params[j]->count(); ++i) {
+      EXPECT_NEAR(expected_params[j]->cpu_diff()[i],
+                  actual_params[j]->cpu_diff()[i], 1e-5);
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestShareBlobViews) {
+  typedef typename TypeParam::Dtype Dtype;
+  // The parts of the concatenation are computed in place, the TanH reads its
+  // part of the slice in place, the Split of s1 adds to the diff of its first
+  // top, and both nets agree on Forward and Backward, also after reshaping to
+  // two items, where the parts are not contiguous.
+  Caffe::set_random_seed(this->seed_);
+  this->InitSliceConcatNet("");
+  shared_ptr<Net<Dtype> > copying_net = this->net_;
+  this->InitSliceConcatNet("share_blob_views: true ");
+  this->net_->ShareTrainedLayersWith(copying_net.get());
+  const Net<Dtype>& net = *this->net_;
+  const Dtype* concat = net.blob_by_name("concat")->cpu_data();
+  EXPECT_EQ(concat, net.blob_by_name("conv")->cpu_data());
+  EXPECT_EQ(concat + 2 * 9, net.blob_by_name("tanh")->cpu_data());
+  EXPECT_EQ(concat + 5 * 9, net.blob_by_name("s1")->cpu_data());
+  EXPECT_EQ(net.blob_by_name("data")->cpu_data() + 9,
+            net.blob_by_name("s2")->cpu_data());
+  EXPECT_EQ(net.blob_by_name("s1")->diff(),
+            net.blob_by_name("s1_slice_0_split_0")->diff());
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<Dtype> filler(filler_param);
+  Net<Dtype>* nets[] = { copying_net.get(), this->net_.get() };
+  for (int num = 1; num <= 2; ++num) {
+    for (int n = 0; n < 2; ++n) {
+      nets[n]->input_blobs()[0]->Reshape(num, 4, 3, 3);
+      nets[n]->Reshape();
+    }
+    filler.Fill(copying_net->input_blobs()[0]);
+    this->net_->input_blobs()[0]->CopyFrom(*copying_net->input_blobs()[0]);
+    for (int n = 0; n < 2; ++n) {
+      Blob<Dtype>* out = nets[n]->ForwardPrefilled()[0];
+      caffe_copy(out->count(), out->cpu_data(), out->mutable_cpu_diff());
+      nets[n]->ClearParamDiffs();
+      nets[n]->Backward();
+    }
+    const Blob<Dtype>* expected = copying_net->output_blobs()[0];
+    const Blob<Dtype>* actual = this->net_->output_blobs()[0];
+    ASSERT_EQ(expected->count(), actual->count());
+    for (int i = 0; i < expected->count(); ++i) {
+      EXPECT_EQ(expected->cpu_data()[i], actual->cpu_data()[i]);
+    }
+    const Blob<Dtype>* expected_input = copying_net->input_blobs()[0];
+    const Blob<Dtype>* actual_input = this->net_->input_blobs()[0];
+    for (int i = 0; i < expected_input->count(); ++i) {
+      EXPECT_EQ(expected_input->cpu_diff()[i], actual_input->cpu_diff()[i]);
+    }
+    const vector<shared_ptr<Blob<Dtype> > >& expected_params =
+        copying_net->params();
+    const vector<shared_ptr<Blob<Dtype> > >& actual_params =
+        this->net_->params();
+    for (int j = 0; j < expected_params.size(); ++j) {
+      for (int i = 0; i < expected_params[j]->count(); ++i) {
+        EXPECT_EQ(expected_params[j]->cpu_diff()[i],
+                  actual_params[j]->cpu_diff()[i]);
+      }
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestShareBlobViewsLayerThreads) {
+  typedef typename TypeParam::Dtype Dtype;
+  // The conv and tanh branches write their parts of the concatenation, and
+  // in Backward their parts of the input diff, on different threads. The
+  // first pass allocates the parents, and the parts stay views of them.
+  Caffe::set_random_seed(this->seed_);
+  this->InitSliceConcatNet("");
+  shared_ptr<Net<Dtype> > serial_net = this->net_;
+  this->InitSliceConcatNet("share_blob_views: true layer_threads: 4 ");
+  this->net_->ShareTrainedLayersWith(serial_net.get());
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<Dtype> filler(filler_param);
+  Net<Dtype>* nets[] = { serial_net.get(), this->net_.get() };
+  for (int iter = 0; iter < 2; ++iter) {
+    filler.Fill(serial_net->input_blobs()[0]);
+    this->net_->input_blobs()[0]->CopyFrom(*serial_net->input_blobs()[0]);
+    for (int n = 0; n < 2; ++n) {
+      Blob<Dtype>* out = nets[n]->ForwardPrefilled()[0];
+      caffe_copy(out->count(), out->cpu_data(), out->mutable_cpu_diff());
+      nets[n]->ClearParamDiffs();
+      nets[n]->Backward();
+    }
+    const Net<Dtype>& net = *this->net_;
+    const Dtype* concat = net.blob_by_name("concat")->cpu_data();
+    EXPECT_EQ(concat, net.blob_by_name("conv")->cpu_data());
+    EXPECT_EQ(concat + 2 * 9, net.blob_by_name("tanh")->cpu_data());
+    const Dtype* data_diff = net.blob_by_name("data")->cpu_diff();
+    EXPECT_EQ(data_diff + 9, net.blob_by_name("s2")->cpu_diff());
+    for (int i = 0; i < 6 * 9; ++i) {
+      EXPECT_EQ(serial_net->blob_by_name("concat")->cpu_data()[i],
+                concat[i]);
+    }
+    const Blob<Dtype>* expected = serial_net->output_blobs()[0];
+    const Blob<Dtype>* actual = this->net_->output_blobs()[0];
+    ASSERT_EQ(expected->count(), actual->count());
+    for (int i = 0; i < expected->count(); ++i) {
+      EXPECT_EQ(expected->cpu_data()[i], actual->cpu_data()[i]);
+    }
+    const Blob<Dtype>* expected_input = serial_net->input_blobs()[0];
+    for (int i = 0; i < expected_input->count(); ++i) {
+      EXPECT_EQ(expected_input->cpu_diff()[i], data_diff[i]);
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestChannelBlock) {
+  typedef typename TypeParam::Dtype Dtype;
+  // The first convolution and the last one, a 1x1 over all channels, keep
+  // the usual layout; the layers in between compute in the blocked one, with
+  // reorders into it before pool1 and out of it for out and the output pool2.
+  Caffe::set_random_seed(this->seed_);
+  this->InitBlockedNet("");
+  shared_ptr<Net<Dtype> > plain_net = this->net_;
+  this->InitBlockedNet("channel_block: 4 ");
+  this->net_->ShareTrainedLayersWith(plain_net.get());
+  int num_reorders = 0;
+  for (int i = 0; i < this->net_->layers().size(); ++i) {
+    const LayerParameter& layer_param = this->net_->layers()[i]->layer_param();
+    if (string(this->net_->layers()[i]->type()) == "Reorder") {
+      ++num_reorders;
+    } else {
+      const bool blocked = layer_param.name() != "conv1" &&
+          layer_param.name() != "relu1" && layer_param.name() != "out" &&
+          layer_param.type() != "Split";
+      EXPECT_EQ(blocked ? 4 : 0, layer_param.channel_block())
+          << layer_param.name();
+    }
+  }
+  EXPECT_EQ(3, num_reorders);
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(plain_net->input_blobs()[0]);
+  this->net_->input_blobs()[0]->CopyFrom(*plain_net->input_blobs()[0]);
+  plain_net->ForwardPrefilled();
+  this->net_->ForwardPrefilled();
+  ASSERT_EQ(2, this->net_->output_blobs().size());
+  const char* outputs[] = { "out", "pool2" };
+  for (int j = 0; j < 2; ++j) {
+    const Blob<Dtype>& expected = *plain_net->blob_by_name(outputs[j]);
+    const Blob<Dtype>& actual = *this->net_->blob_by_name(outputs[j]);
+    ASSERT_EQ(expected.shape(), actual.shape());
+    for (int i = 0; i < expected.count(); ++i) {
+      EXPECT_NEAR(expected.cpu_data()[i], actual.cpu_data()[i], 1e-4);
+    }
+  }
+}
+
 }  // namespace caffe
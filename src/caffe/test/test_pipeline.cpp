@@ -0,0 +1,187 @@
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/net.hpp"
+#include "caffe/pipeline.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class PipelineTest : public CPUDeviceTest<Dtype> {
+ protected:
+  PipelineTest() : seed_(1701) {}
+
+  NetParameter ParseNet(const string& proto) {
+    NetParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+    return param;
+  }
+
+  // A chain of layers on an input batch of 6.
+  NetParameter ChainNet() {
+    return ParseNet(
+        "name: 'ChainNetwork' "
+        "input: 'data' "
+        "input_shape { dim: 6 dim: 3 dim: 8 dim: 8 } "
+        "layer { "
+        "  name: 'conv' "
+        "  type: 'Convolution' "
+        "  bottom: 'data' "
+        "  top: 'conv' "
+        "  convolution_param { "
+        "    num_output: 4 "
+        "    kernel_size: 3 "
+        "    pad: 1 "
+        "    weight_filler { type: 'gaussian' std: 0.1 } "
+        "    bias_filler { type: 'gaussian' std: 0.1 } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'relu' "
+        "  type: 'ReLU' "
+        "  bottom: 'conv' "
+        "  top: 'conv' "
+        "} "
+        "layer { "
+        "  name: 'pool' "
+        "  type: 'Pooling' "
+        "  bottom: 'conv' "
+        "  top: 'pool' "
+        "  pooling_param { pool: MAX kernel_size: 2 stride: 2 } "
+        "} "
+        "layer { "
+        "  name: 'ip' "
+        "  type: 'InnerProduct' "
+        "  bottom: 'pool' "
+        "  top: 'ip' "
+        "  inner_product_param { "
+        "    num_output: 5 "
+        "    weight_filler { type: 'gaussian' std: 0.1 } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'prob' "
+        "  type: 'Softmax' "
+        "  bottom: 'ip' "
+        "  top: 'prob' "
+        "} ");
+  }
+
+  // Checks that the pipeline computes the outputs of the whole net.
+  void CheckForward(const PipelineParameter& pipeline_param) {
+    Caffe::set_random_seed(seed_);
+    const NetParameter param = ChainNet();
+    Net<Dtype> net(param);
+    FillerParameter filler_param;
+    filler_param.set_std(1);
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(net.input_blobs()[0]);
+    Blob<Dtype> input;
+    input.CopyFrom(*net.input_blobs()[0], false, true);
+    const Blob<Dtype>& expected = *net.ForwardPrefilled()[0];
+    Pipeline<Dtype> pipeline(param, net, pipeline_param);
+    EXPECT_EQ(2, pipeline.micro_batch());
+    // Run twice, to check that the stages are ready for more.
+    for (int run = 0; run < 2; ++run) {
+      const Blob<Dtype>& actual =
+          *pipeline.Forward(vector<Blob<Dtype>*>(1, &input))[0];
+      ASSERT_TRUE(expected.shape() == actual.shape());
+      for (int i = 0; i < expected.count(); ++i) {
+        EXPECT_NEAR(expected.cpu_data()[i], actual.cpu_data()[i], 1e-5);
+      }
+    }
+  }
+
+  int seed_;
+};
+
+TYPED_TEST_CASE(PipelineTest, TestDtypes);
+
+TYPED_TEST(PipelineTest, TestForward) {
+  PipelineParameter pipeline_param;
+  pipeline_param.set_stages(3);
+  pipeline_param.set_micro_batch(2);
+  pipeline_param.set_profile_iterations(1);
+  this->CheckForward(pipeline_param);
+}
+
+TYPED_TEST(PipelineTest, TestForwardOneStage) {
+  PipelineParameter pipeline_param;
+  pipeline_param.set_stages(1);
+  pipeline_param.set_micro_batch(2);
+  pipeline_param.set_queue_depth(1);
+  this->CheckForward(pipeline_param);
+}
+
+TYPED_TEST(PipelineTest, TestStageStart) {
+  typedef TypeParam Dtype;
+  PipelineParameter pipeline_param;
+  pipeline_param.set_stages(3);
+  pipeline_param.set_micro_batch(2);
+  pipeline_param.add_stage_start("relu");
+  pipeline_param.add_stage_start("ip");
+  this->CheckForward(pipeline_param);
+  Net<Dtype> net(this->ChainNet());
+  Pipeline<Dtype> pipeline(this->ChainNet(), net, pipeline_param);
+  ASSERT_EQ(3, pipeline.stage_starts().size());
+  EXPECT_EQ(0, pipeline.stage_starts()[0]);
+  EXPECT_EQ(1, pipeline.stage_starts()[1]);
+  EXPECT_EQ(3, pipeline.stage_starts()[2]);
+}
+
+TYPED_TEST(PipelineTest, TestRun) {
+  typedef TypeParam Dtype;
+  // A net reading its own data, with a constant loss of
+  // (2 * 4) * 2^2 / (2 * 2) = 8 per batch.
+  const NetParameter param = this->ParseNet(
+      "name: 'DataNetwork' "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'DummyData' "
+      "  top: 'data' "
+      "  top: 'target' "
+      "  dummy_data_param { "
+      "    shape { dim: 2 dim: 4 } "
+      "    shape { dim: 2 dim: 4 } "
+      "    data_filler { type: 'constant' value: 1 } "
+      "    data_filler { type: 'constant' value: 0 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'ip' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'data' "
+      "  top: 'ip' "
+      "  inner_product_param { "
+      "    num_output: 4 "
+      "    weight_filler { type: 'constant' value: 0.5 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'loss' "
+      "  type: 'EuclideanLoss' "
+      "  bottom: 'ip' "
+      "  bottom: 'target' "
+      "  top: 'loss' "
+      "} ");
+  Net<Dtype> net(param);
+  PipelineParameter pipeline_param;
+  pipeline_param.set_stages(2);
+  Pipeline<Dtype> pipeline(param, net, pipeline_param);
+  const vector<Blob<Dtype>*>& outputs = pipeline.Run(5);
+  ASSERT_EQ(1, outputs.size());
+  EXPECT_EQ("loss", pipeline.output_blob_names()[0]);
+  EXPECT_EQ(1, outputs[0]->count());
+  EXPECT_NEAR(8, outputs[0]->cpu_data()[0], 1e-5);
+}
+
+}  // namespace caffe
@@ -6,6 +6,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/pooling_layer.hpp"
+#include "caffe/util/blocked_layout.hpp"
 
 #ifdef USE_CUDNN
 #include "caffe/layers/cudnn_pooling_layer.hpp"
@@ -609,6 +610,45 @@ TYPED_TEST(PoolingLayerTest, TestGradientAvePadded) {
   }
 }
 
+TYPED_TEST(PoolingLayerTest, TestForwardBlocked) {
+  typedef typename TypeParam::Dtype Dtype;
+  const int block = 4;
+  this->blob_bottom_->Reshape(2, 8, 7, 6);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  Blob<Dtype> bottom_blocked, top_blocked, top;
+  bottom_blocked.ReshapeLike(*this->blob_bottom_);
+  reorder_to_blocked_cpu(2, 8, 7 * 6, block, this->blob_bottom_->cpu_data(),
+      bottom_blocked.mutable_cpu_data());
+  vector<Blob<Dtype>*> bottom_blocked_vec(1, &bottom_blocked);
+  vector<Blob<Dtype>*> top_blocked_vec(1, &top_blocked);
+  const PoolingParameter_PoolMethod pools[] = {
+      PoolingParameter_PoolMethod_MAX, PoolingParameter_PoolMethod_AVE };
+  for (int i = 0; i < 2; ++i) {
+    LayerParameter layer_param;
+    PoolingParameter* pooling_param = layer_param.mutable_pooling_param();
+    pooling_param->set_kernel_size(3);
+    pooling_param->set_stride(2);
+    pooling_param->set_pad(1);
+    pooling_param->set_pool(pools[i]);
+    PoolingLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    layer_param.set_channel_block(block);
+    PoolingLayer<Dtype> blocked_layer(layer_param);
+    blocked_layer.SetUp(bottom_blocked_vec, top_blocked_vec);
+    blocked_layer.Forward(bottom_blocked_vec, top_blocked_vec);
+    ASSERT_EQ(this->blob_top_->shape(), top_blocked.shape());
+    top.ReshapeLike(top_blocked);
+    reorder_from_blocked_cpu(2, 8, top.count(2), block,
+        top_blocked.cpu_data(), top.mutable_cpu_data());
+    for (int j = 0; j < top.count(); ++j) {
+      EXPECT_NEAR(this->blob_top_->cpu_data()[j], top.cpu_data()[j], 1e-5);
+    }
+  }
+}
+
 #ifdef USE_CUDNN
 template <typename Dtype>
 class CuDNNPoolingLayerTest : public GPUDeviceTest<Dtype> {
@@ -0,0 +1,152 @@
+#include <stdint.h>
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/conv_layer.hpp"
+#include "caffe/layers/quantized_conv_layer.hpp"
+#include "caffe/util/quantize.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class QuantizedConvolutionLayerTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  QuantizedConvolutionLayerTest()
+      : blob_bottom_(new Blob<Dtype>(2, 4, 6, 5)),
+        blob_top_(new Blob<Dtype>()) {
+    // fill the values
+    FillerParameter filler_param;
+    filler_param.set_min(-1);
+    filler_param.set_max(1);
+    UniformFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+  virtual ~QuantizedConvolutionLayerTest() {
+    delete blob_bottom_;
+    delete blob_top_;
+  }
+
+  void MakeParam(LayerParameter* layer_param) {
+    ConvolutionParameter* convolution_param =
+        layer_param->mutable_convolution_param();
+    convolution_param->set_num_output(6);
+    convolution_param->mutable_weight_filler()->set_type("uniform");
+    convolution_param->mutable_bias_filler()->set_type("uniform");
+    layer_param->mutable_quantization_param()->set_bottom_scale(
+        quantization_scale(blob_bottom_->count(), blob_bottom_->cpu_data()));
+  }
+
+  // Checks the output against a float convolution of the dequantized
+  // weights and bottom.
+  void CheckForward(const LayerParameter& layer_param) {
+    QuantizedConvolutionLayer<Dtype> layer(layer_param);
+    layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    layer.Forward(blob_bottom_vec_, blob_top_vec_);
+    const vector<shared_ptr<Blob<Dtype> > >& blobs = layer.blobs();
+    const Dtype bottom_scale = layer_param.quantization_param().bottom_scale();
+    Blob<Dtype> bottom(blob_bottom_->shape());
+    vector<int8_t> quantized_bottom(bottom.count());
+    quantize_cpu(bottom.count(), bottom_scale, blob_bottom_->cpu_data(),
+        &quantized_bottom[0]);
+    for (int i = 0; i < bottom.count(); ++i) {
+      bottom.mutable_cpu_data()[i] = quantized_bottom[i] * bottom_scale;
+    }
+    LayerParameter reference_param(layer_param);
+    reference_param.set_type("Convolution");
+    ConvolutionLayer<Dtype> reference_layer(reference_param);
+    Blob<Dtype> top;
+    vector<Blob<Dtype>*> bottom_vec(1, &bottom);
+    vector<Blob<Dtype>*> top_vec(1, &top);
+    reference_layer.SetUp(bottom_vec, top_vec);
+    const int outputs = blobs[0]->shape(0);
+    const int weights_per_output = blobs[0]->count(1);
+    Dtype* weights = reference_layer.blobs()[0]->mutable_cpu_data();
+    for (int o = 0; o < outputs; ++o) {
+      for (int k = 0; k < weights_per_output; ++k) {
+        const int index = o * weights_per_output + k;
+        weights[index] = blobs[0]->cpu_data()[index] * blobs[2]->cpu_data()[o];
+      }
+    }
+    reference_layer.blobs()[1]->CopyFrom(*blobs[1]);
+    reference_layer.Forward(bottom_vec, top_vec);
+    ASSERT_EQ(top.count(), blob_top_->count());
+    for (int i = 0; i < top.count(); ++i) {
+      EXPECT_NEAR(blob_top_->cpu_data()[i], top.cpu_data()[i], 1e-4);
+    }
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(QuantizedConvolutionLayerTest, TestDtypesAndDevices);
+
+TYPED_TEST(QuantizedConvolutionLayerTest, TestForward) {
+  LayerParameter layer_param;
+  this->MakeParam(&layer_param);
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->add_stride(2);
+  this->CheckForward(layer_param);
+}
+
+TYPED_TEST(QuantizedConvolutionLayerTest, TestForwardGroup) {
+  LayerParameter layer_param;
+  this->MakeParam(&layer_param);
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_group(2);
+  this->CheckForward(layer_param);
+}
+
+TYPED_TEST(QuantizedConvolutionLayerTest, TestForward1x1) {
+  LayerParameter layer_param;
+  this->MakeParam(&layer_param);
+  layer_param.mutable_convolution_param()->add_kernel_size(1);
+  this->CheckForward(layer_param);
+}
+
+TYPED_TEST(QuantizedConvolutionLayerTest, TestToProto) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  this->MakeParam(&layer_param);
+  layer_param.mutable_convolution_param()->add_kernel_size(3);
+  QuantizedConvolutionLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // The weights are saved with one byte per value.
+  LayerParameter saved_param;
+  layer.ToProto(&saved_param);
+  ASSERT_EQ(saved_param.blobs_size(), 3);
+  EXPECT_EQ(saved_param.blobs(0).data_size(), 0);
+  EXPECT_EQ(saved_param.blobs(0).int8_data().size(),
+      layer.blobs()[0]->count());
+  Blob<Dtype> top;
+  vector<Blob<Dtype>*> top_vec(1, &top);
+  QuantizedConvolutionLayer<Dtype> loaded_layer(saved_param);
+  loaded_layer.SetUp(this->blob_bottom_vec_, top_vec);
+  loaded_layer.Forward(this->blob_bottom_vec_, top_vec);
+  ASSERT_EQ(top.count(), this->blob_top_->count());
+  for (int i = 0; i < top.count(); ++i) {
+    EXPECT_EQ(top.cpu_data()[i], this->blob_top_->cpu_data()[i]);
+  }
+}
+
+}  // namespace caffe
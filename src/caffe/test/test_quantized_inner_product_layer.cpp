@@ -0,0 +1,149 @@
+#include <stdint.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/quantized_inner_product_layer.hpp"
+#include "caffe/util/quantize.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class QuantizedInnerProductLayerTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  QuantizedInnerProductLayerTest()
+      : blob_bottom_(new Blob<Dtype>(2, 3, 4, 5)),
+        blob_top_(new Blob<Dtype>()) {
+    // fill the values
+    FillerParameter filler_param;
+    filler_param.set_min(-1);
+    filler_param.set_max(1);
+    UniformFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+  virtual ~QuantizedInnerProductLayerTest() {
+    delete blob_bottom_;
+    delete blob_top_;
+  }
+
+  void MakeParam(LayerParameter* layer_param) {
+    InnerProductParameter* inner_product_param =
+        layer_param->mutable_inner_product_param();
+    inner_product_param->set_num_output(10);
+    inner_product_param->mutable_weight_filler()->set_type("uniform");
+    inner_product_param->mutable_bias_filler()->set_type("uniform");
+    inner_product_param->mutable_bias_filler()->set_min(1);
+    inner_product_param->mutable_bias_filler()->set_max(2);
+    layer_param->mutable_quantization_param()->set_bottom_scale(
+        quantization_scale(blob_bottom_->count(), blob_bottom_->cpu_data()));
+  }
+
+  // Computes the output with the dequantized weights and bottom in Dtype.
+  void Reference(Layer<Dtype>* layer, const Dtype bottom_scale,
+      Blob<Dtype>* reference) {
+    const int M = blob_bottom_->num();
+    const int K = blob_bottom_->count(1);
+    const vector<shared_ptr<Blob<Dtype> > >& blobs = layer->blobs();
+    const int N = blobs[0]->shape(0);
+    vector<int8_t> bottom(M * K);
+    quantize_cpu(M * K, bottom_scale, blob_bottom_->cpu_data(), &bottom[0]);
+    reference->Reshape(M, N, 1, 1);
+    const Dtype* weights = blobs[0]->cpu_data();
+    const Dtype* bias = blobs[1]->cpu_data();
+    const Dtype* scales = blobs[2]->cpu_data();
+    for (int m = 0; m < M; ++m) {
+      for (int n = 0; n < N; ++n) {
+        Dtype sum = bias[n];
+        for (int k = 0; k < K; ++k) {
+          sum += bottom[m * K + k] * bottom_scale *
+              weights[n * K + k] * scales[n];
+        }
+        reference->mutable_cpu_data()[m * N + n] = sum;
+      }
+    }
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(QuantizedInnerProductLayerTest, TestDtypesAndDevices);
+
+TYPED_TEST(QuantizedInnerProductLayerTest, TestSetUp) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  this->MakeParam(&layer_param);
+  QuantizedInnerProductLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(this->blob_top_->num(), 2);
+  EXPECT_EQ(this->blob_top_->channels(), 10);
+  // The filled weights are quantized to integers with one scale per output.
+  ASSERT_EQ(layer.blobs().size(), 3);
+  EXPECT_EQ(layer.blobs()[2]->count(), 10);
+  const Dtype* weights = layer.blobs()[0]->cpu_data();
+  Dtype max_weight = 0;
+  for (int i = 0; i < layer.blobs()[0]->count(); ++i) {
+    EXPECT_EQ(weights[i], static_cast<int>(weights[i]));
+    EXPECT_LE(std::abs(weights[i]), 127);
+    max_weight = std::max(max_weight, std::abs(weights[i]));
+  }
+  EXPECT_EQ(max_weight, 127);
+}
+
+TYPED_TEST(QuantizedInnerProductLayerTest, TestForward) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  this->MakeParam(&layer_param);
+  QuantizedInnerProductLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  Blob<Dtype> reference;
+  this->Reference(&layer, layer_param.quantization_param().bottom_scale(),
+      &reference);
+  ASSERT_EQ(reference.count(), this->blob_top_->count());
+  const Dtype* data = this->blob_top_->cpu_data();
+  for (int i = 0; i < reference.count(); ++i) {
+    EXPECT_NEAR(data[i], reference.cpu_data()[i], 1e-4);
+  }
+}
+
+TYPED_TEST(QuantizedInnerProductLayerTest, TestToProto) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  this->MakeParam(&layer_param);
+  QuantizedInnerProductLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // The weights are saved with one byte per value.
+  LayerParameter saved_param;
+  layer.ToProto(&saved_param);
+  ASSERT_EQ(saved_param.blobs_size(), 3);
+  EXPECT_EQ(saved_param.blobs(0).data_size(), 0);
+  EXPECT_EQ(saved_param.blobs(0).int8_data().size(),
+      layer.blobs()[0]->count());
+  Blob<Dtype> top;
+  vector<Blob<Dtype>*> top_vec(1, &top);
+  QuantizedInnerProductLayer<Dtype> loaded_layer(saved_param);
+  loaded_layer.SetUp(this->blob_bottom_vec_, top_vec);
+  loaded_layer.Forward(this->blob_bottom_vec_, top_vec);
+  ASSERT_EQ(top.count(), this->blob_top_->count());
+  for (int i = 0; i < top.count(); ++i) {
+    EXPECT_EQ(top.cpu_data()[i], this->blob_top_->cpu_data()[i]);
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,80 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/reorder_layer.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+#include "caffe/test/test_gradient_check_util.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class ReorderLayerTest : public CPUDeviceTest<Dtype> {
+ protected:
+  ReorderLayerTest()
+      : blob_bottom_(new Blob<Dtype>(2, 6, 3, 4)),
+        blob_top_(new Blob<Dtype>()) {
+    Caffe::set_random_seed(1701);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+  virtual ~ReorderLayerTest() { delete blob_bottom_; delete blob_top_; }
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(ReorderLayerTest, TestDtypes);
+
+TYPED_TEST(ReorderLayerTest, TestForward) {
+  typedef TypeParam Dtype;
+  LayerParameter layer_param;
+  layer_param.set_channel_block(3);
+  ReorderLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(this->blob_bottom_->shape(), this->blob_top_->shape());
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  const int spatial = 3 * 4;
+  for (int n = 0; n < 2; ++n) {
+    for (int c = 0; c < 6; ++c) {
+      for (int p = 0; p < spatial; ++p) {
+        EXPECT_EQ(this->blob_bottom_->cpu_data()[(n * 6 + c) * spatial + p],
+            this->blob_top_->cpu_data()[
+            ((n * 2 + c / 3) * spatial + p) * 3 + c % 3]);
+      }
+    }
+  }
+  // And back.
+  Blob<Dtype> back;
+  vector<Blob<Dtype>*> back_vec(1, &back);
+  layer_param.mutable_reorder_param()->set_to_blocked(false);
+  ReorderLayer<Dtype> back_layer(layer_param);
+  back_layer.SetUp(this->blob_top_vec_, back_vec);
+  back_layer.Forward(this->blob_top_vec_, back_vec);
+  for (int i = 0; i < back.count(); ++i) {
+    EXPECT_EQ(this->blob_bottom_->cpu_data()[i], back.cpu_data()[i]);
+  }
+}
+
+TYPED_TEST(ReorderLayerTest, TestGradient) {
+  typedef TypeParam Dtype;
+  for (int to_blocked = 0; to_blocked <= 1; ++to_blocked) {
+    LayerParameter layer_param;
+    layer_param.set_channel_block(2);
+    layer_param.mutable_reorder_param()->set_to_blocked(to_blocked);
+    ReorderLayer<Dtype> layer(layer_param);
+    GradientChecker<Dtype> checker(1e-2, 1e-3);
+    checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+        this->blob_top_vec_);
+  }
+}
+
+}  // namespace caffe
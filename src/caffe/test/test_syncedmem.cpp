@@ -67,6 +67,44 @@ TEST_F(SyncedMemoryTest, TestCPUWrite) {
   }
 }
 
+TEST_F(SyncedMemoryTest, TestView) {
+  shared_ptr<SyncedMemory> mem(new SyncedMemory(10));
+  shared_ptr<SyncedMemory> view(new SyncedMemory(mem, 2, 6));
+  SyncedMemory view_of_view(view, 3, 2);
+  EXPECT_EQ(view->size(), 6);
+  EXPECT_EQ(view->head(), SyncedMemory::UNINITIALIZED);
+  char* cpu_data = static_cast<char*>(mem->mutable_cpu_data());
+  caffe_memset(mem->size(), 1, cpu_data);
+  EXPECT_EQ(view->head(), SyncedMemory::HEAD_AT_CPU);
+  EXPECT_EQ(view->cpu_data(), cpu_data + 2);
+  EXPECT_EQ(view_of_view.cpu_data(), cpu_data + 5);
+  // Writing the views writes their range of the memory.
+  caffe_memset(view->size(), 2, view->mutable_cpu_data());
+  caffe_memset(view_of_view.size(), 3, view_of_view.mutable_cpu_data());
+  const char expected[] = { 1, 1, 2, 2, 2, 3, 3, 2, 1, 1 };
+  for (int i = 0; i < mem->size(); ++i) {
+    EXPECT_EQ(cpu_data[i], expected[i]);
+  }
+}
+
+TEST_F(SyncedMemoryTest, TestViewVersion) {
+  shared_ptr<SyncedMemory> mem(new SyncedMemory(10));
+  SyncedMemory view(mem, 2, 6);
+  // The first write through the view allocates the parent.
+  view.mutable_cpu_data();
+  EXPECT_EQ(mem->head(), SyncedMemory::HEAD_AT_CPU);
+  const unsigned int mem_version = mem->version();
+  const unsigned int view_version = view.version();
+  // Later ones leave the parent alone, but still change the view's version.
+  view.mutable_cpu_data();
+  EXPECT_EQ(mem->version(), mem_version);
+  EXPECT_GT(view.version(), view_version);
+  // Writes to the parent change the versions of both.
+  mem->mutable_cpu_data();
+  EXPECT_GT(mem->version(), mem_version);
+  EXPECT_GT(view.version(), view_version + 1);
+}
+
 #ifndef CPU_ONLY  // GPU test
 
 TEST_F(SyncedMemoryTest, TestGPURead) {
@@ -0,0 +1,254 @@
+#include <boost/thread.hpp>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/lrn_layer.hpp"
+#include "caffe/layers/pooling_layer.hpp"
+#include "caffe/layers/softmax_layer.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class ThreadPoolTest : public ::testing::Test {
+ protected:
+  ThreadPoolTest() : threads_(Caffe::cpu_threads()) {}
+  virtual void SetUp() { Caffe::set_cpu_threads(4); }
+  virtual void TearDown() { Caffe::set_cpu_threads(threads_); }
+
+  const int threads_;
+};
+
+// Counts the calls for each iteration and the ranges it is called with.
+struct CountBody {
+  explicit CountBody(int n) : counts(n, 0), ranges(0) {}
+  void operator()(int begin, int end) const {
+    EXPECT_LT(begin, end);
+    for (int i = begin; i < end; ++i) {
+      ++counts[i];
+    }
+    boost::mutex::scoped_lock lock(mutex);
+    ++ranges;
+  }
+  mutable vector<int> counts;
+  mutable int ranges;
+  mutable boost::mutex mutex;
+};
+
+// Runs a parallel_for from each of its iterations.
+struct NestedBody {
+  explicit NestedBody(vector<int>* counts) : counts(counts) {}
+  void operator()(int begin, int end) const {
+    for (int i = begin; i < end; ++i) {
+      CountBody body(10);
+      parallel_for(10, body);
+      for (int j = 0; j < 10; ++j) {
+        (*counts)[i * 10 + j] = body.counts[j];
+      }
+    }
+  }
+  vector<int>* counts;
+};
+
+TEST_F(ThreadPoolTest, TestCoversRange) {
+  const int sizes[] = { 1, 2, 3, 7, 100, 1001 };
+  for (int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+    CountBody body(sizes[s]);
+    parallel_for(sizes[s], body);
+    for (int i = 0; i < sizes[s]; ++i) {
+      EXPECT_EQ(1, body.counts[i]);
+    }
+    EXPECT_LE(body.ranges, 4);
+  }
+}
+
+TEST_F(ThreadPoolTest, TestGrain) {
+  // Loops shorter than two grains run in one call.
+  CountBody body(100);
+  parallel_for(100, body, 60);
+  EXPECT_EQ(1, body.ranges);
+  CountBody split_body(100);
+  parallel_for(100, split_body, 20);
+  EXPECT_EQ(4, split_body.ranges);
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(1, split_body.counts[i]);
+  }
+}
+
+TEST_F(ThreadPoolTest, TestNested) {
+  vector<int> counts(100 * 10, 0);
+  parallel_for(100, NestedBody(&counts));
+  for (int i = 0; i < counts.size(); ++i) {
+    EXPECT_EQ(1, counts[i]);
+  }
+}
+
+TEST_F(ThreadPoolTest, TestConcurrentCallers) {
+  vector<int> counts_a(1000 * 10, 0);
+  vector<int> counts_b(1000 * 10, 0);
+  boost::thread thread_a(NestedBody(&counts_a), 0, 1000);
+  boost::thread thread_b(NestedBody(&counts_b), 0, 1000);
+  thread_a.join();
+  thread_b.join();
+  for (int i = 0; i < counts_a.size(); ++i) {
+    EXPECT_EQ(1, counts_a[i]);
+    EXPECT_EQ(1, counts_b[i]);
+  }
+}
+
+// Records the ranges of a loop by their first iteration.
+struct RangeBody {
+  explicit RangeBody(int n) : begins(n, -1), ends(n, -1), ranges(0) {}
+  void operator()(int begin, int end) const {
+    begins[begin] = begin;
+    ends[begin] = end;
+    boost::mutex::scoped_lock lock(mutex);
+    ++ranges;
+  }
+  mutable vector<int> begins;
+  mutable vector<int> ends;
+  mutable int ranges;
+  mutable boost::mutex mutex;
+};
+
+TEST_F(ThreadPoolTest, TestWorkerPool) {
+  // The ranges of a worker pool only depend on its threads, and it runs
+  // while the process-wide pool is busy.
+  WorkerPool pool(3);
+  vector<int> counts(100 * 10, 0);
+  boost::thread busy(NestedBody(&counts), 0, 100);
+  for (int iter = 0; iter < 10; ++iter) {
+    RangeBody body(3);
+    pool.parallel_for(3, body);
+    for (int i = 0; i < 3; ++i) {
+      EXPECT_EQ(i, body.begins[i]);
+      EXPECT_EQ(i + 1, body.ends[i]);
+    }
+    EXPECT_EQ(3, body.ranges);
+  }
+  // As many ranges as the grain allows.
+  RangeBody body(10);
+  pool.parallel_for(10, body, 4);
+  EXPECT_EQ(2, body.ranges);
+  EXPECT_EQ(5, body.ends[0]);
+  EXPECT_EQ(10, body.ends[5]);
+  busy.join();
+}
+
+TEST_F(ThreadPoolTest, TestSetParallelForPool) {
+  // The loops of a thread with a pool of its own run on it, whatever
+  // Caffe::cpu_threads(), and those started from their bodies serially.
+  WorkerPool pool(3);
+  SetParallelForPool(&pool);
+  Caffe::set_cpu_threads(1);
+  CountBody body(100);
+  parallel_for(100, body);
+  EXPECT_EQ(3, body.ranges);
+  vector<int> counts(100 * 10, 0);
+  parallel_for(100, NestedBody(&counts));
+  for (int i = 0; i < counts.size(); ++i) {
+    EXPECT_EQ(1, counts[i]);
+  }
+  // A pool pinned to cores has a thread per core.
+  WorkerPool pinned_pool(vector<int>(2, 0));
+  EXPECT_EQ(2, pinned_pool.threads());
+  SetParallelForPool(&pinned_pool);
+  CountBody pinned_body(100);
+  parallel_for(100, pinned_body);
+  EXPECT_EQ(2, pinned_body.ranges);
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(1, pinned_body.counts[i]);
+  }
+  SetParallelForPool(NULL);
+  Caffe::set_cpu_threads(4);
+  CountBody shared_body(100);
+  parallel_for(100, shared_body);
+  EXPECT_EQ(4, shared_body.ranges);
+}
+
+template <typename TypeParam>
+class ParallelLayerTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  ParallelLayerTest() : threads_(Caffe::cpu_threads()) {}
+  virtual void TearDown() { Caffe::set_cpu_threads(threads_); }
+
+  // Checks that the layer computes the same with 1 and 4 threads.
+  void CheckThreads(const LayerParameter& layer_param) {
+    Blob<Dtype> bottom(3, 6, 9, 8);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(&bottom);
+    vector<Blob<Dtype>*> bottom_vec(1, &bottom);
+    Blob<Dtype> serial_top;
+    Blob<Dtype> serial_diff;
+    for (int threads = 1; threads <= 4; threads += 3) {
+      Caffe::set_cpu_threads(threads);
+      Blob<Dtype> top;
+      vector<Blob<Dtype>*> top_vec(1, &top);
+      shared_ptr<Layer<Dtype> > layer =
+          LayerRegistry<Dtype>::CreateLayer(layer_param);
+      layer->SetUp(bottom_vec, top_vec);
+      layer->Forward(bottom_vec, top_vec);
+      for (int i = 0; i < top.count(); ++i) {
+        top.mutable_cpu_diff()[i] = top.cpu_data()[i] * i;
+      }
+      layer->Backward(top_vec, vector<bool>(1, true), bottom_vec);
+      if (threads == 1) {
+        serial_top.CopyFrom(top, false, true);
+        serial_diff.CopyFrom(bottom, true, true);
+        continue;
+      }
+      for (int i = 0; i < top.count(); ++i) {
+        EXPECT_EQ(serial_top.cpu_data()[i], top.cpu_data()[i]);
+      }
+      for (int i = 0; i < bottom.count(); ++i) {
+        EXPECT_EQ(serial_diff.cpu_diff()[i], bottom.cpu_diff()[i]);
+      }
+    }
+  }
+
+  const int threads_;
+};
+
+TYPED_TEST_CASE(ParallelLayerTest, TestDtypesAndDevices);
+
+TYPED_TEST(ParallelLayerTest, TestPooling) {
+  LayerParameter layer_param;
+  layer_param.set_type("Pooling");
+  PoolingParameter* pooling_param = layer_param.mutable_pooling_param();
+  pooling_param->set_kernel_size(3);
+  pooling_param->set_stride(2);
+  this->CheckThreads(layer_param);
+  pooling_param->set_pool(PoolingParameter_PoolMethod_AVE);
+  pooling_param->set_pad(1);
+  this->CheckThreads(layer_param);
+}
+
+TYPED_TEST(ParallelLayerTest, TestLRN) {
+  LayerParameter layer_param;
+  layer_param.set_type("LRN");
+  this->CheckThreads(layer_param);
+}
+
+TYPED_TEST(ParallelLayerTest, TestSoftmax) {
+  LayerParameter layer_param;
+  layer_param.set_type("Softmax");
+  this->CheckThreads(layer_param);
+}
+
+TYPED_TEST(ParallelLayerTest, TestBatchNorm) {
+  LayerParameter layer_param;
+  layer_param.set_type("BatchNorm");
+  this->CheckThreads(layer_param);
+  layer_param.mutable_batch_norm_param()->set_use_global_stats(true);
+  this->CheckThreads(layer_param);
+}
+
+}  // namespace caffe
@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <cmath>
+
+#include "caffe/util/activation.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+namespace {
+
+// The activations, computing as the ReLU, Sigmoid and TanH layers do.
+template <typename Dtype>
+struct Identity {
+  Dtype operator()(Dtype x) const { return x; }
+};
+
+template <typename Dtype>
+struct ReLU {
+  explicit ReLU(Dtype negative_slope) : negative_slope(negative_slope) {}
+  Dtype operator()(Dtype x) const {
+    return std::max(x, Dtype(0)) + negative_slope * std::min(x, Dtype(0));
+  }
+  // The derivative, given the output; the slope is not negative.
+  Dtype derivative(Dtype y) const {
+    return (y > 0) + negative_slope * (y <= 0);
+  }
+  const Dtype negative_slope;
+};
+
+template <typename Dtype>
+struct Sigmoid {
+  Dtype operator()(Dtype x) const { return 1. / (1. + exp(-x)); }
+  Dtype derivative(Dtype y) const { return y * (1. - y); }
+};
+
+template <typename Dtype>
+struct TanH {
+  Dtype operator()(Dtype x) const { return tanh(x); }
+  Dtype derivative(Dtype y) const { return 1 - y * y; }
+};
+
+template <typename Dtype, typename Op>
+struct BiasActivation {
+  BiasActivation(int cols, const Dtype* row_bias, const Dtype* col_bias,
+      Dtype* data, const Op& op)
+      : cols(cols), row_bias(row_bias), col_bias(col_bias), data(data),
+        op(op) {}
+  void operator()(int begin, int end) const {
+    for (int r = begin; r < end; ++r) {
+      Dtype* row = data + static_cast<size_t>(r) * cols;
+      const Dtype bias = row_bias ? row_bias[r] : Dtype(0);
+      if (col_bias) {
+        for (int c = 0; c < cols; ++c) {
+          row[c] = op(row[c] + bias + col_bias[c]);
+        }
+      } else {
+        for (int c = 0; c < cols; ++c) {
+          row[c] = op(row[c] + bias);
+        }
+      }
+    }
+  }
+  const int cols;
+  const Dtype* const row_bias;
+  const Dtype* const col_bias;
+  Dtype* const data;
+  const Op op;
+};
+
+template <typename Dtype, typename Op>
+struct ActivationBackward {
+  ActivationBackward(const Dtype* data, Dtype* diff, const Op& op)
+      : data(data), diff(diff), op(op) {}
+  void operator()(int begin, int end) const {
+    for (int i = begin; i < end; ++i) {
+      diff[i] *= op.derivative(data[i]);
+    }
+  }
+  const Dtype* const data;
+  Dtype* const diff;
+  const Op op;
+};
+
+template <typename Dtype, typename Op>
+void BiasActivationRows(int rows, int cols, const Dtype* row_bias,
+    const Dtype* col_bias, Dtype* data, const Op& op) {
+  parallel_for(rows,
+      BiasActivation<Dtype, Op>(cols, row_bias, col_bias, data, op),
+      std::max(1, kElementwiseGrain / std::max(cols, 1)));
+}
+
+template <typename Dtype, typename Op>
+void ActivationDerivative(int n, const Dtype* data, Dtype* diff,
+    const Op& op) {
+  parallel_for(n, ActivationBackward<Dtype, Op>(data, diff, op),
+      kElementwiseGrain);
+}
+
+}  // namespace
+
+template <typename Dtype>
+void activation_forward_cpu(const ActivationParameter& param, const int rows,
+    const int cols, const Dtype* row_bias, const Dtype* col_bias,
+    Dtype* data) {
+  switch (param.type()) {
+  case ActivationParameter_Type_NONE:
+    if (row_bias || col_bias) {
+      BiasActivationRows(rows, cols, row_bias, col_bias, data,
+          Identity<Dtype>());
+    }
+    break;
+  case ActivationParameter_Type_RELU:
+    BiasActivationRows(rows, cols, row_bias, col_bias, data,
+        ReLU<Dtype>(param.negative_slope()));
+    break;
+  case ActivationParameter_Type_SIGMOID:
+    BiasActivationRows(rows, cols, row_bias, col_bias, data,
+        Sigmoid<Dtype>());
+    break;
+  case ActivationParameter_Type_TANH:
+    BiasActivationRows(rows, cols, row_bias, col_bias, data, TanH<Dtype>());
+    break;
+  default:
+    LOG(FATAL) << "Unknown activation " << param.type();
+  }
+}
+
+template void activation_forward_cpu<float>(const ActivationParameter& param,
+    const int rows, const int cols, const float* row_bias,
+    const float* col_bias, float* data);
+template void activation_forward_cpu<double>(const ActivationParameter& param,
+    const int rows, const int cols, const double* row_bias,
+    const double* col_bias, double* data);
+
+template <typename Dtype>
+void activation_backward_cpu(const ActivationParameter& param, const int n,
+    const Dtype* data, Dtype* diff) {
+  switch (param.type()) {
+  case ActivationParameter_Type_NONE:
+    break;
+  case ActivationParameter_Type_RELU:
+    ActivationDerivative(n, data, diff, ReLU<Dtype>(param.negative_slope()));
+    break;
+  case ActivationParameter_Type_SIGMOID:
+    ActivationDerivative(n, data, diff, Sigmoid<Dtype>());
+    break;
+  case ActivationParameter_Type_TANH:
+    ActivationDerivative(n, data, diff, TanH<Dtype>());
+    break;
+  default:
+    LOG(FATAL) << "Unknown activation " << param.type();
+  }
+}
+
+template void activation_backward_cpu<float>(const ActivationParameter& param,
+    const int n, const float* data, float* diff);
+template void activation_backward_cpu<double>(
+    const ActivationParameter& param, const int n, const double* data,
+    double* diff);
+
+}  // namespace caffe
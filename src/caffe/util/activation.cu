@@ -0,0 +1,74 @@
+#include "caffe/util/activation.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+__global__ void ActivationForward(const int n, const int type,
+    const Dtype negative_slope, Dtype* data) {
+  CUDA_KERNEL_LOOP(index, n) {
+    const Dtype x = data[index];
+    switch (type) {
+    case ActivationParameter_Type_RELU:
+      data[index] = x > 0 ? x : x * negative_slope;
+      break;
+    case ActivationParameter_Type_SIGMOID:
+      data[index] = 0.5 * tanh(0.5 * x) + 0.5;
+      break;
+    case ActivationParameter_Type_TANH:
+      data[index] = tanh(x);
+      break;
+    }
+  }
+}
+
+template <typename Dtype>
+__global__ void ActivationBackward(const int n, const int type,
+    const Dtype negative_slope, const Dtype* data, Dtype* diff) {
+  CUDA_KERNEL_LOOP(index, n) {
+    const Dtype y = data[index];
+    switch (type) {
+    case ActivationParameter_Type_RELU:
+      diff[index] *= (y > 0) + (y <= 0) * negative_slope;
+      break;
+    case ActivationParameter_Type_SIGMOID:
+      diff[index] *= y * (1 - y);
+      break;
+    case ActivationParameter_Type_TANH:
+      diff[index] *= 1 - y * y;
+      break;
+    }
+  }
+}
+
+template <typename Dtype>
+void activation_forward_gpu(const ActivationParameter& param, const int n,
+    Dtype* data) {
+  if (param.type() == ActivationParameter_Type_NONE) { return; }
+  // NOLINT_NEXT_LINE(whitespace/operators)
+  ActivationForward<Dtype><<<CAFFE_GET_BLOCKS(n), CAFFE_CUDA_NUM_THREADS>>>(
+      n, param.type(), Dtype(param.negative_slope()), data);
+  CUDA_POST_KERNEL_CHECK;
+}
+
+template void activation_forward_gpu<float>(const ActivationParameter& param,
+    const int n, float* data);
+template void activation_forward_gpu<double>(const ActivationParameter& param,
+    const int n, double* data);
+
+template <typename Dtype>
+void activation_backward_gpu(const ActivationParameter& param, const int n,
+    const Dtype* data, Dtype* diff) {
+  if (param.type() == ActivationParameter_Type_NONE) { return; }
+  // NOLINT_NEXT_LINE(whitespace/operators)
+  ActivationBackward<Dtype><<<CAFFE_GET_BLOCKS(n), CAFFE_CUDA_NUM_THREADS>>>(
+      n, param.type(), Dtype(param.negative_slope()), data, diff);
+  CUDA_POST_KERNEL_CHECK;
+}
+
+template void activation_backward_gpu<float>(const ActivationParameter& param,
+    const int n, const float* data, float* diff);
+template void activation_backward_gpu<double>(
+    const ActivationParameter& param, const int n, const double* data,
+    double* diff);
+
+}  // namespace caffe
@@ -0,0 +1,324 @@
+#include <algorithm>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+
+#include "caffe/common.hpp"
+#include "caffe/util/blocked_layout.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+namespace {
+
+// The reorder loops run over ranges of the channel blocks of all items.
+template <typename Dtype>
+struct Reorder {
+  Reorder(int spatial, int block, bool to_blocked, const Dtype* src,
+      Dtype* dst)
+      : spatial(spatial), block(block), to_blocked(to_blocked), src(src),
+        dst(dst) {}
+  void operator()(int begin, int end) const {
+    for (int b = begin; b < end; ++b) {
+      const int offset = b * block * spatial;
+      for (int c = 0; c < block; ++c) {
+        for (int p = 0; p < spatial; ++p) {
+          const int plain = offset + c * spatial + p;
+          const int blocked = offset + p * block + c;
+          if (to_blocked) {
+            dst[blocked] = src[plain];
+          } else {
+            dst[plain] = src[blocked];
+          }
+        }
+      }
+    }
+  }
+  const int spatial, block;
+  const bool to_blocked;
+  const Dtype* const src;
+  Dtype* const dst;
+};
+
+template <typename Dtype>
+void reorder_cpu(const int num, const int channels, const int spatial,
+    const int block, const bool to_blocked, const Dtype* src, Dtype* dst) {
+  CHECK_GT(block, 0);
+  CHECK_EQ(channels % block, 0) << "The channels (" << channels
+      << ") must be a multiple of the channel block (" << block << ").";
+  parallel_for(num * channels / block,
+      Reorder<Dtype>(spatial, block, to_blocked, src, dst),
+      std::max(1, kElementwiseGrain / (block * spatial)));
+}
+
+// The names of the up to date versions of a blob of the original net in the
+// usual and blocked layouts, empty where that version is stale.
+struct BlobVersions {
+  string plain, blocked;
+};
+
+// Layers computing each element of their tops from the same element of their
+// bottoms, which run the same in both layouts.
+bool Elementwise(const LayerParameter& layer) {
+  const string& type = layer.type();
+  return type == "AbsVal" || type == "BNLL" || type == "Dropout" ||
+      type == "Eltwise" || type == "ElementwiseChain" || type == "Exp" ||
+      type == "Log" || type == "Power" || type == "ReLU" ||
+      type == "Sigmoid" || type == "TanH" || type == "Threshold";
+}
+
+// Whether a layer has a kernel for the blocked layout with blocks of block
+// channels, given the channels of its bottom.
+bool HasBlockedKernel(const LayerParameter& layer, int channels, int block) {
+  if (channels == 0 || channels % block != 0 || layer.bottom_size() != 1 ||
+      layer.top_size() != 1 || layer.top(0) == layer.bottom(0) ||
+      layer.loss_weight_size() > 0) {
+    return false;
+  }
+  const string& type = layer.type();
+  if (type == "Pooling") {
+    const PoolingParameter& pool_param = layer.pooling_param();
+    return (pool_param.pool() == PoolingParameter_PoolMethod_MAX ||
+        pool_param.pool() == PoolingParameter_PoolMethod_AVE) &&
+        pool_param.engine() != PoolingParameter_Engine_CUDNN;
+  }
+  if (type == "LRN") {
+    const LRNParameter& lrn_param = layer.lrn_param();
+    return lrn_param.norm_region() == LRNParameter_NormRegion_ACROSS_CHANNELS
+        && lrn_param.engine() != LRNParameter_Engine_CUDNN;
+  }
+  if (type == "Convolution") {
+    const ConvolutionParameter& conv_param = layer.convolution_param();
+    return conv_param.group() == channels &&
+        conv_param.num_output() == channels && conv_param.axis() == 1 &&
+        !conv_param.force_nd_im2col() &&
+        (conv_param.engine() == ConvolutionParameter_Engine_DEFAULT ||
+         conv_param.engine() == ConvolutionParameter_Engine_CAFFE);
+  }
+  return false;
+}
+
+int Channels(const map<string, int>& channels, const string& blob) {
+  map<string, int>::const_iterator it = channels.find(blob);
+  return it == channels.end() ? 0 : it->second;
+}
+
+// The channels of the tops of a layer, where they all have those of the
+// first bottom or a known number of them, and 0 otherwise.
+int TopChannels(const LayerParameter& layer,
+    const map<string, int>& channels) {
+  const string& type = layer.type();
+  if (type == "Convolution" || type == "Deconvolution") {
+    return layer.convolution_param().axis() == 1 ?
+        layer.convolution_param().num_output() : 0;
+  }
+  if (layer.bottom_size() == 0) { return 0; }
+  if (Elementwise(layer) || type == "BatchNorm" || type == "Bias" ||
+      type == "LRN" || type == "MVN" || type == "Pooling" ||
+      type == "PReLU" || type == "Scale" || type == "Split") {
+    return Channels(channels, layer.bottom(0));
+  }
+  if (type == "Concat") {
+    const ConcatParameter& concat_param = layer.concat_param();
+    const int axis = concat_param.has_concat_dim() ?
+        concat_param.concat_dim() : concat_param.axis();
+    if (axis != 1) { return 0; }
+    int sum = 0;
+    for (int i = 0; i < layer.bottom_size(); ++i) {
+      const int bottom_channels = Channels(channels, layer.bottom(i));
+      if (bottom_channels == 0) { return 0; }
+      sum += bottom_channels;
+    }
+    return sum;
+  }
+  return 0;
+}
+
+// A name starting with base that is not in names, which it is added to.
+string NewName(const string& base, set<string>* names) {
+  string name = base;
+  for (int i = 1; names->count(name); ++i) {
+    std::ostringstream numbered;
+    numbered << base << "_" << i;
+    name = numbered.str();
+  }
+  names->insert(name);
+  return name;
+}
+
+void AddReorder(const string& bottom, const string& top, bool to_blocked,
+    int block, set<string>* names, NetParameter* param) {
+  LayerParameter* layer = param->add_layer();
+  layer->set_name(NewName(top + "_reorder", names));
+  layer->set_type("Reorder");
+  layer->add_bottom(bottom);
+  layer->add_top(top);
+  layer->set_channel_block(block);
+  layer->mutable_reorder_param()->set_to_blocked(to_blocked);
+}
+
+bool InPlace(const LayerParameter& layer, const string& blob) {
+  for (int i = 0; i < layer.bottom_size(); ++i) {
+    if (layer.bottom(i) == blob) {
+      for (int j = 0; j < layer.top_size(); ++j) {
+        if (layer.top(j) == blob) { return true; }
+      }
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+template <typename Dtype>
+void reorder_to_blocked_cpu(const int num, const int channels,
+    const int spatial, const int block, const Dtype* data,
+    Dtype* data_blocked) {
+  reorder_cpu(num, channels, spatial, block, true, data, data_blocked);
+}
+
+template void reorder_to_blocked_cpu<float>(const int num,
+    const int channels, const int spatial, const int block, const float* data,
+    float* data_blocked);
+template void reorder_to_blocked_cpu<double>(const int num,
+    const int channels, const int spatial, const int block,
+    const double* data, double* data_blocked);
+
+template <typename Dtype>
+void reorder_from_blocked_cpu(const int num, const int channels,
+    const int spatial, const int block, const Dtype* data_blocked,
+    Dtype* data) {
+  reorder_cpu(num, channels, spatial, block, false, data_blocked, data);
+}
+
+template void reorder_from_blocked_cpu<float>(const int num,
+    const int channels, const int spatial, const int block,
+    const float* data_blocked, float* data);
+template void reorder_from_blocked_cpu<double>(const int num,
+    const int channels, const int spatial, const int block,
+    const double* data_blocked, double* data);
+
+int ConvertToBlockedLayout(const NetParameter& param,
+    NetParameter* param_blocked) {
+  const int block = param.channel_block();
+  param_blocked->CopyFrom(param);
+  if (block <= 0 || param.state().phase() != TEST) { return 0; }
+  param_blocked->clear_layer();
+  // All the names of the net, so that the new blobs and layers get others,
+  // and the names of the blobs written so far in the converted net.
+  set<string> names(param.input().begin(), param.input().end());
+  set<string> written(param.input().begin(), param.input().end());
+  // The blobs output by the net, those not read after their last write.
+  set<string> outputs(param.input().begin(), param.input().end());
+  map<string, int> channels;
+  map<string, BlobVersions> versions;
+  for (int i = 0; i < param.input_size(); ++i) {
+    const string& input = param.input(i);
+    versions[input].plain = input;
+    if (i < param.input_shape_size()) {
+      if (param.input_shape(i).dim_size() > 1) {
+        channels[input] = param.input_shape(i).dim(1);
+      }
+    } else if (param.input_dim_size() >= 4 * (i + 1)) {
+      channels[input] = param.input_dim(4 * i + 1);
+    }
+  }
+  for (int i = 0; i < param.layer_size(); ++i) {
+    const LayerParameter& layer = param.layer(i);
+    names.insert(layer.name());
+    for (int j = 0; j < layer.bottom_size(); ++j) {
+      names.insert(layer.bottom(j));
+      outputs.erase(layer.bottom(j));
+    }
+    for (int j = 0; j < layer.top_size(); ++j) {
+      names.insert(layer.top(j));
+      outputs.insert(layer.top(j));
+    }
+  }
+  for (int i = 0; i < param.keep_blob_size(); ++i) {
+    outputs.insert(param.keep_blob(i));
+  }
+
+  int num_blocked = 0;
+  for (int i = 0; i < param.layer_size(); ++i) {
+    const LayerParameter& layer = param.layer(i);
+    const int bottom_channels = layer.bottom_size() > 0 ?
+        Channels(channels, layer.bottom(0)) : 0;
+    // Elementwise layers compute in the blocked layout where all their
+    // bottoms are only in it, so that an in-place one never makes a version
+    // stale that later layers read.
+    bool blocked = HasBlockedKernel(layer, bottom_channels, block);
+    if (!blocked && Elementwise(layer) && layer.bottom_size() > 0 &&
+        layer.loss_weight_size() == 0) {
+      blocked = true;
+      for (int j = 0; j < layer.bottom_size(); ++j) {
+        const BlobVersions& bottom = versions[layer.bottom(j)];
+        blocked &= bottom.plain.empty() && !bottom.blocked.empty();
+      }
+    }
+    for (int j = 0; j < layer.bottom_size(); ++j) {
+      const string& name = layer.bottom(j);
+      BlobVersions& bottom = versions[name];
+      if (blocked && bottom.blocked.empty()) {
+        bottom.blocked = NewName(name + "_blocked", &names);
+        AddReorder(bottom.plain, bottom.blocked, true, block, &names,
+            param_blocked);
+      } else if (!blocked && bottom.plain.empty()) {
+        bottom.plain = written.count(name) ? NewName(name + "_plain", &names)
+            : name;
+        written.insert(bottom.plain);
+        AddReorder(bottom.blocked, bottom.plain, false, block, &names,
+            param_blocked);
+      }
+    }
+    LayerParameter* converted = param_blocked->add_layer();
+    converted->CopyFrom(layer);
+    for (int j = 0; j < layer.bottom_size(); ++j) {
+      const BlobVersions& bottom = versions[layer.bottom(j)];
+      converted->set_bottom(j, blocked ? bottom.blocked : bottom.plain);
+    }
+    for (int j = 0; j < layer.top_size(); ++j) {
+      const string& name = layer.top(j);
+      BlobVersions& top = versions[name];
+      if (InPlace(layer, name)) {
+        converted->set_top(j, blocked ? top.blocked : top.plain);
+      } else {
+        if (blocked) {
+          top.blocked = NewName(name + "_blocked", &names);
+        } else {
+          top.plain = name;
+        }
+        converted->set_top(j, blocked ? top.blocked : top.plain);
+        written.insert(converted->top(j));
+      }
+      // The other version is stale after the write.
+      if (blocked) {
+        top.plain.clear();
+      } else {
+        top.blocked.clear();
+      }
+    }
+    if (blocked) {
+      converted->set_channel_block(block);
+      ++num_blocked;
+    }
+    const int top_channels = TopChannels(layer, channels);
+    for (int j = 0; j < layer.top_size(); ++j) {
+      channels[layer.top(j)] = top_channels;
+    }
+  }
+  // The net outputs left in the blocked layout only are reordered back.
+  for (set<string>::const_iterator it = outputs.begin(); it != outputs.end();
+       ++it) {
+    map<string, BlobVersions>::iterator output = versions.find(*it);
+    if (output != versions.end() && output->second.plain.empty()) {
+      CHECK(!written.count(*it));
+      AddReorder(output->second.blocked, *it, false, block, &names,
+          param_blocked);
+    }
+  }
+  return num_blocked;
+}
+
+}  // namespace caffe
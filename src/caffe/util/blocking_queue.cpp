@@ -4,6 +4,7 @@
 #include "caffe/data_reader.hpp"
 #include "caffe/layers/base_data_layer.hpp"
 #include "caffe/parallel.hpp"
+#include "caffe/pipeline.hpp"
 #include "caffe/util/blocking_queue.hpp"
 
 namespace caffe {
@@ -92,5 +93,8 @@ template class BlockingQueue<Datum*>;
 template class BlockingQueue<shared_ptr<DataReader::QueuePair> >;
 template class BlockingQueue<P2PSync<float>*>;
 template class BlockingQueue<P2PSync<double>*>;
+template class BlockingQueue<PipelineBatch<float>*>;
+template class BlockingQueue<PipelineBatch<double>*>;
+template class BlockingQueue<int>;
 
 }  // namespace caffe
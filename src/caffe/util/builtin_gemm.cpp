@@ -0,0 +1,263 @@
+#include <algorithm>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/builtin_gemm.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+namespace {
+
+// The register block: the micro-kernel keeps kMR x NR accumulators, NR
+// being two SSE vectors of Dtype so that they all fit in the registers.
+const int kMR = 4;
+template <typename Dtype>
+struct Block {
+  static const int NR = 32 / sizeof(Dtype);
+};
+// The cache blocks: a kKC x NR panel of B stays in L1 while it meets the
+// kMC x kKC block of A in L2, and kNC columns of B are packed at a time.
+const int kKC = 256;
+const int kMC = 128;
+const int kNC = 4096;
+// The partial sums of the GEMV dot products, independent so that they
+// vectorize without reassociating.
+const int kLanes = 8;
+
+inline int RoundUp(int n, int block) {
+  return (n + block - 1) / block * block;
+}
+
+// Packs rows x cols of op(X), starting at (row, col), into panels of block
+// rows each storing the block values of a column next to each other, the
+// last one padded with zeros. With trans, op(X)(i, k) is X[k * ld + i].
+template <typename Dtype>
+struct Pack {
+  Pack(bool trans, const Dtype* x, int ld, int row, int col, int rows,
+      int cols, int block, Dtype* packed)
+      : trans(trans), x(x), ld(ld), row(row), col(col), rows(rows),
+        cols(cols), block(block), packed(packed) {}
+  void operator()(int begin, int end) const {
+    for (int p = begin; p < end; ++p) {
+      Dtype* panel = packed + p * block * cols;
+      for (int i = 0; i < block; ++i) {
+        const int r = p * block + i;
+        if (r >= rows) {
+          for (int k = 0; k < cols; ++k) { panel[k * block + i] = 0; }
+        } else if (trans) {
+          const Dtype* src = x + col * ld + row + r;
+          for (int k = 0; k < cols; ++k) { panel[k * block + i] = src[k * ld]; }
+        } else {
+          const Dtype* src = x + (row + r) * ld + col;
+          for (int k = 0; k < cols; ++k) { panel[k * block + i] = src[k]; }
+        }
+      }
+    }
+  }
+  const bool trans;
+  const Dtype* const x;
+  const int ld, row, col, rows, cols, block;
+  Dtype* const packed;
+};
+
+// C(0:mr, 0:nr) = alpha * a * b + beta * C(0:mr, 0:nr) for a kMR x kc
+// panel a and a kc x NR panel b. The loops have constant bounds, so the
+// compiler unrolls them and keeps acc in vector registers.
+template <typename Dtype>
+void MicroKernel(int kc, const Dtype* a, const Dtype* b, Dtype alpha,
+    Dtype beta, Dtype* c, int ldc, int mr, int nr) {
+  const int NR = Block<Dtype>::NR;
+  Dtype acc[kMR][Block<Dtype>::NR] = {};
+  for (int k = 0; k < kc; ++k, a += kMR, b += NR) {
+    for (int i = 0; i < kMR; ++i) {
+      const Dtype ai = a[i];
+      for (int j = 0; j < NR; ++j) {
+        acc[i][j] += ai * b[j];
+      }
+    }
+  }
+  if (mr == kMR && nr == NR) {
+    // Whole tiles, again with constant bounds.
+    for (int i = 0; i < kMR; ++i) {
+      Dtype* ci = c + i * ldc;
+      if (beta == Dtype(0)) {
+        for (int j = 0; j < NR; ++j) { ci[j] = alpha * acc[i][j]; }
+      } else {
+        for (int j = 0; j < NR; ++j) {
+          ci[j] = alpha * acc[i][j] + beta * ci[j];
+        }
+      }
+    }
+    return;
+  }
+  // beta = 0 sets C, whatever it held before.
+  for (int i = 0; i < mr; ++i) {
+    Dtype* ci = c + i * ldc;
+    for (int j = 0; j < nr; ++j) {
+      ci[j] = alpha * acc[i][j] + (beta == Dtype(0) ? Dtype(0) : beta * ci[j]);
+    }
+  }
+}
+
+// Multiplies the packed blocks of A and B, over ranges of tiles of kMC rows
+// by NR columns. Only the first K block scales C by beta.
+template <typename Dtype>
+struct MacroKernel {
+  MacroKernel(int m, int n, int kc, Dtype alpha, Dtype beta, const Dtype* a,
+      const Dtype* b, Dtype* c, int ldc)
+      : m(m), n(n), kc(kc), alpha(alpha), beta(beta), a(a), b(b), c(c),
+        ldc(ldc) {}
+  void operator()(int begin, int end) const {
+    const int NR = Block<Dtype>::NR;
+    const int panels = RoundUp(n, NR) / NR;
+    for (int t = begin; t < end; ++t) {
+      const int i0 = (t / panels) * kMC;
+      const int j0 = (t % panels) * NR;
+      const int mc = std::min(kMC, m - i0);
+      const int nr = std::min(NR, n - j0);
+      for (int i = 0; i < mc; i += kMR) {
+        MicroKernel(kc, a + (i0 + i) * kc, b + j0 * kc, alpha, beta,
+            c + (i0 + i) * ldc + j0, ldc, std::min(kMR, mc - i), nr);
+      }
+    }
+  }
+  const int m, n, kc;
+  const Dtype alpha, beta;
+  const Dtype* const a;
+  const Dtype* const b;
+  Dtype* const c;
+  const int ldc;
+};
+
+// y(i) = alpha * A(i, :) x + beta * y(i) over ranges of rows.
+template <typename Dtype>
+struct GemvRows {
+  GemvRows(int n, Dtype alpha, const Dtype* a, const Dtype* x, Dtype beta,
+      Dtype* y)
+      : n(n), alpha(alpha), a(a), x(x), beta(beta), y(y) {}
+  void operator()(int begin, int end) const {
+    for (int i = begin; i < end; ++i) {
+      const Dtype* ai = a + static_cast<size_t>(i) * n;
+      Dtype lanes[kLanes] = {};
+      int k = 0;
+      for (; k + kLanes <= n; k += kLanes) {
+        for (int l = 0; l < kLanes; ++l) {
+          lanes[l] += ai[k + l] * x[k + l];
+        }
+      }
+      Dtype sum = 0;
+      for (; k < n; ++k) { sum += ai[k] * x[k]; }
+      for (int l = 0; l < kLanes; ++l) { sum += lanes[l]; }
+      y[i] = alpha * sum + (beta == Dtype(0) ? Dtype(0) : beta * y[i]);
+    }
+  }
+  const int n;
+  const Dtype alpha;
+  const Dtype* const a;
+  const Dtype* const x;
+  const Dtype beta;
+  Dtype* const y;
+};
+
+// y(j) = alpha * A(:, j)' x + beta * y(j) over ranges of columns, adding
+// the rows of A scaled by x in turn.
+template <typename Dtype>
+struct GemvColumns {
+  GemvColumns(int m, int n, Dtype alpha, const Dtype* a, const Dtype* x,
+      Dtype beta, Dtype* y)
+      : m(m), n(n), alpha(alpha), a(a), x(x), beta(beta), y(y) {}
+  void operator()(int begin, int end) const {
+    for (int j = begin; j < end; ++j) {
+      y[j] = beta == Dtype(0) ? Dtype(0) : beta * y[j];
+    }
+    for (int i = 0; i < m; ++i) {
+      const Dtype* ai = a + static_cast<size_t>(i) * n;
+      const Dtype xi = alpha * x[i];
+      for (int j = begin; j < end; ++j) {
+        y[j] += xi * ai[j];
+      }
+    }
+  }
+  const int m, n;
+  const Dtype alpha;
+  const Dtype* const a;
+  const Dtype* const x;
+  const Dtype beta;
+  Dtype* const y;
+};
+
+}  // namespace
+
+template <typename Dtype>
+void caffe_builtin_gemm(const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const Dtype alpha, const Dtype* A, const int lda, const Dtype* B,
+    const int ldb, const Dtype beta, Dtype* C, const int ldc) {
+  if (M <= 0 || N <= 0) { return; }
+  const int NR = Block<Dtype>::NR;
+  if (K <= 0 || alpha == Dtype(0)) {
+    // Only the scaling by beta is left.
+    for (int i = 0; i < M; ++i) {
+      for (int j = 0; j < N; ++j) {
+        C[i * ldc + j] = beta == Dtype(0) ? Dtype(0) : beta * C[i * ldc + j];
+      }
+    }
+    return;
+  }
+  const int m_panels = RoundUp(M, kMR) / kMR;
+  vector<Dtype> packed_a(static_cast<size_t>(m_panels) * kMR *
+      std::min(K, kKC));
+  vector<Dtype> packed_b(static_cast<size_t>(RoundUp(std::min(N, kNC), NR)) *
+      std::min(K, kKC));
+  for (int jc = 0; jc < N; jc += kNC) {
+    const int nc = std::min(kNC, N - jc);
+    const int n_panels = RoundUp(nc, NR) / NR;
+    for (int pc = 0; pc < K; pc += kKC) {
+      const int kc = std::min(kKC, K - pc);
+      // The panels take a few thousand values each, and the tiles many
+      // times that in multiply-adds.
+      const int grain = std::max(1, kElementwiseGrain / (NR * kc));
+      parallel_for(n_panels, Pack<Dtype>(TransB != CblasTrans, B, ldb, jc,
+          pc, nc, kc, NR, &packed_b[0]), grain);
+      // All the rows of A are packed, so that the tiles of every row block
+      // can run at once.
+      parallel_for(m_panels, Pack<Dtype>(TransA == CblasTrans, A, lda, 0,
+          pc, M, kc, kMR, &packed_a[0]), grain);
+      parallel_for(RoundUp(M, kMC) / kMC * n_panels, MacroKernel<Dtype>(M,
+          nc, kc, alpha, pc == 0 ? beta : Dtype(1), &packed_a[0],
+          &packed_b[0], C + jc, ldc));
+    }
+  }
+}
+
+template void caffe_builtin_gemm<float>(const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const float alpha, const float* A, const int lda, const float* B,
+    const int ldb, const float beta, float* C, const int ldc);
+template void caffe_builtin_gemm<double>(const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const double alpha, const double* A, const int lda, const double* B,
+    const int ldb, const double beta, double* C, const int ldc);
+
+template <typename Dtype>
+void caffe_builtin_gemv(const CBLAS_TRANSPOSE TransA, const int M,
+    const int N, const Dtype alpha, const Dtype* A, const Dtype* x,
+    const Dtype beta, Dtype* y) {
+  if (TransA == CblasNoTrans) {
+    parallel_for(M, GemvRows<Dtype>(N, alpha, A, x, beta, y),
+        std::max(1, kElementwiseGrain / std::max(N, 1)));
+  } else {
+    parallel_for(N, GemvColumns<Dtype>(M, N, alpha, A, x, beta, y),
+        std::max(kLanes, kElementwiseGrain / std::max(M, 1)));
+  }
+}
+
+template void caffe_builtin_gemv<float>(const CBLAS_TRANSPOSE TransA,
+    const int M, const int N, const float alpha, const float* A,
+    const float* x, const float beta, float* y);
+template void caffe_builtin_gemv<double>(const CBLAS_TRANSPOSE TransA,
+    const int M, const int N, const double alpha, const double* A,
+    const double* x, const double beta, double* y);
+
+}  // namespace caffe
@@ -0,0 +1,84 @@
+#include <boost/thread.hpp>
+
+#include <map>
+
+#include "caffe/util/conv_workspace.hpp"
+
+namespace caffe {
+
+namespace {
+
+boost::mutex& accounting_mutex() {
+  static boost::mutex* mutex = new boost::mutex();
+  return *mutex;
+}
+
+// Buffer size of every registered user; needs accounting_mutex().
+std::map<const void*, size_t>& requested() {
+  static std::map<const void*, size_t>* sizes =
+      new std::map<const void*, size_t>();
+  return *sizes;
+}
+
+// Sum of the workspace sizes of all threads; needs accounting_mutex().
+size_t allocated = 0;
+
+}  // namespace
+
+// Make sure each thread has its own workspace.
+static boost::thread_specific_ptr<ConvWorkspace> thread_workspace_;
+
+ConvWorkspace& ConvWorkspace::Get() {
+  if (!thread_workspace_.get()) {
+    thread_workspace_.reset(new ConvWorkspace());
+  }
+  return *(thread_workspace_.get());
+}
+
+ConvWorkspace::~ConvWorkspace() {
+  boost::mutex::scoped_lock lock(accounting_mutex());
+  allocated -= size();
+}
+
+const shared_ptr<SyncedMemory>& ConvWorkspace::Reserve(size_t size) {
+  if (size > this->size()) {
+    // The memory itself is only allocated by the first user that touches it.
+    boost::mutex::scoped_lock lock(accounting_mutex());
+    allocated += size - this->size();
+    memory_.reset(new SyncedMemory(size));
+  }
+  return memory_;
+}
+
+void ConvWorkspace::Register(const void* user, size_t size) {
+  boost::mutex::scoped_lock lock(accounting_mutex());
+  if (size > 0) {
+    requested()[user] = size;
+  } else {
+    requested().erase(user);
+  }
+}
+
+size_t ConvWorkspace::requested_bytes() {
+  boost::mutex::scoped_lock lock(accounting_mutex());
+  size_t total = 0;
+  for (std::map<const void*, size_t>::const_iterator it = requested().begin();
+       it != requested().end(); ++it) {
+    total += it->second;
+  }
+  return total;
+}
+
+size_t ConvWorkspace::allocated_bytes() {
+  boost::mutex::scoped_lock lock(accounting_mutex());
+  return allocated;
+}
+
+size_t ConvWorkspace::saved_bytes() {
+  const size_t requested_total = requested_bytes();
+  const size_t allocated_total = allocated_bytes();
+  return requested_total > allocated_total ?
+      requested_total - allocated_total : 0;
+}
+
+}  // namespace caffe
@@ -0,0 +1,264 @@
+#include <algorithm>
+#include <vector>
+
+#include "caffe/util/depthwise_conv.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+// The inner loops run over a range of output columns whose input columns are
+// all inside the image, so they need no padding checks; with stride 1 they
+// read and write contiguous memory, which compilers vectorize.
+
+// Sets [*begin, *end) to the output columns that read the input column
+// ow * stride + offset from inside an image of the given width.
+inline void depthwise_valid_columns(const int offset, const int stride,
+    const int width, const int output_w, int* begin, int* end) {
+  *begin = offset >= 0 ? 0 : (stride - 1 - offset) / stride;
+  *end = width - 1 - offset >= 0 ?
+      std::min(output_w, (width - 1 - offset) / stride + 1) : 0;
+}
+
+template <typename Dtype>
+void depthwise_conv_cpu(const Dtype* data_im, const int channels,
+    const int height, const int width, const Dtype* weights,
+    const int multiplier, const int kernel_h, const int kernel_w,
+    const int pad_h, const int pad_w, const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w, const int output_h,
+    const int output_w, Dtype* data_out) {
+  const int num_output = channels * multiplier;
+  caffe_set(num_output * output_h * output_w, Dtype(0), data_out);
+  for (int k = 0; k < num_output; ++k) {
+    const Dtype* im = data_im + (k / multiplier) * height * width;
+    const Dtype* filter = weights + k * kernel_h * kernel_w;
+    Dtype* out = data_out + k * output_h * output_w;
+    for (int oh = 0; oh < output_h; ++oh) {
+      Dtype* out_row = out + oh * output_w;
+      for (int i = 0; i < kernel_h; ++i) {
+        const int ih = oh * stride_h - pad_h + i * dilation_h;
+        if (ih < 0 || ih >= height) { continue; }
+        const Dtype* im_row = im + ih * width;
+        for (int j = 0; j < kernel_w; ++j) {
+          const Dtype w = filter[i * kernel_w + j];
+          const int offset = j * dilation_w - pad_w;
+          int begin, end;
+          depthwise_valid_columns(offset, stride_w, width, output_w, &begin,
+              &end);
+          if (stride_w == 1) {
+            const Dtype* in = im_row + offset;
+            for (int ow = begin; ow < end; ++ow) {
+              out_row[ow] += w * in[ow];
+            }
+          } else {
+            for (int ow = begin; ow < end; ++ow) {
+              out_row[ow] += w * im_row[ow * stride_w + offset];
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+template void depthwise_conv_cpu<float>(const float* data_im,
+    const int channels, const int height, const int width,
+    const float* weights, const int multiplier, const int kernel_h,
+    const int kernel_w, const int pad_h, const int pad_w, const int stride_h,
+    const int stride_w, const int dilation_h, const int dilation_w,
+    const int output_h, const int output_w, float* data_out);
+template void depthwise_conv_cpu<double>(const double* data_im,
+    const int channels, const int height, const int width,
+    const double* weights, const int multiplier, const int kernel_h,
+    const int kernel_w, const int pad_h, const int pad_w, const int stride_h,
+    const int stride_w, const int dilation_h, const int dilation_w,
+    const int output_h, const int output_w, double* data_out);
+
+// The blocked loops run over ranges of the output rows of all channel
+// blocks, with the channels of a block in the innermost loop.
+template <typename Dtype>
+struct DepthwiseConvBlockedRows {
+  int block, height, width, kernel_h, kernel_w, pad_h, pad_w;
+  int stride_h, stride_w, dilation_h, dilation_w, output_h, output_w;
+  const Dtype* data_im;
+  // The weights as [block][kernel_h][kernel_w][channel in block].
+  const Dtype* packed_weights;
+  Dtype* data_out;
+  void operator()(int begin, int end) const {
+    for (int r = begin; r < end; ++r) {
+      const int b = r / output_h;
+      const int oh = r % output_h;
+      const Dtype* im = data_im + b * height * width * block;
+      const Dtype* filter = packed_weights + b * kernel_h * kernel_w * block;
+      Dtype* out_row = data_out + r * output_w * block;
+      caffe_set(output_w * block, Dtype(0), out_row);
+      for (int i = 0; i < kernel_h; ++i) {
+        const int ih = oh * stride_h - pad_h + i * dilation_h;
+        if (ih < 0 || ih >= height) { continue; }
+        const Dtype* im_row = im + ih * width * block;
+        for (int j = 0; j < kernel_w; ++j) {
+          const Dtype* w = filter + (i * kernel_w + j) * block;
+          const int offset = j * dilation_w - pad_w;
+          int col_begin, col_end;
+          depthwise_valid_columns(offset, stride_w, width, output_w,
+              &col_begin, &col_end);
+          for (int ow = col_begin; ow < col_end; ++ow) {
+            const Dtype* in = im_row + (ow * stride_w + offset) * block;
+            Dtype* out = out_row + ow * block;
+            for (int l = 0; l < block; ++l) {
+              out[l] += w[l] * in[l];
+            }
+          }
+        }
+      }
+    }
+  }
+};
+
+template <typename Dtype>
+void depthwise_conv_blocked_cpu(const Dtype* data_im, const int channels,
+    const int block, const int height, const int width, const Dtype* weights,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int dilation_h,
+    const int dilation_w, const int output_h, const int output_w,
+    Dtype* data_out) {
+  const int kernel_dim = kernel_h * kernel_w;
+  std::vector<Dtype> packed_weights(channels * kernel_dim);
+  for (int k = 0; k < channels; ++k) {
+    for (int e = 0; e < kernel_dim; ++e) {
+      packed_weights[((k / block) * kernel_dim + e) * block + k % block] =
+          weights[k * kernel_dim + e];
+    }
+  }
+  const DepthwiseConvBlockedRows<Dtype> rows = { block, height, width,
+      kernel_h, kernel_w, pad_h, pad_w, stride_h, stride_w, dilation_h,
+      dilation_w, output_h, output_w, data_im, &packed_weights[0],
+      data_out };
+  parallel_for(channels / block * output_h, rows,
+      std::max(1, kElementwiseGrain / (output_w * block * kernel_dim)));
+}
+
+template void depthwise_conv_blocked_cpu<float>(const float* data_im,
+    const int channels, const int block, const int height, const int width,
+    const float* weights, const int kernel_h, const int kernel_w,
+    const int pad_h, const int pad_w, const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w, const int output_h,
+    const int output_w, float* data_out);
+template void depthwise_conv_blocked_cpu<double>(const double* data_im,
+    const int channels, const int block, const int height, const int width,
+    const double* weights, const int kernel_h, const int kernel_w,
+    const int pad_h, const int pad_w, const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w, const int output_h,
+    const int output_w, double* data_out);
+
+template <typename Dtype>
+void depthwise_conv_backward_data_cpu(const Dtype* diff_out,
+    const int channels, const int height, const int width,
+    const Dtype* weights, const int multiplier, const int kernel_h,
+    const int kernel_w, const int pad_h, const int pad_w, const int stride_h,
+    const int stride_w, const int dilation_h, const int dilation_w,
+    const int output_h, const int output_w, Dtype* diff_im) {
+  const int num_output = channels * multiplier;
+  for (int k = 0; k < num_output; ++k) {
+    Dtype* im = diff_im + (k / multiplier) * height * width;
+    const Dtype* filter = weights + k * kernel_h * kernel_w;
+    const Dtype* out = diff_out + k * output_h * output_w;
+    for (int oh = 0; oh < output_h; ++oh) {
+      const Dtype* out_row = out + oh * output_w;
+      for (int i = 0; i < kernel_h; ++i) {
+        const int ih = oh * stride_h - pad_h + i * dilation_h;
+        if (ih < 0 || ih >= height) { continue; }
+        Dtype* im_row = im + ih * width;
+        for (int j = 0; j < kernel_w; ++j) {
+          const Dtype w = filter[i * kernel_w + j];
+          const int offset = j * dilation_w - pad_w;
+          int begin, end;
+          depthwise_valid_columns(offset, stride_w, width, output_w, &begin,
+              &end);
+          if (stride_w == 1) {
+            Dtype* in = im_row + offset;
+            for (int ow = begin; ow < end; ++ow) {
+              in[ow] += w * out_row[ow];
+            }
+          } else {
+            for (int ow = begin; ow < end; ++ow) {
+              im_row[ow * stride_w + offset] += w * out_row[ow];
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+template void depthwise_conv_backward_data_cpu<float>(const float* diff_out,
+    const int channels, const int height, const int width,
+    const float* weights, const int multiplier, const int kernel_h,
+    const int kernel_w, const int pad_h, const int pad_w, const int stride_h,
+    const int stride_w, const int dilation_h, const int dilation_w,
+    const int output_h, const int output_w, float* diff_im);
+template void depthwise_conv_backward_data_cpu<double>(
+    const double* diff_out, const int channels, const int height,
+    const int width, const double* weights, const int multiplier,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int dilation_h,
+    const int dilation_w, const int output_h, const int output_w,
+    double* diff_im);
+
+template <typename Dtype>
+void depthwise_conv_backward_weights_cpu(const Dtype* data_im,
+    const int channels, const int height, const int width,
+    const Dtype* diff_out, const int multiplier, const int kernel_h,
+    const int kernel_w, const int pad_h, const int pad_w, const int stride_h,
+    const int stride_w, const int dilation_h, const int dilation_w,
+    const int output_h, const int output_w, Dtype* diff_weights) {
+  const int num_output = channels * multiplier;
+  for (int k = 0; k < num_output; ++k) {
+    const Dtype* im = data_im + (k / multiplier) * height * width;
+    const Dtype* out = diff_out + k * output_h * output_w;
+    Dtype* filter_diff = diff_weights + k * kernel_h * kernel_w;
+    for (int i = 0; i < kernel_h; ++i) {
+      for (int j = 0; j < kernel_w; ++j) {
+        const int offset = j * dilation_w - pad_w;
+        int begin, end;
+        depthwise_valid_columns(offset, stride_w, width, output_w, &begin,
+            &end);
+        Dtype sum = 0;
+        for (int oh = 0; oh < output_h; ++oh) {
+          const int ih = oh * stride_h - pad_h + i * dilation_h;
+          if (ih < 0 || ih >= height) { continue; }
+          const Dtype* im_row = im + ih * width;
+          const Dtype* out_row = out + oh * output_w;
+          if (stride_w == 1) {
+            const Dtype* in = im_row + offset;
+            for (int ow = begin; ow < end; ++ow) {
+              sum += out_row[ow] * in[ow];
+            }
+          } else {
+            for (int ow = begin; ow < end; ++ow) {
+              sum += out_row[ow] * im_row[ow * stride_w + offset];
+            }
+          }
+        }
+        filter_diff[i * kernel_w + j] += sum;
+      }
+    }
+  }
+}
+
+template void depthwise_conv_backward_weights_cpu<float>(
+    const float* data_im, const int channels, const int height,
+    const int width, const float* diff_out, const int multiplier,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int dilation_h,
+    const int dilation_w, const int output_h, const int output_w,
+    float* diff_weights);
+template void depthwise_conv_backward_weights_cpu<double>(
+    const double* data_im, const int channels, const int height,
+    const int width, const double* diff_out, const int multiplier,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int dilation_h,
+    const int dilation_w, const int output_h, const int output_w,
+    double* diff_weights);
+
+}  // namespace caffe
@@ -0,0 +1,85 @@
+#include <algorithm>
+#include <cmath>
+
+#include "caffe/common.hpp"
+#include "caffe/util/fft.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+FFT2D<Dtype>::Plan::Plan(int n)
+    : n(n), reversed(n), cos(n / 2), sin(n / 2) {
+  CHECK_GT(n, 0);
+  CHECK_EQ(n & (n - 1), 0) << "FFT sizes must be powers of two.";
+  int bits = 0;
+  while ((1 << bits) < n) { ++bits; }
+  for (int i = 0; i < n; ++i) {
+    int r = 0;
+    for (int b = 0; b < bits; ++b) {
+      r |= ((i >> b) & 1) << (bits - 1 - b);
+    }
+    reversed[i] = r;
+  }
+  for (int k = 0; k < n / 2; ++k) {
+    const double angle = 2 * M_PI * k / n;
+    cos[k] = std::cos(angle);
+    sin[k] = std::sin(angle);
+  }
+}
+
+template <typename Dtype>
+FFT2D<Dtype>::FFT2D(int height, int width)
+    : height_(height), width_(width), rows_(width), columns_(height) {}
+
+template <typename Dtype>
+void FFT2D<Dtype>::Transform1D(const Plan& plan, Dtype* re, Dtype* im,
+    int stride, int count, bool inverse) {
+  const int n = plan.n;
+  for (int i = 0; i < n; ++i) {
+    const int r = plan.reversed[i];
+    if (r > i) {
+      std::swap_ranges(re + i * stride, re + i * stride + count,
+          re + r * stride);
+      std::swap_ranges(im + i * stride, im + i * stride + count,
+          im + r * stride);
+    }
+  }
+  // The forward transform uses the twiddles exp(-2 pi i k / n), the inverse
+  // their conjugates.
+  const Dtype sign = inverse ? 1 : -1;
+  for (int len = 2; len <= n; len *= 2) {
+    const int half = len / 2;
+    const int step = n / len;
+    for (int i = 0; i < n; i += len) {
+      for (int j = 0; j < half; ++j) {
+        const Dtype wr = plan.cos[j * step];
+        const Dtype wi = sign * plan.sin[j * step];
+        Dtype* ur = re + (i + j) * stride;
+        Dtype* ui = im + (i + j) * stride;
+        Dtype* vr = re + (i + j + half) * stride;
+        Dtype* vi = im + (i + j + half) * stride;
+        for (int k = 0; k < count; ++k) {
+          const Dtype tr = vr[k] * wr - vi[k] * wi;
+          const Dtype ti = vr[k] * wi + vi[k] * wr;
+          vr[k] = ur[k] - tr;
+          vi[k] = ui[k] - ti;
+          ur[k] += tr;
+          ui[k] += ti;
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void FFT2D<Dtype>::Transform(Dtype* re, Dtype* im, bool inverse) const {
+  for (int h = 0; h < height_; ++h) {
+    Transform1D(rows_, re + h * width_, im + h * width_, 1, 1, inverse);
+  }
+  // The columns are transformed together, whole rows at a time.
+  Transform1D(columns_, re, im, width_, width_, inverse);
+}
+
+INSTANTIATE_CLASS(FFT2D);
+
+}  // namespace caffe
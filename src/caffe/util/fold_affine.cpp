@@ -0,0 +1,198 @@
+#include <cmath>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/fold_affine.hpp"
+#include "caffe/util/net_surgery.hpp"
+
+namespace caffe {
+
+namespace {
+
+void ReadValues(const BlobProto& proto, vector<double>* values) {
+  if (proto.double_data_size() > 0) {
+    values->assign(proto.double_data().begin(), proto.double_data().end());
+  } else {
+    values->assign(proto.data().begin(), proto.data().end());
+  }
+}
+
+// Writes values in the precision of like.
+void WriteValues(const vector<double>& values, const BlobProto& like,
+    BlobProto* proto) {
+  proto->clear_data();
+  proto->clear_double_data();
+  for (int i = 0; i < values.size(); ++i) {
+    if (like.double_data_size() > 0) {
+      proto->add_double_data(values[i]);
+    } else {
+      proto->add_data(values[i]);
+    }
+  }
+}
+
+// The number of outputs of a layer whose weights can take a folded affine
+// transform, or 0 if it cannot.
+int FoldableOutputs(const LayerParameter& layer,
+    const LayerParameter* layer_weights) {
+  if (layer.top_size() != 1 || !layer_weights ||
+      layer_weights->blobs_size() == 0 ||
+      layer_weights->blobs(0).int8_data().size() > 0) {
+    return 0;
+  }
+  // Shared params would change the other layers using them.
+  for (int i = 0; i < layer.param_size(); ++i) {
+    if (layer.param(i).name().size() > 0) { return 0; }
+  }
+  // A fused activation comes after the affine transform.
+  if (layer.type() == "Convolution" &&
+      !layer.convolution_param().has_fused_activation()) {
+    return layer.convolution_param().num_output();
+  }
+  if (layer.type() == "InnerProduct" &&
+      layer.inner_product_param().axis() == 1 &&
+      !layer.inner_product_param().has_fused_activation()) {
+    return layer.inner_product_param().num_output();
+  }
+  return 0;
+}
+
+// Gets the transform y = scale * x + shift of each of the channels of an
+// affine layer, returning false if the layer is not one.
+bool AffineTransform(const LayerParameter& layer,
+    const LayerParameter* layer_weights, int channels, vector<double>* scale,
+    vector<double>* shift) {
+  if (layer.bottom_size() != 1 || layer.top_size() != 1 ||
+      layer.loss_weight_size() > 0) {
+    return false;
+  }
+  if (layer.type() == "Power") {
+    const PowerParameter& power_param = layer.power_param();
+    if (power_param.power() != 1) { return false; }
+    scale->assign(channels, power_param.scale());
+    shift->assign(channels, power_param.shift());
+    return true;
+  }
+  if (layer.type() == "BatchNorm") {
+    const BatchNormParameter& bn_param = layer.batch_norm_param();
+    if (bn_param.has_use_global_stats() && !bn_param.use_global_stats()) {
+      return false;
+    }
+    if (!layer_weights || layer_weights->blobs_size() != 3) { return false; }
+    vector<double> mean, variance, factor;
+    ReadValues(layer_weights->blobs(0), &mean);
+    ReadValues(layer_weights->blobs(1), &variance);
+    ReadValues(layer_weights->blobs(2), &factor);
+    if (mean.size() != channels || variance.size() != channels ||
+        factor.size() != 1) {
+      return false;
+    }
+    // As in BatchNormLayer::Forward_cpu with global statistics.
+    const double scale_factor = factor[0] == 0 ? 0 : 1 / factor[0];
+    scale->resize(channels);
+    shift->resize(channels);
+    for (int c = 0; c < channels; ++c) {
+      (*scale)[c] = 1 / std::sqrt(variance[c] * scale_factor +
+          static_cast<double>(bn_param.eps()));
+      (*shift)[c] = -mean[c] * scale_factor * (*scale)[c];
+    }
+    return true;
+  }
+  return false;
+}
+
+}  // namespace
+
+int FoldAffineLayers(const NetParameter& param, const NetParameter& weights,
+    NetParameter* param_folded, NetParameter* weights_folded) {
+  map<string, int> weight_ids;
+  for (int i = 0; i < weights.layer_size(); ++i) {
+    weight_ids[weights.layer(i).name()] = i;
+  }
+  NetParameter layers(param);
+  NetParameter trained(weights);
+  set<string> folded;
+  for (int i = 0; i < layers.layer_size(); ++i) {
+    LayerParameter* layer = layers.mutable_layer(i);
+    if (!weight_ids.count(layer->name())) { continue; }
+    LayerParameter* layer_weights =
+        trained.mutable_layer(weight_ids[layer->name()]);
+    const int outputs = FoldableOutputs(*layer, layer_weights);
+    if (outputs == 0) { continue; }
+    // Fold the chain of affine layers reading the top, as long as nothing
+    // else reads the top before them.
+    for (int j = i + 1; j < layers.layer_size(); ++j) {
+      const LayerParameter& next = layers.layer(j);
+      if (folded.count(next.name())) { continue; }
+      const string& top = layer->top(0);
+      bool uses_top = false;
+      for (int k = 0; k < next.bottom_size(); ++k) {
+        uses_top |= next.bottom(k) == top;
+      }
+      for (int k = 0; k < next.top_size(); ++k) {
+        uses_top |= next.top(k) == top;
+      }
+      if (!uses_top) { continue; }
+      const LayerParameter* next_weights = weight_ids.count(next.name()) ?
+          &trained.layer(weight_ids[next.name()]) : NULL;
+      vector<double> scale, shift;
+      if (next.bottom_size() != 1 || next.bottom(0) != top ||
+          !AffineTransform(next, next_weights, outputs, &scale, &shift) ||
+          (next.top(0) != top && BlobReadLater(layers, j, top))) {
+        break;
+      }
+      vector<double> weight;
+      ReadValues(layer_weights->blobs(0), &weight);
+      CHECK_EQ(weight.size() % outputs, 0) << "Unexpected weights for layer "
+          << layer->name();
+      const int row = weight.size() / outputs;
+      for (int c = 0; c < outputs; ++c) {
+        for (int k = 0; k < row; ++k) {
+          weight[c * row + k] *= scale[c];
+        }
+      }
+      vector<double> bias(outputs, 0);
+      if (layer_weights->blobs_size() > 1) {
+        ReadValues(layer_weights->blobs(1), &bias);
+        CHECK_EQ(bias.size(), outputs) << "Unexpected bias for layer "
+            << layer->name();
+      } else {
+        BlobProto* bias_proto = layer_weights->add_blobs();
+        bias_proto->mutable_shape()->add_dim(outputs);
+        if (layer->type() == "Convolution") {
+          layer->mutable_convolution_param()->set_bias_term(true);
+        } else {
+          layer->mutable_inner_product_param()->set_bias_term(true);
+        }
+      }
+      for (int c = 0; c < outputs; ++c) {
+        bias[c] = bias[c] * scale[c] + shift[c];
+      }
+      const BlobProto like(layer_weights->blobs(0));
+      WriteValues(weight, like, layer_weights->mutable_blobs(0));
+      WriteValues(bias, like, layer_weights->mutable_blobs(1));
+      layer->set_top(0, next.top(0));
+      folded.insert(next.name());
+    }
+  }
+  param_folded->CopyFrom(param);
+  param_folded->clear_layer();
+  for (int i = 0; i < layers.layer_size(); ++i) {
+    if (!folded.count(layers.layer(i).name())) {
+      param_folded->add_layer()->CopyFrom(layers.layer(i));
+    }
+  }
+  weights_folded->CopyFrom(weights);
+  weights_folded->clear_layer();
+  for (int i = 0; i < trained.layer_size(); ++i) {
+    if (!folded.count(trained.layer(i).name())) {
+      weights_folded->add_layer()->CopyFrom(trained.layer(i));
+    }
+  }
+  return folded.size();
+}
+
+}  // namespace caffe
@@ -0,0 +1,102 @@
+#include <set>
+#include <string>
+
+#include "caffe/common.hpp"
+#include "caffe/util/fuse_activations.hpp"
+#include "caffe/util/net_surgery.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Whether a layer can take a fused activation.
+bool TakesActivation(const LayerParameter& layer) {
+  if (layer.top_size() != 1 || layer.loss_weight_size() > 0) {
+    return false;
+  }
+  if (layer.type() == "Convolution") {
+    const ConvolutionParameter& conv_param = layer.convolution_param();
+    // CuDNN does not run fused activations.
+    return conv_param.engine() != ConvolutionParameter_Engine_CUDNN &&
+        !conv_param.has_fused_activation();
+  }
+  return layer.type() == "InnerProduct" &&
+      !layer.inner_product_param().has_fused_activation();
+}
+
+// Gets the activation of a neuron layer, returning false if it has none that
+// can be fused. PReLU has learned slopes and is left alone.
+bool Activation(const LayerParameter& layer, ActivationParameter* activation) {
+  if (layer.bottom_size() != 1 || layer.top_size() != 1 ||
+      layer.loss_weight_size() > 0) {
+    return false;
+  }
+  for (int i = 0; i < layer.propagate_down_size(); ++i) {
+    if (!layer.propagate_down(i)) { return false; }
+  }
+  if (layer.type() == "ReLU") {
+    // The derivative is taken from the output, which needs a slope that
+    // keeps the sign.
+    if (layer.relu_param().negative_slope() < 0) { return false; }
+    activation->set_type(ActivationParameter_Type_RELU);
+    activation->set_negative_slope(layer.relu_param().negative_slope());
+    return true;
+  }
+  if (layer.type() == "Sigmoid") {
+    activation->set_type(ActivationParameter_Type_SIGMOID);
+    return true;
+  }
+  if (layer.type() == "TanH") {
+    activation->set_type(ActivationParameter_Type_TANH);
+    return true;
+  }
+  return false;
+}
+
+}  // namespace
+
+int FuseActivations(const NetParameter& param, NetParameter* param_fused) {
+  NetParameter layers(param);
+  set<int> fused;
+  for (int i = 0; i < layers.layer_size(); ++i) {
+    LayerParameter* layer = layers.mutable_layer(i);
+    if (!TakesActivation(*layer)) { continue; }
+    // The activation has to be the first layer to touch the top.
+    const string& top = layer->top(0);
+    for (int j = i + 1; j < layers.layer_size(); ++j) {
+      const LayerParameter& next = layers.layer(j);
+      bool uses_top = false;
+      for (int k = 0; k < next.bottom_size(); ++k) {
+        uses_top |= next.bottom(k) == top;
+      }
+      for (int k = 0; k < next.top_size(); ++k) {
+        uses_top |= next.top(k) == top;
+      }
+      if (!uses_top) { continue; }
+      ActivationParameter activation;
+      if (Activation(next, &activation) && next.bottom(0) == top &&
+          (next.top(0) == top || !BlobReadLater(layers, j, top))) {
+        if (layer->type() == "Convolution") {
+          layer->mutable_convolution_param()->mutable_fused_activation()
+              ->CopyFrom(activation);
+        } else {
+          layer->mutable_inner_product_param()->mutable_fused_activation()
+              ->CopyFrom(activation);
+        }
+        layer->set_top(0, next.top(0));
+        fused.insert(j);
+      }
+      break;
+    }
+  }
+  param_fused->CopyFrom(layers);
+  param_fused->clear_layer();
+  for (int i = 0; i < layers.layer_size(); ++i) {
+    if (!fused.count(i)) {
+      param_fused->add_layer()->CopyFrom(layers.layer(i));
+    }
+  }
+  return fused.size();
+}
+
+}  // namespace caffe
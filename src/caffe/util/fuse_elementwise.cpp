@@ -0,0 +1,115 @@
+#include <set>
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/fuse_elementwise.hpp"
+#include "caffe/util/net_surgery.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Whether a layer can be part of an elementwise chain, at its start if first.
+bool Chainable(const LayerParameter& layer, Phase phase, bool first) {
+  if (layer.top_size() != 1 || layer.loss_weight_size() > 0 ||
+      layer.param_size() > 0) {
+    return false;
+  }
+  const string& type = layer.type();
+  if (type == "Eltwise") {
+    if (!first || layer.bottom_size() < 2) { return false; }
+    for (int i = 0; i < layer.bottom_size(); ++i) {
+      if (layer.bottom(i) == layer.top(0)) { return false; }
+    }
+    return true;
+  }
+  if (layer.bottom_size() != 1) { return false; }
+  // The chain takes the propagate_down of its first layer only.
+  if (!first) {
+    for (int i = 0; i < layer.propagate_down_size(); ++i) {
+      if (!layer.propagate_down(i)) { return false; }
+    }
+  }
+  if (type == "Dropout") { return phase == TEST; }
+  return type == "AbsVal" || type == "BNLL" || type == "Exp" ||
+      type == "Log" || type == "Power" || type == "ReLU" ||
+      type == "Sigmoid" || type == "TanH" || type == "Threshold";
+}
+
+bool Touches(const LayerParameter& layer, const string& blob) {
+  for (int k = 0; k < layer.bottom_size(); ++k) {
+    if (layer.bottom(k) == blob) { return true; }
+  }
+  for (int k = 0; k < layer.top_size(); ++k) {
+    if (layer.top(k) == blob) { return true; }
+  }
+  return false;
+}
+
+}  // namespace
+
+int FuseElementwiseChains(const NetParameter& param,
+    NetParameter* param_fused) {
+  const Phase phase = param.state().phase();
+  param_fused->CopyFrom(param);
+  param_fused->clear_layer();
+  set<int> chained;
+  for (int i = 0; i < param.layer_size(); ++i) {
+    if (chained.count(i)) { continue; }
+    const LayerParameter& first = param.layer(i);
+    vector<int> chain(1, i);
+    if (Chainable(first, phase, true)) {
+      // Extend the chain with the layers each reading only the top of the
+      // one before, as long as the blob between them is not read elsewhere.
+      string top = first.top(0);
+      for (int j = i + 1; j < param.layer_size(); ++j) {
+        const LayerParameter& next = param.layer(j);
+        if (!Touches(next, top)) { continue; }
+        if (!Chainable(next, phase, false) || next.bottom(0) != top ||
+            (next.top(0) != top && BlobReadLater(param, j, top))) {
+          break;
+        }
+        chain.push_back(j);
+        top = next.top(0);
+      }
+      // The chain runs in place of its first layer, so the layers in between
+      // must not touch its top. An Eltwise chain cannot run in place.
+      while (chain.size() > 1) {
+        const string& chain_top = param.layer(chain.back()).top(0);
+        bool touched = false;
+        for (int k = 0; k < first.bottom_size() && first.bottom_size() > 1;
+            ++k) {
+          touched |= first.bottom(k) == chain_top;
+        }
+        for (int j = i + 1, k = 1; j < chain.back(); ++j) {
+          if (j == chain[k]) {
+            ++k;
+          } else {
+            touched |= Touches(param.layer(j), chain_top);
+          }
+        }
+        if (!touched) { break; }
+        chain.pop_back();
+      }
+    }
+    if (chain.size() == 1) {
+      param_fused->add_layer()->CopyFrom(first);
+      continue;
+    }
+    LayerParameter* fused = param_fused->add_layer();
+    fused->set_name(first.name() + "_chain");
+    fused->set_type("ElementwiseChain");
+    fused->mutable_bottom()->CopyFrom(first.bottom());
+    fused->add_top(param.layer(chain.back()).top(0));
+    fused->mutable_propagate_down()->CopyFrom(first.propagate_down());
+    for (int k = 0; k < chain.size(); ++k) {
+      fused->mutable_elementwise_chain_param()->add_layer()->CopyFrom(
+          param.layer(chain[k]));
+      chained.insert(chain[k]);
+    }
+  }
+  return param.layer_size() - param_fused->layer_size();
+}
+
+}  // namespace caffe
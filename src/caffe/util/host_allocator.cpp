@@ -0,0 +1,263 @@
+#include <boost/thread.hpp>
+#include <stdlib.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#include <set>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/host_allocator.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Alignment of every pooled block (one cache line, and enough for AVX-512).
+const size_t kAlignment = 64;
+const size_t kHugePageSize = 2 << 20;
+// Size classes are multiples of kAlignment up to kSmallSize, and four classes
+// per power of two above it, so rounding up wastes at most 25%.
+const size_t kSmallSize = 4 * kAlignment;
+const int kSmallClasses = 4;
+const int kSmallSizeLog2 = 8;
+const int kNumClasses = kSmallClasses + 4 * (64 - kSmallSizeLog2);
+// Per-thread caches hold a few blocks of each class up to this size.
+const size_t kThreadCacheMaxBlock = 1 << 20;
+const int kThreadCacheBlocks = 4;
+
+int SizeClass(size_t size) {
+  if (size <= kSmallSize) {
+    return size == 0 ? 0 : (size - 1) / kAlignment;
+  }
+  // Find k such that 2^k < size <= 2^(k + 1).
+  int k = kSmallSizeLog2;
+  while ((size - 1) >> (k + 1)) { ++k; }
+  const size_t step = static_cast<size_t>(1) << (k - 2);
+  const size_t quarter = (size - (static_cast<size_t>(1) << k) + step - 1)
+      / step;
+  return kSmallClasses + 4 * (k - kSmallSizeLog2) + quarter - 1;
+}
+
+size_t ClassSize(int size_class) {
+  if (size_class < kSmallClasses) {
+    return (size_class + 1) * kAlignment;
+  }
+  const int k = kSmallSizeLog2 + (size_class - kSmallClasses) / 4;
+  const size_t quarter = (size_class - kSmallClasses) % 4 + 1;
+  return (static_cast<size_t>(1) << k) + quarter * (static_cast<size_t>(1)
+      << (k - 2));
+}
+
+void* SystemAllocate(size_t size) {
+  const bool huge = Caffe::host_huge_pages() && size >= kHugePageSize;
+  void* ptr = NULL;
+  if (posix_memalign(&ptr, huge ? kHugePageSize : kAlignment, size) != 0) {
+    return NULL;
+  }
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+  if (huge) {
+    madvise(ptr, size, MADV_HUGEPAGE);
+  }
+#endif
+  return ptr;
+}
+
+class MallocHostAllocator : public HostAllocator {
+ public:
+  virtual void* Allocate(size_t size) { return malloc(size); }
+  virtual void Free(void* ptr, size_t size) { free(ptr); }
+  virtual HostAllocatorStats stats() const { return HostAllocatorStats(); }
+};
+
+class PooledHostAllocator : public HostAllocator {
+ public:
+  PooledHostAllocator() : free_lists_(kNumClasses) {}
+  virtual void* Allocate(size_t size);
+  virtual void Free(void* ptr, size_t size);
+  virtual void ReleaseCached();
+  virtual HostAllocatorStats stats() const;
+
+ private:
+  // The blocks and counters of one thread, which only that thread touches,
+  // except stats(), which reads the counters under the cache's mutex. Blocks
+  // may be freed by another thread than the one that allocated them, so the
+  // byte counters of a thread are deltas that can wrap around below zero;
+  // only their sum is meaningful.
+  class ThreadCache {
+   public:
+    explicit ThreadCache(PooledHostAllocator* pool)
+        : pool_(pool), blocks_(kNumClasses) {
+      boost::mutex::scoped_lock lock(pool_->mutex_);
+      pool_->thread_caches_.insert(this);
+    }
+    // Hand the cached blocks and the counters back to the shared pool when
+    // the thread exits.
+    ~ThreadCache() {
+      boost::mutex::scoped_lock lock(pool_->mutex_);
+      for (int c = 0; c < kNumClasses; ++c) {
+        pool_->free_lists_[c].insert(pool_->free_lists_[c].end(),
+            blocks_[c].begin(), blocks_[c].end());
+      }
+      pool_->Merge(counters_);
+      pool_->thread_caches_.erase(this);
+    }
+
+    PooledHostAllocator* pool_;
+    vector<vector<void*> > blocks_;
+    // Guards counters_ against stats(). Only the owning thread writes them,
+    // so it may read them without the lock, and the lock is uncontended
+    // except while stats() runs. Taken after the pool's mutex_.
+    boost::mutex mutex_;
+    HostAllocatorStats counters_;
+  };
+
+  ThreadCache* thread_cache() {
+    if (!thread_cache_.get()) {
+      thread_cache_.reset(new ThreadCache(this));
+    }
+    return thread_cache_.get();
+  }
+  // Folds the counters of a thread into the shared ones; needs mutex_.
+  void Merge(const HostAllocatorStats& counters);
+
+  mutable boost::mutex mutex_;
+  vector<vector<void*> > free_lists_;
+  // Counters of the shared pool, including those of exited threads.
+  HostAllocatorStats counters_;
+  std::set<ThreadCache*> thread_caches_;
+  boost::thread_specific_ptr<ThreadCache> thread_cache_;
+};
+
+void* PooledHostAllocator::Allocate(size_t size) {
+  const int size_class = SizeClass(size);
+  const size_t block_size = ClassSize(size_class);
+  if (block_size <= kThreadCacheMaxBlock) {
+    ThreadCache* cache = thread_cache();
+    vector<void*>& blocks = cache->blocks_[size_class];
+    if (!blocks.empty()) {
+      void* ptr = blocks.back();
+      blocks.pop_back();
+      boost::mutex::scoped_lock lock(cache->mutex_);
+      ++cache->counters_.allocs;
+      ++cache->counters_.cache_hits;
+      cache->counters_.bytes_in_use += block_size;
+      cache->counters_.bytes_cached -= block_size;
+      return ptr;
+    }
+  }
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    ++counters_.allocs;
+    vector<void*>& free_list = free_lists_[size_class];
+    if (!free_list.empty()) {
+      void* ptr = free_list.back();
+      free_list.pop_back();
+      ++counters_.cache_hits;
+      counters_.bytes_in_use += block_size;
+      counters_.bytes_cached -= block_size;
+      return ptr;
+    }
+  }
+  void* ptr = SystemAllocate(block_size);
+  if (ptr) {
+    boost::mutex::scoped_lock lock(mutex_);
+    counters_.bytes_in_use += block_size;
+    counters_.bytes_reserved += block_size;
+  }
+  return ptr;
+}
+
+void PooledHostAllocator::Free(void* ptr, size_t size) {
+  if (!ptr) { return; }
+  const int size_class = SizeClass(size);
+  const size_t block_size = ClassSize(size_class);
+  if (block_size <= kThreadCacheMaxBlock) {
+    ThreadCache* cache = thread_cache();
+    vector<void*>& blocks = cache->blocks_[size_class];
+    if (blocks.size() < kThreadCacheBlocks) {
+      blocks.push_back(ptr);
+      boost::mutex::scoped_lock lock(cache->mutex_);
+      ++cache->counters_.frees;
+      cache->counters_.bytes_in_use -= block_size;
+      cache->counters_.bytes_cached += block_size;
+      return;
+    }
+  }
+  boost::mutex::scoped_lock lock(mutex_);
+  free_lists_[size_class].push_back(ptr);
+  ++counters_.frees;
+  counters_.bytes_in_use -= block_size;
+  counters_.bytes_cached += block_size;
+}
+
+void PooledHostAllocator::ReleaseCached() {
+  // Blocks in the caches of other threads stay there until they exit.
+  ThreadCache* cache = thread_cache_.get();
+  boost::mutex::scoped_lock lock(mutex_);
+  if (cache) {
+    boost::mutex::scoped_lock cache_lock(cache->mutex_);
+    for (int c = 0; c < kNumClasses; ++c) {
+      free_lists_[c].insert(free_lists_[c].end(), cache->blocks_[c].begin(),
+          cache->blocks_[c].end());
+      const size_t bytes = cache->blocks_[c].size() * ClassSize(c);
+      cache->counters_.bytes_cached -= bytes;
+      counters_.bytes_cached += bytes;
+      cache->blocks_[c].clear();
+    }
+  }
+  for (int c = 0; c < kNumClasses; ++c) {
+    const size_t bytes = free_lists_[c].size() * ClassSize(c);
+    for (int i = 0; i < free_lists_[c].size(); ++i) {
+      free(free_lists_[c][i]);
+    }
+    free_lists_[c].clear();
+    counters_.bytes_cached -= bytes;
+    counters_.bytes_reserved -= bytes;
+  }
+}
+
+void PooledHostAllocator::Merge(const HostAllocatorStats& counters) {
+  counters_.allocs += counters.allocs;
+  counters_.frees += counters.frees;
+  counters_.cache_hits += counters.cache_hits;
+  counters_.bytes_in_use += counters.bytes_in_use;
+  counters_.bytes_cached += counters.bytes_cached;
+}
+
+HostAllocatorStats PooledHostAllocator::stats() const {
+  boost::mutex::scoped_lock lock(mutex_);
+  HostAllocatorStats stats = counters_;
+  for (std::set<ThreadCache*>::const_iterator it = thread_caches_.begin();
+       it != thread_caches_.end(); ++it) {
+    boost::mutex::scoped_lock cache_lock((*it)->mutex_);
+    const HostAllocatorStats& counters = (*it)->counters_;
+    stats.allocs += counters.allocs;
+    stats.frees += counters.frees;
+    stats.cache_hits += counters.cache_hits;
+    stats.bytes_in_use += counters.bytes_in_use;
+    stats.bytes_cached += counters.bytes_cached;
+  }
+  return stats;
+}
+
+}  // namespace
+
+HostAllocator* GetHostAllocator(Caffe::HostAllocatorType type) {
+  // Allocators are never destroyed, so that memory freed during static
+  // destruction still finds its allocator.
+  static MallocHostAllocator* malloc_allocator = new MallocHostAllocator();
+  static PooledHostAllocator* pooled_allocator = new PooledHostAllocator();
+  switch (type) {
+  case Caffe::MALLOC:
+    return malloc_allocator;
+  case Caffe::POOLED:
+    return pooled_allocator;
+  default:
+    LOG(FATAL) << "Unknown host allocator type: " << type;
+  }
+  return NULL;
+}
+
+}  // namespace caffe
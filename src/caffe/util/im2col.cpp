@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <vector>
 
 #include "caffe/util/im2col.hpp"
@@ -5,6 +6,119 @@
 
 namespace caffe {
 
+// The 2D CPU versions share one core, specialized at compile time for the
+// common kernel sizes KH x KW and horizontal strides SW (0 where they are
+// only known at run time). Each row of the column image splits into a left
+// and a right border that read the padding and an interior without bounds
+// checks, which is a plain copy for stride 1; rows that fall entirely in
+// the padding are filled at once.
+//
+// The core handles rows [row_begin, row_end) of the column image, with the
+// rows of one column channel col_stride elements apart. im2col overwrites
+// data_col; col2im adds to data_im.
+template <typename Dtype, bool kIm2Col, int KH, int KW, int SW>
+void im2col_2d_core_cpu(const Dtype* data_input, const int channels,
+    const int height, const int width, const int kernel_h_arg,
+    const int kernel_w_arg, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w_arg,
+    const int dilation_h, const int dilation_w,
+    const int width_col, const int row_begin, const int row_end,
+    const int col_stride, Dtype* data_output) {
+  const int kernel_h = KH ? KH : kernel_h_arg;
+  const int kernel_w = KW ? KW : kernel_w_arg;
+  const int stride_w = SW ? SW : stride_w_arg;
+  int c_col = 0;
+  for (int c_im = 0; c_im < channels; ++c_im) {
+    for (int h_offset = 0; h_offset < kernel_h; ++h_offset) {
+      for (int w_offset = 0; w_offset < kernel_w; ++w_offset, ++c_col) {
+        // Output column w_col reads input column w_col * stride_w + offset,
+        // which is inside the image for w_col in [begin, end).
+        const int offset = w_offset * dilation_w - pad_w;
+        const int begin = std::min(width_col,
+            offset >= 0 ? 0 : (stride_w - 1 - offset) / stride_w);
+        const int end = std::max(begin, width - 1 - offset >= 0 ?
+            std::min(width_col, (width - 1 - offset) / stride_w + 1) : 0);
+        for (int h_col = row_begin; h_col < row_end; ++h_col) {
+          const int h_im = h_col * stride_h - pad_h + h_offset * dilation_h;
+          const int col_index = c_col * col_stride +
+              (h_col - row_begin) * width_col;
+          if (h_im < 0 || h_im >= height) {
+            if (kIm2Col) {
+              caffe_set(width_col, Dtype(0), data_output + col_index);
+            }
+            continue;
+          }
+          const int im_index = (c_im * height + h_im) * width + offset;
+          if (kIm2Col) {
+            const Dtype* im_row = data_input + im_index;
+            Dtype* col_row = data_output + col_index;
+            for (int w_col = 0; w_col < begin; ++w_col) {
+              col_row[w_col] = 0;
+            }
+            if (stride_w == 1) {
+              std::copy(im_row + begin, im_row + end, col_row + begin);
+            } else {
+              for (int w_col = begin; w_col < end; ++w_col) {
+                col_row[w_col] = im_row[w_col * stride_w];
+              }
+            }
+            for (int w_col = end; w_col < width_col; ++w_col) {
+              col_row[w_col] = 0;
+            }
+          } else {
+            const Dtype* col_row = data_input + col_index;
+            Dtype* im_row = data_output + im_index;
+            if (stride_w == 1) {
+              for (int w_col = begin; w_col < end; ++w_col) {
+                im_row[w_col] += col_row[w_col];
+              }
+            } else {
+              for (int w_col = begin; w_col < end; ++w_col) {
+                im_row[w_col * stride_w] += col_row[w_col];
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+// Picks the specialization of im2col_2d_core_cpu for the kernel geometry:
+// 1x1 with stride 1 or 2, 3x3 with stride 1 or 2, 5x5 with stride 1 and
+// 7x7 with stride 2, any of them dilated, else the generic version for
+// stride 1 or any stride.
+template <typename Dtype, bool kIm2Col>
+void im2col_2d_cpu(const Dtype* data_input, const int channels,
+    const int height, const int width, const int kernel_h,
+    const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w,
+    const int width_col, const int row_begin, const int row_end,
+    const int col_stride, Dtype* data_output) {
+  void (*core)(const Dtype*, const int, const int, const int, const int,
+      const int, const int, const int, const int, const int, const int,
+      const int, const int, const int, const int, const int, Dtype*);
+  if (kernel_h == 1 && kernel_w == 1 && stride_w <= 2) {
+    core = stride_w == 1 ? im2col_2d_core_cpu<Dtype, kIm2Col, 1, 1, 1> :
+        im2col_2d_core_cpu<Dtype, kIm2Col, 1, 1, 2>;
+  } else if (kernel_h == 3 && kernel_w == 3 && stride_w <= 2) {
+    core = stride_w == 1 ? im2col_2d_core_cpu<Dtype, kIm2Col, 3, 3, 1> :
+        im2col_2d_core_cpu<Dtype, kIm2Col, 3, 3, 2>;
+  } else if (kernel_h == 5 && kernel_w == 5 && stride_w == 1) {
+    core = im2col_2d_core_cpu<Dtype, kIm2Col, 5, 5, 1>;
+  } else if (kernel_h == 7 && kernel_w == 7 && stride_w == 2) {
+    core = im2col_2d_core_cpu<Dtype, kIm2Col, 7, 7, 2>;
+  } else if (stride_w == 1) {
+    core = im2col_2d_core_cpu<Dtype, kIm2Col, 0, 0, 1>;
+  } else {
+    core = im2col_2d_core_cpu<Dtype, kIm2Col, 0, 0, 0>;
+  }
+  core(data_input, channels, height, width, kernel_h, kernel_w, pad_h, pad_w,
+      stride_h, stride_w, dilation_h, dilation_w, width_col, row_begin,
+      row_end, col_stride, data_output);
+}
+
 template <typename Dtype>
 void im2col_cpu(const Dtype* data_im, const int channels,
     const int height, const int width, const int kernel_h, const int kernel_w,
@@ -16,21 +130,9 @@ void im2col_cpu(const Dtype* data_im, const int channels,
       (dilation_h * (kernel_h - 1) + 1)) / stride_h + 1;
   const int width_col = (width + 2 * pad_w -
       (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1;
-  const int channels_col = channels * kernel_h * kernel_w;
-  for (int c_col = 0; c_col < channels_col; ++c_col) {
-    int w_offset = c_col % kernel_w;
-    int h_offset = (c_col / kernel_w) % kernel_h;
-    int c_im = c_col / kernel_h / kernel_w;
-    for (int h_col = 0; h_col < height_col; ++h_col) {
-      for (int w_col = 0; w_col < width_col; ++w_col) {
-        int h_im = h_col * stride_h - pad_h + h_offset * dilation_h;
-        int w_im = w_col * stride_w - pad_w + w_offset * dilation_w;
-        data_col[(c_col * height_col + h_col) * width_col + w_col] =
-            (h_im >= 0 && w_im >= 0 && h_im < height && w_im < width) ?
-            data_im[(c_im * height + h_im) * width + w_im] : 0;
-      }
-    }
-  }
+  im2col_2d_cpu<Dtype, true>(data_im, channels, height, width, kernel_h,
+      kernel_w, pad_h, pad_w, stride_h, stride_w, dilation_h, dilation_w,
+      width_col, 0, height_col, height_col * width_col, data_col);
 }
 
 // Explicit instantiation
@@ -121,6 +223,13 @@ void im2col_nd_cpu(const Dtype* data_im, const int num_spatial_axes,
     const int* im_shape, const int* col_shape,
     const int* kernel_shape, const int* pad, const int* stride,
     const int* dilation, Dtype* data_col) {
+  if (num_spatial_axes == 2) {
+    im2col_2d_cpu<Dtype, true>(data_im, im_shape[0], im_shape[1],
+        im_shape[2], kernel_shape[0], kernel_shape[1], pad[0], pad[1],
+        stride[0], stride[1], dilation[0], dilation[1], col_shape[2], 0,
+        col_shape[1], col_shape[1] * col_shape[2], data_col);
+    return;
+  }
   const bool kIm2Col = true;
   im2col_nd_core_cpu(data_im, kIm2Col, num_spatial_axes, im_shape, col_shape,
                   kernel_shape, pad, stride, dilation, data_col);
@@ -150,21 +259,9 @@ void col2im_cpu(const Dtype* data_col, const int channels,
       (dilation_h * (kernel_h - 1) + 1)) / stride_h + 1;
   const int width_col = (width + 2 * pad_w -
       (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1;
-  const int channels_col = channels * kernel_h * kernel_w;
-  for (int c_col = 0; c_col < channels_col; ++c_col) {
-    int w_offset = c_col % kernel_w;
-    int h_offset = (c_col / kernel_w) % kernel_h;
-    int c_im = c_col / kernel_h / kernel_w;
-    for (int h_col = 0; h_col < height_col; ++h_col) {
-      for (int w_col = 0; w_col < width_col; ++w_col) {
-        int h_im = h_col * stride_h - pad_h + h_offset * dilation_h;
-        int w_im = w_col * stride_w - pad_w + w_offset * dilation_w;
-        if (h_im >= 0 && h_im < height && w_im >= 0 && w_im < width)
-          data_im[(c_im * height + h_im) * width + w_im] +=
-              data_col[(c_col * height_col + h_col) * width_col + w_col];
-      }
-    }
-  }
+  im2col_2d_cpu<Dtype, false>(data_col, channels, height, width, kernel_h,
+      kernel_w, pad_h, pad_w, stride_h, stride_w, dilation_h, dilation_w,
+      width_col, 0, height_col, height_col * width_col, data_im);
 }
 
 // Explicit instantiation
@@ -179,11 +276,105 @@ template void col2im_cpu<double>(const double* data_col, const int channels,
     const int stride_w, const int dilation_h, const int dilation_w,
     double* data_im);
 
+template <typename Dtype>
+void im2col_rows_cpu(const Dtype* data_im, const int channels,
+    const int height, const int width, const int kernel_h, const int kernel_w,
+    const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w,
+    const int row_begin, const int row_end, Dtype* data_col) {
+  const int width_col = (width + 2 * pad_w -
+      (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1;
+  im2col_2d_cpu<Dtype, true>(data_im, channels, height, width, kernel_h,
+      kernel_w, pad_h, pad_w, stride_h, stride_w, dilation_h, dilation_w,
+      width_col, row_begin, row_end, (row_end - row_begin) * width_col,
+      data_col);
+}
+
+// Explicit instantiation
+template void im2col_rows_cpu<float>(const float* data_im,
+    const int channels, const int height, const int width,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int dilation_h,
+    const int dilation_w, const int row_begin, const int row_end,
+    float* data_col);
+template void im2col_rows_cpu<double>(const double* data_im,
+    const int channels, const int height, const int width,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int dilation_h,
+    const int dilation_w, const int row_begin, const int row_end,
+    double* data_col);
+
+template <typename Dtype>
+void im2col_strided_cpu(const Dtype* data_im, const int channels,
+    const int height, const int width, const int kernel_h, const int kernel_w,
+    const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w,
+    const int col_stride, Dtype* data_col) {
+  const int height_col = (height + 2 * pad_h -
+      (dilation_h * (kernel_h - 1) + 1)) / stride_h + 1;
+  const int width_col = (width + 2 * pad_w -
+      (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1;
+  im2col_2d_cpu<Dtype, true>(data_im, channels, height, width, kernel_h,
+      kernel_w, pad_h, pad_w, stride_h, stride_w, dilation_h, dilation_w,
+      width_col, 0, height_col, col_stride, data_col);
+}
+
+// Explicit instantiation
+template void im2col_strided_cpu<float>(const float* data_im,
+    const int channels, const int height, const int width,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int dilation_h,
+    const int dilation_w, const int col_stride, float* data_col);
+template void im2col_strided_cpu<double>(const double* data_im,
+    const int channels, const int height, const int width,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int dilation_h,
+    const int dilation_w, const int col_stride, double* data_col);
+
+template <typename Dtype>
+void col2im_rows_cpu(const Dtype* data_col, const int channels,
+    const int height, const int width, const int kernel_h, const int kernel_w,
+    const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w,
+    const int row_begin, const int row_end, Dtype* data_im) {
+  const int width_col = (width + 2 * pad_w -
+      (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1;
+  im2col_2d_cpu<Dtype, false>(data_col, channels, height, width, kernel_h,
+      kernel_w, pad_h, pad_w, stride_h, stride_w, dilation_h, dilation_w,
+      width_col, row_begin, row_end, (row_end - row_begin) * width_col,
+      data_im);
+}
+
+// Explicit instantiation
+template void col2im_rows_cpu<float>(const float* data_col,
+    const int channels, const int height, const int width,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int dilation_h,
+    const int dilation_w, const int row_begin, const int row_end,
+    float* data_im);
+template void col2im_rows_cpu<double>(const double* data_col,
+    const int channels, const int height, const int width,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int dilation_h,
+    const int dilation_w, const int row_begin, const int row_end,
+    double* data_im);
+
 template <typename Dtype>
 void col2im_nd_cpu(const Dtype* data_col, const int num_spatial_axes,
     const int* im_shape, const int* col_shape,
     const int* kernel_shape, const int* pad, const int* stride,
     const int* dilation, Dtype* data_im) {
+  if (num_spatial_axes == 2) {
+    caffe_set(im_shape[0] * im_shape[1] * im_shape[2], Dtype(0), data_im);
+    im2col_2d_cpu<Dtype, false>(data_col, im_shape[0], im_shape[1],
+        im_shape[2], kernel_shape[0], kernel_shape[1], pad[0], pad[1],
+        stride[0], stride[1], dilation[0], dilation[1], col_shape[2], 0,
+        col_shape[1], col_shape[1] * col_shape[2], data_im);
+    return;
+  }
   const bool kIm2Col = false;
   im2col_nd_core_cpu(data_col, kIm2Col, num_spatial_axes, im_shape, col_shape,
                      kernel_shape, pad, stride, dilation, data_im);
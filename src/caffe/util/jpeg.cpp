@@ -0,0 +1,142 @@
+#ifdef USE_LIBJPEG
+#include <setjmp.h>
+#include <stdio.h>
+// jpeglib.h needs the FILE of stdio.h.
+#include <jpeglib.h>  // NOLINT(build/include_alpha)
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "caffe/util/jpeg.hpp"
+
+// The crops and BGR output need the extensions of libjpeg-turbo.
+#if !defined(LIBJPEG_TURBO_VERSION) || !defined(JCS_EXTENSIONS)
+#error "USE_LIBJPEG needs libjpeg-turbo 1.5 or later."
+#endif
+
+namespace caffe {
+
+namespace {
+
+// libjpeg reports errors by calling error_exit, which must not return: it
+// jumps back to the decoding function instead of exiting the process.
+struct JPEGError {
+  jpeg_error_mgr pub;
+  jmp_buf jump;
+};
+
+void JPEGErrorExit(j_common_ptr cinfo) {
+  longjmp(reinterpret_cast<JPEGError*>(cinfo->err)->jump, 1);
+}
+
+// Corrupt data warnings are not printed, as cv::imdecode does not.
+void JPEGOutputMessage(j_common_ptr cinfo) {}
+
+void InitJPEGSource(const string& data, jpeg_decompress_struct* cinfo,
+    JPEGError* error) {
+  cinfo->err = jpeg_std_error(&error->pub);
+  error->pub.error_exit = JPEGErrorExit;
+  error->pub.output_message = JPEGOutputMessage;
+  jpeg_create_decompress(cinfo);
+  // Older versions of libjpeg take a non-const buffer.
+  jpeg_mem_src(cinfo, const_cast<unsigned char*>(
+      reinterpret_cast<const unsigned char*>(data.data())), data.size());
+}
+
+// Reads the header and sets the output color space and scale, returning
+// false for the color spaces libjpeg does not convert to BGR.
+bool ReadJPEGHeader(jpeg_decompress_struct* cinfo, int color, int scale) {
+  if (jpeg_read_header(cinfo, TRUE) != JPEG_HEADER_OK ||
+      cinfo->jpeg_color_space == JCS_CMYK ||
+      cinfo->jpeg_color_space == JCS_YCCK) {
+    return false;
+  }
+  const bool gray = color == 0 || (color < 0 && cinfo->num_components == 1);
+  cinfo->out_color_space = gray ? JCS_GRAYSCALE : JCS_EXT_BGR;
+  cinfo->scale_num = 1;
+  cinfo->scale_denom = scale;
+  jpeg_calc_output_dimensions(cinfo);
+  return true;
+}
+
+}  // namespace
+
+bool ReadJPEGShape(const string& data, int color, int min_size, int* scale,
+    int* height, int* width, int* channels) {
+  if (data.size() < 2 || static_cast<unsigned char>(data[0]) != 0xFF ||
+      static_cast<unsigned char>(data[1]) != 0xD8) {
+    return false;
+  }
+  jpeg_decompress_struct cinfo;
+  JPEGError error;
+  if (setjmp(error.jump)) {
+    jpeg_destroy_decompress(&cinfo);
+    return false;
+  }
+  InitJPEGSource(data, &cinfo, &error);
+  if (!ReadJPEGHeader(&cinfo, color, 1)) {
+    jpeg_destroy_decompress(&cinfo);
+    return false;
+  }
+  // libjpeg rounds the scaled sizes up.
+  const int min_side = std::min(cinfo.image_height, cinfo.image_width);
+  *scale = 1;
+  while (min_size > 0 && *scale < 8 &&
+         (min_side + 2 * *scale - 1) / (2 * *scale) >= min_size) {
+    *scale *= 2;
+  }
+  if (*scale > 1) {
+    cinfo.scale_denom = *scale;
+    jpeg_calc_output_dimensions(&cinfo);
+  }
+  *height = cinfo.output_height;
+  *width = cinfo.output_width;
+  *channels = cinfo.out_color_components;
+  jpeg_destroy_decompress(&cinfo);
+  return true;
+}
+
+bool DecodeJPEG(const string& data, int color, int scale, int x, int y,
+    int cols, int rows, vector<unsigned char>* buffer, int* step,
+    int* offset) {
+  jpeg_decompress_struct cinfo;
+  JPEGError error;
+  if (setjmp(error.jump)) {
+    jpeg_destroy_decompress(&cinfo);
+    return false;
+  }
+  InitJPEGSource(data, &cinfo, &error);
+  if (!ReadJPEGHeader(&cinfo, color, scale)) {
+    jpeg_destroy_decompress(&cinfo);
+    return false;
+  }
+  jpeg_start_decompress(&cinfo);
+  CHECK_GE(x, 0);
+  CHECK_GE(y, 0);
+  CHECK_LE(x + cols, static_cast<int>(cinfo.output_width));
+  CHECK_LE(y + rows, static_cast<int>(cinfo.output_height));
+  // The columns widen to whole blocks.
+  JDIMENSION first_col = x;
+  JDIMENSION crop_cols = cols;
+  if (cols < static_cast<int>(cinfo.output_width)) {
+    jpeg_crop_scanline(&cinfo, &first_col, &crop_cols);
+  }
+  const int channels = cinfo.output_components;
+  *step = crop_cols * channels;
+  *offset = (x - first_col) * channels;
+  buffer->resize(static_cast<size_t>(rows) * *step);
+  if (y > 0) {
+    jpeg_skip_scanlines(&cinfo, y);
+  }
+  for (int i = 0; i < rows; ++i) {
+    JSAMPROW row = &(*buffer)[static_cast<size_t>(i) * *step];
+    jpeg_read_scanlines(&cinfo, &row, 1);
+  }
+  // The rows below the crop are left undecoded.
+  jpeg_destroy_decompress(&cinfo);
+  return true;
+}
+
+}  // namespace caffe
+#endif  // USE_LIBJPEG
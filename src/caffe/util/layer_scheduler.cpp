@@ -0,0 +1,168 @@
+#include <boost/thread.hpp>
+#include <functional>
+#include <queue>
+#include <vector>
+
+#include "caffe/util/layer_scheduler.hpp"
+
+namespace caffe {
+
+class LayerScheduler::Impl {
+ public:
+  explicit Impl(int threads);
+  ~Impl();
+
+  void Run(const vector<vector<int> >& predecessors,
+      const vector<bool>& active, const vector<bool>& on_caller, Task task,
+      void* context);
+
+ private:
+  typedef std::priority_queue<int, vector<int>, std::greater<int> > Queue;
+
+  void Work();
+  // Runs ready nodes until all nodes of the current run are done; lock
+  // holds mutex_. Only the caller takes the nodes of caller_nodes_.
+  void RunNodes(boost::mutex::scoped_lock* lock, bool caller);
+  void Ready(int node) {
+    (on_caller_[node] ? caller_nodes_ : ready_nodes_).push(node);
+  }
+
+  boost::mutex mutex_;
+  // Signaled when nodes become ready, a run starts, or the workers stop.
+  boost::condition_variable ready_;
+  // Signaled when the last node of a run is done.
+  boost::condition_variable done_;
+  vector<shared_ptr<boost::thread> > workers_;
+  bool stop_;
+  // Incremented for each run, to wake the workers.
+  unsigned int generation_;
+  // The current run.
+  Task task_;
+  void* context_;
+  vector<bool> active_;
+  vector<bool> on_caller_;
+  vector<vector<int> > successors_;
+  vector<int> waiting_;
+  Queue ready_nodes_;
+  Queue caller_nodes_;
+  int pending_;
+
+  DISABLE_COPY_AND_ASSIGN(Impl);
+};
+
+LayerScheduler::Impl::Impl(int threads)
+    : stop_(false), generation_(0), task_(NULL), context_(NULL),
+      pending_(0) {
+  for (int i = 1; i < threads; ++i) {
+    workers_.push_back(shared_ptr<boost::thread>(
+        new boost::thread(&Impl::Work, this)));
+  }
+}
+
+LayerScheduler::Impl::~Impl() {
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    stop_ = true;
+  }
+  ready_.notify_all();
+  for (int i = 0; i < workers_.size(); ++i) {
+    workers_[i]->join();
+  }
+}
+
+void LayerScheduler::Impl::Work() {
+  boost::mutex::scoped_lock lock(mutex_);
+  unsigned int generation = 0;
+  while (true) {
+    while (!stop_ && generation_ == generation) {
+      ready_.wait(lock);
+    }
+    if (stop_) { return; }
+    generation = generation_;
+    RunNodes(&lock, false);
+  }
+}
+
+void LayerScheduler::Impl::RunNodes(boost::mutex::scoped_lock* lock,
+    bool caller) {
+  while (pending_ > 0) {
+    // The caller takes the lowest numbered node of either queue.
+    Queue* queue = &ready_nodes_;
+    if (caller && !caller_nodes_.empty() && (ready_nodes_.empty() ||
+        caller_nodes_.top() < ready_nodes_.top())) {
+      queue = &caller_nodes_;
+    }
+    if (queue->empty()) {
+      ready_.wait(*lock);
+      continue;
+    }
+    const int node = queue->top();
+    queue->pop();
+    if (active_[node]) {
+      lock->unlock();
+      task_(context_, node);
+      lock->lock();
+    }
+    bool woke = false;
+    for (int i = 0; i < successors_[node].size(); ++i) {
+      const int successor = successors_[node][i];
+      if (--waiting_[successor] == 0) {
+        Ready(successor);
+        woke = true;
+      }
+    }
+    if (--pending_ == 0) {
+      done_.notify_all();
+      ready_.notify_all();
+    } else if (woke) {
+      ready_.notify_all();
+    }
+  }
+}
+
+void LayerScheduler::Impl::Run(const vector<vector<int> >& predecessors,
+    const vector<bool>& active, const vector<bool>& on_caller, Task task,
+    void* context) {
+  boost::mutex::scoped_lock lock(mutex_);
+  const int num_nodes = predecessors.size();
+  task_ = task;
+  context_ = context;
+  active_ = active;
+  on_caller_ = on_caller;
+  on_caller_.resize(num_nodes, false);
+  successors_.assign(num_nodes, vector<int>());
+  waiting_.assign(num_nodes, 0);
+  pending_ = num_nodes;
+  for (int node = 0; node < num_nodes; ++node) {
+    for (int i = 0; i < predecessors[node].size(); ++i) {
+      const int predecessor = predecessors[node][i];
+      CHECK_LT(predecessor, node) << "Nodes must follow their predecessors.";
+      successors_[predecessor].push_back(node);
+      ++waiting_[node];
+    }
+    if (waiting_[node] == 0) {
+      Ready(node);
+    }
+  }
+  ++generation_;
+  ready_.notify_all();
+  RunNodes(&lock, true);
+  while (pending_ > 0) {
+    done_.wait(lock);
+  }
+}
+
+LayerScheduler::LayerScheduler(int threads)
+    : threads_(threads), impl_(new Impl(threads)) {
+  CHECK_GT(threads, 0);
+}
+
+LayerScheduler::~LayerScheduler() {}
+
+void LayerScheduler::Run(const vector<vector<int> >& predecessors,
+    const vector<bool>& active, const vector<bool>& on_caller, Task task,
+    void* context) {
+  impl_->Run(predecessors, active, on_caller, task, context);
+}
+
+}  // namespace caffe
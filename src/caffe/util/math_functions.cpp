@@ -4,11 +4,21 @@
 #include <limits>
 
 #include "caffe/common.hpp"
+#include "caffe/util/builtin_gemm.hpp"
 #include "caffe/util/math_functions.hpp"
 #include "caffe/util/rng.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+void caffe_set_blas_threads(const int threads) {
+#ifdef USE_MKL
+  mkl_set_num_threads(threads);
+#elif defined(USE_OPENBLAS)
+  openblas_set_num_threads(threads);
+#endif
+}
+
 template<>
 void caffe_cpu_gemm<float>(const CBLAS_TRANSPOSE TransA,
     const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
@@ -16,8 +26,13 @@ void caffe_cpu_gemm<float>(const CBLAS_TRANSPOSE TransA,
     float* C) {
   int lda = (TransA == CblasNoTrans) ? K : M;
   int ldb = (TransB == CblasNoTrans) ? N : K;
+#ifdef USE_BUILTIN_GEMM
+  caffe_builtin_gemm(TransA, TransB, M, N, K, alpha, A, lda, B, ldb, beta, C,
+      N);
+#else
   cblas_sgemm(CblasRowMajor, TransA, TransB, M, N, K, alpha, A, lda, B,
       ldb, beta, C, N);
+#endif
 }
 
 template<>
@@ -27,22 +42,101 @@ void caffe_cpu_gemm<double>(const CBLAS_TRANSPOSE TransA,
     double* C) {
   int lda = (TransA == CblasNoTrans) ? K : M;
   int ldb = (TransB == CblasNoTrans) ? N : K;
+#ifdef USE_BUILTIN_GEMM
+  caffe_builtin_gemm(TransA, TransB, M, N, K, alpha, A, lda, B, ldb, beta, C,
+      N);
+#else
   cblas_dgemm(CblasRowMajor, TransA, TransB, M, N, K, alpha, A, lda, B,
       ldb, beta, C, N);
+#endif
+}
+
+template<>
+void caffe_cpu_gemm<float>(const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const float alpha, const float* A, const int lda, const float* B,
+    const int ldb, const float beta, float* C, const int ldc) {
+#ifdef USE_BUILTIN_GEMM
+  caffe_builtin_gemm(TransA, TransB, M, N, K, alpha, A, lda, B, ldb, beta, C,
+      ldc);
+#else
+  cblas_sgemm(CblasRowMajor, TransA, TransB, M, N, K, alpha, A, lda, B,
+      ldb, beta, C, ldc);
+#endif
+}
+
+template<>
+void caffe_cpu_gemm<double>(const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const double alpha, const double* A, const int lda, const double* B,
+    const int ldb, const double beta, double* C, const int ldc) {
+#ifdef USE_BUILTIN_GEMM
+  caffe_builtin_gemm(TransA, TransB, M, N, K, alpha, A, lda, B, ldb, beta, C,
+      ldc);
+#else
+  cblas_dgemm(CblasRowMajor, TransA, TransB, M, N, K, alpha, A, lda, B,
+      ldb, beta, C, ldc);
+#endif
+}
+
+void caffe_cpu_gemm_s8(const int M, const int N, const int K,
+    const int8_t* A, const int8_t* B, int32_t* C) {
+  // Both operands are contiguous along K, so every output is a dot product
+  // the compiler can vectorize; four rows of B share each pass over a row
+  // of A.
+  for (int i = 0; i < M; ++i) {
+    const int8_t* a = A + i * K;
+    int32_t* c = C + i * N;
+    int j = 0;
+    for (; j + 4 <= N; j += 4) {
+      const int8_t* b0 = B + j * K;
+      const int8_t* b1 = b0 + K;
+      const int8_t* b2 = b1 + K;
+      const int8_t* b3 = b2 + K;
+      int32_t sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+      for (int k = 0; k < K; ++k) {
+        const int32_t x = a[k];
+        sum0 += x * b0[k];
+        sum1 += x * b1[k];
+        sum2 += x * b2[k];
+        sum3 += x * b3[k];
+      }
+      c[j] = sum0;
+      c[j + 1] = sum1;
+      c[j + 2] = sum2;
+      c[j + 3] = sum3;
+    }
+    for (; j < N; ++j) {
+      const int8_t* b = B + j * K;
+      int32_t sum = 0;
+      for (int k = 0; k < K; ++k) {
+        sum += static_cast<int32_t>(a[k]) * b[k];
+      }
+      c[j] = sum;
+    }
+  }
 }
 
 template <>
 void caffe_cpu_gemv<float>(const CBLAS_TRANSPOSE TransA, const int M,
     const int N, const float alpha, const float* A, const float* x,
     const float beta, float* y) {
+#ifdef USE_BUILTIN_GEMM
+  caffe_builtin_gemv(TransA, M, N, alpha, A, x, beta, y);
+#else
   cblas_sgemv(CblasRowMajor, TransA, M, N, alpha, A, N, x, 1, beta, y, 1);
+#endif
 }
 
 template <>
 void caffe_cpu_gemv<double>(const CBLAS_TRANSPOSE TransA, const int M,
     const int N, const double alpha, const double* A, const double* x,
     const double beta, double* y) {
+#ifdef USE_BUILTIN_GEMM
+  caffe_builtin_gemv(TransA, M, N, alpha, A, x, beta, y);
+#else
   cblas_dgemv(CblasRowMajor, TransA, M, N, alpha, A, N, x, 1, beta, y, 1);
+#endif
 }
 
 template <>
@@ -53,15 +147,46 @@ template <>
 void caffe_axpy<double>(const int N, const double alpha, const double* X,
     double* Y) { cblas_daxpy(N, alpha, X, 1, Y, 1); }
 
+namespace {
+
+// Large fills and copies are split over the CPU thread pool in ranges of at
+// least this many bytes.
+const int kParallelCopyBytes = 1 << 18;
+
 template <typename Dtype>
-void caffe_set(const int N, const Dtype alpha, Dtype* Y) {
-  if (alpha == 0) {
-    memset(Y, 0, sizeof(Dtype) * N);  // NOLINT(caffe/alt_fn)
-    return;
+struct SetRange {
+  SetRange(const Dtype alpha, Dtype* Y) : alpha(alpha), Y(Y) {}
+  void operator()(int begin, int end) const {
+    if (alpha == 0) {
+      // NOLINT_NEXT_LINE(caffe/alt_fn)
+      memset(Y + begin, 0, sizeof(Dtype) * (end - begin));
+      return;
+    }
+    for (int i = begin; i < end; ++i) {
+      Y[i] = alpha;
+    }
   }
-  for (int i = 0; i < N; ++i) {
-    Y[i] = alpha;
+  const Dtype alpha;
+  Dtype* const Y;
+};
+
+template <typename Dtype>
+struct CopyRange {
+  CopyRange(const Dtype* X, Dtype* Y) : X(X), Y(Y) {}
+  void operator()(int begin, int end) const {
+    // NOLINT_NEXT_LINE(caffe/alt_fn)
+    memcpy(Y + begin, X + begin, sizeof(Dtype) * (end - begin));
   }
+  const Dtype* const X;
+  Dtype* const Y;
+};
+
+}  // namespace
+
+template <typename Dtype>
+void caffe_set(const int N, const Dtype alpha, Dtype* Y) {
+  parallel_for(N, SetRange<Dtype>(alpha, Y),
+      kParallelCopyBytes / sizeof(Dtype));
 }
 
 template void caffe_set<int>(const int N, const int alpha, int* Y);
@@ -93,7 +218,8 @@ void caffe_copy(const int N, const Dtype* X, Dtype* Y) {
       NO_GPU;
 #endif
     } else {
-      memcpy(Y, X, sizeof(Dtype) * N);  // NOLINT(caffe/alt_fn)
+      parallel_for(N, CopyRange<Dtype>(X, Y),
+          kParallelCopyBytes / sizeof(Dtype));
     }
   }
 }
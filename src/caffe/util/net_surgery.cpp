@@ -0,0 +1,21 @@
+#include <string>
+
+#include "caffe/common.hpp"
+#include "caffe/util/net_surgery.hpp"
+
+namespace caffe {
+
+bool BlobReadLater(const NetParameter& param, int after, const string& blob) {
+  for (int i = after + 1; i < param.layer_size(); ++i) {
+    const LayerParameter& layer = param.layer(i);
+    for (int j = 0; j < layer.bottom_size(); ++j) {
+      if (layer.bottom(j) == blob) { return true; }
+    }
+    for (int j = 0; j < layer.top_size(); ++j) {
+      if (layer.top(j) == blob) { return false; }
+    }
+  }
+  return false;
+}
+
+}  // namespace caffe
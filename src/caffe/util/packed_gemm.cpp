@@ -0,0 +1,243 @@
+#include <algorithm>
+
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/packed_gemm.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+namespace {
+
+#ifdef USE_MKL
+// The MKL packed GEMM, with the weights as B (transposed) for Y = X W^T and
+// as A for Y = W X.
+template <typename Dtype>
+size_t mkl_pack_size(bool transposed, int rows, int cols, int m);
+template <typename Dtype>
+void mkl_pack(bool transposed, int rows, int cols, int m, const Dtype* w,
+    Dtype* packed);
+template <typename Dtype>
+void mkl_compute(bool transposed, int rows, int cols, int m,
+    const Dtype* packed, const Dtype* x, Dtype* y);
+
+template <>
+size_t mkl_pack_size<float>(bool transposed, int rows, int cols, int m) {
+  return transposed ?
+      cblas_sgemm_pack_get_size(CblasBMatrix, m, rows, cols) :
+      cblas_sgemm_pack_get_size(CblasAMatrix, rows, m, cols);
+}
+
+template <>
+size_t mkl_pack_size<double>(bool transposed, int rows, int cols, int m) {
+  return transposed ?
+      cblas_dgemm_pack_get_size(CblasBMatrix, m, rows, cols) :
+      cblas_dgemm_pack_get_size(CblasAMatrix, rows, m, cols);
+}
+
+template <>
+void mkl_pack<float>(bool transposed, int rows, int cols, int m,
+    const float* w, float* packed) {
+  if (transposed) {
+    cblas_sgemm_pack(CblasRowMajor, CblasBMatrix, CblasTrans, m, rows, cols,
+        1.f, w, cols, packed);
+  } else {
+    cblas_sgemm_pack(CblasRowMajor, CblasAMatrix, CblasNoTrans, rows, m, cols,
+        1.f, w, cols, packed);
+  }
+}
+
+template <>
+void mkl_pack<double>(bool transposed, int rows, int cols, int m,
+    const double* w, double* packed) {
+  if (transposed) {
+    cblas_dgemm_pack(CblasRowMajor, CblasBMatrix, CblasTrans, m, rows, cols,
+        1., w, cols, packed);
+  } else {
+    cblas_dgemm_pack(CblasRowMajor, CblasAMatrix, CblasNoTrans, rows, m, cols,
+        1., w, cols, packed);
+  }
+}
+
+template <>
+void mkl_compute<float>(bool transposed, int rows, int cols, int m,
+    const float* packed, const float* x, float* y) {
+  if (transposed) {
+    cblas_sgemm_compute(CblasRowMajor, CblasNoTrans, CblasPacked, m, rows,
+        cols, x, cols, packed, cols, 0.f, y, rows);
+  } else {
+    cblas_sgemm_compute(CblasRowMajor, CblasPacked, CblasNoTrans, rows, m,
+        cols, packed, cols, x, m, 0.f, y, m);
+  }
+}
+
+template <>
+void mkl_compute<double>(bool transposed, int rows, int cols, int m,
+    const double* packed, const double* x, double* y) {
+  if (transposed) {
+    cblas_dgemm_compute(CblasRowMajor, CblasNoTrans, CblasPacked, m, rows,
+        cols, x, cols, packed, cols, 0., y, rows);
+  } else {
+    cblas_dgemm_compute(CblasRowMajor, CblasPacked, CblasNoTrans, rows, m,
+        cols, packed, cols, x, m, 0., y, m);
+  }
+}
+#else
+const int kPanel = PackedWeights<float>::kPanel;
+// The rows of X multiplied at once by a panel, sharing its loads.
+const int kRowBlock = 4;
+
+// Copies rows x cols weights into panels of kPanel rows, each storing the
+// kPanel weights of a column next to each other, the last one padded with
+// zeros.
+template <typename Dtype>
+void pack_panels(int rows, int cols, const Dtype* w, Dtype* packed) {
+  const int panels = (rows + kPanel - 1) / kPanel;
+  caffe_set(panels * kPanel * cols, Dtype(0), packed);
+  for (int r = 0; r < rows; ++r) {
+    Dtype* panel = packed + (r / kPanel) * kPanel * cols + r % kPanel;
+    for (int k = 0; k < cols; ++k) {
+      panel[k * kPanel] = w[r * cols + k];
+    }
+  }
+}
+
+// Computes the outputs of ranges of panels for the m rows of X, where X(i, k)
+// is x[i * x_row + k * x_col] and Y(i, r) is y[i * y_row + r * y_col].
+template <typename Dtype>
+struct PanelProduct {
+  PanelProduct(int rows, int cols, int m, const Dtype* packed,
+      const Dtype* x, int x_row, int x_col, Dtype* y, int y_row, int y_col)
+      : rows(rows), cols(cols), m(m), packed(packed), x(x), x_row(x_row),
+        x_col(x_col), y(y), y_row(y_row), y_col(y_col) {}
+  void operator()(int begin, int end) const {
+    Dtype acc[kRowBlock][kPanel];
+    for (int p = begin; p < end; ++p) {
+      const Dtype* panel = packed + p * kPanel * cols;
+      const int r0 = p * kPanel;
+      const int panel_rows = std::min(kPanel, rows - r0);
+      for (int i0 = 0; i0 < m; i0 += kRowBlock) {
+        const int block_rows = std::min(kRowBlock, m - i0);
+        caffe_set(kRowBlock * kPanel, Dtype(0), &acc[0][0]);
+        if (block_rows == kRowBlock) {
+          // The full blocks, with loop bounds the compiler can unroll.
+          for (int k = 0; k < cols; ++k) {
+            const Dtype* w = panel + k * kPanel;
+            const Dtype* xk = x + i0 * x_row + k * x_col;
+            for (int i = 0; i < kRowBlock; ++i) {
+              const Dtype xi = xk[i * x_row];
+              for (int j = 0; j < kPanel; ++j) {
+                acc[i][j] += xi * w[j];
+              }
+            }
+          }
+        } else {
+          for (int k = 0; k < cols; ++k) {
+            const Dtype* w = panel + k * kPanel;
+            const Dtype* xk = x + i0 * x_row + k * x_col;
+            for (int i = 0; i < block_rows; ++i) {
+              const Dtype xi = xk[i * x_row];
+              for (int j = 0; j < kPanel; ++j) {
+                acc[i][j] += xi * w[j];
+              }
+            }
+          }
+        }
+        for (int i = 0; i < block_rows; ++i) {
+          Dtype* yi = y + (i0 + i) * y_row + r0 * y_col;
+          for (int j = 0; j < panel_rows; ++j) {
+            yi[j * y_col] = acc[i][j];
+          }
+        }
+      }
+    }
+  }
+  const int rows, cols, m;
+  const Dtype* const packed;
+  const Dtype* const x;
+  const int x_row, x_col;
+  Dtype* const y;
+  const int y_row, y_col;
+};
+#endif  // USE_MKL
+
+}  // namespace
+
+template <typename Dtype>
+bool PackedWeights<Dtype>::Packs(int m) {
+#ifdef USE_MKL
+  return m > 0;
+#else
+  return m > 0 && m <= kPackedGemmMaxRows;
+#endif
+}
+
+template <typename Dtype>
+void PackedWeights<Dtype>::Pack(const Blob<Dtype>& weights, int groups,
+    int rows, int cols, int m, bool transposed) {
+  CHECK(Packs(m)) << "No packed product with " << m << " rows.";
+  CHECK_EQ(weights.count(), groups * rows * cols);
+  const shared_ptr<SyncedMemory>& data = weights.data();
+  bool current = data == source_ && data->version() == version_ &&
+      groups == groups_ && rows == rows_ && cols == cols_ &&
+      transposed == transposed_;
+#ifdef USE_MKL
+  // MKL packs for the given shape of the product.
+  current = current && m == m_;
+#endif
+  m_ = m;
+  if (current) { return; }
+#ifdef USE_MKL
+  // The packed size is in bytes, and may exceed the size of the weights.
+  const size_t bytes = mkl_pack_size<Dtype>(transposed, rows, cols, m);
+  group_size_ = (bytes + sizeof(Dtype) - 1) / sizeof(Dtype);
+#else
+  group_size_ = static_cast<size_t>((rows + kPanel - 1) / kPanel) * kPanel *
+      cols;
+#endif
+  if (!packed_ || packed_->size() < group_size_ * groups * sizeof(Dtype)) {
+    packed_.reset(new SyncedMemory(group_size_ * groups * sizeof(Dtype)));
+  }
+  Dtype* packed = static_cast<Dtype*>(packed_->mutable_cpu_data());
+  const Dtype* w = weights.cpu_data();
+  for (int g = 0; g < groups; ++g) {
+#ifdef USE_MKL
+    mkl_pack(transposed, rows, cols, m, w + g * rows * cols,
+        packed + g * group_size_);
+#else
+    pack_panels(rows, cols, w + g * rows * cols, packed + g * group_size_);
+#endif
+  }
+  groups_ = groups;
+  rows_ = rows;
+  cols_ = cols;
+  transposed_ = transposed;
+  source_ = data;
+  version_ = data->version();
+}
+
+template <typename Dtype>
+void PackedWeights<Dtype>::Multiply(int group, const Dtype* x, Dtype* y)
+    const {
+  CHECK(packed_) << "Pack the weights first.";
+  CHECK_GE(group, 0);
+  CHECK_LT(group, groups_);
+  const Dtype* packed =
+      static_cast<const Dtype*>(packed_->cpu_data()) + group * group_size_;
+#ifdef USE_MKL
+  mkl_compute(transposed_, rows_, cols_, m_, packed, x, y);
+#else
+  const int panels = (rows_ + kPanel - 1) / kPanel;
+  const int grain = std::max(1, kElementwiseGrain / (kPanel * cols_));
+  if (transposed_) {
+    parallel_for(panels, PanelProduct<Dtype>(rows_, cols_, m_, packed, x,
+        cols_, 1, y, rows_, 1), grain);
+  } else {
+    parallel_for(panels, PanelProduct<Dtype>(rows_, cols_, m_, packed, x,
+        1, m_, y, 1, m_), grain);
+  }
+#endif
+}
+
+INSTANTIATE_CLASS(PackedWeights);
+
+}  // namespace caffe
@@ -0,0 +1,77 @@
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "caffe/util/quantize.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+Dtype quantization_scale(const int n, const Dtype* x) {
+  Dtype max_abs = 0;
+  for (int i = 0; i < n; ++i) {
+    max_abs = std::max(max_abs, static_cast<Dtype>(std::fabs(x[i])));
+  }
+  return max_abs > 0 ? max_abs / 127 : Dtype(1);
+}
+
+template float quantization_scale<float>(const int n, const float* x);
+template double quantization_scale<double>(const int n, const double* x);
+
+template <typename Dtype>
+void quantize_cpu(const int n, const Dtype scale, const Dtype* x,
+    int8_t* q) {
+  const Dtype inv_scale = Dtype(1) / scale;
+  for (int i = 0; i < n; ++i) {
+    const Dtype v = std::min(std::max(x[i] * inv_scale, Dtype(-127)),
+        Dtype(127));
+    q[i] = static_cast<int8_t>(v >= 0 ? v + Dtype(0.5) : v - Dtype(0.5));
+  }
+}
+
+template void quantize_cpu<float>(const int n, const float scale,
+    const float* x, int8_t* q);
+template void quantize_cpu<double>(const int n, const double scale,
+    const double* x, int8_t* q);
+
+template <typename Dtype>
+void quantize_rows_cpu(const int rows, const int cols, const Dtype* x,
+    Dtype* q, Dtype* scales) {
+  std::vector<int8_t> row(cols);
+  for (int r = 0; r < rows; ++r) {
+    scales[r] = quantization_scale(cols, x + r * cols);
+    quantize_cpu(cols, scales[r], x + r * cols, &row[0]);
+    std::copy(row.begin(), row.end(), q + r * cols);
+  }
+}
+
+template void quantize_rows_cpu<float>(const int rows, const int cols,
+    const float* x, float* q, float* scales);
+template void quantize_rows_cpu<double>(const int rows, const int cols,
+    const double* x, double* q, double* scales);
+
+template <typename Dtype>
+void Int8BlobToProto(const Blob<Dtype>& blob, BlobProto* proto) {
+  proto->clear_shape();
+  for (int i = 0; i < blob.num_axes(); ++i) {
+    proto->mutable_shape()->add_dim(blob.shape(i));
+  }
+  proto->clear_data();
+  proto->clear_double_data();
+  const Dtype* data = blob.cpu_data();
+  std::string bytes(blob.count(), '\0');
+  for (int i = 0; i < blob.count(); ++i) {
+    CHECK(data[i] >= -127 && data[i] <= 127 && data[i] == std::floor(data[i]))
+        << "Not an int8 value: " << data[i];
+    bytes[i] = static_cast<char>(static_cast<int8_t>(data[i]));
+  }
+  proto->set_int8_data(bytes);
+}
+
+template void Int8BlobToProto<float>(const Blob<float>& blob,
+    BlobProto* proto);
+template void Int8BlobToProto<double>(const Blob<double>& blob,
+    BlobProto* proto);
+
+}  // namespace caffe
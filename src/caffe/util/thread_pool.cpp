@@ -0,0 +1,233 @@
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <vector>
+
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+namespace {
+
+// The pool parallel_for runs the loops of each thread on instead of the
+// process-wide one, if any. The pools belong to their users.
+void KeepPool(WorkerPool* pool) {}
+boost::thread_specific_ptr<WorkerPool> thread_pool_(&KeepPool);
+
+// A pool running loops serially, for the threads already running one.
+WorkerPool* SerialPool() {
+  static WorkerPool* pool = new WorkerPool(1);
+  return pool;
+}
+
+#ifdef __linux__
+void PinThread(int core) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(core, &set);
+  pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+#endif
+
+}  // namespace
+
+class ThreadPool {
+ public:
+  // Pins worker i to cores[i % cores.size()] if cores are given, or else to
+  // core i % (number of cores) if affinity is set.
+  ThreadPool(int threads, bool affinity, const vector<int>& cores);
+  ~ThreadPool();
+
+  // Runs the ranges of a loop on the workers and the calling thread.
+  void Run(int n, int grain, ParallelTask task, const void* body);
+
+  const int threads_;
+  const bool affinity_;
+  const vector<int> cores_;
+
+ private:
+  void Work(int id);
+  // Runs ranges of the current loop until none is left; lock holds mutex_.
+  void RunRanges(boost::mutex::scoped_lock* lock);
+
+  boost::mutex mutex_;
+  boost::condition_variable start_;
+  boost::condition_variable done_;
+  std::vector<shared_ptr<boost::thread> > workers_;
+  bool stop_;
+  // Incremented for each loop, to wake the workers.
+  unsigned int generation_;
+  // The current loop.
+  ParallelTask task_;
+  const void* body_;
+  int n_;
+  int ranges_;
+  int next_range_;
+  int done_ranges_;
+
+  DISABLE_COPY_AND_ASSIGN(ThreadPool);
+};
+
+ThreadPool::ThreadPool(int threads, bool affinity, const vector<int>& cores)
+    : threads_(threads), affinity_(affinity), cores_(cores), stop_(false),
+      generation_(0), task_(NULL), body_(NULL), n_(0), ranges_(0),
+      next_range_(0), done_ranges_(0) {
+  for (int i = 1; i < threads_; ++i) {
+    workers_.push_back(shared_ptr<boost::thread>(
+        new boost::thread(&ThreadPool::Work, this, i)));
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    stop_ = true;
+  }
+  start_.notify_all();
+  for (int i = 0; i < workers_.size(); ++i) {
+    workers_[i]->join();
+  }
+}
+
+void ThreadPool::Work(int id) {
+#ifdef __linux__
+  if (cores_.size() > 0) {
+    PinThread(cores_[id % cores_.size()]);
+  } else if (affinity_) {
+    // Worker i (from 1) runs on core i % cores, wrapping back to core 0
+    // with more threads than cores. The thread starting loops is not
+    // pinned, as the threads it creates later would inherit its mask.
+    const int cores = std::max(1U, boost::thread::hardware_concurrency());
+    PinThread(id % cores);
+  }
+#endif
+  // Loops started from the loop bodies run serially.
+  thread_pool_.reset(SerialPool());
+#ifdef USE_MKL
+  // The loops already use all threads.
+  mkl_set_num_threads_local(1);
+#endif
+  boost::mutex::scoped_lock lock(mutex_);
+  unsigned int generation = 0;
+  while (true) {
+    while (!stop_ && generation_ == generation) {
+      start_.wait(lock);
+    }
+    if (stop_) { return; }
+    generation = generation_;
+    RunRanges(&lock);
+  }
+}
+
+void ThreadPool::RunRanges(boost::mutex::scoped_lock* lock) {
+  while (next_range_ < ranges_) {
+    const int range = next_range_++;
+    const int begin = static_cast<int64_t>(n_) * range / ranges_;
+    const int end = static_cast<int64_t>(n_) * (range + 1) / ranges_;
+    lock->unlock();
+    task_(body_, begin, end);
+    lock->lock();
+    if (++done_ranges_ == ranges_) {
+      done_.notify_all();
+    }
+  }
+}
+
+void ThreadPool::Run(int n, int grain, ParallelTask task, const void* body) {
+  boost::mutex::scoped_lock lock(mutex_);
+  task_ = task;
+  body_ = body;
+  n_ = n;
+  ranges_ = std::min(threads_, n / std::max(grain, 1));
+  next_range_ = 0;
+  done_ranges_ = 0;
+  ++generation_;
+  start_.notify_all();
+  RunRanges(&lock);
+  while (done_ranges_ < ranges_) {
+    done_.wait(lock);
+  }
+}
+
+namespace {
+
+// The pool, and whether a loop is running on it.
+boost::mutex pool_mutex_;
+shared_ptr<ThreadPool> pool_;
+bool pool_busy_ = false;
+
+}  // namespace
+
+void SetParallelForPool(WorkerPool* pool) {
+  thread_pool_.reset(pool);
+}
+
+void RunParallel(const int n, const int grain, ParallelTask task,
+    const void* body) {
+  WorkerPool* worker_pool = thread_pool_.get();
+  if (worker_pool) {
+    worker_pool->Run(n, grain, task, body);
+    return;
+  }
+  if (Caffe::cpu_threads() == 1) {
+    task(body, 0, n);
+    return;
+  }
+  shared_ptr<ThreadPool> pool;
+  {
+    boost::mutex::scoped_lock lock(pool_mutex_);
+    if (!pool_busy_) {
+      pool_busy_ = true;
+      const int threads = Caffe::cpu_threads();
+      const bool affinity = Caffe::cpu_thread_affinity();
+      if (!pool_ || pool_->threads_ != threads ||
+          pool_->affinity_ != affinity) {
+        pool_.reset();
+        pool_.reset(new ThreadPool(threads, affinity, vector<int>()));
+      }
+      pool = pool_;
+    }
+  }
+  if (!pool) {
+    task(body, 0, n);
+    return;
+  }
+  pool->Run(n, grain, task, body);
+  boost::mutex::scoped_lock lock(pool_mutex_);
+  pool_busy_ = false;
+}
+
+WorkerPool::WorkerPool(int threads) : threads_(threads) {
+  CHECK_GE(threads, 1);
+  if (threads > 1) {
+    pool_.reset(new ThreadPool(threads, false, vector<int>()));
+  }
+}
+
+WorkerPool::WorkerPool(const vector<int>& cores) : threads_(cores.size()) {
+  CHECK_GE(threads_, 1);
+  if (threads_ > 1) {
+    pool_.reset(new ThreadPool(threads_, false, cores));
+  }
+}
+
+void WorkerPool::Run(int n, int grain, ParallelTask task, const void* body)
+    const {
+  if (threads_ == 1) {
+    task(body, 0, n);
+    return;
+  }
+  // Loops started from the ranges the calling thread runs are serial, as
+  // on the workers.
+  WorkerPool* caller_pool = thread_pool_.get();
+  thread_pool_.reset(SerialPool());
+  pool_->Run(n, grain, task, body);
+  thread_pool_.reset(caller_pool);
+}
+
+}  // namespace caffe
@@ -40,6 +40,15 @@ DEFINE_string(weights, "",
     "separated by ','. Cannot be set simultaneously with snapshot.");
 DEFINE_int32(iterations, 50,
     "The number of iterations to run.");
+DEFINE_int32(cpu_threads, 0,
+    "Optional; the number of threads running the CPU layers and BLAS, by "
+    "default one per core.");
+DEFINE_bool(cpu_thread_affinity, false,
+    "Optional; pin the threads running the CPU layers to one core each.");
+DEFINE_int32(pipeline_stages, 0,
+    "Optional; test in CPU mode with the net split in this many stages, "
+    "each on its own thread and NUMA node, streaming the batches through "
+    "them.");
 DEFINE_string(sigint_effect, "stop",
              "Optional; action to take when a SIGINT signal is received: "
               "snapshot, stop or none.");
@@ -219,6 +228,38 @@ RegisterBrewFunction(train);
 
 
 // Test: score a model.
+// Test a net split in pipeline stages, reporting its throughput.
+int test_pipeline(const Net<float>& caffe_net) {
+  caffe::NetParameter net_param;
+  caffe::ReadNetParamsFromTextFileOrDie(FLAGS_model, &net_param);
+  caffe::PipelineParameter pipeline_param;
+  pipeline_param.set_stages(FLAGS_pipeline_stages);
+  caffe::Pipeline<float> pipeline(net_param, caffe_net, pipeline_param);
+  Timer timer;
+  timer.Start();
+  const vector<Blob<float>*>& result = pipeline.Run(FLAGS_iterations);
+  timer.Stop();
+  LOG(INFO) << "Ran " << FLAGS_iterations << " batches in "
+      << timer.MilliSeconds() << " ms: "
+      << FLAGS_iterations / timer.Seconds() << " batches per second.";
+  for (int j = 0; j < result.size(); ++j) {
+    const std::string& output_name = pipeline.output_blob_names()[j];
+    const float loss_weight = caffe_net.blob_loss_weights()[
+        caffe_net.output_blob_indices()[j]];
+    const float* result_vec = result[j]->cpu_data();
+    for (int k = 0; k < result[j]->count(); ++k) {
+      std::ostringstream loss_msg_stream;
+      if (loss_weight) {
+        loss_msg_stream << " (* " << loss_weight
+                        << " = " << loss_weight * result_vec[k] << " loss)";
+      }
+      LOG(INFO) << output_name << " = " << result_vec[k]
+          << loss_msg_stream.str();
+    }
+  }
+  return 0;
+}
+
 int test() {
   CHECK_GT(FLAGS_model.size(), 0) << "Need a model definition to score.";
   CHECK_GT(FLAGS_weights.size(), 0) << "Need model weights to score.";
@@ -238,6 +279,10 @@ int test() {
   Net<float> caffe_net(FLAGS_model, caffe::TEST);
   caffe_net.CopyTrainedLayersFrom(FLAGS_weights);
   LOG(INFO) << "Running for " << FLAGS_iterations << " iterations.";
+  if (FLAGS_pipeline_stages > 1) {
+    CHECK_EQ(gpus.size(), 0) << "Pipelines run in CPU mode.";
+    return test_pipeline(caffe_net);
+  }
 
   vector<Blob<float>* > bottom_vec;
   vector<int> test_score_output_id;
@@ -388,6 +433,10 @@ int main(int argc, char** argv) {
       "  time            benchmark model execution time");
   // Run tool or show usage.
   caffe::GlobalInit(&argc, &argv);
+  if (FLAGS_cpu_threads > 0) {
+    Caffe::set_cpu_threads(FLAGS_cpu_threads);
+  }
+  Caffe::set_cpu_thread_affinity(FLAGS_cpu_thread_affinity);
   if (argc == 2) {
 #ifdef WITH_PYTHON_LAYER
     try {
@@ -0,0 +1,123 @@
+// This program folds the BatchNorm layers, and Power layers of power 1, that
+// follow a Convolution or InnerProduct layer of a trained net into the
+// weights and bias of that layer, and checks that the result computes the
+// same outputs as the original.
+// Usage:
+//    fold_affine_layers -model net.prototxt -weights net.caffemodel
+//        -output_model net_folded.prototxt
+//        -output_weights net_folded.caffemodel
+//
+// The folded net is meant for the TEST phase. The check runs both nets on
+// random values for the net inputs, and on the batches of the original net's
+// data layers for nets reading their own data.
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "caffe/caffe.hpp"
+#include "caffe/util/fold_affine.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+using caffe::Blob;
+using caffe::Caffe;
+using caffe::Net;
+using caffe::NetParameter;
+using std::string;
+using std::vector;
+
+DEFINE_string(model, "",
+    "The model definition protocol buffer text file.");
+DEFINE_string(weights, "",
+    "The trained weights.");
+DEFINE_string(output_model, "",
+    "The folded model definition to write.");
+DEFINE_string(output_weights, "",
+    "The folded weights to write.");
+DEFINE_int32(iterations, 3,
+    "The number of batches to compare the folded net with.");
+DEFINE_double(tolerance, 1e-4,
+    "The largest difference allowed between the outputs of the nets, "
+    "relative to the largest output magnitude.");
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;
+  gflags::SetUsageMessage("Folds the affine layers following the "
+      "Convolution and InnerProduct layers of a trained net into them.\n"
+      "Usage: fold_affine_layers -model net.prototxt -weights net.caffemodel "
+      "-output_model net_folded.prototxt "
+      "-output_weights net_folded.caffemodel");
+  caffe::GlobalInit(&argc, &argv);
+  CHECK_GT(FLAGS_model.size(), 0) << "Need a model definition.";
+  CHECK_GT(FLAGS_weights.size(), 0) << "Need model weights.";
+  CHECK_GT(FLAGS_output_model.size(), 0) << "Need an output model.";
+  CHECK_GT(FLAGS_output_weights.size(), 0) << "Need output weights.";
+  Caffe::set_mode(Caffe::CPU);
+
+  NetParameter model;
+  caffe::ReadNetParamsFromTextFileOrDie(FLAGS_model, &model);
+  NetParameter weights;
+  caffe::ReadNetParamsFromBinaryFileOrDie(FLAGS_weights, &weights);
+  NetParameter folded_model;
+  NetParameter folded_weights;
+  const int folded = caffe::FoldAffineLayers(model, weights, &folded_model,
+      &folded_weights);
+  caffe::WriteProtoToTextFile(folded_model, FLAGS_output_model);
+  caffe::WriteProtoToBinaryFile(folded_weights, FLAGS_output_weights);
+  LOG(INFO) << "Folded " << folded << " layers.";
+
+  // Compare: feed both nets the same random inputs, or the batches of the
+  // data layers of the original one.
+  Net<float> net(FLAGS_model, caffe::TEST);
+  net.CopyTrainedLayersFrom(FLAGS_weights);
+  Net<float> folded_net(FLAGS_output_model, caffe::TEST);
+  folded_net.CopyTrainedLayersFrom(FLAGS_output_weights);
+  int first = 0;
+  while (first < net.layers().size() && net.bottom_vecs()[first].empty()) {
+    ++first;
+  }
+  CHECK_LT(first, net.layers().size()) << "The net has no layer to compare.";
+  const vector<Blob<float>*>& outputs = net.output_blobs();
+  const vector<Blob<float>*>& folded_outputs = folded_net.output_blobs();
+  CHECK_EQ(outputs.size(), folded_outputs.size());
+  double max_value = 0;
+  double max_diff = 0;
+  for (int iter = 0; iter < FLAGS_iterations; ++iter) {
+    for (int i = 0; i < net.input_blobs().size(); ++i) {
+      Blob<float>* input = net.input_blobs()[i];
+      caffe::caffe_rng_gaussian<float>(input->count(), 0, 1,
+          input->mutable_cpu_data());
+      folded_net.input_blobs()[i]->CopyFrom(*input, false, true);
+    }
+    if (first > 0) {
+      net.ForwardTo(first - 1);
+    }
+    for (int i = 0; i < first; ++i) {
+      const vector<Blob<float>*>& tops = net.top_vecs()[i];
+      for (int j = 0; j < tops.size(); ++j) {
+        const string& name = net.blob_names()[net.top_ids(i)[j]];
+        folded_net.blob_by_name(name)->CopyFrom(*tops[j], false, true);
+      }
+    }
+    net.ForwardFrom(first);
+    folded_net.ForwardFrom(first);
+    for (int j = 0; j < outputs.size(); ++j) {
+      CHECK_EQ(outputs[j]->count(), folded_outputs[j]->count());
+      for (int k = 0; k < outputs[j]->count(); ++k) {
+        const float value = outputs[j]->cpu_data()[k];
+        max_value = std::max<double>(max_value, std::fabs(value));
+        max_diff = std::max<double>(max_diff,
+            std::fabs(value - folded_outputs[j]->cpu_data()[k]));
+      }
+    }
+  }
+  LOG(INFO) << "Largest output difference over " << FLAGS_iterations
+      << " batches: " << max_diff << " (largest output " << max_value << ").";
+  if (max_diff > FLAGS_tolerance * std::max(1.0, max_value)) {
+    LOG(ERROR) << "The folded net does not compute the same outputs.";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,194 @@
+// This program times Caffe's built-in GEMM against the linked BLAS on the
+// products the Convolution and InnerProduct layers issue, in Forward and
+// Backward, and checks that both give the same results.
+// Usage:
+//    gemm_benchmark [-model net.prototxt] [-batch 10] [-iterations 10]
+//
+// Without -model, the shapes are those of the CaffeNet reference model. With
+// it, they are read from the layers of the net, set up in the TEST phase,
+// whose inputs must have their shapes set as in a deploy model.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "caffe/caffe.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/builtin_gemm.hpp"
+#include "caffe/util/math_functions.hpp"
+
+using caffe::Blob;
+using caffe::Caffe;
+using caffe::CPUTimer;
+using caffe::Layer;
+using caffe::Net;
+using caffe::shared_ptr;
+using std::string;
+using std::vector;
+
+DEFINE_string(model, "",
+    "Optional; the model definition to read the layer shapes from.");
+DEFINE_int32(batch, 10,
+    "The batch size of the InnerProduct layers of the default shapes.");
+DEFINE_int32(iterations, 10,
+    "The number of times each product is run.");
+DEFINE_int32(cpu_threads, 0,
+    "Optional; the number of threads running the products, by default one "
+    "per core.");
+
+// The sizes of a layer: for a convolution, the output channels per group,
+// the output pixels and the kernel size times the input channels per group;
+// for an inner product, the items, the outputs and the inputs.
+struct LayerShape {
+  LayerShape(const string& name, bool conv, int m, int n, int k)
+      : name(name), conv(conv), m(m), n(n), k(k) {}
+  string name;
+  bool conv;
+  int m, n, k;
+};
+
+// A product C = op(A) op(B) with C of m x n and k the inner dimension.
+struct Gemm {
+  Gemm(const string& name, CBLAS_TRANSPOSE trans_a, CBLAS_TRANSPOSE trans_b,
+      int m, int n, int k)
+      : name(name), trans_a(trans_a), trans_b(trans_b), m(m), n(n), k(k) {}
+  string name;
+  CBLAS_TRANSPOSE trans_a, trans_b;
+  int m, n, k;
+};
+
+vector<LayerShape> CaffeNetShapes(int batch) {
+  vector<LayerShape> shapes;
+  shapes.push_back(LayerShape("conv1", true, 96, 55 * 55, 3 * 11 * 11));
+  shapes.push_back(LayerShape("conv2", true, 128, 27 * 27, 48 * 5 * 5));
+  shapes.push_back(LayerShape("conv3", true, 384, 13 * 13, 256 * 3 * 3));
+  shapes.push_back(LayerShape("conv4", true, 192, 13 * 13, 192 * 3 * 3));
+  shapes.push_back(LayerShape("conv5", true, 128, 13 * 13, 192 * 3 * 3));
+  shapes.push_back(LayerShape("fc6", false, batch, 4096, 256 * 6 * 6));
+  shapes.push_back(LayerShape("fc7", false, batch, 4096, 4096));
+  shapes.push_back(LayerShape("fc8", false, batch, 1000, 4096));
+  return shapes;
+}
+
+vector<LayerShape> NetShapes(const string& model) {
+  Net<float> net(model, caffe::TEST);
+  vector<LayerShape> shapes;
+  for (int i = 0; i < net.layers().size(); ++i) {
+    const shared_ptr<Layer<float> >& layer = net.layers()[i];
+    const string type = layer->type();
+    if (layer->blobs().empty()) { continue; }
+    const Blob<float>& weights = *layer->blobs()[0];
+    const Blob<float>& top = *net.top_vecs()[i][0];
+    if (type == "Convolution" && top.num_axes() > 2) {
+      const int group = layer->layer_param().convolution_param().group();
+      shapes.push_back(LayerShape(net.layer_names()[i], true,
+          weights.shape(0) / group, top.count(2), weights.count(1)));
+    } else if (type == "InnerProduct") {
+      shapes.push_back(LayerShape(net.layer_names()[i], false,
+          net.bottom_vecs()[i][0]->count() / weights.shape(1),
+          weights.shape(0), weights.shape(1)));
+    }
+  }
+  return shapes;
+}
+
+// The products of the Forward and Backward of a layer, as in
+// BaseConvolutionLayer and InnerProductLayer.
+void AddGemms(const LayerShape& s, vector<Gemm>* gemms) {
+  if (s.conv) {
+    gemms->push_back(Gemm(s.name + " forward", CblasNoTrans, CblasNoTrans,
+        s.m, s.n, s.k));
+    gemms->push_back(Gemm(s.name + " weight diff", CblasNoTrans, CblasTrans,
+        s.m, s.k, s.n));
+    gemms->push_back(Gemm(s.name + " bottom diff", CblasTrans, CblasNoTrans,
+        s.k, s.n, s.m));
+  } else {
+    gemms->push_back(Gemm(s.name + " forward", CblasNoTrans, CblasTrans,
+        s.m, s.n, s.k));
+    gemms->push_back(Gemm(s.name + " weight diff", CblasTrans, CblasNoTrans,
+        s.n, s.k, s.m));
+    gemms->push_back(Gemm(s.name + " bottom diff", CblasNoTrans,
+        CblasNoTrans, s.m, s.k, s.n));
+  }
+}
+
+// Returns the milliseconds per run of the builtin GEMM, or of the BLAS.
+float Time(const Gemm& g, bool builtin, const float* A, const float* B,
+    float* C) {
+  const int lda = g.trans_a == CblasNoTrans ? g.k : g.m;
+  const int ldb = g.trans_b == CblasNoTrans ? g.n : g.k;
+  CPUTimer timer;
+  // The first run warms the caches and the threads up.
+  for (int i = 0; i <= FLAGS_iterations; ++i) {
+    if (i == 1) { timer.Start(); }
+    if (builtin) {
+      caffe::caffe_builtin_gemm<float>(g.trans_a, g.trans_b, g.m, g.n, g.k,
+          1.f, A, lda, B, ldb, 0.f, C, g.n);
+    } else {
+      cblas_sgemm(CblasRowMajor, g.trans_a, g.trans_b, g.m, g.n, g.k, 1.f, A,
+          lda, B, ldb, 0.f, C, g.n);
+    }
+  }
+  timer.Stop();
+  return timer.MilliSeconds() / std::max(FLAGS_iterations, 1);
+}
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;
+  gflags::SetUsageMessage("Times Caffe's built-in GEMM against the linked "
+      "BLAS on the products of the Convolution and InnerProduct layers.\n"
+      "Usage: gemm_benchmark [-model net.prototxt] [-batch 10]");
+  caffe::GlobalInit(&argc, &argv);
+  Caffe::set_mode(Caffe::CPU);
+  if (FLAGS_cpu_threads > 0) {
+    Caffe::set_cpu_threads(FLAGS_cpu_threads);
+  }
+  const vector<LayerShape> shapes = FLAGS_model.size() ?
+      NetShapes(FLAGS_model) : CaffeNetShapes(FLAGS_batch);
+  vector<Gemm> gemms;
+  for (int i = 0; i < shapes.size(); ++i) {
+    AddGemms(shapes[i], &gemms);
+  }
+  CHECK_GT(gemms.size(), 0) << "No Convolution or InnerProduct layer.";
+
+  const char* format = "%-26s  %-2s  %6s %6s %6s  %8s  %11s  %11s  %15s";
+  char line[256];
+  snprintf(line, sizeof(line), format, "product", "op", "M", "N", "K",
+      "BLAS ms", "built-in ms", "BLAS GFLOPS", "built-in GFLOPS");
+  LOG(INFO) << line;
+  double blas_total = 0, builtin_total = 0;
+  for (int i = 0; i < gemms.size(); ++i) {
+    const Gemm& g = gemms[i];
+    Blob<float> A(vector<int>(1, g.m * g.k));
+    Blob<float> B(vector<int>(1, g.k * g.n));
+    Blob<float> C(vector<int>(1, g.m * g.n));
+    Blob<float> C_builtin(vector<int>(1, g.m * g.n));
+    caffe::caffe_rng_uniform<float>(A.count(), -1, 1, A.mutable_cpu_data());
+    caffe::caffe_rng_uniform<float>(B.count(), -1, 1, B.mutable_cpu_data());
+    const float blas_ms = Time(g, false, A.cpu_data(), B.cpu_data(),
+        C.mutable_cpu_data());
+    const float builtin_ms = Time(g, true, A.cpu_data(), B.cpu_data(),
+        C_builtin.mutable_cpu_data());
+    float max_diff = 0;
+    for (int j = 0; j < C.count(); ++j) {
+      max_diff = std::max(max_diff,
+          std::fabs(C.cpu_data()[j] - C_builtin.cpu_data()[j]));
+    }
+    CHECK_LE(max_diff, 1e-4 * g.k) << g.name << ": the results differ.";
+    const double gflop = 2e-9 * g.m * g.n * g.k;
+    snprintf(line, sizeof(line),
+        "%-26s  %c%c  %6d %6d %6d  %8.3f  %11.3f  %11.2f  %15.2f",
+        g.name.c_str(), g.trans_a == CblasNoTrans ? 'N' : 'T',
+        g.trans_b == CblasNoTrans ? 'N' : 'T', g.m, g.n, g.k, blas_ms,
+        builtin_ms, gflop / blas_ms * 1e3, gflop / builtin_ms * 1e3);
+    LOG(INFO) << line;
+    blas_total += blas_ms;
+    builtin_total += builtin_ms;
+  }
+  LOG(INFO) << "Total: BLAS " << blas_total << " ms, built-in "
+      << builtin_total << " ms, a speed-up of "
+      << blas_total / builtin_total << "x.";
+  return 0;
+}
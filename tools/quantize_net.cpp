@@ -0,0 +1,205 @@
+// This program converts the InnerProduct and Convolution layers of a trained
+// net into their int8 quantized variants for CPU inference, and reports the
+// accuracy and speed of the result against the original.
+// Usage:
+//    quantize_net -model net.prototxt -weights net.caffemodel
+//        -output_model net_int8.prototxt -output_weights net_int8.caffemodel
+//
+// The model must be a TEST net with its own data layers: the calibration
+// runs it for -iterations batches and sets the scale of each quantized
+// bottom from the largest magnitude seen, then both nets are run on the
+// same -compare_iterations further batches.
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "boost/algorithm/string.hpp"
+#include "caffe/caffe.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/quantize.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+using caffe::Blob;
+using caffe::BlobProto;
+using caffe::Caffe;
+using caffe::LayerParameter;
+using caffe::Net;
+using caffe::NetParameter;
+using caffe::Timer;
+using std::map;
+using std::string;
+using std::vector;
+
+DEFINE_string(model, "",
+    "The model definition protocol buffer text file, with TEST data layers.");
+DEFINE_string(weights, "",
+    "The trained weights to quantize.");
+DEFINE_string(output_model, "",
+    "The quantized model definition to write.");
+DEFINE_string(output_weights, "",
+    "The quantized weights to write.");
+DEFINE_string(layers, "",
+    "Optional; the layers to quantize, separated by ','. By default all "
+    "InnerProduct and 2D Convolution layers with one bottom.");
+DEFINE_int32(iterations, 10,
+    "The number of batches to gather the activation ranges from.");
+DEFINE_int32(compare_iterations, 10,
+    "The number of batches to compare the quantized net with.");
+
+// The quantized type of a layer, or "" if it is not quantized.
+string QuantizedType(const LayerParameter& layer, const vector<int>& shape) {
+  if (layer.bottom_size() != 1) { return ""; }
+  if (layer.type() == "InnerProduct") { return "QuantizedInnerProduct"; }
+  if (layer.type() == "Convolution" && shape.size() == 4 &&
+      !layer.convolution_param().force_nd_im2col()) {
+    return "QuantizedConvolution";
+  }
+  return "";
+}
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;
+  gflags::SetUsageMessage("Quantizes the InnerProduct and Convolution "
+      "layers of a trained net to int8.\n"
+      "Usage: quantize_net -model net.prototxt -weights net.caffemodel "
+      "-output_model net_int8.prototxt -output_weights net_int8.caffemodel");
+  caffe::GlobalInit(&argc, &argv);
+  CHECK_GT(FLAGS_model.size(), 0) << "Need a model definition.";
+  CHECK_GT(FLAGS_weights.size(), 0) << "Need model weights.";
+  CHECK_GT(FLAGS_output_model.size(), 0) << "Need an output model.";
+  CHECK_GT(FLAGS_output_weights.size(), 0) << "Need output weights.";
+  Caffe::set_mode(Caffe::CPU);
+
+  Net<float> net(FLAGS_model, caffe::TEST);
+  net.CopyTrainedLayersFrom(FLAGS_weights);
+  vector<string> only;
+  if (FLAGS_layers.size()) {
+    boost::split(only, FLAGS_layers, boost::is_any_of(","));
+  }
+  // Pick the layers to quantize.
+  map<string, int> quantized;  // layer name -> layer index in net
+  for (int i = 0; i < net.layers().size(); ++i) {
+    const LayerParameter& layer = net.layers()[i]->layer_param();
+    if (only.size() &&
+        std::find(only.begin(), only.end(), layer.name()) == only.end()) {
+      continue;
+    }
+    if (QuantizedType(layer, net.bottom_vecs()[i][0]->shape()).size()) {
+      quantized[layer.name()] = i;
+    }
+  }
+  CHECK_GT(quantized.size(), 0) << "No layer to quantize.";
+
+  // Calibrate: gather the largest magnitude of each quantized bottom.
+  map<string, float> bottom_max;
+  for (int iter = 0; iter < FLAGS_iterations; ++iter) {
+    net.ForwardFrom(0);
+    for (map<string, int>::const_iterator it = quantized.begin();
+         it != quantized.end(); ++it) {
+      const Blob<float>* bottom = net.bottom_vecs()[it->second][0];
+      const float scale = caffe::quantization_scale(bottom->count(),
+          bottom->cpu_data());
+      bottom_max[it->first] = std::max(bottom_max[it->first], 127 * scale);
+    }
+  }
+
+  // Rewrite the model definition and the weights.
+  NetParameter model;
+  caffe::ReadNetParamsFromTextFileOrDie(FLAGS_model, &model);
+  for (int i = 0; i < model.layer_size(); ++i) {
+    LayerParameter* layer = model.mutable_layer(i);
+    if (!quantized.count(layer->name())) { continue; }
+    const int index = quantized[layer->name()];
+    layer->set_type(QuantizedType(*layer,
+        net.bottom_vecs()[index][0]->shape()));
+    const float range = bottom_max[layer->name()];
+    layer->mutable_quantization_param()->set_bottom_scale(
+        range > 0 ? range / 127 : 1);
+  }
+  NetParameter weights;
+  net.ToProto(&weights, false);
+  size_t fp32_bytes = 0;
+  size_t int8_bytes = 0;
+  for (int i = 0; i < weights.layer_size(); ++i) {
+    LayerParameter* layer = weights.mutable_layer(i);
+    if (!quantized.count(layer->name())) { continue; }
+    Blob<float> blob;
+    blob.FromProto(layer->blobs(0));
+    Blob<float> scales(vector<int>(1, blob.shape(0)));
+    caffe::quantize_rows_cpu(blob.shape(0), blob.count(1), blob.cpu_data(),
+        blob.mutable_cpu_data(), scales.mutable_cpu_data());
+    caffe::Int8BlobToProto(blob, layer->mutable_blobs(0));
+    scales.ToProto(layer->add_blobs());
+    fp32_bytes += blob.count() * sizeof(float);
+    int8_bytes += blob.count() + scales.count() * sizeof(float);
+  }
+  caffe::WriteProtoToTextFile(model, FLAGS_output_model);
+  caffe::WriteProtoToBinaryFile(weights, FLAGS_output_weights);
+  LOG(INFO) << "Quantized " << quantized.size() << " layers; their weights "
+      << "take " << int8_bytes << " bytes instead of " << fp32_bytes << ".";
+
+  // Compare: feed both nets the inputs produced by the data layers of the
+  // original one.
+  Net<float> quantized_net(FLAGS_output_model, caffe::TEST);
+  quantized_net.CopyTrainedLayersFrom(FLAGS_output_weights);
+  int first = 0;
+  while (first < net.layers().size() && net.bottom_vecs()[first].empty()) {
+    ++first;
+  }
+  CHECK_LT(first, net.layers().size()) << "The net has no layer to compare.";
+  const vector<Blob<float>*>& outputs = net.output_blobs();
+  const vector<Blob<float>*>& quantized_outputs =
+      quantized_net.output_blobs();
+  vector<double> fp32_sum(outputs.size()), int8_sum(outputs.size());
+  vector<double> diff_sum(outputs.size()), diff_max(outputs.size());
+  double fp32_time = 0;
+  double int8_time = 0;
+  Timer timer;
+  for (int iter = 0; iter < FLAGS_compare_iterations; ++iter) {
+    net.ForwardTo(first - 1);
+    for (int i = 0; i < first; ++i) {
+      const vector<Blob<float>*>& tops = net.top_vecs()[i];
+      for (int j = 0; j < tops.size(); ++j) {
+        const string& name = net.blob_names()[net.top_ids(i)[j]];
+        quantized_net.blob_by_name(name)->CopyFrom(*tops[j], false, true);
+      }
+    }
+    timer.Start();
+    net.ForwardFrom(first);
+    fp32_time += timer.MicroSeconds();
+    timer.Start();
+    quantized_net.ForwardFrom(first);
+    int8_time += timer.MicroSeconds();
+    for (int j = 0; j < outputs.size(); ++j) {
+      const float* fp32 = outputs[j]->cpu_data();
+      const float* int8 = quantized_outputs[j]->cpu_data();
+      for (int k = 0; k < outputs[j]->count(); ++k) {
+        fp32_sum[j] += fp32[k];
+        int8_sum[j] += int8[k];
+        diff_sum[j] += std::fabs(fp32[k] - int8[k]);
+        diff_max[j] = std::max<double>(diff_max[j], std::fabs(fp32[k] -
+            int8[k]));
+      }
+    }
+  }
+  LOG(INFO) << "Accuracy of the quantized net over "
+      << FLAGS_compare_iterations << " batches:";
+  for (int j = 0; j < outputs.size(); ++j) {
+    const double count = static_cast<double>(outputs[j]->count()) *
+        FLAGS_compare_iterations;
+    LOG(INFO) << "  " << net.blob_names()[net.output_blob_indices()[j]]
+        << ": fp32 mean = " << fp32_sum[j] / count
+        << ", int8 mean = " << int8_sum[j] / count
+        << ", mean abs difference = " << diff_sum[j] / count
+        << ", max abs difference = " << diff_max[j];
+  }
+  LOG(INFO) << "Forward time after the data layers: fp32 "
+      << fp32_time / 1000 / FLAGS_compare_iterations << " ms, int8 "
+      << int8_time / 1000 / FLAGS_compare_iterations << " ms per batch ("
+      << fp32_time / int8_time << "x).";
+  return 0;
+}